@@ -7,6 +7,7 @@ extern "C" {
 
 #include <xconfigs.h>
 #include <arm32.h>
+#include <irqflags.h>
 
 #if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && !defined(__SANDBOX__)
 static inline int smp_processor_id(void)
@@ -28,6 +29,55 @@ static inline int smp_processor_id(void)
 }
 #endif
 
+/*
+ * Called with interrupts disabled, returns with interrupts disabled once an
+ * interrupt is pending or another cpu has sent a wakeup event.
+ */
+#if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && (__ARM32_ARCH__ >= 7) && !defined(__SANDBOX__)
+static inline void cpu_idle(void)
+{
+	arch_local_irq_enable();
+	__asm__ __volatile__("dsb\n" "wfe" : : : "memory");
+	arch_local_irq_disable();
+}
+
+static inline void cpu_wakeup(void)
+{
+	__asm__ __volatile__("dsb ishst\n" "sev" : : : "memory");
+}
+#elif defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1)
+static inline void cpu_idle(void)
+{
+}
+
+static inline void cpu_wakeup(void)
+{
+}
+#elif (__ARM32_ARCH__ >= 7)
+static inline void cpu_idle(void)
+{
+	__asm__ __volatile__("dsb\n" "wfi" : : : "memory");
+}
+
+static inline void cpu_wakeup(void)
+{
+}
+#else
+static inline void cpu_idle(void)
+{
+	__asm__ __volatile__(
+		"mcr p15, 0, %0, c7, c10, 4\n"
+		"mcr p15, 0, %0, c7, c0, 4"
+		:
+		: "r" (0)
+		: "memory");
+}
+
+static inline void cpu_wakeup(void)
+{
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,58 +5,92 @@
 extern "C" {
 #endif
 
+#include <xconfigs.h>
 #include <types.h>
 #include <barrier.h>
 #include <irqflags.h>
 
+/*
+ * Contention statistics, only updated on the slow path while the lock is held
+ */
+#if defined(CONFIG_SPINLOCK_STAT) && (CONFIG_SPINLOCK_STAT > 0)
+#define arch_spin_stat(lock, n)				do { (lock)->contended++; (lock)->spins += (n); } while(0)
+#define arch_spin_stat_init(lock)			do { (lock)->contended = 0; (lock)->spins = 0; } while(0)
+#else
+#define arch_spin_stat(lock, n)				do { } while(0)
+#define arch_spin_stat_init(lock)			do { } while(0)
+#endif
+
 #if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && (__ARM32_ARCH__ >= 6) && !defined(__SANDBOX__)
+#if (__ARM32_ARCH__ >= 7)
+#define arch_spin_wfe()						__asm__ __volatile__ ("wfe" : : : "memory")
+#define arch_spin_sev()						__asm__ __volatile__ ("dsb ishst\n" "sev" : : : "memory")
+#else
+#define arch_spin_wfe()						__asm__ __volatile__ ("" : : : "memory")
+#define arch_spin_sev()						__asm__ __volatile__ ("" : : : "memory")
+#endif
+
 static inline int arch_spin_trylock(spinlock_t * lock)
 {
-	unsigned int tmp;
+	unsigned int slock, contended, res;
 
-	__asm__ __volatile__(
-"	ldrex %0, [%1]\n"
-"	teq %0, #0\n"
-"	strexeq %0, %2, [%1]"
-	: "=&r" (tmp)
-	: "r" (&lock->lock), "r" (1)
-	: "cc");
+	do {
+		__asm__ __volatile__(
+"	ldrex %0, [%3]\n"
+"	mov %2, #0\n"
+"	subs %1, %0, %0, ror #16\n"
+"	addeq %0, %0, %4\n"
+"	strexeq %2, %0, [%3]"
+		: "=&r" (slock), "=&r" (contended), "=&r" (res)
+		: "r" (&lock->lock), "I" (1 << 16)
+		: "cc");
+	} while(res);
 
-	if(tmp == 0)
+	if(contended == 0)
 	{
 		smp_mb();
 		return 1;
 	}
-	else
-	{
-		return 0;
-	}
+	return 0;
 }
 
 static inline void arch_spin_lock(spinlock_t * lock)
 {
-	unsigned int tmp;
+	unsigned int lockval, newval, tmp;
+	unsigned short ticket;
+	unsigned int spins = 0;
 
 	__asm__ __volatile__(
-"1:	ldrex %0, [%1]\n"
-"	teq %0, #0\n"
-"	strexeq %0, %2, [%1]\n"
-"	teqeq %0, #0\n"
+"1:	ldrex %0, [%3]\n"
+"	add %1, %0, %4\n"
+"	strex %2, %1, [%3]\n"
+"	teq %2, #0\n"
 "	bne 1b"
-	: "=&r" (tmp)
-	: "r" (&lock->lock), "r" (1)
+	: "=&r" (lockval), "=&r" (newval), "=&r" (tmp)
+	: "r" (&lock->lock), "I" (1 << 16)
 	: "cc");
-	smp_mb();
+
+	ticket = lockval >> 16;
+	if(ticket != (unsigned short)lockval)
+	{
+		do {
+			arch_spin_wfe();
+			spins++;
+		} while(lock->tickets.owner != ticket);
+		smp_mb();
+		arch_spin_stat(lock, spins);
+	}
+	else
+	{
+		smp_mb();
+	}
 }
 
 static inline void arch_spin_unlock(spinlock_t * lock)
 {
 	smp_mb();
-	__asm__ __volatile__(
-"	str %1, [%0]\n"
-	:
-	: "r" (&lock->lock), "r" (0)
-	: "cc");
+	lock->tickets.owner++;
+	arch_spin_sev();
 }
 #else
 static inline int arch_spin_trylock(spinlock_t * lock)
@@ -77,7 +111,7 @@ static inline void arch_spin_unlock(spinlock_t * lock)
 #endif
 
 #define SPIN_LOCK_INIT()					{ .lock = 0 }
-#define spin_lock_init(plock)				do { (plock)->lock = 0; } while(0)
+#define spin_lock_init(plock)				do { (plock)->lock = 0; arch_spin_stat_init(plock); } while(0)
 #define spin_trylock(lock)					({ int __ret; __ret = arch_spin_trylock(lock); __ret; })
 #define spin_lock(lock)						do { arch_spin_lock(lock); } while(0)
 #define spin_unlock(lock)					do { arch_spin_unlock(lock); } while(0)
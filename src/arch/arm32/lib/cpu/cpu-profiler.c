@@ -2,29 +2,133 @@
  * cpu-profiler.c
  */
 
+#include <xboot.h>
+#include <xboot/profiler.h>
 #include <pmu.h>
 
-void cpu_profiler_start(int event, int data)
+/*
+ * The cycle counter and the event counters are 32 bits wide, they are
+ * widened here, which holds as long as a counter is read at least once
+ * every wrap around
+ */
+struct pmu_counter_t {
+	uint32_t last;
+	uint32_t high;
+};
+
+static struct pmu_counter_t __pmu_counter[CONFIG_MAX_SMP_CPUS][PROFILER_COUNTER_MAX];
+static int __pmu_present = 0;
+
+/*
+ * Only the armv7 cores with a PMUv2 or PMUv3, such as cortex-a7 and the
+ * cortex-a53 in aarch32, have the cp15 c9 interface
+ */
+static int pmu_probe(void)
 {
-	pmn_config(data, event);
-	pmn_enable(data);
+	uint32_t midr, dfr0, v;
+
+	__asm__ __volatile__("mrc p15, 0, %0, c0, c0, 0" : "=r"(midr));
+	if(((midr >> 16) & 0xf) != 0xf)
+		return 0;
+	__asm__ __volatile__("mrc p15, 0, %0, c0, c1, 2" : "=r"(dfr0));
+	v = (dfr0 >> 24) & 0xf;
+	if((v < 2) || (v == 0xf))
+		return 0;
+	return 1;
 }
 
-void cpu_profiler_stop(int event, int data)
+static inline uint32_t pmu_counter_read(int counter)
 {
-	pmn_disable(data);
+	switch(counter)
+	{
+	case PROFILER_COUNTER_CYCLES:
+		return ccnt_read();
+	case PROFILER_COUNTER_INSTRUCTIONS:
+		return pmn_read(0);
+	case PROFILER_COUNTER_CACHE_MISSES:
+		return pmn_read(1);
+	default:
+		break;
+	}
+	return 0;
 }
 
-uint64_t cpu_profiler_read(int event, int data)
+int cpu_profiler_start(int counter)
 {
-	return pmn_read(data);
+	struct pmu_counter_t * c;
+
+	if(!__pmu_present)
+		return -1;
+	switch(counter)
+	{
+	case PROFILER_COUNTER_CYCLES:
+		ccnt_enable();
+		break;
+	case PROFILER_COUNTER_INSTRUCTIONS:
+		if(pmn_number() < 1)
+			return -1;
+		pmn_config(0, INSTRUCTION);
+		pmn_enable(0);
+		break;
+	case PROFILER_COUNTER_CACHE_MISSES:
+		if(pmn_number() < 2)
+			return -1;
+		pmn_config(1, L1DCACHE_MISS);
+		pmn_enable(1);
+		break;
+	default:
+		return -1;
+	}
+	c = &__pmu_counter[smp_processor_id()][counter];
+	c->last = pmu_counter_read(counter);
+	c->high = 0;
+	return 0;
+}
+
+void cpu_profiler_stop(int counter)
+{
+	switch(counter)
+	{
+	case PROFILER_COUNTER_CYCLES:
+		ccnt_disable();
+		break;
+	case PROFILER_COUNTER_INSTRUCTIONS:
+		pmn_disable(0);
+		break;
+	case PROFILER_COUNTER_CACHE_MISSES:
+		pmn_disable(1);
+		break;
+	default:
+		break;
+	}
+}
+
+uint64_t cpu_profiler_read(int counter)
+{
+	struct pmu_counter_t * c = &__pmu_counter[smp_processor_id()][counter];
+	irq_flags_t flags;
+	uint32_t v;
+	uint64_t r;
+
+	local_irq_save(flags);
+	v = pmu_counter_read(counter);
+	if(v < c->last)
+		c->high++;
+	c->last = v;
+	r = ((uint64_t)c->high << 32) | v;
+	local_irq_restore(flags);
+	return r;
 }
 
 void cpu_profiler_reset(void)
 {
-	pmu_enable();
-	pmu_user_enable();
-	pmn_reset();
-	ccnt_reset();
-	ccnt_divider(0);
+	__pmu_present = pmu_probe();
+	if(__pmu_present)
+	{
+		pmu_enable();
+		pmu_user_enable();
+		pmn_reset();
+		ccnt_reset();
+		ccnt_divider(0);
+	}
 }
@@ -0,0 +1,127 @@
+/*
+ * render-span.c
+ */
+
+#include <xboot.h>
+#include <graphic/surface.h>
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+
+/*
+ * The same source over as blend() in the default render, done per
+ * channel as s + ((d * (256 - sa)) >> 8), which is what blend() works
+ * out to, so both agree bit for bit
+ */
+static inline uint32_t blend_pixel(uint32_t d, uint32_t s)
+{
+	uint32_t sa = s >> 24;
+	uint32_t ia, rb, ag;
+
+	if(sa == 255)
+		return s;
+	if(sa == 0)
+		return d;
+	ia = 256 - sa;
+	rb = (((d & 0x00ff00ff) * ia) >> 8) & 0x00ff00ff;
+	ag = (((d >> 8) & 0x00ff00ff) * ia) & 0xff00ff00;
+	return (((s & 0x00ff00ff) + rb) & 0x00ff00ff) | (((s & 0xff00ff00) + ag) & 0xff00ff00);
+}
+
+static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, int f)
+{
+	uint32_t rb = ((((a & 0x00ff00ff) * (256 - f)) + ((b & 0x00ff00ff) * f)) >> 8) & 0x00ff00ff;
+	uint32_t ag = ((((a >> 8) & 0x00ff00ff) * (256 - f)) + (((b >> 8) & 0x00ff00ff) * f)) & 0xff00ff00;
+	return rb | ag;
+}
+
+/*
+ * Eight pixels at a time, split into their b, g, r and a planes
+ */
+void render_span_blend(uint32_t * d, uint32_t * s, int n)
+{
+	uint16x8_t c = vdupq_n_u16(256);
+	uint8x8x4_t vs, vd;
+	uint16x8_t ia;
+	uint8x8_t z;
+	uint64_t a;
+
+	for(; n >= 8; n -= 8, d += 8, s += 8)
+	{
+		vs = vld4_u8((uint8_t *)s);
+		a = vget_lane_u64(vreinterpret_u64_u8(vs.val[3]), 0);
+		if(a == 0xffffffffffffffffULL)
+		{
+			vst1q_u32(d + 0, vld1q_u32(s + 0));
+			vst1q_u32(d + 4, vld1q_u32(s + 4));
+		}
+		else if(a != 0)
+		{
+			vd = vld4_u8((uint8_t *)d);
+			ia = vsubq_u16(c, vmovl_u8(vs.val[3]));
+			z = vceq_u8(vs.val[3], vdup_n_u8(0));
+			vd.val[0] = vbsl_u8(z, vd.val[0], vadd_u8(vs.val[0], vshrn_n_u16(vmulq_u16(vmovl_u8(vd.val[0]), ia), 8)));
+			vd.val[1] = vbsl_u8(z, vd.val[1], vadd_u8(vs.val[1], vshrn_n_u16(vmulq_u16(vmovl_u8(vd.val[1]), ia), 8)));
+			vd.val[2] = vbsl_u8(z, vd.val[2], vadd_u8(vs.val[2], vshrn_n_u16(vmulq_u16(vmovl_u8(vd.val[2]), ia), 8)));
+			vd.val[3] = vbsl_u8(z, vd.val[3], vadd_u8(vs.val[3], vshrn_n_u16(vmulq_u16(vmovl_u8(vd.val[3]), ia), 8)));
+			vst4_u8((uint8_t *)d, vd);
+		}
+	}
+	for(; n > 0; n--, d++, s++)
+		*d = blend_pixel(*d, *s);
+}
+
+void render_span_fill(uint32_t * d, uint32_t c, int n)
+{
+	uint32x4_t v = vdupq_n_u32(c);
+
+	for(; n >= 16; n -= 16, d += 16)
+	{
+		vst1q_u32(d + 0, v);
+		vst1q_u32(d + 4, v);
+		vst1q_u32(d + 8, v);
+		vst1q_u32(d + 12, v);
+	}
+	for(; n >= 4; n -= 4, d += 4)
+		vst1q_u32(d, v);
+	for(; n > 0; n--)
+		*d++ = c;
+}
+
+void render_span_copy(uint32_t * d, uint32_t * s, int n)
+{
+	for(; n >= 16; n -= 16, d += 16, s += 16)
+	{
+		vst1q_u32(d + 0, vld1q_u32(s + 0));
+		vst1q_u32(d + 4, vld1q_u32(s + 4));
+		vst1q_u32(d + 8, vld1q_u32(s + 8));
+		vst1q_u32(d + 12, vld1q_u32(s + 12));
+	}
+	for(; n >= 4; n -= 4, d += 4, s += 4)
+		vst1q_u32(d, vld1q_u32(s));
+	for(; n > 0; n--)
+		*d++ = *s++;
+}
+
+/*
+ * The channels are widened to 16 bits, where a * (256 - f) + b * f still
+ * fits unsigned, the same sum lerp_pixel() makes in its halfwords
+ */
+void render_span_lerp(uint32_t * d, uint32_t * a, uint32_t * b, int f, int n)
+{
+	uint16x8_t fa = vdupq_n_u16(256 - f);
+	uint16x8_t fb = vdupq_n_u16(f);
+	uint8x16_t va, vb;
+	uint16x8_t l, h;
+
+	for(; n >= 4; n -= 4, d += 4, a += 4, b += 4)
+	{
+		va = vld1q_u8((uint8_t *)a);
+		vb = vld1q_u8((uint8_t *)b);
+		l = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(va)), fa), vmovl_u8(vget_low_u8(vb)), fb);
+		h = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(va)), fa), vmovl_u8(vget_high_u8(vb)), fb);
+		vst1q_u8((uint8_t *)d, vcombine_u8(vshrn_n_u16(l, 8), vshrn_n_u16(h, 8)));
+	}
+	for(; n > 0; n--)
+		*d++ = lerp_pixel(*a++, *b++, f);
+}
+#endif
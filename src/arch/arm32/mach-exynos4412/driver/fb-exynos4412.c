@@ -605,6 +605,8 @@ static struct device_t * fb_exynos4412_probe(struct driver_t * drv, struct dtnod
 	fb->create = fb_create;
 	fb->destroy = fb_destroy;
 	fb->present = fb_present;
+	fb->create_surfaces = NULL;
+	fb->flip = NULL;
 	fb->priv = pdat;
 	fb_exynos4412_init(pdat);
 
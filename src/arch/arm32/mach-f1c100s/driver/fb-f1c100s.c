@@ -328,6 +328,8 @@ static struct device_t * fb_f1c100s_probe(struct driver_t * drv, struct dtnode_t
 	fb->create = fb_create;
 	fb->destroy = fb_destroy;
 	fb->present = fb_present;
+	fb->create_surfaces = NULL;
+	fb->flip = NULL;
 	fb->priv = pdat;
 
 	clk_enable(pdat->clkdefe);
@@ -7,6 +7,7 @@ extern "C" {
 
 #include <xconfigs.h>
 #include <arm64.h>
+#include <irqflags.h>
 
 #if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && !defined(__SANDBOX__)
 static inline int smp_processor_id(void)
@@ -20,6 +21,33 @@ static inline int smp_processor_id(void)
 }
 #endif
 
+/*
+ * Called with interrupts disabled, returns with interrupts disabled once an
+ * interrupt is pending or another cpu has sent a wakeup event.
+ */
+#if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && !defined(__SANDBOX__)
+static inline void cpu_idle(void)
+{
+	arch_local_irq_enable();
+	__asm__ __volatile__("dsb sy\n" "wfe" : : : "memory");
+	arch_local_irq_disable();
+}
+
+static inline void cpu_wakeup(void)
+{
+	__asm__ __volatile__("dsb ishst\n" "sev" : : : "memory");
+}
+#else
+static inline void cpu_idle(void)
+{
+	__asm__ __volatile__("dsb sy\n" "wfi" : : : "memory");
+}
+
+static inline void cpu_wakeup(void)
+{
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,25 +5,91 @@
 extern "C" {
 #endif
 
+#include <xconfigs.h>
 #include <types.h>
 #include <barrier.h>
 #include <irqflags.h>
 
+/*
+ * Contention statistics, only updated on the slow path while the lock is held
+ */
+#if defined(CONFIG_SPINLOCK_STAT) && (CONFIG_SPINLOCK_STAT > 0)
+#define arch_spin_stat(lock, n)				do { (lock)->contended++; (lock)->spins += (n); } while(0)
+#define arch_spin_stat_init(lock)			do { (lock)->contended = 0; (lock)->spins = 0; } while(0)
+#else
+#define arch_spin_stat(lock, n)				do { } while(0)
+#define arch_spin_stat_init(lock)			do { } while(0)
+#endif
+
 #if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && !defined(__SANDBOX__)
 static inline int arch_spin_trylock(spinlock_t * lock)
 {
-	lock->lock = 1;
-	return 1;
+	unsigned int lockval, tmp;
+
+	__asm__ __volatile__(
+"	prfm pstl1strm, %2\n"
+"1:	ldaxr %w0, %2\n"
+"	eor %w1, %w0, %w0, ror #16\n"
+"	cbnz %w1, 2f\n"
+"	add %w0, %w0, %3\n"
+"	stxr %w1, %w0, %2\n"
+"	cbnz %w1, 1b\n"
+"2:"
+	: "=&r" (lockval), "=&r" (tmp), "+Q" (lock->lock)
+	: "I" (1 << 16)
+	: "memory");
+
+	return !tmp;
 }
 
+/*
+ * Take a ticket with ldaxr/stxr, then sleep in wfe until the owner field
+ * reaches it. The exclusive load arms the monitor, so the stlrh of the
+ * unlocking cpu wakes us up without an explicit sev.
+ */
 static inline void arch_spin_lock(spinlock_t * lock)
 {
-	lock->lock = 1;
+	unsigned int lockval, newval, tmp;
+	unsigned int owner, ticket;
+	unsigned int spins = 0;
+
+	__asm__ __volatile__(
+"	prfm pstl1strm, %3\n"
+"1:	ldaxr %w0, %3\n"
+"	add %w1, %w0, %w4\n"
+"	stxr %w2, %w1, %3\n"
+"	cbnz %w2, 1b"
+	: "=&r" (lockval), "=&r" (newval), "=&r" (tmp), "+Q" (lock->lock)
+	: "r" (1 << 16)
+	: "memory");
+
+	ticket = lockval >> 16;
+	owner = lockval & 0xffff;
+	if(ticket != owner)
+	{
+		__asm__ __volatile__ ("sevl" : : : "memory");
+		do {
+			__asm__ __volatile__(
+"	wfe\n"
+"	ldaxrh %w0, %1"
+			: "=&r" (owner)
+			: "Q" (lock->tickets.owner)
+			: "memory");
+			spins++;
+		} while(owner != ticket);
+		arch_spin_stat(lock, spins);
+	}
 }
 
 static inline void arch_spin_unlock(spinlock_t * lock)
 {
-	lock->lock = 0;
+	unsigned short owner = lock->tickets.owner + 1;
+
+	__asm__ __volatile__(
+"	stlrh %w1, %0"
+	: "=Q" (lock->tickets.owner)
+	: "r" (owner)
+	: "memory");
 }
 #else
 static inline int arch_spin_trylock(spinlock_t * lock)
@@ -44,7 +110,7 @@ static inline void arch_spin_unlock(spinlock_t * lock)
 #endif
 
 #define SPIN_LOCK_INIT()					{ .lock = 0 }
-#define spin_lock_init(plock)				do { (plock)->lock = 0; } while(0)
+#define spin_lock_init(plock)				do { (plock)->lock = 0; arch_spin_stat_init(plock); } while(0)
 #define spin_trylock(lock)					({ int __ret; __ret = arch_spin_trylock(lock); __ret; })
 #define spin_lock(lock)						do { arch_spin_lock(lock); } while(0)
 #define spin_unlock(lock)					do { arch_spin_unlock(lock); } while(0)
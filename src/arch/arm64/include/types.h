@@ -5,6 +5,8 @@
 extern "C" {
 #endif
 
+#include <xconfigs.h>
+
 typedef signed char				s8_t;
 typedef unsigned char			u8_t;
 
@@ -43,7 +45,17 @@ typedef struct {
 } atomic_t;
 
 typedef struct {
-	volatile int lock;
+	union {
+		volatile unsigned int lock;
+		struct {
+			volatile unsigned short owner;
+			volatile unsigned short next;
+		} tickets;
+	};
+#if defined(CONFIG_SPINLOCK_STAT) && (CONFIG_SPINLOCK_STAT > 0)
+	unsigned int contended;
+	unsigned int spins;
+#endif
 } spinlock_t;
 
 #ifdef __cplusplus
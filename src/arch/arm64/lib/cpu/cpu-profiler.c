@@ -0,0 +1,123 @@
+/*
+ * cpu-profiler.c
+ */
+
+#include <xboot.h>
+#include <xboot/profiler.h>
+#include <arm64.h>
+
+/*
+ * The PMUv3 cycle counter is 64 bits wide in long mode, the event
+ * counters are only 32 bits and are widened here, which holds as long
+ * as a counter is read at least once every wrap around
+ */
+#define PMU_EVENT_INST_RETIRED		(0x08)
+#define PMU_EVENT_L1D_CACHE_REFILL	(0x03)
+#define PMU_FILTER_NSH				(1 << 27)
+
+struct pmu_counter_t {
+	uint32_t last;
+	uint32_t high;
+};
+
+static struct pmu_counter_t __pmu_counter[CONFIG_MAX_SMP_CPUS][PROFILER_COUNTER_MAX];
+static int __pmu_events = 0;
+static int __pmu_present = 0;
+
+static inline uint32_t pmu_event_read(int counter)
+{
+	if(counter == PROFILER_COUNTER_INSTRUCTIONS)
+		return arm64_read_sysreg(pmevcntr0_el0);
+	return arm64_read_sysreg(pmevcntr1_el0);
+}
+
+int cpu_profiler_start(int counter)
+{
+	struct pmu_counter_t * c;
+
+	if(!__pmu_present)
+		return -1;
+	switch(counter)
+	{
+	case PROFILER_COUNTER_CYCLES:
+		arm64_write_sysreg(pmccfiltr_el0, PMU_FILTER_NSH);
+		arm64_write_sysreg(pmcntenset_el0, (1UL << 31));
+		return 0;
+	case PROFILER_COUNTER_INSTRUCTIONS:
+		if(__pmu_events < 1)
+			return -1;
+		arm64_write_sysreg(pmevtyper0_el0, PMU_FILTER_NSH | PMU_EVENT_INST_RETIRED);
+		arm64_write_sysreg(pmcntenset_el0, (1UL << 0));
+		break;
+	case PROFILER_COUNTER_CACHE_MISSES:
+		if(__pmu_events < 2)
+			return -1;
+		arm64_write_sysreg(pmevtyper1_el0, PMU_FILTER_NSH | PMU_EVENT_L1D_CACHE_REFILL);
+		arm64_write_sysreg(pmcntenset_el0, (1UL << 1));
+		break;
+	default:
+		return -1;
+	}
+	c = &__pmu_counter[smp_processor_id()][counter];
+	c->last = pmu_event_read(counter);
+	c->high = 0;
+	return 0;
+}
+
+void cpu_profiler_stop(int counter)
+{
+	switch(counter)
+	{
+	case PROFILER_COUNTER_CYCLES:
+		arm64_write_sysreg(pmcntenclr_el0, (1UL << 31));
+		break;
+	case PROFILER_COUNTER_INSTRUCTIONS:
+		arm64_write_sysreg(pmcntenclr_el0, (1UL << 0));
+		break;
+	case PROFILER_COUNTER_CACHE_MISSES:
+		arm64_write_sysreg(pmcntenclr_el0, (1UL << 1));
+		break;
+	default:
+		break;
+	}
+}
+
+uint64_t cpu_profiler_read(int counter)
+{
+	struct pmu_counter_t * c;
+	irq_flags_t flags;
+	uint32_t v;
+	uint64_t r;
+
+	if(counter == PROFILER_COUNTER_CYCLES)
+		return arm64_read_sysreg(pmccntr_el0);
+	c = &__pmu_counter[smp_processor_id()][counter];
+	local_irq_save(flags);
+	v = pmu_event_read(counter);
+	if(v < c->last)
+		c->high++;
+	c->last = v;
+	r = ((uint64_t)c->high << 32) | v;
+	local_irq_restore(flags);
+	return r;
+}
+
+/*
+ * Enable the PMU with a 64 bits cycle counter, reset all counters and
+ * count at el2 as well, where some boards leave xboot running
+ */
+void cpu_profiler_reset(void)
+{
+	uint64_t v;
+
+	v = (arm64_read_sysreg(id_aa64dfr0_el1) >> 8) & 0xf;
+	__pmu_present = ((v != 0) && (v != 0xf)) ? 1 : 0;
+	if(__pmu_present)
+	{
+		v = arm64_read_sysreg(pmcr_el0);
+		__pmu_events = (v >> 11) & 0x1f;
+		v &= ~(1 << 3);
+		v |= (1 << 6) | (1 << 2) | (1 << 1) | (1 << 0);
+		arm64_write_sysreg(pmcr_el0, v);
+	}
+}
@@ -20,6 +20,30 @@ static inline int smp_processor_id(void)
 }
 #endif
 
+/*
+ * Called with interrupts disabled, returns with interrupts disabled once an
+ * interrupt is pending. There is no inter-processor wakeup on smp, so the
+ * secondary harts keep polling their ready tree instead.
+ */
+#if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && !defined(__SANDBOX__)
+static inline void cpu_idle(void)
+{
+}
+
+static inline void cpu_wakeup(void)
+{
+}
+#else
+static inline void cpu_idle(void)
+{
+	__asm__ __volatile__("wfi" : : : "memory");
+}
+
+static inline void cpu_wakeup(void)
+{
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
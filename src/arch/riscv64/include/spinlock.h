@@ -5,41 +5,84 @@
 extern "C" {
 #endif
 
+#include <xconfigs.h>
 #include <types.h>
 #include <barrier.h>
 #include <irqflags.h>
 
+/*
+ * Contention statistics, only updated on the slow path while the lock is held
+ */
+#if defined(CONFIG_SPINLOCK_STAT) && (CONFIG_SPINLOCK_STAT > 0)
+#define arch_spin_stat(lock, n)				do { (lock)->contended++; (lock)->spins += (n); } while(0)
+#define arch_spin_stat_init(lock)			do { (lock)->contended = 0; (lock)->spins = 0; } while(0)
+#else
+#define arch_spin_stat(lock, n)				do { } while(0)
+#define arch_spin_stat_init(lock)			do { } while(0)
+#endif
+
 #if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && !defined(__SANDBOX__)
 static inline int arch_spin_trylock(spinlock_t * lock)
 {
-	int tmp = 1, busy;
+	int lockval = lock->lock;
+	int newval, tmp, res;
+
+	if((lockval >> 16) != (lockval & 0xffff))
+		return 0;
+	newval = lockval + (1 << 16);
 
 	__asm__ __volatile__ (
-		"amoswap.w %0, %2, %1\n"
-		"fence r, rw\n"
-		: "=r" (busy), "+A" (lock->lock)
-		: "r" (tmp)
+		"1: lr.w.aq %0, %2\n"
+		"bne %0, %3, 2f\n"
+		"sc.w %1, %4, %2\n"
+		"bnez %1, 1b\n"
+		"2:\n"
+		: "=&r" (tmp), "=&r" (res), "+A" (lock->lock)
+		: "r" (lockval), "r" (newval)
 		: "memory");
 
-	return !busy;
+	return (tmp == lockval);
 }
 
+/*
+ * There is no wfe on riscv, so back off in proportion to the distance
+ * between our ticket and the current owner instead.
+ */
 static inline void arch_spin_lock(spinlock_t * lock)
 {
-	while(1)
+	unsigned int lockval, newval, tmp;
+	unsigned short ticket, owner;
+	unsigned int spins = 0;
+	int i;
+
+	__asm__ __volatile__ (
+		"1: lr.w.aq %0, %3\n"
+		"addw %1, %0, %4\n"
+		"sc.w %2, %1, %3\n"
+		"bnez %2, 1b\n"
+		: "=&r" (lockval), "=&r" (newval), "=&r" (tmp), "+A" (lock->lock)
+		: "r" (1 << 16)
+		: "memory");
+
+	ticket = lockval >> 16;
+	owner = lockval & 0xffff;
+	if(ticket != owner)
 	{
-		smp_mb();
-		if((lock->lock == 0) ? 0 : 1)
-			continue;
-		if(arch_spin_trylock(lock))
-			break;
+		do {
+			for(i = (unsigned short)(ticket - owner) * 16; i > 0; i--)
+				__asm__ __volatile__ ("nop");
+			owner = lock->tickets.owner;
+			spins++;
+		} while(owner != ticket);
+		__asm__ __volatile__ ("fence r, rw" : : : "memory");
+		arch_spin_stat(lock, spins);
 	}
 }
 
 static inline void arch_spin_unlock(spinlock_t * lock)
 {
 	__asm__ __volatile__ ("fence rw, w" : : : "memory");
-	lock->lock = 0;
+	lock->tickets.owner++;
 }
 #else
 static inline int arch_spin_trylock(spinlock_t * lock)
@@ -60,7 +103,7 @@ static inline void arch_spin_unlock(spinlock_t * lock)
 #endif
 
 #define SPIN_LOCK_INIT()					{ .lock = 0 }
-#define spin_lock_init(plock)				do { (plock)->lock = 0; } while(0)
+#define spin_lock_init(plock)				do { (plock)->lock = 0; arch_spin_stat_init(plock); } while(0)
 #define spin_trylock(lock)					({ int __ret; __ret = arch_spin_trylock(lock); __ret; })
 #define spin_lock(lock)						do { arch_spin_lock(lock); } while(0)
 #define spin_unlock(lock)					do { arch_spin_unlock(lock); } while(0)
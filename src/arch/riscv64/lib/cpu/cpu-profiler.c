@@ -0,0 +1,47 @@
+/*
+ * cpu-profiler.c
+ */
+
+#include <xboot.h>
+#include <xboot/profiler.h>
+#include <riscv64.h>
+
+/*
+ * Xboot runs in machine mode, where the mcycle and minstret counters are
+ * free running from reset. There is no portable cache miss event, the
+ * mhpmcounters are left to the machine.
+ */
+int cpu_profiler_start(int counter)
+{
+	switch(counter)
+	{
+	case PROFILER_COUNTER_CYCLES:
+	case PROFILER_COUNTER_INSTRUCTIONS:
+		return 0;
+	default:
+		break;
+	}
+	return -1;
+}
+
+void cpu_profiler_stop(int counter)
+{
+}
+
+uint64_t cpu_profiler_read(int counter)
+{
+	switch(counter)
+	{
+	case PROFILER_COUNTER_CYCLES:
+		return csr_read(mcycle);
+	case PROFILER_COUNTER_INSTRUCTIONS:
+		return csr_read(minstret);
+	default:
+		break;
+	}
+	return 0;
+}
+
+void cpu_profiler_reset(void)
+{
+}
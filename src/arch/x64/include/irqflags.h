@@ -25,21 +25,27 @@ static inline void arch_local_irq_restore(irq_flags_t flags)
 {
 }
 #else
+extern unsigned long sandbox_irq_save(void);
+extern void sandbox_irq_restore(unsigned long flags);
+
 static inline void arch_local_irq_enable(void)
 {
+	sandbox_irq_restore(0);
 }
 
 static inline void arch_local_irq_disable(void)
 {
+	sandbox_irq_save();
 }
 
 static inline irq_flags_t arch_local_irq_save(void)
 {
-	return 0;
+	return sandbox_irq_save();
 }
 
 static inline void arch_local_irq_restore(irq_flags_t flags)
 {
+	sandbox_irq_restore(flags);
 }
 #endif
 
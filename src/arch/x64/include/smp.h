@@ -19,6 +19,32 @@ static inline int smp_processor_id(void)
 }
 #endif
 
+/*
+ * Called with interrupts disabled, returns with interrupts disabled once an
+ * interrupt is pending. The sandbox sleeps until the timer signal arrives.
+ */
+#if defined(__SANDBOX__)
+extern void sandbox_irq_wait(void);
+
+static inline void cpu_idle(void)
+{
+	sandbox_irq_wait();
+}
+
+static inline void cpu_wakeup(void)
+{
+}
+#else
+static inline void cpu_idle(void)
+{
+	__asm__ __volatile__("pause" : : : "memory");
+}
+
+static inline void cpu_wakeup(void)
+{
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,25 +5,59 @@
 extern "C" {
 #endif
 
+#include <xconfigs.h>
 #include <types.h>
 #include <barrier.h>
 #include <irqflags.h>
 
+/*
+ * Contention statistics, only updated on the slow path while the lock is held
+ */
+#if defined(CONFIG_SPINLOCK_STAT) && (CONFIG_SPINLOCK_STAT > 0)
+#define arch_spin_stat(lock, n)				do { (lock)->contended++; (lock)->spins += (n); } while(0)
+#define arch_spin_stat_init(lock)			do { (lock)->contended = 0; (lock)->spins = 0; } while(0)
+#else
+#define arch_spin_stat(lock, n)				do { } while(0)
+#define arch_spin_stat_init(lock)			do { } while(0)
+#endif
+
 #if defined(CONFIG_MAX_SMP_CPUS) && (CONFIG_MAX_SMP_CPUS > 1) && !defined(__SANDBOX__)
 static inline int arch_spin_trylock(spinlock_t * lock)
 {
-	lock->lock = 1;
-	return 1;
+	unsigned int lockval = lock->lock;
+
+	if((lockval >> 16) != (lockval & 0xffff))
+		return 0;
+	return __sync_bool_compare_and_swap(&lock->lock, lockval, lockval + (1 << 16));
 }
 
 static inline void arch_spin_lock(spinlock_t * lock)
 {
-	lock->lock = 1;
+	unsigned int lockval = 1 << 16;
+	unsigned short ticket;
+	unsigned int spins = 0;
+
+	__asm__ __volatile__ (
+		"lock; xaddl %0, %1\n"
+		: "+r" (lockval), "+m" (lock->lock)
+		:
+		: "memory", "cc");
+
+	ticket = lockval >> 16;
+	if(ticket != (unsigned short)lockval)
+	{
+		do {
+			__asm__ __volatile__ ("pause" : : : "memory");
+			spins++;
+		} while(lock->tickets.owner != ticket);
+		arch_spin_stat(lock, spins);
+	}
 }
 
 static inline void arch_spin_unlock(spinlock_t * lock)
 {
-	lock->lock = 0;
+	__asm__ __volatile__ ("" : : : "memory");
+	lock->tickets.owner++;
 }
 #else
 static inline int arch_spin_trylock(spinlock_t * lock)
@@ -44,7 +78,7 @@ static inline void arch_spin_unlock(spinlock_t * lock)
 #endif
 
 #define SPIN_LOCK_INIT()					{ .lock = 0 }
-#define spin_lock_init(plock)				do { (plock)->lock = 0; } while(0)
+#define spin_lock_init(plock)				do { (plock)->lock = 0; arch_spin_stat_init(plock); } while(0)
 #define spin_trylock(lock)					({ int __ret; __ret = arch_spin_trylock(lock); __ret; })
 #define spin_lock(lock)						do { arch_spin_lock(lock); } while(0)
 #define spin_unlock(lock)					do { arch_spin_unlock(lock); } while(0)
@@ -0,0 +1,61 @@
+/*
+ * cpu-profiler.c
+ */
+
+#include <xboot.h>
+#include <xboot/profiler.h>
+#include <sandbox.h>
+
+/*
+ * The counters are those of the host, counting the sandbox thread in
+ * user mode. Without perf events on the host none of them start.
+ */
+static void * __pmu[CONFIG_MAX_SMP_CPUS][PROFILER_COUNTER_MAX];
+
+static inline int pmu_event(int counter)
+{
+	switch(counter)
+	{
+	case PROFILER_COUNTER_CYCLES:
+		return SANDBOX_PMU_CYCLES;
+	case PROFILER_COUNTER_INSTRUCTIONS:
+		return SANDBOX_PMU_INSTRUCTIONS;
+	case PROFILER_COUNTER_CACHE_MISSES:
+		return SANDBOX_PMU_CACHE_MISSES;
+	default:
+		break;
+	}
+	return -1;
+}
+
+int cpu_profiler_start(int counter)
+{
+	void ** ctx;
+
+	if(pmu_event(counter) < 0)
+		return -1;
+	ctx = &__pmu[smp_processor_id()][counter];
+	if(!*ctx)
+		*ctx = sandbox_pmu_open(pmu_event(counter));
+	return *ctx ? 0 : -1;
+}
+
+void cpu_profiler_stop(int counter)
+{
+	void ** ctx = &__pmu[smp_processor_id()][counter];
+
+	if(*ctx)
+	{
+		sandbox_pmu_close(*ctx);
+		*ctx = NULL;
+	}
+}
+
+uint64_t cpu_profiler_read(int counter)
+{
+	return sandbox_pmu_read(__pmu[smp_processor_id()][counter]);
+}
+
+void cpu_profiler_reset(void)
+{
+}
@@ -0,0 +1,199 @@
+/*
+ * render-span.c
+ */
+
+#include <xboot.h>
+#include <graphic/surface.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+/*
+ * There is no copy kernel here, the generic one goes through memcpy(),
+ * which is already faster on x64 than any loop of vector moves
+ */
+
+/*
+ * The same source over as blend() in the default render, done per
+ * channel as s + ((d * (256 - sa)) >> 8), which is what blend() works
+ * out to, so both agree bit for bit
+ */
+static inline uint32_t blend_pixel(uint32_t d, uint32_t s)
+{
+	uint32_t sa = s >> 24;
+	uint32_t ia, rb, ag;
+
+	if(sa == 255)
+		return s;
+	if(sa == 0)
+		return d;
+	ia = 256 - sa;
+	rb = (((d & 0x00ff00ff) * ia) >> 8) & 0x00ff00ff;
+	ag = (((d >> 8) & 0x00ff00ff) * ia) & 0xff00ff00;
+	return (((s & 0x00ff00ff) + rb) & 0x00ff00ff) | (((s & 0xff00ff00) + ag) & 0xff00ff00);
+}
+
+static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, int f)
+{
+	uint32_t rb = ((((a & 0x00ff00ff) * (256 - f)) + ((b & 0x00ff00ff) * f)) >> 8) & 0x00ff00ff;
+	uint32_t ag = ((((a >> 8) & 0x00ff00ff) * (256 - f)) + (((b >> 8) & 0x00ff00ff) * f)) & 0xff00ff00;
+	return rb | ag;
+}
+
+#if defined(__AVX2__)
+static inline __m256i blend8(__m256i vd, __m256i vs)
+{
+	__m256i z = _mm256_setzero_si256();
+	__m256i c = _mm256_set1_epi16(256);
+	__m256i al, ah, dl, dh, v;
+
+	al = _mm256_unpacklo_epi8(vs, z);
+	ah = _mm256_unpackhi_epi8(vs, z);
+	al = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(al, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	ah = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(ah, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	dl = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(vd, z), _mm256_sub_epi16(c, al)), 8);
+	dh = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(vd, z), _mm256_sub_epi16(c, ah)), 8);
+	v = _mm256_add_epi8(vs, _mm256_packus_epi16(dl, dh));
+	return _mm256_blendv_epi8(v, vd, _mm256_cmpeq_epi32(_mm256_srli_epi32(vs, 24), z));
+}
+
+void render_span_blend(uint32_t * d, uint32_t * s, int n)
+{
+	__m256i m = _mm256_set1_epi32(0xff000000);
+	__m256i vs, a;
+	int k;
+
+	for(; n >= 8; n -= 8, d += 8, s += 8)
+	{
+		vs = _mm256_loadu_si256((__m256i *)s);
+		a = _mm256_and_si256(vs, m);
+		k = _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, m));
+		if(k == -1)
+			_mm256_storeu_si256((__m256i *)d, vs);
+		else if(_mm256_testz_si256(a, a) == 0)
+			_mm256_storeu_si256((__m256i *)d, blend8(_mm256_loadu_si256((__m256i *)d), vs));
+	}
+	for(; n > 0; n--, d++, s++)
+		*d = blend_pixel(*d, *s);
+}
+
+void render_span_fill(uint32_t * d, uint32_t c, int n)
+{
+	__m256i v = _mm256_set1_epi32(c);
+
+	for(; n >= 32; n -= 32, d += 32)
+	{
+		_mm256_storeu_si256((__m256i *)(d + 0), v);
+		_mm256_storeu_si256((__m256i *)(d + 8), v);
+		_mm256_storeu_si256((__m256i *)(d + 16), v);
+		_mm256_storeu_si256((__m256i *)(d + 24), v);
+	}
+	for(; n >= 8; n -= 8, d += 8)
+		_mm256_storeu_si256((__m256i *)d, v);
+	for(; n > 0; n--)
+		*d++ = c;
+}
+
+/*
+ * The channels are widened to 16 bits, where a * (256 - f) + b * f still
+ * fits unsigned, the same sum lerp_pixel() makes in its halfwords
+ */
+void render_span_lerp(uint32_t * d, uint32_t * a, uint32_t * b, int f, int n)
+{
+	__m256i z = _mm256_setzero_si256();
+	__m256i fa = _mm256_set1_epi16(256 - f);
+	__m256i fb = _mm256_set1_epi16(f);
+	__m256i va, vb, l, h;
+
+	for(; n >= 8; n -= 8, d += 8, a += 8, b += 8)
+	{
+		va = _mm256_loadu_si256((__m256i *)a);
+		vb = _mm256_loadu_si256((__m256i *)b);
+		l = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, z), fa), _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, z), fb));
+		h = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, z), fa), _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, z), fb));
+		_mm256_storeu_si256((__m256i *)d, _mm256_packus_epi16(_mm256_srli_epi16(l, 8), _mm256_srli_epi16(h, 8)));
+	}
+	for(; n > 0; n--)
+		*d++ = lerp_pixel(*a++, *b++, f);
+}
+
+#else
+static inline __m128i blend4(__m128i vd, __m128i vs)
+{
+	__m128i z = _mm_setzero_si128();
+	__m128i c = _mm_set1_epi16(256);
+	__m128i al, ah, dl, dh, v, k;
+
+	al = _mm_unpacklo_epi8(vs, z);
+	ah = _mm_unpackhi_epi8(vs, z);
+	al = _mm_shufflehi_epi16(_mm_shufflelo_epi16(al, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	ah = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ah, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	dl = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(vd, z), _mm_sub_epi16(c, al)), 8);
+	dh = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(vd, z), _mm_sub_epi16(c, ah)), 8);
+	v = _mm_add_epi8(vs, _mm_packus_epi16(dl, dh));
+	k = _mm_cmpeq_epi32(_mm_srli_epi32(vs, 24), z);
+	return _mm_or_si128(_mm_and_si128(k, vd), _mm_andnot_si128(k, v));
+}
+
+void render_span_blend(uint32_t * d, uint32_t * s, int n)
+{
+	__m128i m = _mm_set1_epi32(0xff000000);
+	__m128i z = _mm_setzero_si128();
+	__m128i vs, a;
+
+	for(; n >= 4; n -= 4, d += 4, s += 4)
+	{
+		vs = _mm_loadu_si128((__m128i *)s);
+		a = _mm_and_si128(vs, m);
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(a, m)) == 0xffff)
+			_mm_storeu_si128((__m128i *)d, vs);
+		else if(_mm_movemask_epi8(_mm_cmpeq_epi32(a, z)) != 0xffff)
+			_mm_storeu_si128((__m128i *)d, blend4(_mm_loadu_si128((__m128i *)d), vs));
+	}
+	for(; n > 0; n--, d++, s++)
+		*d = blend_pixel(*d, *s);
+}
+
+void render_span_fill(uint32_t * d, uint32_t c, int n)
+{
+	__m128i v = _mm_set1_epi32(c);
+
+	for(; n >= 16; n -= 16, d += 16)
+	{
+		_mm_storeu_si128((__m128i *)(d + 0), v);
+		_mm_storeu_si128((__m128i *)(d + 4), v);
+		_mm_storeu_si128((__m128i *)(d + 8), v);
+		_mm_storeu_si128((__m128i *)(d + 12), v);
+	}
+	for(; n >= 4; n -= 4, d += 4)
+		_mm_storeu_si128((__m128i *)d, v);
+	for(; n > 0; n--)
+		*d++ = c;
+}
+
+/*
+ * The channels are widened to 16 bits, where a * (256 - f) + b * f still
+ * fits unsigned, the same sum lerp_pixel() makes in its halfwords
+ */
+void render_span_lerp(uint32_t * d, uint32_t * a, uint32_t * b, int f, int n)
+{
+	__m128i z = _mm_setzero_si128();
+	__m128i fa = _mm_set1_epi16(256 - f);
+	__m128i fb = _mm_set1_epi16(f);
+	__m128i va, vb, l, h;
+
+	for(; n >= 4; n -= 4, d += 4, a += 4, b += 4)
+	{
+		va = _mm_loadu_si128((__m128i *)a);
+		vb = _mm_loadu_si128((__m128i *)b);
+		l = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, z), fa), _mm_mullo_epi16(_mm_unpacklo_epi8(vb, z), fb));
+		h = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, z), fa), _mm_mullo_epi16(_mm_unpackhi_epi8(vb, z), fb));
+		_mm_storeu_si128((__m128i *)d, _mm_packus_epi16(_mm_srli_epi16(l, 8), _mm_srli_epi16(h, 8)));
+	}
+	for(; n > 0; n--)
+		*d++ = lerp_pixel(*a++, *b++, f);
+}
+
+#endif
@@ -51,7 +51,7 @@ static int fb_getbl(struct framebuffer_t * fb)
 	return sandbox_fb_drm_get_backlight(pdat->priv);
 }
 
-static struct surface_t * fb_create(struct framebuffer_t * fb)
+static struct surface_t * fb_alloc_surface(struct framebuffer_t * fb, int scanout)
 {
 	struct fb_sandbox_drm_pdata_t * pdat = (struct fb_sandbox_drm_pdata_t *)fb->priv;
 	struct sandbox_fb_surface_t * surface;
@@ -61,7 +61,7 @@ static struct surface_t * fb_create(struct framebuffer_t * fb)
 	if(!surface)
 		return NULL;
 
-	if(!sandbox_fb_drm_surface_create(pdat->priv, surface))
+	if(!(scanout ? sandbox_fb_drm_surface_create_scanout(pdat->priv, surface) : sandbox_fb_drm_surface_create(pdat->priv, surface)))
 	{
 		free(surface);
 		return NULL;
@@ -80,6 +80,7 @@ static struct surface_t * fb_create(struct framebuffer_t * fb)
 	s->stride = surface->stride;
 	s->pixlen = surface->pixlen;
 	s->pixels = surface->pixels;
+	s->version = 0;
 	s->r = search_render();
 	s->rctx = s->r->create(s);
 	s->priv = surface;
@@ -87,6 +88,11 @@ static struct surface_t * fb_create(struct framebuffer_t * fb)
 	return s;
 }
 
+static struct surface_t * fb_create(struct framebuffer_t * fb)
+{
+	return fb_alloc_surface(fb, 0);
+}
+
 static void fb_destroy(struct framebuffer_t * fb, struct surface_t * s)
 {
 	struct fb_sandbox_drm_pdata_t * pdat = (struct fb_sandbox_drm_pdata_t *)fb->priv;
@@ -107,6 +113,24 @@ static void fb_present(struct framebuffer_t * fb, struct surface_t * s, struct r
 	sandbox_fb_drm_surface_present(pdat->priv, s->priv, (struct sandbox_region_list_t *)rl);
 }
 
+static int fb_create_surfaces(struct framebuffer_t * fb, struct surface_t ** s, int n)
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+	{
+		if(!(s[i] = fb_alloc_surface(fb, 1)))
+			break;
+	}
+	return i;
+}
+
+static void fb_flip(struct framebuffer_t * fb, struct surface_t * s, struct region_list_t * rl, int vsync)
+{
+	struct fb_sandbox_drm_pdata_t * pdat = (struct fb_sandbox_drm_pdata_t *)fb->priv;
+	sandbox_fb_drm_surface_flip(pdat->priv, s->priv, vsync);
+}
+
 static struct device_t * fb_sandbox_drm_probe(struct driver_t * drv, struct dtnode_t * n)
 {
 	struct fb_sandbox_drm_pdata_t * pdat;
@@ -145,6 +169,8 @@ static struct device_t * fb_sandbox_drm_probe(struct driver_t * drv, struct dtno
 	fb->create = fb_create;
 	fb->destroy = fb_destroy;
 	fb->present = fb_present;
+	fb->create_surfaces = fb_create_surfaces;
+	fb->flip = fb_flip;
 	fb->priv = pdat;
 
 	if(!(dev = register_framebuffer(fb, drv)))
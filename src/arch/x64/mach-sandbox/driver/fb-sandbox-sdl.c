@@ -80,6 +80,7 @@ static struct surface_t * fb_create(struct framebuffer_t * fb)
 	s->stride = surface->stride;
 	s->pixlen = surface->pixlen;
 	s->pixels = surface->pixels;
+	s->version = 0;
 	s->r = search_render();
 	s->rctx = s->r->create(s);
 	s->priv = surface;
@@ -107,6 +108,24 @@ static void fb_present(struct framebuffer_t * fb, struct surface_t * s, struct r
 	sandbox_fb_sdl_surface_present(pdat->priv, s->priv, (struct sandbox_region_list_t *)rl);
 }
 
+static int fb_create_surfaces(struct framebuffer_t * fb, struct surface_t ** s, int n)
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+	{
+		if(!(s[i] = fb_create(fb)))
+			break;
+	}
+	return i;
+}
+
+static void fb_flip(struct framebuffer_t * fb, struct surface_t * s, struct region_list_t * rl, int vsync)
+{
+	struct fb_sandbox_sdl_pdata_t * pdat = (struct fb_sandbox_sdl_pdata_t *)fb->priv;
+	sandbox_fb_sdl_surface_present(pdat->priv, s->priv, (struct sandbox_region_list_t *)rl);
+}
+
 static struct device_t * fb_sandbox_sdl_probe(struct driver_t * drv, struct dtnode_t * n)
 {
 	struct fb_sandbox_sdl_pdata_t * pdat;
@@ -149,6 +168,8 @@ static struct device_t * fb_sandbox_sdl_probe(struct driver_t * drv, struct dtno
 	fb->create = fb_create;
 	fb->destroy = fb_destroy;
 	fb->present = fb_present;
+	fb->create_surfaces = fb_create_surfaces;
+	fb->flip = fb_flip;
 	fb->priv = pdat;
 
 	if(!(dev = register_framebuffer(fb, drv)))
@@ -26,6 +26,9 @@ struct sandbox_fb_drm_context_t {
 	int index;
 	struct fb_drm_buf_t * drmbuf[2];
 	struct sandbox_region_list_t * nrl, * orl;
+	int scanout;
+	int pending;
+	int crtc;
 };
 
 static struct fb_drm_buf_t * fb_drm_buf_create(struct sandbox_fb_drm_context_t * ctx)
@@ -100,6 +103,33 @@ static void fb_drm_buf_destroy(struct sandbox_fb_drm_context_t * ctx, struct fb_
 	}
 }
 
+static void fb_drm_page_flip_handler(int fd, unsigned int frame, unsigned int sec, unsigned int usec, void * data)
+{
+	struct sandbox_fb_drm_context_t * ctx = (struct sandbox_fb_drm_context_t *)data;
+	ctx->pending = 0;
+}
+
+static void fb_drm_flip_wait(struct sandbox_fb_drm_context_t * ctx)
+{
+	drmEventContext ev;
+	struct pollfd pfd;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.version = 2;
+	ev.page_flip_handler = fb_drm_page_flip_handler;
+	pfd.fd = ctx->fd;
+	pfd.events = POLLIN;
+	while(ctx->pending)
+	{
+		if(poll(&pfd, 1, 100) <= 0)
+		{
+			ctx->pending = 0;
+			break;
+		}
+		drmHandleEvent(ctx->fd, &ev);
+	}
+}
+
 void * sandbox_fb_drm_open(const char * dev)
 {
 	struct sandbox_fb_drm_context_t * ctx;
@@ -145,6 +175,9 @@ void * sandbox_fb_drm_open(const char * dev)
 	ctx->pwidth = 256;
 	ctx->pheight = 135;
 	ctx->index = 0;
+	ctx->scanout = 0;
+	ctx->pending = 0;
+	ctx->crtc = 0;
 	ctx->drmbuf[0] = fb_drm_buf_create(ctx);
 	ctx->drmbuf[1] = fb_drm_buf_create(ctx);
 	ctx->nrl = sandbox_region_list_alloc(0);
@@ -161,6 +194,7 @@ void sandbox_fb_drm_close(void * context)
 
 	if(ctx)
 	{
+		fb_drm_flip_wait(ctx);
 		fb_drm_buf_destroy(ctx, ctx->drmbuf[0]);
 		fb_drm_buf_destroy(ctx, ctx->drmbuf[1]);
 		sandbox_region_list_free(ctx->nrl);
@@ -202,13 +236,48 @@ int sandbox_fb_drm_surface_create(void * context, struct sandbox_fb_surface_t *
 	surface->stride = ctx->stride;
 	surface->pixlen = ctx->pixlen;
 	surface->pixels = memalign(4, ctx->pixlen);
+	surface->priv = NULL;
+	return 1;
+}
+
+/*
+ * A surface whose pixels are a dumb buffer the crtc can scan out, so it is
+ * shown by a page flip instead of being copied
+ */
+int sandbox_fb_drm_surface_create_scanout(void * context, struct sandbox_fb_surface_t * surface)
+{
+	struct sandbox_fb_drm_context_t * ctx = (struct sandbox_fb_drm_context_t *)context;
+	struct fb_drm_buf_t * drmbuf;
+
+	drmbuf = fb_drm_buf_create(ctx);
+	if(!drmbuf)
+		return 0;
+	surface->width = drmbuf->width;
+	surface->height = drmbuf->height;
+	surface->stride = drmbuf->stride;
+	surface->pixlen = drmbuf->pixlen;
+	surface->pixels = drmbuf->pixels;
+	surface->priv = drmbuf;
+	ctx->scanout++;
 	return 1;
 }
 
 int sandbox_fb_drm_surface_destroy(void * context, struct sandbox_fb_surface_t * surface)
 {
-	if(surface && surface->pixels)
-		free(surface->pixels);
+	struct sandbox_fb_drm_context_t * ctx = (struct sandbox_fb_drm_context_t *)context;
+
+	if(surface)
+	{
+		if(surface->priv)
+		{
+			fb_drm_flip_wait(ctx);
+			fb_drm_buf_destroy(ctx, surface->priv);
+			ctx->scanout--;
+			ctx->crtc = 0;
+		}
+		else if(surface->pixels)
+			free(surface->pixels);
+	}
 	return 1;
 }
 
@@ -250,6 +319,35 @@ int sandbox_fb_drm_surface_present(void * context, struct sandbox_fb_surface_t *
 		memcpy(drmbuf->pixels, surface->pixels, surface->pixlen);
 	}
 	drmModeSetCrtc(ctx->fd, ctx->crtc_id, drmbuf->fb, 0, 0, &ctx->conn_id, 1, &ctx->conn->modes[0]);
+	ctx->crtc = 0;
+	return 1;
+}
+
+/*
+ * Only one flip is queued at a time. With two buffers the call waits for it
+ * to complete, as the one left behind is drawn into right away, while with
+ * three it returns at once and the wait happens on the next flip.
+ */
+int sandbox_fb_drm_surface_flip(void * context, struct sandbox_fb_surface_t * surface, int vsync)
+{
+	struct sandbox_fb_drm_context_t * ctx = (struct sandbox_fb_drm_context_t *)context;
+	struct fb_drm_buf_t * drmbuf = (struct fb_drm_buf_t *)surface->priv;
+
+	if(!drmbuf)
+		return 0;
+	fb_drm_flip_wait(ctx);
+	if(ctx->crtc && ((drmModePageFlip(ctx->fd, ctx->crtc_id, drmbuf->fb, DRM_MODE_PAGE_FLIP_EVENT | (vsync ? 0 : DRM_MODE_PAGE_FLIP_ASYNC), ctx) == 0) ||
+		(!vsync && (drmModePageFlip(ctx->fd, ctx->crtc_id, drmbuf->fb, DRM_MODE_PAGE_FLIP_EVENT, ctx) == 0))))
+	{
+		ctx->pending = 1;
+		if(ctx->scanout < 3)
+			fb_drm_flip_wait(ctx);
+	}
+	else
+	{
+		drmModeSetCrtc(ctx->fd, ctx->crtc_id, drmbuf->fb, 0, 0, &ctx->conn_id, 1, &ctx->conn->modes[0]);
+		ctx->crtc = 1;
+	}
 	return 1;
 }
 
@@ -122,6 +122,7 @@ int sandbox_fb_surface_create(void * context, struct sandbox_fb_surface_t * surf
 	surface->stride = ctx->fi.line_length;
 	surface->pixlen = ctx->vramsz;
 	surface->pixels = memalign(4, ctx->vramsz);
+	surface->priv = NULL;
 	return 1;
 }
 
@@ -168,6 +169,20 @@ int sandbox_fb_surface_present(void * context, struct sandbox_fb_surface_t * sur
 	return 1;
 }
 
+/*
+ * The fbdev has a single scanout buffer, a flip waits for the vertical blank
+ * when asked and then copies the damage like a present
+ */
+int sandbox_fb_surface_flip(void * context, struct sandbox_fb_surface_t * surface, struct sandbox_region_list_t * rl, int vsync)
+{
+	struct sandbox_fb_context_t * ctx = (struct sandbox_fb_context_t *)context;
+	int crtc = 0;
+
+	if(vsync)
+		ioctl(ctx->fd, FBIO_WAITFORVSYNC, &crtc);
+	return sandbox_fb_surface_present(context, surface, rl);
+}
+
 void sandbox_fb_set_backlight(void * context, int brightness)
 {
 }
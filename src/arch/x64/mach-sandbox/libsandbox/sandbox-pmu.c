@@ -0,0 +1,117 @@
+#include <x.h>
+#include <sandbox.h>
+
+struct sandbox_pmu_context_t {
+	int fd;
+	struct perf_event_mmap_page * page;
+	size_t size;
+};
+
+void * sandbox_pmu_open(int event)
+{
+	struct sandbox_pmu_context_t * ctx;
+	struct perf_event_attr attr;
+	int fd;
+
+	memset(&attr, 0, sizeof(struct perf_event_attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(struct perf_event_attr);
+	switch(event)
+	{
+	case SANDBOX_PMU_CYCLES:
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case SANDBOX_PMU_INSTRUCTIONS:
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case SANDBOX_PMU_CACHE_MISSES:
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	default:
+		return NULL;
+	}
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if(fd < 0)
+		return NULL;
+	ctx = malloc(sizeof(struct sandbox_pmu_context_t));
+	if(!ctx)
+	{
+		close(fd);
+		return NULL;
+	}
+	ctx->fd = fd;
+	ctx->size = sysconf(_SC_PAGESIZE);
+	ctx->page = mmap(NULL, ctx->size, PROT_READ, MAP_SHARED, fd, 0);
+	if(ctx->page == MAP_FAILED)
+		ctx->page = NULL;
+	return ctx;
+}
+
+void sandbox_pmu_close(void * context)
+{
+	struct sandbox_pmu_context_t * ctx = (struct sandbox_pmu_context_t *)context;
+
+	if(ctx)
+	{
+		if(ctx->page)
+			munmap(ctx->page, ctx->size);
+		close(ctx->fd);
+		free(ctx);
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t rdpmc(uint32_t counter)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+	return ((uint64_t)hi << 32) | lo;
+}
+#endif
+
+/*
+ * The counter is read in user space with rdpmc when the host allows it,
+ * following the seqlock of the mmaped page, and with a syscall otherwise
+ */
+uint64_t sandbox_pmu_read(void * context)
+{
+	struct sandbox_pmu_context_t * ctx = (struct sandbox_pmu_context_t *)context;
+	uint64_t count;
+#if defined(__x86_64__) || defined(__i386__)
+	struct perf_event_mmap_page * pc;
+	uint32_t seq, idx;
+	int64_t pmc;
+#endif
+
+	if(!ctx)
+		return 0;
+#if defined(__x86_64__) || defined(__i386__)
+	pc = ctx->page;
+	if(pc && pc->cap_user_rdpmc)
+	{
+		do {
+			seq = pc->lock;
+			__asm__ __volatile__("" ::: "memory");
+			idx = pc->index;
+			count = pc->offset;
+			if(idx)
+			{
+				pmc = rdpmc(idx - 1);
+				pmc <<= 64 - pc->pmc_width;
+				pmc >>= 64 - pc->pmc_width;
+				count += pmc;
+			}
+			__asm__ __volatile__("" ::: "memory");
+		} while(pc->lock != seq);
+		if(idx)
+			return count;
+	}
+#endif
+	if(read(ctx->fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+	return count;
+}
@@ -65,48 +65,190 @@ void sandbox_region_list_clone(struct sandbox_region_list_t * rl, struct sandbox
 	}
 }
 
-void sandbox_region_list_merge(struct sandbox_region_list_t * rl, struct sandbox_region_list_t * o)
+static inline int sandbox_region_list_reserve(struct sandbox_region_list_t * rl, unsigned int count)
 {
-	int count;
-	int i;
+	struct sandbox_region_t * r;
+	unsigned int size = rl->size;
 
-	if(rl && o && ((count = o->count) > 0))
+	if(count <= size)
+		return 1;
+	while(size < count)
+		size <<= 1;
+	r = realloc(rl->region, size * sizeof(struct sandbox_region_t));
+	if(!r)
+		return 0;
+	rl->region = r;
+	rl->size = size;
+	return 1;
+}
+
+static inline int sandbox_region_band_end(struct sandbox_region_list_t * rl, int i)
+{
+	int y = rl->region[i].y;
+
+	for(i++; (i < rl->count) && (rl->region[i].y == y); i++);
+	return i;
+}
+
+static void sandbox_region_band_union(struct sandbox_region_list_t * o, struct sandbox_region_t * a, int na, struct sandbox_region_t * b, int nb, int y0, int y1)
+{
+	struct sandbox_region_t * r;
+	int x0 = 0, x1 = 0, cur = 0;
+
+	while((na > 0) || (nb > 0))
 	{
-		for(i = 0; i < count; i++)
-			sandbox_region_list_add(rl, &o->region[i]);
+		if((nb <= 0) || ((na > 0) && (a->x < b->x)))
+		{
+			r = a++;
+			na--;
+		}
+		else
+		{
+			r = b++;
+			nb--;
+		}
+		if(!cur)
+		{
+			x0 = r->x;
+			x1 = r->x + r->w;
+			cur = 1;
+		}
+		else if(r->x <= x1)
+		{
+			if(r->x + r->w > x1)
+				x1 = r->x + r->w;
+		}
+		else
+		{
+			sandbox_region_init(&o->region[o->count++], x0, y0, x1 - x0, y1 - y0);
+			x0 = r->x;
+			x1 = r->x + r->w;
+		}
 	}
+	if(cur)
+		sandbox_region_init(&o->region[o->count++], x0, y0, x1 - x0, y1 - y0);
 }
 
-void sandbox_region_list_add(struct sandbox_region_list_t * rl, struct sandbox_region_t * r)
+/*
+ * The same banded union as the region list of the kernel, both lists are
+ * kept sorted by band and the result joins touching bands of equal spans.
+ */
+static void sandbox_region_list_union(struct sandbox_region_list_t * rl, struct sandbox_region_list_t * a, struct sandbox_region_list_t * b)
 {
-	struct sandbox_region_t * p;
-	int index = -1;
-	int i;
+	struct sandbox_region_list_t o;
+	int na = a->count, nb = b->count;
+	int ia = 0, ib = 0, ea, eb;
+	int ay0 = 0, ay1 = 0, by0 = 0, by1 = 0;
+	int aon, bon;
+	int y, y1;
+	int ps = -1, pe = 0, start, k;
 
-	if(!rl || !r)
+	o.size = sandbox_max(16, na + nb);
+	o.count = 0;
+	o.region = malloc(o.size * sizeof(struct sandbox_region_t));
+	if(!o.region)
 		return;
 
-	for(i = 0; i < rl->count; i++)
+	y = INT_MAX;
+	if(na > 0)
+		y = a->region[0].y;
+	if(nb > 0)
+		y = sandbox_min(y, b->region[0].y);
+	while((ia < na) || (ib < nb))
 	{
-		if(sandbox_region_overlap(&rl->region[i], r))
+		if(ia < na)
+		{
+			ay0 = a->region[ia].y;
+			ay1 = ay0 + a->region[ia].h;
+			if(ay1 <= y)
+			{
+				ia = sandbox_region_band_end(a, ia);
+				continue;
+			}
+		}
+		if(ib < nb)
+		{
+			by0 = b->region[ib].y;
+			by1 = by0 + b->region[ib].h;
+			if(by1 <= y)
+			{
+				ib = sandbox_region_band_end(b, ib);
+				continue;
+			}
+		}
+		aon = (ia < na) && (ay0 <= y);
+		bon = (ib < nb) && (by0 <= y);
+		if(!aon && !bon)
+		{
+			y = sandbox_min((ia < na) ? ay0 : INT_MAX, (ib < nb) ? by0 : INT_MAX);
+			continue;
+		}
+		y1 = INT_MAX;
+		if(ia < na)
+			y1 = sandbox_min(y1, aon ? ay1 : ay0);
+		if(ib < nb)
+			y1 = sandbox_min(y1, bon ? by1 : by0);
+		ea = aon ? sandbox_region_band_end(a, ia) : ia;
+		eb = bon ? sandbox_region_band_end(b, ib) : ib;
+		if(!sandbox_region_list_reserve(&o, o.count + (ea - ia) + (eb - ib)))
 		{
-			index = i;
-			break;
+			free(o.region);
+			return;
 		}
+		start = o.count;
+		sandbox_region_band_union(&o, &a->region[ia], ea - ia, &b->region[ib], eb - ib, y, y1);
+		if(o.count > start)
+		{
+			if((ps >= 0) && (pe == start) && (o.region[ps].y + o.region[ps].h == y) && (start - ps == o.count - start))
+			{
+				for(k = 0; k < start - ps; k++)
+				{
+					if((o.region[ps + k].x != o.region[start + k].x) || (o.region[ps + k].w != o.region[start + k].w))
+						break;
+				}
+				if(k == start - ps)
+				{
+					for(k = ps; k < start; k++)
+						o.region[k].h += y1 - y;
+					o.count = start;
+				}
+				else
+					ps = start;
+			}
+			else
+				ps = start;
+			pe = o.count;
+		}
+		y = y1;
 	}
+	free(rl->region);
+	rl->region = o.region;
+	rl->size = o.size;
+	rl->count = o.count;
+}
 
-	if(index >= 0)
+void sandbox_region_list_merge(struct sandbox_region_list_t * rl, struct sandbox_region_list_t * o)
+{
+	if(rl && o && (o->count > 0))
+		sandbox_region_list_union(rl, rl, o);
+}
+
+void sandbox_region_list_add(struct sandbox_region_list_t * rl, struct sandbox_region_t * r)
+{
+	struct sandbox_region_list_t o = { .region = r, .size = 1, .count = 1 };
+
+	if(!rl || !r || (r->w <= 0) || (r->h <= 0))
+		return;
+	if(rl->count == 0)
 	{
-		p = &rl->region[index];
-		sandbox_region_union(p, p, r);
+		if(sandbox_region_list_reserve(rl, 1))
+		{
+			sandbox_region_clone(&rl->region[0], r);
+			rl->count = 1;
+		}
 	}
 	else
-	{
-		if(rl->size <= rl->count)
-			sandbox_region_list_resize(rl, rl->size << 1);
-		sandbox_region_clone(&rl->region[rl->count], r);
-		rl->count++;
-	}
+		sandbox_region_list_union(rl, rl, &o);
 }
 
 void sandbox_region_list_clear(struct sandbox_region_list_t * rl)
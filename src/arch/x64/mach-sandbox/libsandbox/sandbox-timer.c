@@ -10,14 +10,77 @@ static struct timer_callback_data_t __tcd;
 static struct sigevent __sev;
 static struct itimerspec __its;
 static timer_t __tid;
+static volatile sig_atomic_t __irq_disabled = 0;
+static volatile sig_atomic_t __irq_pending = 0;
 
 static void signal_timer_handler(int signum)
 {
 	__its.it_value.tv_sec = 0;
 	__its.it_value.tv_nsec = 0;
 	timer_settime(__tid, 0, &__its, NULL);
+	if(__irq_disabled)
+	{
+		__irq_pending = 1;
+		return;
+	}
+	__irq_disabled = 1;
 	if(__tcd.cb)
 		__tcd.cb(__tcd.data);
+	__irq_disabled = 0;
+}
+
+/*
+ * The timer signal is the only interrupt source, so masking it with a flag
+ * is enough. A signal that arrives while masked is replayed on restore.
+ */
+unsigned long sandbox_irq_save(void)
+{
+	unsigned long flags = __irq_disabled;
+	__irq_disabled = 1;
+	__sync_synchronize();
+	return flags;
+}
+
+void sandbox_irq_restore(unsigned long flags)
+{
+	if(flags)
+		return;
+	while(1)
+	{
+		__sync_synchronize();
+		__irq_disabled = 0;
+		__sync_synchronize();
+		if(!__irq_pending)
+			break;
+		__irq_disabled = 1;
+		__sync_synchronize();
+		if(__irq_pending)
+		{
+			__irq_pending = 0;
+			if(__tcd.cb)
+				__tcd.cb(__tcd.data);
+		}
+	}
+}
+
+/*
+ * Sleep until the timer signal arrives. The signal is blocked while the
+ * pending flag is checked, and sigsuspend unblocks it atomically.
+ */
+void sandbox_irq_wait(void)
+{
+	sigset_t mask, omask;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR1);
+	sigprocmask(SIG_BLOCK, &mask, &omask);
+	if(!__irq_pending)
+	{
+		mask = omask;
+		sigdelset(&mask, SIGUSR1);
+		sigsuspend(&mask);
+	}
+	sigprocmask(SIG_SETMASK, &omask, NULL);
 }
 
 void sandbox_timer_init(void)
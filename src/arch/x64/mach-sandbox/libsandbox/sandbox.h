@@ -234,6 +234,7 @@ int sandbox_fb_get_pheight(void * context);
 int sandbox_fb_surface_create(void * context, struct sandbox_fb_surface_t * surface);
 int sandbox_fb_surface_destroy(void * context, struct sandbox_fb_surface_t * surface);
 int sandbox_fb_surface_present(void * context, struct sandbox_fb_surface_t * surface, struct sandbox_region_list_t * rl);
+int sandbox_fb_surface_flip(void * context, struct sandbox_fb_surface_t * surface, struct sandbox_region_list_t * rl, int vsync);
 void sandbox_fb_set_backlight(void * context, int brightness);
 int sandbox_fb_get_backlight(void * context);
 
@@ -245,8 +246,10 @@ int sandbox_fb_drm_get_height(void * context);
 int sandbox_fb_drm_get_pwidth(void * context);
 int sandbox_fb_drm_get_pheight(void * context);
 int sandbox_fb_drm_surface_create(void * context, struct sandbox_fb_surface_t * surface);
+int sandbox_fb_drm_surface_create_scanout(void * context, struct sandbox_fb_surface_t * surface);
 int sandbox_fb_drm_surface_destroy(void * context, struct sandbox_fb_surface_t * surface);
 int sandbox_fb_drm_surface_present(void * context, struct sandbox_fb_surface_t * surface, struct sandbox_region_list_t * rl);
+int sandbox_fb_drm_surface_flip(void * context, struct sandbox_fb_surface_t * surface, int vsync);
 void sandbox_fb_drm_set_backlight(void * context, int brightness);
 int sandbox_fb_drm_get_backlight(void * context);
 
@@ -281,12 +284,32 @@ int64_t sandbox_file_seek(int fd, int64_t offset);
 int64_t sandbox_file_tell(int fd);
 int64_t sandbox_file_length(int fd);
 
+/*
+ * Irq interface
+ */
+unsigned long sandbox_irq_save(void);
+void sandbox_irq_restore(unsigned long flags);
+void sandbox_irq_wait(void);
+
 /*
  * Keygen interface
  */
 const char * sandbox_uniqueid(void);
 int sandbox_keygen(const char * msg, void * key);
 
+/*
+ * Pmu interface
+ */
+enum {
+	SANDBOX_PMU_CYCLES			= 0,
+	SANDBOX_PMU_INSTRUCTIONS	= 1,
+	SANDBOX_PMU_CACHE_MISSES	= 2,
+};
+
+void * sandbox_pmu_open(int event);
+void sandbox_pmu_close(void * context);
+uint64_t sandbox_pmu_read(void * context);
+
 /*
  * PM interface
  */
@@ -24,11 +24,13 @@ extern "C" {
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <sys/timerfd.h>
 #include <sys/inotify.h>
 #include <sys/poll.h>
 #include <linux/fb.h>
 #include <linux/input.h>
+#include <linux/perf_event.h>
 #include <linux/videodev2.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -14,7 +14,7 @@ void do_autoboot(void)
 			printf("\r\n");
 			return;
 		}
-		mdelay(10);
+		task_sleep(10 * 1000000ULL);
 		delay -= 10;
 		if(delay < 0)
 			delay = 0;
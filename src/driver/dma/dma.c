@@ -74,6 +74,7 @@ struct device_t * register_dmachip(struct dmachip_t * chip, struct driver_t * dr
 	for(i = 0; i < chip->ndma; i++)
 	{
 		spin_lock_init(&chip->channel[i].lock);
+		waitqueue_init(&chip->channel[i].wait);
 		spin_lock_irqsave(&chip->channel[i].lock, flags);
 		if(chip->stop)
 			chip->stop(chip, i);
@@ -197,7 +198,15 @@ void dma_wait(int dma)
 	if(chip && chip->busying)
 	{
 		offset = dma - chip->base;
-		while(chip->busying(chip, offset))
-			task_yield();
+		while(!wait_event_timeout(&chip->channel[offset].wait, !chip->busying(chip, offset), 1000000));
 	}
 }
+
+void dma_complete(struct dmachip_t * chip, int offset)
+{
+	struct dma_channel_t * ch = &chip->channel[offset];
+
+	if(ch->complete)
+		ch->complete(ch->data);
+	waitqueue_wakeup_all(&ch->wait);
+}
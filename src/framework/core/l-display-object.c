@@ -386,6 +386,24 @@ function M:getTouchable()
 	return self._dobj:getTouchable()
 end
 
+function M:setOpaque(opaque)
+	self._dobj:setOpaque(opaque)
+	return self
+end
+
+function M:getOpaque()
+	return self._dobj:getOpaque()
+end
+
+function M:setCacheAsBitmap(cache)
+	self._dobj:setCacheAsBitmap(cache)
+	return self
+end
+
+function M:getCacheAsBitmap()
+	return self._dobj:getCacheAsBitmap()
+end
+
 function M:globalToLocal(x, y)
 	return self._dobj:globalToLocal(x, y)
 end
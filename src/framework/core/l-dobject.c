@@ -35,18 +35,6 @@
 #include <framework/core/l-window.h>
 #include <framework/core/l-dobject.h>
 
-enum {
-	MFLAG_TRANSLATE					= (0x1 << 0),
-	MFLAG_ROTATE					= (0x1 << 1),
-	MFLAG_SCALE						= (0x1 << 2),
-	MFLAG_SKEW						= (0x1 << 3),
-	MFLAG_ANCHOR					= (0x1 << 4),
-	MFLAG_LOCAL_MATRIX				= (0x1 << 5),
-	MFLAG_GLOBAL_MATRIX				= (0x1 << 6),
-	MFLAG_GLOBAL_BOUNDS				= (0x1 << 7),
-	MFLAG_DIRTY						= (0x1 << 8),
-};
-
 static inline struct matrix_t * dobject_local_matrix(struct ldobject_t * o)
 {
 	struct matrix_t * m = &o->local_matrix;
@@ -150,6 +138,27 @@ static inline struct region_t * dobject_parent_global_bounds(struct ldobject_t *
 	return NULL;
 }
 
+/*
+ * The bounds of an object and all of its descendants, the tree of these
+ * boxes is the spatial index the renderer walks to skip whole subtrees
+ * away from the dirty regions
+ */
+static struct region_t * dobject_subtree_bounds(struct ldobject_t * o)
+{
+	struct region_t * r = &o->subtree_bounds;
+	struct ldobject_t * pos;
+	if(o->mflag & MFLAG_SUBTREE_BOUNDS)
+	{
+		region_clone(r, dobject_global_bounds(o));
+		list_for_each_entry(pos, &o->children, entry)
+		{
+			region_union(r, r, dobject_subtree_bounds(pos));
+		}
+		o->mflag &= ~MFLAG_SUBTREE_BOUNDS;
+	}
+	return r;
+}
+
 static inline struct region_t * dobject_dirty_bounds(struct ldobject_t * o)
 {
 	return &o->dirty_bounds;
@@ -160,10 +169,24 @@ static inline void dobject_mark(struct ldobject_t * o, int mark)
 	o->mflag |= mark;
 }
 
+static inline void dobject_mark_subtree(struct ldobject_t * o)
+{
+	while(o && !(o->mflag & MFLAG_SUBTREE_BOUNDS))
+	{
+		o->mflag |= MFLAG_SUBTREE_BOUNDS;
+		o = o->parent;
+	}
+}
+
 static void dobject_mark_children(struct ldobject_t * o, int mark)
 {
 	struct ldobject_t * pos;
 
+	if(mark & MFLAG_GLOBAL_BOUNDS)
+	{
+		dobject_mark_subtree(o->parent);
+		mark |= MFLAG_SUBTREE_BOUNDS;
+	}
 	o->mflag |= mark;
 	list_for_each_entry(pos, &o->children, entry)
 	{
@@ -171,6 +194,20 @@ static void dobject_mark_children(struct ldobject_t * o, int mark)
 	}
 }
 
+/*
+ * Invalidate the cached layers of an object and of all its ancestors, the
+ * chain is always walked up to the root, as a layer drawn while hidden or
+ * nested in another one may keep its mark
+ */
+static inline void dobject_mark_layer(struct ldobject_t * o)
+{
+	while(o)
+	{
+		o->mflag |= MFLAG_LAYER;
+		o = o->parent;
+	}
+}
+
 static inline void dobject_mark_dirty(struct ldobject_t * o)
 {
 	if(!(o->mflag & MFLAG_DIRTY))
@@ -178,6 +215,7 @@ static inline void dobject_mark_dirty(struct ldobject_t * o)
 		region_clone(&o->dirty_bounds, dobject_global_bounds(o));
 		o->mflag |= MFLAG_DIRTY;
 	}
+	dobject_mark_layer(o->parent);
 }
 
 enum layout_direction_t {
@@ -757,6 +795,8 @@ static void dobject_layout(struct ldobject_t * o)
 			{
 				dobject_mark_dirty(pos);
 			}
+			if(pos->width != width || pos->height != height)
+				dobject_mark_layer(pos);
 			pos->width = width;
 			pos->height = height;
 			pos->x = pos->layout.x;
@@ -770,6 +810,7 @@ static void dobject_layout(struct ldobject_t * o)
 			pos->anchory = 0.0;
 			pos->mflag &= ~(MFLAG_TRANSLATE | MFLAG_ROTATE | MFLAG_SCALE | MFLAG_SKEW | MFLAG_ANCHOR | MFLAG_LOCAL_MATRIX | MFLAG_GLOBAL_MATRIX | MFLAG_GLOBAL_BOUNDS);
 			pos->mflag |= MFLAG_LOCAL_MATRIX | MFLAG_GLOBAL_MATRIX | MFLAG_GLOBAL_BOUNDS;
+			dobject_mark_subtree(pos);
 			if((pos->x == 0.0) && (pos->y == 0.0))
 				pos->mflag &= ~MFLAG_TRANSLATE;
 			else
@@ -783,100 +824,279 @@ static void dobject_layout(struct ldobject_t * o)
 	}
 }
 
-static void dobject_draw_image(struct ldobject_t * o, struct window_t * w)
+static void dobject_draw_image(struct ldobject_t * o, struct surface_t * s, struct matrix_t * m, struct region_t * clip)
 {
 	struct limage_t * img = o->priv;
-	surface_blit(w->s, dobject_parent_global_bounds(o), dobject_global_matrix(o), img->s, RENDER_TYPE_GOOD);
+	surface_blit(s, clip, m, img->s, RENDER_TYPE_GOOD);
 }
 
-static void dobject_draw_ninepatch(struct ldobject_t * o, struct window_t * w)
+static void dobject_draw_ninepatch(struct ldobject_t * o, struct surface_t * s, struct matrix_t * m, struct region_t * clip)
 {
 	struct lninepatch_t * ninepatch = o->priv;
-	struct surface_t * s = w->s;
-	struct matrix_t m;
+	struct matrix_t t;
 	if(ninepatch->lt)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, 0, 0);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->lt, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, 0, 0);
+		surface_blit(s, clip, &t, ninepatch->lt, RENDER_TYPE_FAST);
 	}
 	if(ninepatch->mt)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, ninepatch->left, 0);
-		matrix_scale(&m, ninepatch->__sx, 1);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->mt, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, ninepatch->left, 0);
+		matrix_scale(&t, ninepatch->__sx, 1);
+		surface_blit(s, clip, &t, ninepatch->mt, RENDER_TYPE_FAST);
 	}
 	if(ninepatch->rt)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, ninepatch->__w - ninepatch->right, 0);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->rt, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, ninepatch->__w - ninepatch->right, 0);
+		surface_blit(s, clip, &t, ninepatch->rt, RENDER_TYPE_FAST);
 	}
 	if(ninepatch->lm)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, 0, ninepatch->top);
-		matrix_scale(&m, 1, ninepatch->__sy);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->lm, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, 0, ninepatch->top);
+		matrix_scale(&t, 1, ninepatch->__sy);
+		surface_blit(s, clip, &t, ninepatch->lm, RENDER_TYPE_FAST);
 	}
 	if(ninepatch->mm)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, ninepatch->left, ninepatch->top);
-		matrix_scale(&m, ninepatch->__sx, ninepatch->__sy);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->mm, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, ninepatch->left, ninepatch->top);
+		matrix_scale(&t, ninepatch->__sx, ninepatch->__sy);
+		surface_blit(s, clip, &t, ninepatch->mm, RENDER_TYPE_FAST);
 	}
 	if(ninepatch->rm)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, ninepatch->__w - ninepatch->right, ninepatch->top);
-		matrix_scale(&m, 1, ninepatch->__sy);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->rm, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, ninepatch->__w - ninepatch->right, ninepatch->top);
+		matrix_scale(&t, 1, ninepatch->__sy);
+		surface_blit(s, clip, &t, ninepatch->rm, RENDER_TYPE_FAST);
 	}
 	if(ninepatch->lb)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, 0, ninepatch->__h - ninepatch->bottom);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->lb, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, 0, ninepatch->__h - ninepatch->bottom);
+		surface_blit(s, clip, &t, ninepatch->lb, RENDER_TYPE_FAST);
 	}
 	if(ninepatch->mb)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, ninepatch->left, ninepatch->__h - ninepatch->bottom);
-		matrix_scale(&m, ninepatch->__sx, 1);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->mb, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, ninepatch->left, ninepatch->__h - ninepatch->bottom);
+		matrix_scale(&t, ninepatch->__sx, 1);
+		surface_blit(s, clip, &t, ninepatch->mb, RENDER_TYPE_FAST);
 	}
 	if(ninepatch->rb)
 	{
-		memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
-		matrix_translate(&m, ninepatch->__w - ninepatch->right, ninepatch->__h - ninepatch->bottom);
-		surface_blit(s, dobject_parent_global_bounds(o), &m, ninepatch->rb, RENDER_TYPE_FAST);
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_translate(&t, ninepatch->__w - ninepatch->right, ninepatch->__h - ninepatch->bottom);
+		surface_blit(s, clip, &t, ninepatch->rb, RENDER_TYPE_FAST);
 	}
 }
 
-static void dobject_draw_text(struct ldobject_t * o, struct window_t * w)
+static void dobject_draw_text(struct ldobject_t * o, struct surface_t * s, struct matrix_t * m, struct region_t * clip)
 {
 	struct ltext_t * text = o->priv;
-	surface_text(w->s, dobject_parent_global_bounds(o), dobject_global_matrix(o), &text->txt);
+	surface_text(s, clip, m, &text->txt);
 }
 
-static void dobject_draw_icon(struct ldobject_t * o, struct window_t * w)
+static void dobject_draw_icon(struct ldobject_t * o, struct surface_t * s, struct matrix_t * m, struct region_t * clip)
 {
 	struct licon_t * icon = o->priv;
-	surface_icon(w->s, dobject_parent_global_bounds(o), dobject_global_matrix(o), &icon->ico);
+	surface_icon(s, clip, m, &icon->ico);
 }
 
-static void dobject_draw_container(struct ldobject_t * o, struct window_t * w)
+static void dobject_draw_container(struct ldobject_t * o, struct surface_t * s, struct matrix_t * m, struct region_t * clip)
 {
 	if(o->bgcolor.a != 0)
-		surface_fill(w->s, dobject_parent_global_bounds(o), dobject_global_matrix(o), o->width, o->height, &o->bgcolor, RENDER_TYPE_GOOD);
+		surface_fill(s, clip, m, o->width, o->height, &o->bgcolor, RENDER_TYPE_GOOD);
+}
+
+/*
+ * An object cached as bitmap keeps its whole subtree rendered in a layer,
+ * a surface laid out in the local space of the object and blitted under
+ * its global matrix, so moving the object never rebuilds it. The layer is
+ * only redrawn once the object or one of its descendants has marked it,
+ * and all layers share one memory budget, least recently used first out.
+ * A frame draws the tree once for each dirty rectangle, a layer is counted
+ * once for the frame however many of them it is blitted into.
+ */
+#define DOBJECT_LAYER_BUDGET		(CONFIG_DOBJECT_LAYER_CACHE_SIZE)
+#define DOBJECT_LAYER_LIMIT			(DOBJECT_LAYER_BUDGET / 4)
+
+static LIST_HEAD(__dobject_layer_lru);
+static struct cache_stat_t __dobject_layer_stat = {
+	.budget = DOBJECT_LAYER_BUDGET,
+};
+static spinlock_t __dobject_layer_lock = SPIN_LOCK_INIT();
+static unsigned int __dobject_layer_frame = 0;
+
+static void dobject_layer_free(struct ldobject_t * o)
+{
+	struct surface_t * s;
+
+	spin_lock(&__dobject_layer_lock);
+	if((s = o->layer.s))
+	{
+		list_del_init(&o->layer.entry);
+		__dobject_layer_stat.bytes -= s->pixlen;
+		__dobject_layer_stat.count--;
+		o->layer.s = NULL;
+	}
+	spin_unlock(&__dobject_layer_lock);
+	if(s)
+		surface_free(s);
+}
+
+static struct surface_t * dobject_layer_alloc(struct ldobject_t * o, int width, int height)
+{
+	struct ldobject_t * l;
+	struct surface_t * s;
+	size_t size = width * height * 4;
+
+	do {
+		spin_lock(&__dobject_layer_lock);
+		if((__dobject_layer_stat.bytes + size > DOBJECT_LAYER_BUDGET) && !list_empty(&__dobject_layer_lru))
+		{
+			l = list_last_entry(&__dobject_layer_lru, struct ldobject_t, layer.entry);
+			__dobject_layer_stat.evict++;
+		}
+		else
+			l = NULL;
+		spin_unlock(&__dobject_layer_lock);
+		if(l)
+			dobject_layer_free(l);
+	} while(l);
+	if((s = surface_alloc(width, height, NULL)))
+	{
+		spin_lock(&__dobject_layer_lock);
+		list_add(&o->layer.entry, &__dobject_layer_lru);
+		__dobject_layer_stat.bytes += s->pixlen;
+		__dobject_layer_stat.count++;
+		spin_unlock(&__dobject_layer_lock);
+	}
+	o->layer.s = s;
+	return s;
+}
+
+static void dobject_layer_bounds(struct ldobject_t * o, struct matrix_t * m, double * x1, double * y1, double * x2, double * y2)
+{
+	struct ldobject_t * pos;
+	struct matrix_t t;
+	double bx1 = 0;
+	double by1 = 0;
+	double bx2 = o->width;
+	double by2 = o->height;
+
+	matrix_transform_bounds(m, &bx1, &by1, &bx2, &by2);
+	*x1 = min(*x1, bx1);
+	*y1 = min(*y1, by1);
+	*x2 = max(*x2, bx2);
+	*y2 = max(*y2, by2);
+	list_for_each_entry(pos, &o->children, entry)
+	{
+		if(pos->visible)
+		{
+			matrix_multiply(&t, dobject_local_matrix(pos), m);
+			dobject_layer_bounds(pos, &t, x1, y1, x2, y2);
+		}
+	}
+}
+
+static void dobject_layer_render(struct ldobject_t * o, struct surface_t * s, struct matrix_t * m, struct region_t * clip)
+{
+	struct ldobject_t * pos;
+	struct matrix_t t;
+	struct region_t r;
+	double x1 = 0;
+	double y1 = 0;
+	double x2 = o->width;
+	double y2 = o->height;
+
+	o->draw(o, s, m, clip);
+	if(!list_empty(&o->children))
+	{
+		matrix_transform_bounds(m, &x1, &y1, &x2, &y2);
+		region_init(&r, x1, y1, x2 - x1 + 2, y2 - y1 + 2);
+		list_for_each_entry(pos, &o->children, entry)
+		{
+			if(pos->visible)
+			{
+				matrix_multiply(&t, dobject_local_matrix(pos), m);
+				dobject_layer_render(pos, s, &t, &r);
+			}
+		}
+	}
+}
+
+static int dobject_layer_update(struct ldobject_t * o)
+{
+	struct surface_t * s = o->layer.s;
+	struct matrix_t m;
+	double x1 = 0;
+	double y1 = 0;
+	double x2 = o->width;
+	double y2 = o->height;
+	int x, y, w, h;
+
+	if(s && !(o->mflag & MFLAG_LAYER))
+	{
+		spin_lock(&__dobject_layer_lock);
+		list_move(&o->layer.entry, &__dobject_layer_lru);
+		if(o->layer.frame != __dobject_layer_frame)
+		{
+			o->layer.frame = __dobject_layer_frame;
+			__dobject_layer_stat.hit++;
+		}
+		spin_unlock(&__dobject_layer_lock);
+		return 1;
+	}
+	matrix_init_identity(&m);
+	dobject_layer_bounds(o, &m, &x1, &y1, &x2, &y2);
+	x = (int)floor(x1);
+	y = (int)floor(y1);
+	w = (int)ceil(x2) - x + 2;
+	h = (int)ceil(y2) - y + 2;
+	if((w <= 0) || (h <= 0) || ((int64_t)w * h * 4 > DOBJECT_LAYER_LIMIT))
+	{
+		dobject_layer_free(o);
+		return 0;
+	}
+	spin_lock(&__dobject_layer_lock);
+	o->layer.frame = __dobject_layer_frame;
+	__dobject_layer_stat.miss++;
+	spin_unlock(&__dobject_layer_lock);
+	if(s && (surface_get_width(s) == w) && (surface_get_height(s) == h))
+	{
+		surface_clear(s, NULL, 0, 0, 0, 0);
+	}
+	else
+	{
+		dobject_layer_free(o);
+		if(!(s = dobject_layer_alloc(o, w, h)))
+			return 0;
+	}
+	o->layer.x = x;
+	o->layer.y = y;
+	o->mflag &= ~MFLAG_LAYER;
+	matrix_init_translate(&m, -x, -y);
+	dobject_layer_render(o, s, &m, NULL);
+	surface_flush(s);
+	return 1;
+}
+
+void dobject_layer_stat(struct cache_stat_t * stat)
+{
+	spin_lock(&__dobject_layer_lock);
+	memcpy(stat, &__dobject_layer_stat, sizeof(struct cache_stat_t));
+	spin_unlock(&__dobject_layer_lock);
 }
 
 static int l_dobject_new(lua_State * L)
 {
 	enum dobject_type_t dtype;
-	void (*draw)(struct ldobject_t *, struct window_t *);
+	void (*draw)(struct ldobject_t *, struct surface_t *, struct matrix_t *, struct region_t *);
 	void * userdata;
 	double width = luaL_optnumber(L, 1, 0);
 	double height = luaL_optnumber(L, 2, 0);
@@ -943,11 +1163,19 @@ static int l_dobject_new(lua_State * L)
 	o->ctype = COLLIDER_TYPE_NONE;
 	o->visible = 1;
 	o->touchable = 1;
+	o->opaque = 0;
 	o->mflag = 0;
 	matrix_init_identity(&o->local_matrix);
 	matrix_init_identity(&o->global_matrix);
 	region_init(&o->global_bounds, o->x, o->y, o->width, o->height);
 	region_init(&o->dirty_bounds, o->x, o->y, o->width, o->height);
+	region_init(&o->subtree_bounds, o->x, o->y, o->width, o->height);
+	o->cache = 0;
+	init_list_head(&o->layer.entry);
+	o->layer.s = NULL;
+	o->layer.x = 0;
+	o->layer.y = 0;
+	o->layer.frame = 0;
 	o->dtype = dtype;
 	o->draw = draw;
 	o->priv = userdata;
@@ -973,6 +1201,7 @@ static int m_dobject_gc(lua_State * L)
 			o->hit.polygon.length = 0;
 		}
 	}
+	dobject_layer_free(o);
 	return 0;
 }
 
@@ -995,6 +1224,7 @@ static int m_add_child(lua_State * L)
 			c->mflag &= ~MFLAG_DIRTY;
 			dobject_mark_dirty(c);
 		}
+		dobject_mark_layer(o);
 		dobject_mark_children(c, MFLAG_GLOBAL_MATRIX | MFLAG_GLOBAL_BOUNDS);
 	}
 	return 0;
@@ -1021,6 +1251,7 @@ static int m_remove_child(lua_State * L)
 		c->mflag &= ~MFLAG_DIRTY;
 		c->parent = NULL;
 		list_del_init(&c->entry);
+		dobject_mark_subtree(o);
 		dobject_mark_children(c, MFLAG_GLOBAL_MATRIX | MFLAG_GLOBAL_BOUNDS);
 	}
 	return 0;
@@ -1057,6 +1288,7 @@ static int m_set_width(lua_State * L)
 		dobject_mark_dirty(o);
 		o->width = width;
 		o->layout.width = NAN;
+		dobject_mark_layer(o);
 		dobject_mark(o, MFLAG_LOCAL_MATRIX);
 		dobject_mark_children(o, MFLAG_GLOBAL_MATRIX | MFLAG_GLOBAL_BOUNDS);
 	}
@@ -1079,6 +1311,7 @@ static int m_set_height(lua_State * L)
 		dobject_mark_dirty(o);
 		o->height = height;
 		o->layout.height = NAN;
+		dobject_mark_layer(o);
 		dobject_mark(o, MFLAG_LOCAL_MATRIX);
 		dobject_mark_children(o, MFLAG_GLOBAL_MATRIX | MFLAG_GLOBAL_BOUNDS);
 	}
@@ -1104,6 +1337,7 @@ static int m_set_size(lua_State * L)
 		o->height = height;
 		o->layout.width = NAN;
 		o->layout.height = NAN;
+		dobject_mark_layer(o);
 		dobject_mark(o, MFLAG_LOCAL_MATRIX);
 		dobject_mark_children(o, MFLAG_GLOBAL_MATRIX | MFLAG_GLOBAL_BOUNDS);
 	}
@@ -1412,6 +1646,7 @@ static int m_set_background_color(lua_State * L)
 	if((o->bgcolor.r != c->r) || (o->bgcolor.g != c->g) || (o->bgcolor.b != c->b) || (o->bgcolor.a != c->a))
 	{
 		dobject_mark_dirty(o);
+		dobject_mark_layer(o);
 		memcpy(&o->bgcolor, c, sizeof(struct color_t));
 	}
 	return 0;
@@ -1885,6 +2120,42 @@ static int m_get_touchable(lua_State * L)
 	return 1;
 }
 
+static int m_set_opaque(lua_State * L)
+{
+	struct ldobject_t * o = luaL_checkudata(L, 1, MT_DOBJECT);
+	o->opaque = lua_toboolean(L, 2);
+	return 0;
+}
+
+static int m_get_opaque(lua_State * L)
+{
+	struct ldobject_t * o = luaL_checkudata(L, 1, MT_DOBJECT);
+	lua_pushboolean(L, o->opaque);
+	return 1;
+}
+
+static int m_set_cache_as_bitmap(lua_State * L)
+{
+	struct ldobject_t * o = luaL_checkudata(L, 1, MT_DOBJECT);
+	int cache = lua_toboolean(L, 2);
+	if(o->cache != cache)
+	{
+		dobject_mark_dirty(o);
+		dobject_mark_layer(o);
+		o->cache = cache;
+		if(!cache)
+			dobject_layer_free(o);
+	}
+	return 0;
+}
+
+static int m_get_cache_as_bitmap(lua_State * L)
+{
+	struct ldobject_t * o = luaL_checkudata(L, 1, MT_DOBJECT);
+	lua_pushboolean(L, o->cache);
+	return 1;
+}
+
 static int m_global_to_local(lua_State * L)
 {
 	struct ldobject_t * o = luaL_checkudata(L, 1, MT_DOBJECT);
@@ -2053,6 +2324,7 @@ static int m_mark_dirty(lua_State * L)
 {
 	struct ldobject_t * o = luaL_checkudata(L, 1, MT_DOBJECT);
 	dobject_mark_dirty(o);
+	dobject_mark_layer(o);
 	return 0;
 }
 
@@ -2084,18 +2356,54 @@ static void window_region_list_fill(struct window_t * w, struct ldobject_t * o)
 	}
 }
 
-static void display_draw(struct window_t * w, struct ldobject_t * o)
+static void dobject_draw(struct ldobject_t * o, struct window_t * w, struct region_t * r)
 {
 	struct ldobject_t * pos;
+	struct region_t * p, clip;
+	struct matrix_t m;
+	int draw;
 
-	if(o->visible)
+	if(!o->visible || !region_intersect(&clip, r, dobject_subtree_bounds(o)) || region_isempty(&clip))
+		return;
+	if((p = dobject_parent_global_bounds(o)))
 	{
-		o->draw(o, w);
-		list_for_each_entry(pos, &o->children, entry)
+		draw = region_intersect(&clip, r, p) && !region_isempty(&clip);
+	}
+	else
+	{
+		region_clone(&clip, r);
+		draw = 1;
+	}
+	if(o->cache)
+	{
+		if(!draw)
+			return;
+		if(dobject_layer_update(o))
 		{
-			display_draw(w, pos);
+			memcpy(&m, dobject_global_matrix(o), sizeof(struct matrix_t));
+			matrix_translate(&m, o->layer.x, o->layer.y);
+			surface_blit(w->s, &clip, &m, o->layer.s, RENDER_TYPE_GOOD);
+			return;
 		}
 	}
+	if(draw && region_overlap(&clip, dobject_global_bounds(o)))
+		o->draw(o, w->s, dobject_global_matrix(o), &clip);
+	list_for_each_entry(pos, &o->children, entry)
+	{
+		dobject_draw(pos, w, r);
+	}
+}
+
+static void display_draw(struct window_t * w, struct ldobject_t * o)
+{
+	struct region_list_t * rl = w->rl;
+	int i;
+
+	spin_lock(&__dobject_layer_lock);
+	__dobject_layer_frame++;
+	spin_unlock(&__dobject_layer_lock);
+	for(i = 0; i < rl->count; i++)
+		dobject_draw(o, w, &rl->region[i]);
 }
 
 static int m_render(lua_State * L)
@@ -2107,6 +2415,7 @@ static int m_render(lua_State * L)
 		dobject_layout(o);
 		window_region_list_clear(w);
 		window_region_list_fill(w, o);
+		window_set_opaque(w, o->opaque && o->visible && region_contains(dobject_global_bounds(o), &(struct region_t){ 0, 0, window_get_width(w), window_get_height(w) }));
 		window_present(w, o, (void (*)(struct window_t *, void *))display_draw);
 	}
 	return 0;
@@ -2174,6 +2483,10 @@ static const luaL_Reg m_dobject[] = {
 	{"getVisible",			m_get_visible},
 	{"setTouchable",		m_set_touchable},
 	{"getTouchable",		m_get_touchable},
+	{"setOpaque",			m_set_opaque},
+	{"getOpaque",			m_get_opaque},
+	{"setCacheAsBitmap",	m_set_cache_as_bitmap},
+	{"getCacheAsBitmap",	m_get_cache_as_bitmap},
 	{"globalToLocal",		m_global_to_local},
 	{"localToGlobal",		m_local_to_global},
 	{"hitTestPoint",		m_hit_test_point},
@@ -27,6 +27,7 @@
  */
 
 #include <xboot.h>
+#include <framework/core/l-color.h>
 #include <framework/core/l-image.h>
 #include <framework/core/l-window.h>
 
@@ -115,6 +116,52 @@ static int m_window_set_launcher(lua_State * L)
 	return 0;
 }
 
+static int m_window_set_background(lua_State * L)
+{
+	struct window_t * w = luaL_checkudata(L, 1, MT_WINDOW);
+	const char * type = luaL_optstring(L, 2, "checkerboard");
+	struct color_t * c = luaL_testudata(L, 3, MT_COLOR);
+	switch(shash(type))
+	{
+	case 0x7c9b47f5: /* "none" */
+		window_set_background(w, WINDOW_BACKGROUND_NONE, c);
+		break;
+	case 0x105eb980: /* "solid" */
+		window_set_background(w, WINDOW_BACKGROUND_SOLID, c);
+		break;
+	case 0x480a6de2: /* "checkerboard" */
+		window_set_background(w, WINDOW_BACKGROUND_CHECKERBOARD, c);
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
+static int m_window_get_background(lua_State * L)
+{
+	struct window_t * w = luaL_checkudata(L, 1, MT_WINDOW);
+	struct color_t * c = lua_newuserdata(L, sizeof(struct color_t));
+	luaL_setmetatable(L, MT_COLOR);
+	switch(window_get_background(w, c))
+	{
+	case WINDOW_BACKGROUND_NONE:
+		lua_pushstring(L, "none");
+		break;
+	case WINDOW_BACKGROUND_SOLID:
+		lua_pushstring(L, "solid");
+		break;
+	case WINDOW_BACKGROUND_CHECKERBOARD:
+		lua_pushstring(L, "checkerboard");
+		break;
+	default:
+		lua_pushnil(L);
+		break;
+	}
+	lua_insert(L, -2);
+	return 2;
+}
+
 static int m_window_snapshot(lua_State * L)
 {
 	struct window_t * w = luaL_checkudata(L, 1, MT_WINDOW);
@@ -144,6 +191,8 @@ static const luaL_Reg m_window[] = {
 	{"toFront",				m_window_to_front},
 	{"toBack",				m_window_to_back},
 	{"setLauncher",			m_window_set_launcher},
+	{"setBackground",		m_window_set_background},
+	{"getBackground",		m_window_get_background},
 	{"snapshot",			m_window_snapshot},
 	{"addFont",				m_window_add_font},
 	{NULL, NULL}
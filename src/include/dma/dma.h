@@ -76,6 +76,7 @@ struct dma_channel_t
 	int len;
 	void * data;
 	void (*complete)(void * data);
+	struct waitqueue_t wait;
 };
 
 struct dmachip_t
@@ -98,6 +99,7 @@ bool_t dma_is_valid(int dma);
 void dma_start(int dma, void * src, void * dst, int size, int flag, void (*complete)(void *), void * data);
 void dma_stop(int dma);
 void dma_wait(int dma);
+void dma_complete(struct dmachip_t * chip, int offset);
 
 #ifdef __cplusplus
 }
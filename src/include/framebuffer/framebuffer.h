@@ -35,6 +35,12 @@ struct framebuffer_t
 	/* Present a surface */
 	void (*present)(struct framebuffer_t * fb, struct surface_t * s, struct region_list_t * rl);
 
+	/* Create up to n surfaces the display can flip between, return how many were created */
+	int (*create_surfaces)(struct framebuffer_t * fb, struct surface_t ** s, int n);
+
+	/* Flip a surface made by create_surfaces to the display, rl is what changed since the last flip */
+	void (*flip)(struct framebuffer_t * fb, struct surface_t * s, struct region_list_t * rl, int vsync);
+
 	/* Private data */
 	void * priv;
 };
@@ -97,6 +103,18 @@ static inline void framebuffer_present_surface(struct framebuffer_t * fb, struct
 	fb->present(fb, s, rl);
 }
 
+static inline int framebuffer_create_surfaces(struct framebuffer_t * fb, struct surface_t ** s, int n)
+{
+	if(fb->create_surfaces && fb->flip)
+		return fb->create_surfaces(fb, s, n);
+	return 0;
+}
+
+static inline void framebuffer_flip_surface(struct framebuffer_t * fb, struct surface_t * s, struct region_list_t * rl, int vsync)
+{
+	fb->flip(fb, s, rl, vsync);
+}
+
 struct framebuffer_t * search_framebuffer(const char * name);
 struct framebuffer_t * search_first_framebuffer(void);
 struct device_t * register_framebuffer(struct framebuffer_t * fb, struct driver_t * drv);
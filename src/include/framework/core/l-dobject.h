@@ -7,6 +7,7 @@ extern "C" {
 
 #include <list.h>
 #include <xboot/window.h>
+#include <graphic/cache.h>
 #include <framework/luahelper.h>
 
 #define MT_DOBJECT	"__mt_dobject__"
@@ -19,6 +20,20 @@ enum dobject_type_t {
 	DOBJECT_TYPE_ICON				= 4,
 };
 
+enum {
+	MFLAG_TRANSLATE					= (0x1 << 0),
+	MFLAG_ROTATE					= (0x1 << 1),
+	MFLAG_SCALE						= (0x1 << 2),
+	MFLAG_SKEW						= (0x1 << 3),
+	MFLAG_ANCHOR					= (0x1 << 4),
+	MFLAG_LOCAL_MATRIX				= (0x1 << 5),
+	MFLAG_GLOBAL_MATRIX				= (0x1 << 6),
+	MFLAG_GLOBAL_BOUNDS				= (0x1 << 7),
+	MFLAG_DIRTY						= (0x1 << 8),
+	MFLAG_SUBTREE_BOUNDS			= (0x1 << 9),
+	MFLAG_LAYER						= (0x1 << 10),
+};
+
 enum collider_type_t {
 	COLLIDER_TYPE_NONE				= 0,
 	COLLIDER_TYPE_CIRCLE			= 1,
@@ -97,17 +112,28 @@ struct ldobject_t {
 
 	int visible;
 	int touchable;
+	int opaque;
 	int mflag;
 	struct matrix_t local_matrix;
 	struct matrix_t global_matrix;
 	struct region_t global_bounds;
 	struct region_t dirty_bounds;
+	struct region_t subtree_bounds;
+
+	int cache;
+	struct {
+		struct list_head entry;
+		struct surface_t * s;
+		int x, y;
+		unsigned int frame;
+	} layer;
 
-	void (*draw)(struct ldobject_t * o, struct window_t * w);
+	void (*draw)(struct ldobject_t * o, struct surface_t * s, struct matrix_t * m, struct region_t * clip);
 	void * priv;
 };
 
 int luaopen_dobject(lua_State * L);
+void dobject_layer_stat(struct cache_stat_t * stat);
 
 #ifdef __cplusplus
 }
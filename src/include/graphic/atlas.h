@@ -0,0 +1,38 @@
+#ifndef __GRAPHIC_ATLAS_H__
+#define __GRAPHIC_ATLAS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <types.h>
+#include <stdint.h>
+#include <graphic/cache.h>
+
+struct atlas_page_t;
+
+/*
+ * A glyph packed into an atlas page, left and top are the bearing of the
+ * glyph, the coverage is width by height bytes at buffer, one row every
+ * pitch bytes. The page stays pinned until the glyph is released.
+ */
+struct atlas_glyph_t {
+	int left;
+	int top;
+	int width;
+	int height;
+	int pitch;
+	unsigned char * buffer;
+	struct atlas_page_t * page;
+};
+
+int atlas_lookup(uint32_t serial, uint32_t face, int size, uint32_t index, struct atlas_glyph_t * g);
+int atlas_insert(uint32_t serial, uint32_t face, int size, uint32_t index, int left, int top, int width, int height, int pitch, unsigned char * buffer, struct atlas_glyph_t * g);
+void atlas_release(struct atlas_glyph_t * g);
+void atlas_stat(struct cache_stat_t * stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GRAPHIC_ATLAS_H__ */
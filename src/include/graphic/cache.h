@@ -0,0 +1,24 @@
+#ifndef __GRAPHIC_CACHE_H__
+#define __GRAPHIC_CACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <types.h>
+#include <stdint.h>
+
+struct cache_stat_t {
+	size_t bytes;
+	size_t budget;
+	int count;
+	uint64_t hit;
+	uint64_t miss;
+	uint64_t evict;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GRAPHIC_CACHE_H__ */
@@ -8,20 +8,47 @@ extern "C" {
 #include <types.h>
 #include <list.h>
 #include <xfs/xfs.h>
+#include <graphic/matrix.h>
+#include <graphic/cache.h>
 
 struct font_context_t {
+	uint32_t serial;
 	void * library;
 	void * manager;
 	void * cmap;
 	void * sbit;
 	void * image;
 	struct list_head list;
+	struct list_head entry;
+	struct hlist_head * glyph_hash;
+	struct list_head glyph_lru;
+	struct cache_stat_t glyph_stat;
+};
+
+/*
+ * A glyph rendered through a matrix, left and top are from the integer
+ * pen with y going up, the advances are those of the glyph before and
+ * after the transform, in pixels and in 26.6 fixed point.
+ */
+struct font_glyph_t {
+	int left;
+	int top;
+	int width;
+	int height;
+	int pitch;
+	int advance;
+	int ax, ay;
+	unsigned char * buffer;
 };
 
 struct font_context_t * font_context_alloc(void);
 void font_context_free(struct font_context_t * ctx);
 void * font_lookup_bitmap(struct font_context_t * ctx, const char * family, int size, uint32_t code);
+void * font_lookup_bitmap_index(struct font_context_t * ctx, const char * family, int size, uint32_t code, uint32_t * face, uint32_t * index);
+void * font_index_bitmap(struct font_context_t * ctx, uint32_t face, int size, uint32_t index);
 void * font_lookup_glyph(struct font_context_t * ctx, const char * family, int size, uint32_t code);
+struct font_glyph_t * font_lookup_transformed_glyph(struct font_context_t * ctx, const char * family, int size, uint32_t code, struct matrix_t * m, int fx, int fy);
+void font_cache_stat(struct cache_stat_t * stat);
 void font_add(struct font_context_t * ctx, struct xfs_context_t * xfs, const char * family, const char * path);
 
 #ifdef __cplusplus
@@ -101,6 +101,12 @@ static inline int region_union(struct region_t * r, struct region_t * a, struct
 	return 1;
 }
 
+/*
+ * A region list is kept banded, rectangles are sorted by y then by x, those
+ * of a band share the same top and height, never overlap nor touch, and two
+ * bands that touch always differ in their spans, so each area has only one
+ * list of rectangles.
+ */
 struct region_list_t {
 	struct region_t * region;
 	unsigned int size;
@@ -111,7 +117,13 @@ struct region_list_t * region_list_alloc(unsigned int size);
 void region_list_free(struct region_list_t * rl);
 void region_list_clone(struct region_list_t * rl, struct region_list_t * o);
 void region_list_merge(struct region_list_t * rl, struct region_list_t * o);
+void region_list_union(struct region_list_t * rl, struct region_list_t * a, struct region_list_t * b);
+void region_list_intersect(struct region_list_t * rl, struct region_list_t * a, struct region_list_t * b);
+void region_list_subtract(struct region_list_t * rl, struct region_list_t * a, struct region_list_t * b);
 void region_list_add(struct region_list_t * rl, struct region_t * r);
+void region_list_clip(struct region_list_t * rl, struct region_t * r);
+void region_list_cut(struct region_list_t * rl, struct region_t * r);
+int region_list_extents(struct region_list_t * rl, struct region_t * r);
 void region_list_clear(struct region_list_t * rl);
 
 #ifdef __cplusplus
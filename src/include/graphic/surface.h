@@ -8,6 +8,7 @@ extern "C" {
 #include <types.h>
 #include <stdint.h>
 #include <graphic/point.h>
+#include <graphic/cache.h>
 #include <graphic/region.h>
 #include <graphic/color.h>
 #include <graphic/matrix.h>
@@ -23,6 +24,11 @@ struct render_t;
  * Each pixel is a 32-bits, with alpha in the upper 8 bits, then red green and blue.
  * The 32-bit quantities are stored native-endian, Pre-multiplied alpha is used.
  * That is, 50% transparent red is 0x80800000 not 0x80ff0000.
+ *
+ * Whoever gets the pixels may change them, so the version is bumped on each
+ * surface_get_pixels(), a render keeping anything derived from the pixels
+ * rebuilds it when the version moves. A render that defers its drawing has
+ * a flush, which is called before the pixels are handed out.
  */
 struct surface_t
 {
@@ -31,6 +37,7 @@ struct surface_t
 	int stride;
 	int pixlen;
 	void * pixels;
+	unsigned int version;
 	struct render_t * r;
 	void * rctx;
 	void * priv;
@@ -49,6 +56,7 @@ struct render_t
 
 	void * (*create)(struct surface_t * s);
 	void (*destroy)(void * rctx);
+	void (*flush)(struct surface_t * s);
 
 	void (*blit)(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct surface_t * src, enum render_type_t type);
 	void (*fill)(struct surface_t * s, struct region_t * clip, struct matrix_t * m, int w, int h, struct color_t * c, enum render_type_t type);
@@ -100,8 +108,16 @@ static inline int surface_get_stride(struct surface_t * s)
 	return s->stride;
 }
 
+static inline void surface_flush(struct surface_t * s)
+{
+	if(s->r->flush)
+		s->r->flush(s);
+}
+
 static inline void * surface_get_pixels(struct surface_t * s)
 {
+	surface_flush(s);
+	s->version++;
 	return s->pixels;
 }
 
@@ -260,9 +276,14 @@ static inline void surface_filter_dilate(struct surface_t * s, int times)
 	s->r->filter_dilate(s, times);
 }
 
+void render_span_blend(uint32_t * d, uint32_t * s, int n);
+void render_span_fill(uint32_t * d, uint32_t c, int n);
+void render_span_copy(uint32_t * d, uint32_t * s, int n);
+void render_span_lerp(uint32_t * d, uint32_t * a, uint32_t * b, int f, int n);
 void * render_default_create(struct surface_t * s);
 void render_default_destroy(void * rctx);
 void render_default_blit(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct surface_t * src, enum render_type_t type);
+void render_default_blit_prepare(struct surface_t * src, struct matrix_t * m, enum render_type_t type);
 void render_default_fill(struct surface_t * s, struct region_t * clip, struct matrix_t * m, int w, int h, struct color_t * c, enum render_type_t type);
 void render_default_text(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct text_t * txt);
 void render_default_icon(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct icon_t * ico);
@@ -293,8 +314,11 @@ void render_default_filter_haldclut(struct surface_t * s, struct surface_t * clu
 void render_default_filter_blur(struct surface_t * s, int radius);
 void render_default_filter_erode(struct surface_t * s, int times);
 void render_default_filter_dilate(struct surface_t * s, int times);
+void render_shape_cache_stat(struct cache_stat_t * stat);
 
 struct render_t * search_render(void);
+struct render_t * search_render_default(void);
+struct render_t * search_render_tile(void);
 bool_t register_render(struct render_t * r);
 bool_t unregister_render(struct render_t * r);
 struct surface_t * surface_alloc(int width, int height, void * priv);
@@ -17,6 +17,7 @@ struct text_t {
 	struct font_context_t * fctx;
 	const char * family;
 	int size;
+	uint32_t run;
 	struct {
 		int ox;
 		int oy;
@@ -31,6 +32,7 @@ void text_set_color(struct text_t * txt, struct color_t * c);
 void text_set_wrap(struct text_t * txt, int wrap);
 void text_set_family(struct text_t * txt, const char * family);
 void text_set_size(struct text_t * txt, int size);
+void text_run_cache_stat(struct cache_stat_t * stat);
 
 #ifdef __cplusplus
 }
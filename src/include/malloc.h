@@ -6,6 +6,25 @@ extern "C" {
 #endif
 
 #include <types.h>
+#include <stdint.h>
+
+#define MALLOC_STAT_CLASS_COUNT		(16)
+
+struct malloc_stat_t {
+	ssize_t used;
+	ssize_t heap;
+	size_t peak;
+	uint64_t nalloc;
+	uint64_t nfree;
+	long live[MALLOC_STAT_CLASS_COUNT];
+	uint64_t count[MALLOC_STAT_CLASS_COUNT];
+};
+
+struct malloc_site_t {
+	void * caller;
+	long count;
+	long bytes;
+};
 
 void * mm_create(void * mem, size_t bytes);
 void mm_destroy(void * mem);
@@ -23,6 +42,13 @@ void * memalign(size_t align, size_t size);
 void * realloc(void * ptr, size_t size);
 void * calloc(size_t nmemb, size_t size);
 void free(void * ptr);
+size_t malloc_usable_size(void * ptr);
+void malloc_drain(void);
+size_t malloc_stat_class_size(int c);
+void malloc_stat(struct malloc_stat_t * stat);
+void malloc_snapshot(void);
+void malloc_stat_diff(struct malloc_stat_t * stat);
+int malloc_leak(struct malloc_site_t * site, int n);
 
 void do_init_mem(void);
 
@@ -5,10 +5,22 @@
 extern "C" {
 #endif
 
+#include <xconfigs.h>
+#include <stdint.h>
+#include <list.h>
 #include <rbtree_augmented.h>
 #include <clockevent/clockevent.h>
 #include <xboot/ktime.h>
 
+/*
+ * A wheel of 256 slots one tick apart, then four levels of 64 slots each
+ * covering 64 times the span of the level below, up to 2^32 ticks.
+ */
+#define TIMER_WHEEL_L0_BITS		(8)
+#define TIMER_WHEEL_LN_BITS		(6)
+#define TIMER_WHEEL_LEVELS		(5)
+#define TIMER_WHEEL_SIZE		((1 << TIMER_WHEEL_L0_BITS) + (TIMER_WHEEL_LEVELS - 1) * (1 << TIMER_WHEEL_LN_BITS))
+
 struct timer_base_t;
 struct timer_t;
 
@@ -21,14 +33,23 @@ enum timer_state_t {
 struct timer_base_t {
 	struct rb_root head;
 	struct timer_t * next;
-	struct clockevent_t * ce;
+	struct list_head wheel[TIMER_WHEEL_SIZE];
+	uint64_t pending[TIMER_WHEEL_SIZE / 64];
+	uint64_t clk;
+	int count;
+	uint64_t nr_wheel;
+	uint64_t nr_hres;
+	uint64_t nr_cascade;
+	uint64_t nr_expire;
 	spinlock_t lock;
 };
 
 struct timer_t {
 	struct rb_node node;
+	struct list_head entry;
 	struct timer_base_t * base;
 	enum timer_state_t state;
+	int slot;
 	ktime_t expires;
 	void * data;
 	int (*function)(struct timer_t *, void *);
@@ -42,6 +63,7 @@ void timer_forward_now(struct timer_t * timer, ktime_t interval);
 void timer_cancel(struct timer_t * timer);
 
 void timer_bind_clockevent(struct clockevent_t * ce);
+void do_init_timer(void);
 
 #ifdef __cplusplus
 }
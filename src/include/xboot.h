@@ -59,8 +59,14 @@ extern "C" {
 #include <xboot/dtree.h>
 #include <xboot/device.h>
 #include <xboot/driver.h>
+#include <xboot/stack.h>
+#include <xboot/kmem.h>
 #include <xboot/task.h>
 #include <xboot/mutex.h>
+#include <xboot/waitqueue.h>
+#include <xboot/semaphore.h>
+#include <xboot/rwlock.h>
+#include <xboot/condition.h>
 #include <xboot/channel.h>
 #include <xboot/window.h>
 #include <time/delay.h>
@@ -24,6 +24,24 @@ void channel_free(struct channel_t * c);
 void channel_send(struct channel_t * c, unsigned char * buf, unsigned int len);
 void channel_recv(struct channel_t * c, unsigned char * buf, unsigned int len);
 
+struct mchannel_t {
+	void ** msg;
+	unsigned int size;
+	unsigned int in;
+	unsigned int out;
+	struct list_head swait;
+	struct list_head rwait;
+	spinlock_t lock;
+};
+
+struct mchannel_t * mchannel_alloc(unsigned int size);
+void mchannel_free(struct mchannel_t * c);
+int mchannel_send(struct mchannel_t * c, void * msg, uint64_t ns);
+int mchannel_trysend(struct mchannel_t * c, void * msg);
+int mchannel_recv(struct mchannel_t * c, void ** msg, uint64_t ns);
+int mchannel_tryrecv(struct mchannel_t * c, void ** msg);
+int channel_select(struct mchannel_t ** c, int n, void ** msg, uint64_t ns);
+
 #ifdef __cplusplus
 }
 #endif
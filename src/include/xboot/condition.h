@@ -0,0 +1,30 @@
+#ifndef __CONDITION_H__
+#define __CONDITION_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <types.h>
+#include <list.h>
+#include <spinlock.h>
+#include <xboot/task.h>
+#include <xboot/mutex.h>
+#include <xboot/waitqueue.h>
+
+struct condition_t {
+	struct list_head cwait;
+	spinlock_t lock;
+};
+
+void condition_init(struct condition_t * c);
+void condition_wait(struct condition_t * c, struct mutex_t * m);
+int condition_wait_timeout(struct condition_t * c, struct mutex_t * m, uint64_t ns);
+void condition_signal(struct condition_t * c);
+void condition_broadcast(struct condition_t * c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CONDITION_H__ */
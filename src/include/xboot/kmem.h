@@ -0,0 +1,51 @@
+#ifndef __KMEM_H__
+#define __KMEM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <xconfigs.h>
+#include <types.h>
+#include <stdint.h>
+#include <list.h>
+#include <spinlock.h>
+
+#define KMEM_CPU_CACHE			(16)
+
+struct kmem_cpu_cache_t {
+	void * objs[KMEM_CPU_CACHE];
+	int count;
+	uint64_t nr_alloc;
+	uint64_t nr_free;
+};
+
+struct kmem_cache_t {
+	struct kobj_t * kobj;
+	char * name;
+	size_t size;
+	size_t align;
+	size_t slab_size;
+	int objs_per_slab;
+
+	struct list_head partial;
+	struct list_head full;
+	struct list_head empty;
+	int nr_slabs;
+	int nr_empty;
+	struct kmem_cpu_cache_t cpu[CONFIG_MAX_SMP_CPUS];
+	spinlock_t lock;
+};
+
+struct kmem_cache_t * kmem_cache_create(const char * name, size_t size, size_t align);
+void kmem_cache_destroy(struct kmem_cache_t * cache);
+void * kmem_cache_alloc(struct kmem_cache_t * cache);
+void * kmem_cache_zalloc(struct kmem_cache_t * cache);
+void kmem_cache_free(struct kmem_cache_t * cache, void * obj);
+void kmem_cache_shrink(struct kmem_cache_t * cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __KMEM_H__ */
@@ -7,17 +7,20 @@ extern "C" {
 
 #include <types.h>
 #include <list.h>
-#include <atomic.h>
 #include <spinlock.h>
+#include <xboot/task.h>
+#include <xboot/waitqueue.h>
 
 struct mutex_t {
-	atomic_t atomic;
 	struct list_head mwait;
+	struct task_t * owner;
+	int locked;
 	spinlock_t lock;
 };
 
 void mutex_init(struct mutex_t * m);
 void mutex_lock(struct mutex_t * m);
+int mutex_trylock(struct mutex_t * m);
 void mutex_unlock(struct mutex_t * m);
 
 #ifdef __cplusplus
@@ -7,21 +7,86 @@ extern "C" {
 
 #include <stdint.h>
 #include <stddef.h>
-#include <list.h>
 
-struct profiler_t
+#define PROFILER_HIST_COUNT		(48)
+
+/*
+ * The cpu counters sampled next to the wall time of every probe. Which
+ * of them exist depends on the cpu_profiler backend of the architecture,
+ * a missing one always reads as zero.
+ */
+enum profiler_counter_t {
+	PROFILER_COUNTER_CYCLES			= 0,
+	PROFILER_COUNTER_INSTRUCTIONS	= 1,
+	PROFILER_COUNTER_CACHE_MISSES	= 2,
+	PROFILER_COUNTER_MAX			= 3,
+};
+
+/*
+ * A probe is registered at compile time. Its descriptor goes to the
+ * .profiler.text section and its id is the index in that section, so a
+ * probe never hashes a name or allocates on the hot path.
+ */
+struct profiler_probe_t
+{
+	const char * name;
+	const char * file;
+	int line;
+};
+
+struct profiler_mark_t
+{
+	int cpu;
+	uint64_t time;
+	uint64_t counter[PROFILER_COUNTER_MAX];
+};
+
+struct profiler_stat_t
 {
-	struct hlist_node node;
-	char * name;
-	int event;
-	int data;
-	uint64_t begin;
-	uint64_t end;
 	uint64_t count;
+	uint64_t migrated;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t counter[PROFILER_COUNTER_MAX];
+	uint32_t hist[PROFILER_HIST_COUNT];
+};
+
+enum profiler_event_type_t {
+	PROFILER_EVENT_BEGIN	= 0,
+	PROFILER_EVENT_END		= 1,
+};
+
+/*
+ * An event lies in the ring of the cpu that recorded it, the cpu field is
+ * the one its probe began on, which differs for the end of a probe whose
+ * task moved to another cpu in between
+ */
+struct profiler_event_t
+{
+	uint64_t time;
+	int id;
+	int type;
+	int cpu;
 };
 
-struct profiler_t * profiler_search(const char * name);
-void profiler_snap(const char * name, int event, int data);
+extern const struct profiler_probe_t * const __profiler_start[];
+extern const struct profiler_probe_t * const __profiler_end[];
+
+#define profiler_probe(name) ({ \
+	static const struct profiler_probe_t __probe = { (name), __FILE__, __LINE__ }; \
+	static const struct profiler_probe_t * const __probe_entry \
+	__attribute__((__used__, section(".profiler.text"))) = &__probe; \
+	(int)(&__probe_entry - __profiler_start); })
+
+int profiler_count(void);
+const struct profiler_probe_t * profiler_get_probe(int id);
+void profiler_begin(int id, struct profiler_mark_t * m);
+void profiler_end(int id, struct profiler_mark_t * m);
+int profiler_counter_available(int counter);
+void profiler_stat(int id, struct profiler_stat_t * stat);
+void profiler_trace_enable(int enable);
+int profiler_trace_read(int cpu, struct profiler_event_t * ev, int n);
 void profiler_dump(void);
 void profiler_reset(void);
 
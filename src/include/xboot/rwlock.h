@@ -0,0 +1,34 @@
+#ifndef __RWLOCK_H__
+#define __RWLOCK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <types.h>
+#include <list.h>
+#include <spinlock.h>
+#include <xboot/task.h>
+#include <xboot/waitqueue.h>
+
+struct rwlock_t {
+	struct list_head rwait;
+	struct list_head wwait;
+	int readers;
+	int writer;
+	spinlock_t lock;
+};
+
+void rwlock_init(struct rwlock_t * rw);
+void rwlock_read_lock(struct rwlock_t * rw);
+int rwlock_read_trylock(struct rwlock_t * rw);
+void rwlock_read_unlock(struct rwlock_t * rw);
+void rwlock_write_lock(struct rwlock_t * rw);
+int rwlock_write_trylock(struct rwlock_t * rw);
+void rwlock_write_unlock(struct rwlock_t * rw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RWLOCK_H__ */
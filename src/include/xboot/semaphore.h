@@ -0,0 +1,30 @@
+#ifndef __SEMAPHORE_H__
+#define __SEMAPHORE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <types.h>
+#include <list.h>
+#include <spinlock.h>
+#include <xboot/task.h>
+#include <xboot/waitqueue.h>
+
+struct semaphore_t {
+	struct list_head swait;
+	int count;
+	spinlock_t lock;
+};
+
+void semaphore_init(struct semaphore_t * sem, int count);
+void semaphore_down(struct semaphore_t * sem);
+int semaphore_down_timeout(struct semaphore_t * sem, uint64_t ns);
+int semaphore_trydown(struct semaphore_t * sem);
+void semaphore_up(struct semaphore_t * sem);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SEMAPHORE_H__ */
@@ -0,0 +1,37 @@
+#ifndef __STACK_H__
+#define __STACK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <xconfigs.h>
+#include <types.h>
+#include <stdint.h>
+#include <list.h>
+#include <spinlock.h>
+
+#define STACK_CLASS_SHIFT		(12)
+#define STACK_CLASS_MAX			(9)
+
+struct stack_arena_t {
+	struct list_head head[STACK_CLASS_MAX];
+	unsigned int count[STACK_CLASS_MAX];
+	uint64_t nr_alloc;
+	uint64_t nr_hit;
+	uint64_t nr_free;
+	uint64_t nr_release;
+	spinlock_t lock;
+};
+
+void * stack_alloc(size_t * size);
+void stack_free(void * stack, size_t size);
+size_t stack_used(void * stack, size_t size);
+int stack_overflow(void * stack);
+void do_init_stack(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STACK_H__ */
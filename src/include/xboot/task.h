@@ -12,10 +12,12 @@ extern "C" {
 #include <irqflags.h>
 #include <spinlock.h>
 #include <smp.h>
+#include <xboot/stack.h>
 #include <rbtree_augmented.h>
 
 struct task_t;
 struct scheduler_t;
+struct mutex_t;
 typedef void (*task_func_t)(struct task_t * task, void * data);
 
 enum task_status_t {
@@ -29,7 +31,6 @@ struct task_t {
 	struct list_head list;
 	struct list_head slist;
 	struct list_head rlist;
-	struct list_head mlist;
 	struct scheduler_t * sched;
 	enum task_status_t status;
 	uint64_t start;
@@ -40,8 +41,11 @@ struct task_t {
 	void * stack;
 	size_t stksz;
 	int nice;
+	int pi_nice;
 	int weight;
 	uint32_t inv_weight;
+	struct mutex_t * mblocked;
+	int mheld;
 	task_func_t func;
 	void * data;
 	int __errno;
@@ -51,8 +55,16 @@ struct scheduler_t {
 	struct rb_root_cached ready;
 	struct list_head suspend;
 	struct task_t * running;
+	struct task_t * idle;
+	struct task_t * exited;
 	uint64_t min_vtime;
 	uint64_t weight;
+	uint64_t next_balance;
+	unsigned int nr_ready;
+	uint64_t nr_migrate_in;
+	uint64_t nr_migrate_out;
+	uint64_t nr_idle;
+	uint64_t idle_time;
 	spinlock_t lock;
 };
 
@@ -71,9 +83,13 @@ static inline struct task_t * task_self(void)
 struct task_t * task_create(struct scheduler_t * sched, const char * name, task_func_t func, void * data, size_t stksz, int nice);
 void task_destroy(struct task_t * task);
 void task_renice(struct task_t * task, int nice);
+void task_boost(struct task_t * task, int nice);
+void task_unboost(struct task_t * task);
 void task_suspend(struct task_t * task);
 void task_resume(struct task_t * task);
 void task_yield(void);
+int task_wait_until(volatile int * wakeup, uint64_t expires);
+void task_sleep(uint64_t ns);
 
 void scheduler_loop(void);
 void do_init_sched(void);
@@ -0,0 +1,82 @@
+#ifndef __WAITQUEUE_H__
+#define __WAITQUEUE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <types.h>
+#include <list.h>
+#include <spinlock.h>
+#include <xboot/ktime.h>
+#include <xboot/task.h>
+
+struct waitqueue_t {
+	struct list_head head;
+	spinlock_t lock;
+};
+
+struct waitqueue_entry_t {
+	struct list_head list;
+	struct task_t * task;
+	volatile int wakeup;
+};
+
+void waitqueue_init(struct waitqueue_t * wq);
+void waitqueue_prepare(struct waitqueue_t * wq, struct waitqueue_entry_t * wqe);
+void waitqueue_finish(struct waitqueue_t * wq, struct waitqueue_entry_t * wqe);
+int waitqueue_schedule(struct waitqueue_t * wq, struct waitqueue_entry_t * wqe, ktime_t expires);
+void waitqueue_wakeup(struct waitqueue_t * wq);
+void waitqueue_wakeup_all(struct waitqueue_t * wq);
+
+/*
+ * Wait until the condition becomes true or the timeout (in nanoseconds)
+ * elapses. Returns zero if the condition is still false after the timeout,
+ * otherwise the remaining time in nanoseconds, at least one.
+ */
+#define wait_event_timeout(wq, condition, ns)							\
+({																		\
+	ktime_t __expires = ktime_add_ns(ktime_get(), (ns));				\
+	struct waitqueue_entry_t __wqe;										\
+	int64_t __ret = 0;													\
+	while(1)															\
+	{																	\
+		waitqueue_prepare((wq), &__wqe);								\
+		if(condition)													\
+		{																\
+			waitqueue_finish((wq), &__wqe);								\
+			__ret = ktime_to_ns(ktime_sub(__expires, ktime_get()));		\
+			if(__ret <= 0)												\
+				__ret = 1;												\
+			break;														\
+		}																\
+		if(!waitqueue_schedule((wq), &__wqe, __expires))				\
+		{																\
+			if(condition)												\
+				__ret = 1;												\
+			break;														\
+		}																\
+	}																	\
+	__ret;																\
+})
+
+#define wait_event(wq, condition)										\
+do {																	\
+	struct waitqueue_entry_t __wqe;										\
+	while(1)															\
+	{																	\
+		waitqueue_prepare((wq), &__wqe);								\
+		if(condition)													\
+		{																\
+			waitqueue_finish((wq), &__wqe);								\
+			break;														\
+		}																\
+		waitqueue_schedule((wq), &__wqe, ktime_set(KTIME_SEC_MAX, 0));	\
+	}																	\
+} while(0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WAITQUEUE_H__ */
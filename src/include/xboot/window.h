@@ -30,6 +30,14 @@ struct window_manager_t {
 	} cursor;
 };
 
+#define WINDOW_SURFACE_MAX				(3)
+
+enum window_background_t {
+	WINDOW_BACKGROUND_NONE			= 0,
+	WINDOW_BACKGROUND_SOLID			= 1,
+	WINDOW_BACKGROUND_CHECKERBOARD	= 2,
+};
+
 struct window_t {
 	struct list_head list;
 	struct window_manager_t * wm;
@@ -38,6 +46,18 @@ struct window_t {
 	struct fifo_t * event;
 	struct hmap_t * map;
 	int launcher;
+	struct {
+		struct surface_t * s[WINDOW_SURFACE_MAX];
+		struct region_list_t * damage[WINDOW_SURFACE_MAX];
+		struct region_list_t * repair;
+		int count;
+		int index;
+	} chain;
+	struct {
+		enum window_background_t type;
+		struct color_t color;
+		int opaque;
+	} background;
 	void * priv;
 };
 
@@ -100,6 +120,42 @@ static inline int window_get_launcher(struct window_t * w)
 	return w ? w->launcher : 0;
 }
 
+static inline void window_set_background(struct window_t * w, enum window_background_t type, struct color_t * c)
+{
+	if(w)
+	{
+		w->background.type = type;
+		if(c)
+			memcpy(&w->background.color, c, sizeof(struct color_t));
+	}
+}
+
+static inline enum window_background_t window_get_background(struct window_t * w, struct color_t * c)
+{
+	if(w)
+	{
+		if(c)
+			memcpy(c, &w->background.color, sizeof(struct color_t));
+		return w->background.type;
+	}
+	return WINDOW_BACKGROUND_NONE;
+}
+
+/*
+ * Hint that the next frame covers every dirty region with opaque pixels,
+ * then the background is never painted under it
+ */
+static inline void window_set_opaque(struct window_t * w, int opaque)
+{
+	if(w)
+		w->background.opaque = opaque ? 1 : 0;
+}
+
+static inline int window_get_opaque(struct window_t * w)
+{
+	return w ? w->background.opaque : 0;
+}
+
 struct window_t * window_alloc(const char * fb, const char * input, void * data);
 void window_free(struct window_t * w);
 void window_to_front(struct window_t * w);
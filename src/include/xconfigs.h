@@ -15,10 +15,46 @@ extern "C" {
 #define CONFIG_MAX_SMP_CPUS					(1)
 #endif
 
+#if !defined(CONFIG_MALLOC_MAGAZINE_ROUNDS)
+#define CONFIG_MALLOC_MAGAZINE_ROUNDS		(16)
+#endif
+
+#if !defined(CONFIG_MALLOC_MAGAZINE_DEPOT)
+#define CONFIG_MALLOC_MAGAZINE_DEPOT		(4)
+#endif
+
+#if !defined(CONFIG_MALLOC_TRACE)
+#define CONFIG_MALLOC_TRACE					(0)
+#endif
+
+#if !defined(CONFIG_SPINLOCK_STAT)
+#define CONFIG_SPINLOCK_STAT				(0)
+#endif
+
 #if !defined(CONFIG_TASK_STACK_SIZE)
 #define CONFIG_TASK_STACK_SIZE				(512 * 1024)
 #endif
 
+#if !defined(CONFIG_TASK_STACK_CACHE)
+#define CONFIG_TASK_STACK_CACHE				(4)
+#endif
+
+#if !defined(CONFIG_TASK_STACK_PREFILL)
+#define CONFIG_TASK_STACK_PREFILL			(1)
+#endif
+
+#if !defined(CONFIG_TASK_STACK_CHECK)
+#define CONFIG_TASK_STACK_CHECK				(1)
+#endif
+
+#if !defined(CONFIG_TIMER_WHEEL_SHIFT)
+#define CONFIG_TIMER_WHEEL_SHIFT			(20)
+#endif
+
+#if !defined(CONFIG_SCHED_BALANCE_INTERVAL)
+#define CONFIG_SCHED_BALANCE_INTERVAL		(4)
+#endif
+
 #if !defined(CONFIG_DRIVER_HASH_SIZE)
 #define CONFIG_DRIVER_HASH_SIZE				(257)
 #endif
@@ -27,18 +63,54 @@ extern "C" {
 #define CONFIG_DEVICE_HASH_SIZE				(257)
 #endif
 
-#if !defined(CONFIG_PROFILER_HASH_SIZE)
-#define CONFIG_PROFILER_HASH_SIZE			(257)
+#if !defined(CONFIG_PROFILER_TRACE_SIZE)
+#define CONFIG_PROFILER_TRACE_SIZE			(4096)
 #endif
 
 #if !defined(CONFIG_KVDB_HASH_SIZE)
 #define CONFIG_KVDB_HASH_SIZE				(4099)
 #endif
 
+#if !defined(CONFIG_RENDER_TILE)
+#define CONFIG_RENDER_TILE					(0)
+#endif
+
+#if !defined(CONFIG_RENDER_TILE_SIZE)
+#define CONFIG_RENDER_TILE_SIZE				(64)
+#endif
+
+#if !defined(CONFIG_RENDER_SHAPE_CACHE_SIZE)
+#define CONFIG_RENDER_SHAPE_CACHE_SIZE		(SZ_512K)
+#endif
+
+#if !defined(CONFIG_FONT_GLYPH_CACHE_SIZE)
+#define CONFIG_FONT_GLYPH_CACHE_SIZE		(SZ_256K)
+#endif
+
+#if !defined(CONFIG_TEXT_RUN_CACHE_SIZE)
+#define CONFIG_TEXT_RUN_CACHE_SIZE		(SZ_128K)
+#endif
+
+#if !defined(CONFIG_ATLAS_PAGE_SIZE)
+#define CONFIG_ATLAS_PAGE_SIZE			(256)
+#endif
+
+#if !defined(CONFIG_ATLAS_PAGE_COUNT)
+#define CONFIG_ATLAS_PAGE_COUNT			(8)
+#endif
+
+#if !defined(CONFIG_DOBJECT_LAYER_CACHE_SIZE)
+#define CONFIG_DOBJECT_LAYER_CACHE_SIZE	(SZ_4M)
+#endif
+
 #if !defined(CONFIG_MAX_BRIGHTNESS)
 #define CONFIG_MAX_BRIGHTNESS				(1000)
 #endif
 
+#if !defined(CONFIG_WINDOW_SURFACE_COUNT)
+#define CONFIG_WINDOW_SURFACE_COUNT			(2)
+#endif
+
 #if !defined(CONFIG_EVENT_FIFO_SIZE)
 #define CONFIG_EVENT_FIFO_SIZE				(8)
 #endif
@@ -29,11 +29,31 @@
 #include <xboot.h>
 #include <init.h>
 
+static void autoboot_task(struct task_t * task, void * data)
+{
+	/* Do auto boot */
+	do_autoboot();
+
+#if defined(CONFIG_SHELL_TASK) && (CONFIG_SHELL_TASK > 0)
+	/* Create shell task */
+	struct task_t * shell = task_create(scheduler_self(), "shell", shell_task, NULL, 0, 0);
+
+	/* Resume shell task */
+	task_resume(shell);
+#endif
+}
+
 void xboot_main(void)
 {
 	/* Do initial memory */
 	do_init_mem();
 
+	/* Do initial stack arena */
+	do_init_stack();
+
+	/* Do initial timer */
+	do_init_timer();
+
 	/* Do initial scheduler */
 	do_init_sched();
 
@@ -49,16 +69,8 @@ void xboot_main(void)
 	/* Do auto mount */
 	do_automount();
 
-	/* Do auto boot */
-	do_autoboot();
-
-#if defined(CONFIG_SHELL_TASK) && (CONFIG_SHELL_TASK > 0)
-	/* Create shell task */
-	struct task_t * task = task_create(scheduler_self(), "shell", shell_task, NULL, 0, 0);
-
-	/* Resume shell task */
-	task_resume(task);
-#endif
+	/* Resume auto boot task */
+	task_resume(task_create(scheduler_self(), "autoboot", autoboot_task, NULL, 0, 0));
 
 	/* Scheduler loop */
 	scheduler_loop();
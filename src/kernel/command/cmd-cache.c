@@ -0,0 +1,86 @@
+/*
+ * kernel/command/cmd-cache.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <graphic/surface.h>
+#include <graphic/atlas.h>
+#include <framework/core/l-dobject.h>
+#include <command/command.h>
+
+static void usage(void)
+{
+	printf("usage:\r\n");
+	printf("    cache\r\n");
+}
+
+static void cache_stat(const char * name, struct cache_stat_t * stat)
+{
+	char b[32], u[32];
+	uint64_t n = stat->hit + stat->miss;
+
+	printf(" %-8s %8s / %-8s %6d entries, %3d%% hit (%lld/%lld), %lld evicted\r\n", name,
+		ssize(b, stat->bytes), ssize(u, stat->budget), stat->count,
+		n > 0 ? (int)(stat->hit * 100 / n) : 0, (long long)stat->hit, (long long)n, (long long)stat->evict);
+}
+
+static int do_cache(int argc, char ** argv)
+{
+	struct cache_stat_t stat;
+
+	render_shape_cache_stat(&stat);
+	cache_stat("shape", &stat);
+	font_cache_stat(&stat);
+	cache_stat("glyph", &stat);
+	text_run_cache_stat(&stat);
+	cache_stat("text", &stat);
+	atlas_stat(&stat);
+	cache_stat("atlas", &stat);
+	dobject_layer_stat(&stat);
+	cache_stat("layer", &stat);
+	return 0;
+}
+
+static struct command_t cmd_cache = {
+	.name	= "cache",
+	.desc	= "show the hit rate and memory of the graphic caches",
+	.usage	= usage,
+	.exec	= do_cache,
+};
+
+static __init void cache_cmd_init(void)
+{
+	register_command(&cmd_cache);
+}
+
+static __exit void cache_cmd_exit(void)
+{
+	unregister_command(&cmd_cache);
+}
+
+command_initcall(cache_cmd_init);
+command_exitcall(cache_cmd_exit);
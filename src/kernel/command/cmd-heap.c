@@ -0,0 +1,110 @@
+/*
+ * kernel/command/cmd-heap.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <command/command.h>
+
+static void usage(void)
+{
+	printf("usage:\r\n");
+	printf("    heap [stat]\r\n");
+	printf("    heap snapshot\r\n");
+	printf("    heap leak\r\n");
+}
+
+static void heap_stat(void)
+{
+	struct malloc_stat_t stat;
+	char buf[32];
+	int c;
+
+	malloc_stat(&stat);
+	printf("used %s, ", ssize(buf, stat.used));
+	printf("heap %s, ", ssize(buf, stat.heap));
+	printf("peak %s\r\n", ssize(buf, stat.peak));
+	printf("alloc %lld, free %lld\r\n", (long long)stat.nalloc, (long long)stat.nfree);
+	for(c = 0; c < MALLOC_STAT_CLASS_COUNT; c++)
+	{
+		if(stat.count[c] > 0)
+			printf(" %s%-8ld %8ld live %12lld total\r\n", (c < MALLOC_STAT_CLASS_COUNT - 1) ? "<=" : "> ", (long)malloc_stat_class_size(c), stat.live[c], (long long)stat.count[c]);
+	}
+}
+
+static void heap_leak(void)
+{
+	struct malloc_stat_t stat;
+	struct malloc_site_t site[32];
+	int c, i, n;
+
+	malloc_stat_diff(&stat);
+	printf("used %+ld, heap %+ld since snapshot\r\n", (long)stat.used, (long)stat.heap);
+	for(c = 0; c < MALLOC_STAT_CLASS_COUNT; c++)
+	{
+		if(stat.live[c] != 0)
+			printf(" %s%-8ld %+8ld live\r\n", (c < MALLOC_STAT_CLASS_COUNT - 1) ? "<=" : "> ", (long)malloc_stat_class_size(c), stat.live[c]);
+	}
+	n = malloc_leak(site, ARRAY_SIZE(site));
+	for(i = 0; i < n; i++)
+		printf(" %p: %ld bytes in %ld blocks\r\n", site[i].caller, site[i].bytes, site[i].count);
+}
+
+static int do_heap(int argc, char ** argv)
+{
+	if((argc < 2) || !strcmp(argv[1], "stat"))
+		heap_stat();
+	else if(!strcmp(argv[1], "snapshot"))
+		malloc_snapshot();
+	else if(!strcmp(argv[1], "leak"))
+		heap_leak();
+	else
+	{
+		usage();
+		return -1;
+	}
+	return 0;
+}
+
+static struct command_t cmd_heap = {
+	.name	= "heap",
+	.desc	= "show heap statistics and the blocks left since a snapshot",
+	.usage	= usage,
+	.exec	= do_heap,
+};
+
+static __init void heap_cmd_init(void)
+{
+	register_command(&cmd_heap);
+}
+
+static __exit void heap_cmd_exit(void)
+{
+	unregister_command(&cmd_heap);
+}
+
+command_initcall(heap_cmd_init);
+command_exitcall(heap_cmd_exit);
@@ -78,11 +78,12 @@ static int do_ps(int argc, char ** argv)
 		}
 		slist_sort(sl);
 
-		printf("CPU%d:\r\n", i);
+		printf("CPU%d: ready %u, migrate in %lld, out %lld\r\n", i, sched->nr_ready, sched->nr_migrate_in, sched->nr_migrate_out);
 		slist_for_each_entry(e, sl)
 		{
 			pos = (struct task_t *)e->priv;
-			printf(" %p %-8s %3d %20lld %s\r\n", pos->func, task_status_tostring(pos), pos->nice, pos->time, e->key);
+			printf(" %p %-8s %3d %20lld %8ld/%-8ld%c %s\r\n", pos->func, task_status_tostring(pos), pos->nice, pos->time,
+				(long)stack_used(pos->stack, pos->stksz), (long)pos->stksz, stack_overflow(pos->stack) ? '!' : ' ', e->key);
 		}
 		slist_free(sl);
 	}
@@ -276,3 +276,305 @@ void channel_recv(struct channel_t * c, unsigned char * buf, unsigned int len)
 		} while(l < len);
 	}
 }
+
+/*
+ * Message channel, passes pointer sized messages without copying, the
+ * ownership of the pointed buffer moves to the receiver. A size of zero
+ * makes an unbuffered channel, where the sender waits for a receiver.
+ *
+ * Every waiter has a select record, which is claimed exactly once, by
+ * the side that hands it a message or by the waiter itself on timeout.
+ * A waiter queued on several channels is therefore woken only once, and
+ * a claim that fails just drops the stale entry and tries the next one.
+ */
+struct mchannel_select_t {
+	struct task_t * task;
+	atomic_t state;
+	volatile int wakeup;
+	int index;
+	void * msg;
+};
+
+struct mchannel_waiter_t {
+	struct list_head list;
+	struct mchannel_select_t * sel;
+	int index;
+	void * msg;
+};
+
+struct mchannel_t * mchannel_alloc(unsigned int size)
+{
+	struct mchannel_t * c;
+
+	c = malloc(sizeof(struct mchannel_t));
+	if(!c)
+		return NULL;
+
+	if(size & (size - 1))
+		size = roundup_pow_of_two(size);
+
+	if(size > 0)
+	{
+		c->msg = malloc(sizeof(void *) * size);
+		if(!c->msg)
+		{
+			free(c);
+			return NULL;
+		}
+	}
+	else
+	{
+		c->msg = NULL;
+	}
+	c->size = size;
+	c->in = 0;
+	c->out = 0;
+	init_list_head(&c->swait);
+	init_list_head(&c->rwait);
+	spin_lock_init(&c->lock);
+
+	return c;
+}
+
+void mchannel_free(struct mchannel_t * c)
+{
+	if(c)
+	{
+		if(c->msg)
+			free(c->msg);
+		free(c);
+	}
+}
+
+static inline int mchannel_claim(struct mchannel_select_t * sel)
+{
+	return (atomic_cmpxchg(&sel->state, 0, 1) == 0) ? 1 : 0;
+}
+
+static inline void mchannel_wakeup(struct mchannel_select_t * sel)
+{
+	struct task_t * task = sel->task;
+
+	sel->wakeup = 1;
+	if(task)
+		task_resume(task);
+}
+
+static struct mchannel_waiter_t * mchannel_claim_first(struct list_head * head)
+{
+	struct mchannel_waiter_t * w;
+
+	while(!list_empty(head))
+	{
+		w = list_first_entry(head, struct mchannel_waiter_t, list);
+		list_del_init(&w->list);
+		if(mchannel_claim(w->sel))
+			return w;
+	}
+	return NULL;
+}
+
+static inline int mchannel_ready(struct mchannel_t * c)
+{
+	struct mchannel_waiter_t * w;
+
+	if(c->in != c->out)
+		return 1;
+	list_for_each_entry(w, &c->swait, list)
+	{
+		if(atomic_get(&w->sel->state) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Must be called with the channel lock held
+ */
+static int __mchannel_put(struct mchannel_t * c, void * msg)
+{
+	struct mchannel_waiter_t * w;
+
+	w = mchannel_claim_first(&c->rwait);
+	if(w)
+	{
+		w->sel->msg = msg;
+		w->sel->index = w->index;
+		mchannel_wakeup(w->sel);
+		return 1;
+	}
+	if(c->in - c->out < c->size)
+	{
+		c->msg[c->in & (c->size - 1)] = msg;
+		c->in++;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Must be called with the channel lock held
+ */
+static int __mchannel_get(struct mchannel_t * c, void ** msg)
+{
+	struct mchannel_waiter_t * w;
+
+	if(c->in != c->out)
+	{
+		*msg = c->msg[c->out & (c->size - 1)];
+		c->out++;
+		w = mchannel_claim_first(&c->swait);
+		if(w)
+		{
+			c->msg[c->in & (c->size - 1)] = w->msg;
+			c->in++;
+			mchannel_wakeup(w->sel);
+		}
+		return 1;
+	}
+	w = mchannel_claim_first(&c->swait);
+	if(w)
+	{
+		*msg = w->msg;
+		mchannel_wakeup(w->sel);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Send a message, wait up to ns nanoseconds for room, zero means forever
+ */
+int mchannel_send(struct mchannel_t * c, void * msg, uint64_t ns)
+{
+	struct mchannel_select_t sel;
+	struct mchannel_waiter_t w;
+	irq_flags_t flags;
+
+	if(!c)
+		return 0;
+
+	spin_lock_irqsave(&c->lock, flags);
+	if(__mchannel_put(c, msg))
+	{
+		spin_unlock_irqrestore(&c->lock, flags);
+		return 1;
+	}
+	sel.task = task_self();
+	atomic_set(&sel.state, 0);
+	sel.wakeup = 0;
+	init_list_head(&w.list);
+	w.sel = &sel;
+	w.index = 0;
+	w.msg = msg;
+	list_add_tail(&w.list, &c->swait);
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	task_wait_until(&sel.wakeup, (ns > 0) ? ktime_to_ns(ktime_get()) + ns : ~0ULL);
+
+	atomic_cmpxchg(&sel.state, 0, 2);
+	spin_lock_irqsave(&c->lock, flags);
+	list_del_init(&w.list);
+	spin_unlock_irqrestore(&c->lock, flags);
+	return (atomic_get(&sel.state) == 1) ? 1 : 0;
+}
+
+int mchannel_trysend(struct mchannel_t * c, void * msg)
+{
+	irq_flags_t flags;
+	int ret;
+
+	if(!c)
+		return 0;
+
+	spin_lock_irqsave(&c->lock, flags);
+	ret = __mchannel_put(c, msg);
+	spin_unlock_irqrestore(&c->lock, flags);
+	return ret;
+}
+
+int mchannel_recv(struct mchannel_t * c, void ** msg, uint64_t ns)
+{
+	return (channel_select(&c, 1, msg, ns) == 0) ? 1 : 0;
+}
+
+int mchannel_tryrecv(struct mchannel_t * c, void ** msg)
+{
+	irq_flags_t flags;
+	int ret;
+
+	if(!c || !msg)
+		return 0;
+
+	spin_lock_irqsave(&c->lock, flags);
+	ret = __mchannel_get(c, msg);
+	spin_unlock_irqrestore(&c->lock, flags);
+	return ret;
+}
+
+/*
+ * Receive from the first of several channels that has a message, wait up
+ * to ns nanoseconds, zero means forever. Return the index of the channel,
+ * or -1 on timeout.
+ */
+int channel_select(struct mchannel_t ** c, int n, void ** msg, uint64_t ns)
+{
+	struct mchannel_select_t sel;
+	struct mchannel_waiter_t w[n > 0 ? n : 1];
+	irq_flags_t flags;
+	int index, queued, i;
+
+	if(!c || !msg || (n <= 0))
+		return -1;
+
+again:
+	index = -1;
+	queued = 0;
+	sel.task = task_self();
+	atomic_set(&sel.state, 0);
+	sel.wakeup = 0;
+	sel.index = -1;
+	sel.msg = NULL;
+
+	for(i = 0; i < n; i++)
+	{
+		spin_lock_irqsave(&c[i]->lock, flags);
+		if(mchannel_ready(c[i]))
+		{
+			if(mchannel_claim(&sel))
+				index = __mchannel_get(c[i], msg) ? i : -2;
+			spin_unlock_irqrestore(&c[i]->lock, flags);
+			break;
+		}
+		init_list_head(&w[i].list);
+		w[i].sel = &sel;
+		w[i].index = i;
+		w[i].msg = NULL;
+		list_add_tail(&w[i].list, &c[i]->rwait);
+		spin_unlock_irqrestore(&c[i]->lock, flags);
+		queued++;
+	}
+
+	if((index < 0) && (atomic_get(&sel.state) == 0))
+		task_wait_until(&sel.wakeup, (ns > 0) ? ktime_to_ns(ktime_get()) + ns : ~0ULL);
+	atomic_cmpxchg(&sel.state, 0, 2);
+
+	for(i = 0; i < queued; i++)
+	{
+		spin_lock_irqsave(&c[i]->lock, flags);
+		list_del_init(&w[i].list);
+		spin_unlock_irqrestore(&c[i]->lock, flags);
+	}
+
+	/*
+	 * The waiting sender timed out between the check and the claim
+	 */
+	if(index == -2)
+		goto again;
+	if((index < 0) && (sel.index >= 0))
+	{
+		*msg = sel.msg;
+		index = sel.index;
+	}
+	return index;
+}
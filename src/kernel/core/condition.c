@@ -0,0 +1,108 @@
+/*
+ * kernel/core/condition.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <xboot/condition.h>
+
+void condition_init(struct condition_t * c)
+{
+	init_list_head(&c->cwait);
+	spin_lock_init(&c->lock);
+}
+
+/*
+ * The waiter is queued before the mutex is released, so a signal sent
+ * between the unlock and the sleep is never lost.
+ */
+static int __condition_wait(struct condition_t * c, struct mutex_t * m, uint64_t expires)
+{
+	struct waitqueue_entry_t wqe;
+	irq_flags_t flags;
+	int ret;
+
+	init_list_head(&wqe.list);
+	wqe.task = task_self();
+	wqe.wakeup = 0;
+	spin_lock_irqsave(&c->lock, flags);
+	list_add_tail(&wqe.list, &c->cwait);
+	spin_unlock_irqrestore(&c->lock, flags);
+	mutex_unlock(m);
+
+	task_wait_until(&wqe.wakeup, expires);
+
+	spin_lock_irqsave(&c->lock, flags);
+	ret = wqe.wakeup;
+	if(!ret)
+		list_del_init(&wqe.list);
+	spin_unlock_irqrestore(&c->lock, flags);
+	mutex_lock(m);
+	return ret;
+}
+
+void condition_wait(struct condition_t * c, struct mutex_t * m)
+{
+	__condition_wait(c, m, ~0ULL);
+}
+
+int condition_wait_timeout(struct condition_t * c, struct mutex_t * m, uint64_t ns)
+{
+	return __condition_wait(c, m, ktime_to_ns(ktime_get()) + ns);
+}
+
+static inline void condition_wakeup_entry(struct waitqueue_entry_t * wqe)
+{
+	struct task_t * task = wqe->task;
+
+	list_del_init(&wqe->list);
+	wqe->wakeup = 1;
+	if(task)
+		task_resume(task);
+}
+
+void condition_signal(struct condition_t * c)
+{
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&c->lock, flags);
+	if(!list_empty(&c->cwait))
+		condition_wakeup_entry(list_first_entry(&c->cwait, struct waitqueue_entry_t, list));
+	spin_unlock_irqrestore(&c->lock, flags);
+}
+
+void condition_broadcast(struct condition_t * c)
+{
+	struct waitqueue_entry_t * pos, * n;
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&c->lock, flags);
+	list_for_each_entry_safe(pos, n, &c->cwait, list)
+	{
+		condition_wakeup_entry(pos);
+	}
+	spin_unlock_irqrestore(&c->lock, flags);
+}
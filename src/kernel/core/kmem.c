@@ -0,0 +1,320 @@
+/*
+ * kernel/core/kmem.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <xboot/kmem.h>
+
+/*
+ * Slab caches for fixed size objects. A slab is a naturally aligned block
+ * from the heap with its header at the start, so the slab of an object is
+ * found by masking its address. Each cpu keeps a small stack of free
+ * objects, refilled from and flushed to the slabs in batches of half its
+ * size. At most one empty slab is kept, the others go back to the heap.
+ * Each cpu also counts the objects it hands out and takes back, so the
+ * counters need no lock.
+ */
+struct kmem_slab_t {
+	struct list_head list;
+	void * freelist;
+	int inuse;
+};
+
+static struct kobj_t * search_class_kmem_kobj(void)
+{
+	struct kobj_t * kclass = kobj_search_directory_with_create(kobj_get_root(), "class");
+	return kobj_search_directory_with_create(kclass, "kmem");
+}
+
+static ssize_t kmem_read_stat(struct kobj_t * kobj, void * buf, size_t size)
+{
+	struct kmem_cache_t * cache = (struct kmem_cache_t *)kobj->priv;
+	uint64_t nr_alloc = 0, nr_free = 0;
+	char * p = buf;
+	int len = 0;
+	int i;
+
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+	{
+		nr_alloc += cache->cpu[i].nr_alloc;
+		nr_free += cache->cpu[i].nr_free;
+	}
+
+	len += sprintf((char *)(p + len), " size: %ld\r\n", (long)cache->size);
+	len += sprintf((char *)(p + len), " slab: %ld x %d\r\n", (long)cache->slab_size, cache->objs_per_slab);
+	len += sprintf((char *)(p + len), " slabs: %d\r\n", cache->nr_slabs);
+	len += sprintf((char *)(p + len), " alloc: %lld\r\n", nr_alloc);
+	len += sprintf((char *)(p + len), " free: %lld\r\n", nr_free);
+	return len;
+}
+
+static inline size_t kmem_slab_offset(struct kmem_cache_t * cache)
+{
+	return (sizeof(struct kmem_slab_t) + cache->align - 1) & ~(cache->align - 1);
+}
+
+static struct kmem_slab_t * kmem_slab_alloc(struct kmem_cache_t * cache)
+{
+	struct kmem_slab_t * slab;
+	char * obj;
+	int i;
+
+	slab = memalign(cache->slab_size, cache->slab_size);
+	if(!slab)
+		return NULL;
+	init_list_head(&slab->list);
+	slab->freelist = NULL;
+	slab->inuse = 0;
+	obj = (char *)slab + kmem_slab_offset(cache) + (cache->objs_per_slab - 1) * cache->size;
+	for(i = 0; i < cache->objs_per_slab; i++, obj -= cache->size)
+	{
+		*((void **)obj) = slab->freelist;
+		slab->freelist = obj;
+	}
+	cache->nr_slabs++;
+	return slab;
+}
+
+static inline struct kmem_slab_t * kmem_slab_of(struct kmem_cache_t * cache, void * obj)
+{
+	return (struct kmem_slab_t *)((unsigned long)obj & ~(cache->slab_size - 1));
+}
+
+/*
+ * Must be called with the cache lock held
+ */
+static int kmem_refill(struct kmem_cache_t * cache, struct kmem_cpu_cache_t * cc, int n)
+{
+	struct kmem_slab_t * slab;
+	void * obj;
+
+	while(cc->count < n)
+	{
+		if(!list_empty(&cache->partial))
+		{
+			slab = list_first_entry(&cache->partial, struct kmem_slab_t, list);
+		}
+		else if(!list_empty(&cache->empty))
+		{
+			slab = list_first_entry(&cache->empty, struct kmem_slab_t, list);
+			list_move(&slab->list, &cache->partial);
+			cache->nr_empty--;
+		}
+		else
+		{
+			if(!(slab = kmem_slab_alloc(cache)))
+				break;
+			list_add(&slab->list, &cache->partial);
+		}
+		while(slab->freelist && (cc->count < n))
+		{
+			obj = slab->freelist;
+			slab->freelist = *((void **)obj);
+			slab->inuse++;
+			cc->objs[cc->count++] = obj;
+		}
+		if(!slab->freelist)
+			list_move(&slab->list, &cache->full);
+	}
+	return cc->count;
+}
+
+/*
+ * Must be called with the cache lock held
+ */
+static void kmem_flush(struct kmem_cache_t * cache, struct kmem_cpu_cache_t * cc, int n)
+{
+	struct kmem_slab_t * slab;
+	void * obj;
+
+	while(cc->count > n)
+	{
+		obj = cc->objs[--cc->count];
+		slab = kmem_slab_of(cache, obj);
+		if(!slab->freelist)
+			list_move(&slab->list, &cache->partial);
+		*((void **)obj) = slab->freelist;
+		slab->freelist = obj;
+		if(--slab->inuse == 0)
+		{
+			if(cache->nr_empty > 0)
+			{
+				list_del(&slab->list);
+				free(slab);
+				cache->nr_slabs--;
+			}
+			else
+			{
+				list_move(&slab->list, &cache->empty);
+				cache->nr_empty++;
+			}
+		}
+	}
+}
+
+struct kmem_cache_t * kmem_cache_create(const char * name, size_t size, size_t align)
+{
+	struct kmem_cache_t * cache;
+	size_t hdr;
+	int i;
+
+	if(!name || (size == 0))
+		return NULL;
+
+	if(align < sizeof(void *))
+		align = sizeof(void *);
+	if(align & (align - 1))
+		align = roundup_pow_of_two(align);
+	size = (max(size, (size_t)sizeof(void *)) + align - 1) & ~(align - 1);
+
+	cache = malloc(sizeof(struct kmem_cache_t));
+	if(!cache)
+		return NULL;
+
+	cache->name = strdup(name);
+	if(!cache->name)
+	{
+		free(cache);
+		return NULL;
+	}
+	cache->size = size;
+	cache->align = align;
+	hdr = kmem_slab_offset(cache);
+	cache->slab_size = SZ_4K;
+	while(cache->slab_size < hdr + size * 8)
+		cache->slab_size <<= 1;
+	cache->objs_per_slab = (cache->slab_size - hdr) / size;
+	init_list_head(&cache->partial);
+	init_list_head(&cache->full);
+	init_list_head(&cache->empty);
+	cache->nr_slabs = 0;
+	cache->nr_empty = 0;
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+	{
+		cache->cpu[i].count = 0;
+		cache->cpu[i].nr_alloc = 0;
+		cache->cpu[i].nr_free = 0;
+	}
+	spin_lock_init(&cache->lock);
+	cache->kobj = kobj_alloc_regular(cache->name, kmem_read_stat, NULL, cache);
+	kobj_add(search_class_kmem_kobj(), cache->kobj);
+
+	return cache;
+}
+
+void kmem_cache_destroy(struct kmem_cache_t * cache)
+{
+	struct kmem_slab_t * pos, * n;
+	irq_flags_t flags;
+	int i;
+
+	if(!cache)
+		return;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+		kmem_flush(cache, &cache->cpu[i], 0);
+	list_for_each_entry_safe(pos, n, &cache->partial, list)
+		free(pos);
+	list_for_each_entry_safe(pos, n, &cache->full, list)
+		free(pos);
+	list_for_each_entry_safe(pos, n, &cache->empty, list)
+		free(pos);
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	kobj_remove_self(cache->kobj);
+	free(cache->name);
+	free(cache);
+}
+
+void * kmem_cache_alloc(struct kmem_cache_t * cache)
+{
+	struct kmem_cpu_cache_t * cc = &cache->cpu[smp_processor_id()];
+	irq_flags_t flags;
+
+	if(cc->count == 0)
+	{
+		spin_lock_irqsave(&cache->lock, flags);
+		kmem_refill(cache, cc, KMEM_CPU_CACHE / 2);
+		spin_unlock_irqrestore(&cache->lock, flags);
+		if(cc->count == 0)
+			return NULL;
+	}
+	cc->nr_alloc++;
+	return cc->objs[--cc->count];
+}
+
+void * kmem_cache_zalloc(struct kmem_cache_t * cache)
+{
+	void * obj = kmem_cache_alloc(cache);
+
+	if(obj)
+		memset(obj, 0, cache->size);
+	return obj;
+}
+
+void kmem_cache_free(struct kmem_cache_t * cache, void * obj)
+{
+	struct kmem_cpu_cache_t * cc = &cache->cpu[smp_processor_id()];
+	irq_flags_t flags;
+
+	if(!obj)
+		return;
+	if(cc->count >= KMEM_CPU_CACHE)
+	{
+		spin_lock_irqsave(&cache->lock, flags);
+		kmem_flush(cache, cc, KMEM_CPU_CACHE / 2);
+		spin_unlock_irqrestore(&cache->lock, flags);
+	}
+	cc->nr_free++;
+	cc->objs[cc->count++] = obj;
+}
+
+/*
+ * Give the objects cached by this cpu and all empty slabs back to the heap
+ */
+void kmem_cache_shrink(struct kmem_cache_t * cache)
+{
+	struct kmem_cpu_cache_t * cc;
+	struct kmem_slab_t * pos, * n;
+	irq_flags_t flags;
+
+	if(!cache)
+		return;
+
+	cc = &cache->cpu[smp_processor_id()];
+	spin_lock_irqsave(&cache->lock, flags);
+	kmem_flush(cache, cc, 0);
+	list_for_each_entry_safe(pos, n, &cache->empty, list)
+	{
+		list_del(&pos->list);
+		free(pos);
+		cache->nr_slabs--;
+	}
+	cache->nr_empty = 0;
+	spin_unlock_irqrestore(&cache->lock, flags);
+}
@@ -29,44 +29,160 @@
 #include <xboot.h>
 #include <xboot/mutex.h>
 
+/*
+ * Waiters are kept in priority order and the mutex is handed over to the
+ * first one on unlock. While a task waits, the owner inherits its nice
+ * value, following the chain of owners that are themselves blocked on
+ * another mutex. A boosted owner drops back to its own nice value once it
+ * holds no mutex at all.
+ */
+#define MUTEX_PI_DEPTH		(8)
+
+static inline int task_effective_nice(struct task_t * task)
+{
+	return (task->pi_nice < task->nice) ? task->pi_nice : task->nice;
+}
+
+static inline void mutex_enqueue(struct mutex_t * m, struct waitqueue_entry_t * wqe)
+{
+	struct waitqueue_entry_t * pos;
+	int nice = wqe->task ? task_effective_nice(wqe->task) : 20;
+
+	list_for_each_entry(pos, &m->mwait, list)
+	{
+		if(pos->task && (nice < task_effective_nice(pos->task)))
+		{
+			list_add_tail(&wqe->list, &pos->list);
+			return;
+		}
+	}
+	list_add_tail(&wqe->list, &m->mwait);
+}
+
+static void mutex_boost_chain(struct mutex_t * m, int nice)
+{
+	struct mutex_t * next;
+	struct task_t * owner;
+	irq_flags_t flags;
+	int depth;
+
+	for(depth = 0; m && (depth < MUTEX_PI_DEPTH); depth++)
+	{
+		next = NULL;
+		spin_lock_irqsave(&m->lock, flags);
+		owner = m->owner;
+		if(owner && (task_effective_nice(owner) > nice))
+		{
+			task_boost(owner, nice);
+			next = owner->mblocked;
+		}
+		spin_unlock_irqrestore(&m->lock, flags);
+		m = next;
+	}
+}
+
 void mutex_init(struct mutex_t * m)
 {
-	atomic_set(&m->atomic, 1);
 	init_list_head(&m->mwait);
+	m->owner = NULL;
+	m->locked = 0;
 	spin_lock_init(&m->lock);
 }
 
 void mutex_lock(struct mutex_t * m)
 {
-	struct task_t * self;
+	struct task_t * self = task_self();
+	struct waitqueue_entry_t wqe;
+	irq_flags_t flags;
 
-	while(atomic_cmpxchg(&m->atomic, 1, 0) != 1)
+	spin_lock_irqsave(&m->lock, flags);
+	if(!m->locked)
 	{
-		self = task_self();
-		spin_lock(&m->lock);
-		if(list_empty_careful(&self->mlist))
-			list_add_tail(&self->mlist, &m->mwait);
-		spin_unlock(&m->lock);
-		task_suspend(self);
+		m->locked = 1;
+		m->owner = self;
+		if(self)
+			self->mheld++;
+		spin_unlock_irqrestore(&m->lock, flags);
+		return;
 	}
+	init_list_head(&wqe.list);
+	wqe.task = self;
+	wqe.wakeup = 0;
+	mutex_enqueue(m, &wqe);
+	if(self)
+		self->mblocked = m;
+	spin_unlock_irqrestore(&m->lock, flags);
+
+	if(self)
+		mutex_boost_chain(m, task_effective_nice(self));
+	task_wait_until(&wqe.wakeup, ~0ULL);
+
+	/*
+	 * Taking the lock once more waits for the unlocking side to finish
+	 * the handover before this task can go on, and possibly exit.
+	 */
+	spin_lock_irqsave(&m->lock, flags);
+	if(self)
+		self->mblocked = NULL;
+	spin_unlock_irqrestore(&m->lock, flags);
+}
+
+int mutex_trylock(struct mutex_t * m)
+{
+	struct task_t * self = task_self();
+	irq_flags_t flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&m->lock, flags);
+	if(!m->locked)
+	{
+		m->locked = 1;
+		m->owner = self;
+		if(self)
+			self->mheld++;
+		ret = 1;
+	}
+	spin_unlock_irqrestore(&m->lock, flags);
+	return ret;
 }
 
 void mutex_unlock(struct mutex_t * m)
 {
-	struct task_t * pos, * n;
+	struct waitqueue_entry_t * wqe, * pos;
+	struct task_t * owner, * task;
+	irq_flags_t flags;
 
-	if(atomic_cmpxchg(&m->atomic, 0, 1) == 0)
+	spin_lock_irqsave(&m->lock, flags);
+	owner = m->owner;
+	if(!list_empty(&m->mwait))
 	{
-		spin_lock(&m->lock);
-		if(!list_empty(&m->mwait))
+		wqe = list_first_entry(&m->mwait, struct waitqueue_entry_t, list);
+		list_del_init(&wqe->list);
+		task = wqe->task;
+		m->owner = task;
+		if(task)
 		{
-			list_for_each_entry_safe(pos, n, &m->mwait, mlist)
+			task->mheld++;
+			if(!list_empty(&m->mwait))
 			{
-				list_del_init(&pos->mlist);
-				task_resume(pos);
-				break;
+				pos = list_first_entry(&m->mwait, struct waitqueue_entry_t, list);
+				if(pos->task && (task_effective_nice(pos->task) < task_effective_nice(task)))
+					task_boost(task, task_effective_nice(pos->task));
 			}
 		}
-		spin_unlock(&m->lock);
+		wqe->wakeup = 1;
+		if(task)
+			task_resume(task);
+	}
+	else
+	{
+		m->owner = NULL;
+		m->locked = 0;
+	}
+	if(owner && (--owner->mheld <= 0))
+	{
+		owner->mheld = 0;
+		task_unboost(owner);
 	}
+	spin_unlock_irqrestore(&m->lock, flags);
 }
@@ -29,20 +29,45 @@
 #include <xboot.h>
 #include <xboot/profiler.h>
 
-static struct hlist_head __profiler_hash[CONFIG_PROFILER_HASH_SIZE];
+/*
+ * Every cpu keeps its own statistics for all probes and its own ring of
+ * trace events. The cpu is the only writer of both, the ring is read by
+ * a single reader at a time, so neither needs a lock on the hot path.
+ * A task may yield inside a probe and be stolen by another cpu, the end
+ * then goes to the ring of the cpu it ends on and carries the cpu the
+ * probe began on, which is what the reader pairs it by.
+ */
+struct profiler_ring_t {
+	struct profiler_event_t * ev;
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	unsigned int lost;
+};
+
+static struct profiler_stat_t * __profiler_stat[CONFIG_MAX_SMP_CPUS];
+static struct profiler_ring_t __profiler_ring[CONFIG_MAX_SMP_CPUS];
 static spinlock_t __profiler_lock = SPIN_LOCK_INIT();
+static volatile int __profiler_trace = 0;
 
-static void __cpu_profiler_start(int event, int data)
+/*
+ * The cpu counters are per core, so every cpu starts its own the first
+ * time it hits a probe and remembers which of them the backend has
+ */
+#define PROFILER_COUNTER_READY	(1 << 31)
+static volatile int __profiler_counter[CONFIG_MAX_SMP_CPUS];
+
+static int __cpu_profiler_start(int counter)
 {
+	return -1;
 }
 extern __typeof(__cpu_profiler_start) cpu_profiler_start __attribute__((weak, alias("__cpu_profiler_start")));
 
-static void __cpu_profiler_stop(int event, int data)
+static void __cpu_profiler_stop(int counter)
 {
 }
 extern __typeof(__cpu_profiler_stop) cpu_profiler_stop __attribute__((weak, alias("__cpu_profiler_stop")));
 
-static uint64_t __cpu_profiler_read(int event, int data)
+static uint64_t __cpu_profiler_read(int counter)
 {
 	return 0;
 }
@@ -53,129 +78,426 @@ static void __cpu_profiler_reset(void)
 }
 extern __typeof(__cpu_profiler_reset) cpu_profiler_reset __attribute__((weak, alias("__cpu_profiler_reset")));
 
-struct profiler_t * profiler_search(const char * name)
+static int profiler_counter_setup(int cpu)
 {
-	struct profiler_t * p;
-	struct hlist_node * n;
-
-	if(!name)
-		return NULL;
+	int mask = PROFILER_COUNTER_READY;
+	int i;
 
-	hlist_for_each_entry_safe(p, n, &__profiler_hash[shash(name) % CONFIG_PROFILER_HASH_SIZE], node)
+	cpu_profiler_reset();
+	for(i = 0; i < PROFILER_COUNTER_MAX; i++)
 	{
-		if(strcmp(p->name, name) == 0)
-			return p;
+		if(cpu_profiler_start(i) == 0)
+			mask |= (1 << i);
 	}
-	return NULL;
+	__profiler_counter[cpu] = mask;
+	return mask;
 }
 
-void profiler_snap(const char * name, int event, int data)
+static inline void profiler_sample(struct profiler_mark_t * m)
 {
-	struct profiler_t * p;
+	int cpu = smp_processor_id();
+	int mask = __profiler_counter[cpu];
+	int i;
+
+	if(unlikely(mask == 0))
+		mask = profiler_counter_setup(cpu);
+	for(i = 0; i < PROFILER_COUNTER_MAX; i++)
+		m->counter[i] = (mask & (1 << i)) ? cpu_profiler_read(i) : 0;
+	m->time = ktime_to_ns(ktime_get());
+}
+
+/*
+ * A full ring drops the new events instead of overwriting the old ones,
+ * so the reader never sees a torn event
+ */
+static inline void profiler_trace_record(int cpu, int id, int type)
+{
+	struct profiler_ring_t * r = &__profiler_ring[smp_processor_id()];
+	struct profiler_event_t * e;
 	irq_flags_t flags;
+	unsigned int head;
 
-	if(!name)
-		return;
+	local_irq_save(flags);
+	head = r->head;
+	if(head - r->tail < CONFIG_PROFILER_TRACE_SIZE)
+	{
+		e = &r->ev[head & (CONFIG_PROFILER_TRACE_SIZE - 1)];
+		e->time = ktime_to_ns(ktime_get());
+		e->id = id;
+		e->type = type;
+		e->cpu = cpu;
+		smp_wmb();
+		r->head = head + 1;
+	}
+	else
+	{
+		r->lost++;
+	}
+	local_irq_restore(flags);
+}
+
+int profiler_count(void)
+{
+	return __profiler_end - __profiler_start;
+}
 
-	p = profiler_search(name);
-	if(p)
+const struct profiler_probe_t * profiler_get_probe(int id)
+{
+	if((id < 0) || (id >= profiler_count()))
+		return NULL;
+	return __profiler_start[id];
+}
+
+void profiler_begin(int id, struct profiler_mark_t * m)
+{
+	m->cpu = smp_processor_id();
+	if(__profiler_trace)
+		profiler_trace_record(m->cpu, id, PROFILER_EVENT_BEGIN);
+	profiler_sample(m);
+}
+
+void profiler_end(int id, struct profiler_mark_t * m)
+{
+	struct profiler_stat_t * s;
+	struct profiler_mark_t e;
+	uint64_t delta;
+	irq_flags_t flags;
+	int i, h;
+
+	/*
+	 * The cpu counters of two cores can not be subtracted, so a probe
+	 * ending on another cpu than it began only counts its wall time
+	 */
+	e.cpu = smp_processor_id();
+	s = __profiler_stat[e.cpu];
+	profiler_sample(&e);
+	if(s)
 	{
-		if(event == 0)
+		s += id;
+		delta = e.time - m->time;
+		h = fls64(delta);
+		if(h >= PROFILER_HIST_COUNT)
+			h = PROFILER_HIST_COUNT - 1;
+		local_irq_save(flags);
+		if((s->count == 0) || (delta < s->min))
+			s->min = delta;
+		if(delta > s->max)
+			s->max = delta;
+		s->count++;
+		s->total += delta;
+		if(likely(e.cpu == m->cpu))
 		{
-			p->end = ktime_to_ns(ktime_get());
+			for(i = 0; i < PROFILER_COUNTER_MAX; i++)
+				s->counter[i] += e.counter[i] - m->counter[i];
 		}
 		else
 		{
-			p->end = cpu_profiler_read(p->event, p->data);
+			s->migrated++;
 		}
-		p->count++;
+		s->hist[h]++;
+		local_irq_restore(flags);
 	}
-	else
+	if(__profiler_trace)
+		profiler_trace_record(m->cpu, id, PROFILER_EVENT_END);
+}
+
+/*
+ * Whether the current cpu has a counter, which is only known after the
+ * cpu has started its counters
+ */
+int profiler_counter_available(int counter)
+{
+	int cpu = smp_processor_id();
+	int mask = __profiler_counter[cpu];
+
+	if((counter < 0) || (counter >= PROFILER_COUNTER_MAX))
+		return 0;
+	if(mask == 0)
+		mask = profiler_counter_setup(cpu);
+	return (mask & (1 << counter)) ? 1 : 0;
+}
+
+/*
+ * The statistics of a probe summed over all cpus
+ */
+void profiler_stat(int id, struct profiler_stat_t * stat)
+{
+	struct profiler_stat_t * s;
+	int i, h;
+
+	memset(stat, 0, sizeof(struct profiler_stat_t));
+	if((id < 0) || (id >= profiler_count()))
+		return;
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
 	{
-		p = malloc(sizeof(struct profiler_t));
-		if(!p)
-			return;
-
-		init_hlist_node(&p->node);
-		p->name = strdup(name);
-		p->event = event;
-		p->data = data;
-		if(event == 0)
-		{
-			p->end = p->begin = ktime_to_ns(ktime_get());
-		}
-		else
+		if(!__profiler_stat[i])
+			continue;
+		s = &__profiler_stat[i][id];
+		if(s->count == 0)
+			continue;
+		if((stat->count == 0) || (s->min < stat->min))
+			stat->min = s->min;
+		if(s->max > stat->max)
+			stat->max = s->max;
+		stat->count += s->count;
+		stat->migrated += s->migrated;
+		stat->total += s->total;
+		for(h = 0; h < PROFILER_COUNTER_MAX; h++)
+			stat->counter[h] += s->counter[h];
+		for(h = 0; h < PROFILER_HIST_COUNT; h++)
+			stat->hist[h] += s->hist[h];
+	}
+}
+
+/*
+ * The trace rings are allocated the first time tracing is enabled and
+ * kept from then on
+ */
+void profiler_trace_enable(int enable)
+{
+	struct profiler_ring_t * r;
+	irq_flags_t flags;
+	int i;
+
+	if(enable)
+	{
+		spin_lock_irqsave(&__profiler_lock, flags);
+		for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
 		{
-			cpu_profiler_start(p->event, p->data);
-			p->end = p->begin = cpu_profiler_read(p->event, p->data);
+			r = &__profiler_ring[i];
+			if(!r->ev)
+				r->ev = malloc(sizeof(struct profiler_event_t) * CONFIG_PROFILER_TRACE_SIZE);
+			if(!r->ev)
+			{
+				spin_unlock_irqrestore(&__profiler_lock, flags);
+				return;
+			}
 		}
-		p->count = 1;
-		spin_lock_irqsave(&__profiler_lock, flags);
-		hlist_add_head(&p->node, &__profiler_hash[shash(name) % CONFIG_PROFILER_HASH_SIZE]);
 		spin_unlock_irqrestore(&__profiler_lock, flags);
+		smp_wmb();
 	}
+	__profiler_trace = enable ? 1 : 0;
+}
+
+/*
+ * Take up to n of the oldest events from the ring of a cpu
+ */
+int profiler_trace_read(int cpu, struct profiler_event_t * ev, int n)
+{
+	struct profiler_ring_t * r;
+	unsigned int head, tail;
+	irq_flags_t flags;
+	int i = 0;
+
+	if((cpu < 0) || (cpu >= CONFIG_MAX_SMP_CPUS))
+		return 0;
+	r = &__profiler_ring[cpu];
+	spin_lock_irqsave(&__profiler_lock, flags);
+	if(r->ev)
+	{
+		head = r->head;
+		smp_rmb();
+		for(tail = r->tail; (tail != head) && (i < n); tail++)
+			ev[i++] = r->ev[tail & (CONFIG_PROFILER_TRACE_SIZE - 1)];
+		smp_mb();
+		r->tail = tail;
+	}
+	spin_unlock_irqrestore(&__profiler_lock, flags);
+	return i;
+}
+
+/*
+ * The number of calls the counters were summed over, at least one
+ */
+static uint64_t profiler_counted(struct profiler_stat_t * stat)
+{
+	if(stat->count > stat->migrated)
+		return stat->count - stat->migrated;
+	return 1;
+}
+
+/*
+ * Instructions per cycle in hundredths
+ */
+static int profiler_ipc(struct profiler_stat_t * stat)
+{
+	if(stat->counter[PROFILER_COUNTER_CYCLES] == 0)
+		return 0;
+	return stat->counter[PROFILER_COUNTER_INSTRUCTIONS] * 100 / stat->counter[PROFILER_COUNTER_CYCLES];
 }
 
 void profiler_dump(void)
 {
-	struct profiler_t * p;
-	struct hlist_node * n;
-	struct slist_t * sl, * e;
-	int i;
+	const struct profiler_probe_t * p;
+	struct profiler_stat_t stat;
+	int id, n = profiler_count();
 
 	printf("Profiler analysis:\r\n");
-	sl = slist_alloc();
-	for(i = 0; i < ARRAY_SIZE(__profiler_hash); i++)
+	for(id = 0; id < n; id++)
 	{
-		hlist_for_each_entry_safe(p, n, &__profiler_hash[i], node)
-		{
-			slist_add(sl, p, "%s", p->name);
-		}
+		p = __profiler_start[id];
+		profiler_stat(id, &stat);
+		if(stat.count > 0)
+			printf("[%s] %lld, %lld, [%lld ~ %lld], %lld cycles, ipc %d.%02d, %lld migrated\r\n", p->name, stat.count, stat.total / stat.count, stat.min, stat.max,
+				stat.counter[PROFILER_COUNTER_CYCLES] / profiler_counted(&stat), profiler_ipc(&stat) / 100, profiler_ipc(&stat) % 100, stat.migrated);
 	}
-	slist_sort(sl);
-	slist_for_each_entry(e, sl)
+}
+
+void profiler_reset(void)
+{
+	struct profiler_ring_t * r;
+	irq_flags_t flags;
+	int i;
+
+	spin_lock_irqsave(&__profiler_lock, flags);
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
 	{
-		p = (struct profiler_t *)e->priv;
-		if(p->event == 0)
-		{
-			printf("[%s] %lld, %lld, [%lld ~ %lld]\r\n", p->name, p->count, (p->end - p->begin) / ((p->count > 1) ? (p->count - 1) : 1), p->begin, p->end);
-		}
-		else
+		if(__profiler_stat[i])
+			memset(__profiler_stat[i], 0, sizeof(struct profiler_stat_t) * profiler_count());
+		r = &__profiler_ring[i];
+		r->tail = r->head;
+		r->lost = 0;
+	}
+	spin_unlock_irqrestore(&__profiler_lock, flags);
+}
+
+static struct kobj_t * search_class_profiler_kobj(void)
+{
+	struct kobj_t * kclass = kobj_search_directory_with_create(kobj_get_root(), "class");
+	return kobj_search_directory_with_create(kclass, "profiler");
+}
+
+/*
+ * One line per probe, the counters as averages over the calls that began
+ * and ended on the same cpu, and the histogram as bucket:count pairs where
+ * bucket b counts the values in [2^(b-1), 2^b)
+ */
+static ssize_t profiler_read_probes(struct kobj_t * kobj, void * buf, size_t size)
+{
+	const struct profiler_probe_t * p;
+	struct profiler_stat_t stat;
+	uint64_t c, k;
+	char * q = buf;
+	int len = 0;
+	int id, h, n = profiler_count();
+
+	for(id = 0; id < n; id++)
+	{
+		if(len + 256 + PROFILER_HIST_COUNT * 16 > size)
+			break;
+		p = __profiler_start[id];
+		profiler_stat(id, &stat);
+		c = stat.count ? stat.count : 1;
+		k = profiler_counted(&stat);
+		len += sprintf((char *)(q + len), "%s %s:%d count %lld migrated %lld avg %lld min %lld max %lld cycles %lld insns %lld misses %lld ipc %d.%02d hist",
+			p->name, p->file, p->line, stat.count, stat.migrated, stat.total / c, stat.min, stat.max, stat.counter[PROFILER_COUNTER_CYCLES] / k,
+			stat.counter[PROFILER_COUNTER_INSTRUCTIONS] / k, stat.counter[PROFILER_COUNTER_CACHE_MISSES] / k, profiler_ipc(&stat) / 100, profiler_ipc(&stat) % 100);
+		for(h = 0; h < PROFILER_HIST_COUNT; h++)
 		{
-			printf("[%s] %lld, %lld, [%lld ~ %lld]\r\n", p->name, p->count, (p->end - p->begin) / ((p->count > 1) ? (p->count - 1) : 1), p->begin, p->end);
+			if(stat.hist[h])
+				len += sprintf((char *)(q + len), " %d:%u", h, stat.hist[h]);
 		}
+		len += sprintf((char *)(q + len), "\r\n");
 	}
-	slist_free(sl);
+	return len;
 }
 
-void profiler_reset(void)
+/*
+ * Reading drains the trace rings, one "cpu nanoseconds B|E name" line per
+ * event, the cpu being the one the probe began on. Sorted by time, the B
+ * and E lines of a cpu replay as a stack into folded stacks for a
+ * flamegraph, or they map one to one onto Chrome trace events with the
+ * cpu as tid.
+ */
+static ssize_t profiler_read_trace(struct kobj_t * kobj, void * buf, size_t size)
 {
-	struct profiler_t * p;
-	struct hlist_node * n;
-	irq_flags_t flags;
-	int i;
+	struct profiler_event_t ev;
+	char * q = buf;
+	int len = 0;
+	int cpu;
 
-	for(i = 0; i < ARRAY_SIZE(__profiler_hash); i++)
+	for(cpu = 0; cpu < CONFIG_MAX_SMP_CPUS; cpu++)
 	{
-		hlist_for_each_entry_safe(p, n, &__profiler_hash[i], node)
+		while((len + 128 <= size) && (profiler_trace_read(cpu, &ev, 1) == 1))
+			len += sprintf((char *)(q + len), "%d %lld %c %s\r\n", ev.cpu, ev.time, (ev.type == PROFILER_EVENT_BEGIN) ? 'B' : 'E', __profiler_start[ev.id]->name);
+	}
+	return len;
+}
+
+static ssize_t profiler_write_trace(struct kobj_t * kobj, void * buf, size_t size)
+{
+	profiler_trace_enable(strtol(buf, NULL, 0));
+	return size;
+}
+
+static ssize_t profiler_read_lost(struct kobj_t * kobj, void * buf, size_t size)
+{
+	char * q = buf;
+	int len = 0;
+	int cpu;
+
+	for(cpu = 0; cpu < CONFIG_MAX_SMP_CPUS; cpu++)
+		len += sprintf((char *)(q + len), "%d %u\r\n", cpu, __profiler_ring[cpu].lost);
+	return len;
+}
+
+/*
+ * The counters every cpu has started, a cpu that never hit a probe shows
+ * none of them
+ */
+static ssize_t profiler_read_counters(struct kobj_t * kobj, void * buf, size_t size)
+{
+	static const char * name[PROFILER_COUNTER_MAX] = { "cycles", "insns", "misses" };
+	char * q = buf;
+	int len = 0;
+	int cpu, i;
+
+	for(cpu = 0; cpu < CONFIG_MAX_SMP_CPUS; cpu++)
+	{
+		len += sprintf((char *)(q + len), "%d", cpu);
+		for(i = 0; i < PROFILER_COUNTER_MAX; i++)
 		{
-			spin_lock_irqsave(&__profiler_lock, flags);
-			hlist_del(&p->node);
-			if(p->event != 0)
-				cpu_profiler_stop(p->event, p->data);
-			free(p->name);
-			free(p);
-			spin_unlock_irqrestore(&__profiler_lock, flags);
+			if(__profiler_counter[cpu] & (1 << i))
+				len += sprintf((char *)(q + len), " %s", name[i]);
 		}
+		len += sprintf((char *)(q + len), "\r\n");
 	}
-	cpu_profiler_reset();
+	return len;
+}
+
+static ssize_t profiler_write_reset(struct kobj_t * kobj, void * buf, size_t size)
+{
+	profiler_reset();
+	return size;
 }
 
 static __init void profiler_pure_init(void)
 {
+	struct kobj_t * kobj;
+	int i, n = profiler_count();
+
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+		__profiler_stat[i] = calloc(n ? n : 1, sizeof(struct profiler_stat_t));
+
+	kobj = search_class_profiler_kobj();
+	kobj_add_regular(kobj, "probes", profiler_read_probes, NULL, NULL);
+	kobj_add_regular(kobj, "trace", profiler_read_trace, profiler_write_trace, NULL);
+	kobj_add_regular(kobj, "lost", profiler_read_lost, NULL, NULL);
+	kobj_add_regular(kobj, "counters", profiler_read_counters, NULL, NULL);
+	kobj_add_regular(kobj, "reset", NULL, profiler_write_reset, NULL);
+}
+
+static __exit void profiler_pure_exit(void)
+{
+	int mask = __profiler_counter[smp_processor_id()];
 	int i;
 
-	for(i = 0; i < ARRAY_SIZE(__profiler_hash); i++)
-		init_hlist_head(&__profiler_hash[i]);
+	for(i = 0; i < PROFILER_COUNTER_MAX; i++)
+	{
+		if(mask & (1 << i))
+			cpu_profiler_stop(i);
+	}
 }
+
 pure_initcall(profiler_pure_init);
+pure_exitcall(profiler_pure_exit);
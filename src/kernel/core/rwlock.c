@@ -0,0 +1,164 @@
+/*
+ * kernel/core/rwlock.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <xboot/rwlock.h>
+
+/*
+ * New readers queue up behind a waiting writer, so writers can not be
+ * starved. When a writer leaves, all waiting readers go first, then the
+ * next writer. The lock is handed over to the woken tasks directly.
+ */
+static inline void rwlock_wakeup_entry(struct waitqueue_entry_t * wqe)
+{
+	struct task_t * task = wqe->task;
+
+	list_del_init(&wqe->list);
+	wqe->wakeup = 1;
+	if(task)
+		task_resume(task);
+}
+
+static void rwlock_wait(struct rwlock_t * rw, struct list_head * head, irq_flags_t flags)
+{
+	struct waitqueue_entry_t wqe;
+
+	init_list_head(&wqe.list);
+	wqe.task = task_self();
+	wqe.wakeup = 0;
+	list_add_tail(&wqe.list, head);
+	spin_unlock_irqrestore(&rw->lock, flags);
+
+	task_wait_until(&wqe.wakeup, ~0ULL);
+
+	spin_lock_irqsave(&rw->lock, flags);
+	spin_unlock_irqrestore(&rw->lock, flags);
+}
+
+void rwlock_init(struct rwlock_t * rw)
+{
+	init_list_head(&rw->rwait);
+	init_list_head(&rw->wwait);
+	rw->readers = 0;
+	rw->writer = 0;
+	spin_lock_init(&rw->lock);
+}
+
+void rwlock_read_lock(struct rwlock_t * rw)
+{
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&rw->lock, flags);
+	if(!rw->writer && list_empty(&rw->wwait))
+	{
+		rw->readers++;
+		spin_unlock_irqrestore(&rw->lock, flags);
+		return;
+	}
+	rwlock_wait(rw, &rw->rwait, flags);
+}
+
+int rwlock_read_trylock(struct rwlock_t * rw)
+{
+	irq_flags_t flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&rw->lock, flags);
+	if(!rw->writer && list_empty(&rw->wwait))
+	{
+		rw->readers++;
+		ret = 1;
+	}
+	spin_unlock_irqrestore(&rw->lock, flags);
+	return ret;
+}
+
+void rwlock_read_unlock(struct rwlock_t * rw)
+{
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&rw->lock, flags);
+	if((--rw->readers == 0) && !list_empty(&rw->wwait))
+	{
+		rw->writer = 1;
+		rwlock_wakeup_entry(list_first_entry(&rw->wwait, struct waitqueue_entry_t, list));
+	}
+	spin_unlock_irqrestore(&rw->lock, flags);
+}
+
+void rwlock_write_lock(struct rwlock_t * rw)
+{
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&rw->lock, flags);
+	if(!rw->writer && (rw->readers == 0))
+	{
+		rw->writer = 1;
+		spin_unlock_irqrestore(&rw->lock, flags);
+		return;
+	}
+	rwlock_wait(rw, &rw->wwait, flags);
+}
+
+int rwlock_write_trylock(struct rwlock_t * rw)
+{
+	irq_flags_t flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&rw->lock, flags);
+	if(!rw->writer && (rw->readers == 0))
+	{
+		rw->writer = 1;
+		ret = 1;
+	}
+	spin_unlock_irqrestore(&rw->lock, flags);
+	return ret;
+}
+
+void rwlock_write_unlock(struct rwlock_t * rw)
+{
+	struct waitqueue_entry_t * pos, * n;
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&rw->lock, flags);
+	rw->writer = 0;
+	if(!list_empty(&rw->rwait))
+	{
+		list_for_each_entry_safe(pos, n, &rw->rwait, list)
+		{
+			rw->readers++;
+			rwlock_wakeup_entry(pos);
+		}
+	}
+	else if(!list_empty(&rw->wwait))
+	{
+		rw->writer = 1;
+		rwlock_wakeup_entry(list_first_entry(&rw->wwait, struct waitqueue_entry_t, list));
+	}
+	spin_unlock_irqrestore(&rw->lock, flags);
+}
@@ -0,0 +1,118 @@
+/*
+ * kernel/core/semaphore.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <xboot/semaphore.h>
+
+void semaphore_init(struct semaphore_t * sem, int count)
+{
+	init_list_head(&sem->swait);
+	sem->count = count;
+	spin_lock_init(&sem->lock);
+}
+
+static int __semaphore_down(struct semaphore_t * sem, uint64_t expires)
+{
+	struct waitqueue_entry_t wqe;
+	irq_flags_t flags;
+	int ret;
+
+	spin_lock_irqsave(&sem->lock, flags);
+	if(sem->count > 0)
+	{
+		sem->count--;
+		spin_unlock_irqrestore(&sem->lock, flags);
+		return 1;
+	}
+	init_list_head(&wqe.list);
+	wqe.task = task_self();
+	wqe.wakeup = 0;
+	list_add_tail(&wqe.list, &sem->swait);
+	spin_unlock_irqrestore(&sem->lock, flags);
+
+	task_wait_until(&wqe.wakeup, expires);
+
+	spin_lock_irqsave(&sem->lock, flags);
+	ret = wqe.wakeup;
+	if(!ret)
+		list_del_init(&wqe.list);
+	spin_unlock_irqrestore(&sem->lock, flags);
+	return ret;
+}
+
+void semaphore_down(struct semaphore_t * sem)
+{
+	__semaphore_down(sem, ~0ULL);
+}
+
+int semaphore_down_timeout(struct semaphore_t * sem, uint64_t ns)
+{
+	return __semaphore_down(sem, ktime_to_ns(ktime_get()) + ns);
+}
+
+int semaphore_trydown(struct semaphore_t * sem)
+{
+	irq_flags_t flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&sem->lock, flags);
+	if(sem->count > 0)
+	{
+		sem->count--;
+		ret = 1;
+	}
+	spin_unlock_irqrestore(&sem->lock, flags);
+	return ret;
+}
+
+/*
+ * A waiting task gets the count handed over directly, so it can not be
+ * stolen by a task that comes in between.
+ */
+void semaphore_up(struct semaphore_t * sem)
+{
+	struct waitqueue_entry_t * wqe;
+	struct task_t * task;
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&sem->lock, flags);
+	if(!list_empty(&sem->swait))
+	{
+		wqe = list_first_entry(&sem->swait, struct waitqueue_entry_t, list);
+		list_del_init(&wqe->list);
+		task = wqe->task;
+		wqe->wakeup = 1;
+		if(task)
+			task_resume(task);
+	}
+	else
+	{
+		sem->count++;
+	}
+	spin_unlock_irqrestore(&sem->lock, flags);
+}
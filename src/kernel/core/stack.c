@@ -0,0 +1,254 @@
+/*
+ * kernel/core/stack.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <xboot/stack.h>
+
+/*
+ * Stacks are handed out in power of two size classes, from 4KB up to 1MB.
+ * Freed stacks are kept on a small per-cpu free list and given back to the
+ * heap once the list is full. Larger stacks always go to the heap.
+ *
+ * With CONFIG_TASK_STACK_CHECK, a stack is painted with a known pattern.
+ * The bottom words act as a canary, and the painted area left at the low
+ * end gives the high water mark. Recycled stacks are only repainted over
+ * the part that was used.
+ */
+#define STACK_PAINT_BYTE		(0xa5)
+#define STACK_PAINT_WORD		((unsigned long)(~0UL / 0xff * STACK_PAINT_BYTE))
+#define STACK_CANARY_SIZE		(64)
+#define STACK_CLEAN_SIZE		(1024)
+
+static struct stack_arena_t __stack_arena[CONFIG_MAX_SMP_CPUS];
+
+static inline int stack_class(size_t size)
+{
+	int i;
+
+	for(i = 0; i < STACK_CLASS_MAX; i++)
+	{
+		if(size <= ((size_t)1 << (STACK_CLASS_SHIFT + i)))
+			return i;
+	}
+	return -1;
+}
+
+static inline size_t stack_class_size(int c)
+{
+	return (size_t)1 << (STACK_CLASS_SHIFT + c);
+}
+
+/*
+ * Scan down from the top until a run of untouched words is found. A large
+ * uninitialized local buffer may hide used stack below it, so the result
+ * is an estimate; the canary still catches a real overflow.
+ */
+static size_t stack_scan_used(void * stack, size_t size)
+{
+	unsigned long * p = (unsigned long *)(stack + size);
+	unsigned long * end = (unsigned long *)stack;
+	int clean = 0;
+
+	while(p > end)
+	{
+		p--;
+		if(*p == STACK_PAINT_WORD)
+		{
+			if(++clean >= (STACK_CLEAN_SIZE / sizeof(unsigned long)))
+				return (size_t)((stack + size) - (void *)(p + clean));
+		}
+		else
+		{
+			clean = 0;
+		}
+	}
+	return size;
+}
+
+void * stack_alloc(size_t * size)
+{
+	struct stack_arena_t * arena = &__stack_arena[smp_processor_id()];
+	struct list_head * node = NULL;
+	irq_flags_t flags;
+	void * stack;
+	int c;
+
+	c = stack_class(*size);
+	if(c >= 0)
+	{
+		*size = stack_class_size(c);
+		spin_lock_irqsave(&arena->lock, flags);
+		arena->nr_alloc++;
+		if(!list_empty(&arena->head[c]))
+		{
+			node = arena->head[c].next;
+			list_del(node);
+			arena->count[c]--;
+			arena->nr_hit++;
+		}
+		spin_unlock_irqrestore(&arena->lock, flags);
+		if(node)
+		{
+			if(CONFIG_TASK_STACK_CHECK > 0)
+				memset(node, STACK_PAINT_BYTE, sizeof(struct list_head));
+			return (void *)node;
+		}
+	}
+
+	stack = memalign(16, *size);
+	if(stack && (CONFIG_TASK_STACK_CHECK > 0))
+		memset(stack, STACK_PAINT_BYTE, *size);
+	return stack;
+}
+
+void stack_free(void * stack, size_t size)
+{
+	struct stack_arena_t * arena = &__stack_arena[smp_processor_id()];
+	struct list_head * node = (struct list_head *)stack;
+	irq_flags_t flags;
+	size_t used;
+	int c;
+
+	if(!stack)
+		return;
+
+	c = stack_class(size);
+	if((c >= 0) && (stack_class_size(c) == size))
+	{
+		if(CONFIG_TASK_STACK_CHECK > 0)
+		{
+			used = stack_scan_used(stack, size);
+			memset(stack + size - used, STACK_PAINT_BYTE, used);
+		}
+		spin_lock_irqsave(&arena->lock, flags);
+		arena->nr_free++;
+		if(arena->count[c] < CONFIG_TASK_STACK_CACHE)
+		{
+			list_add(node, &arena->head[c]);
+			arena->count[c]++;
+			node = NULL;
+		}
+		else
+		{
+			arena->nr_release++;
+		}
+		spin_unlock_irqrestore(&arena->lock, flags);
+		if(!node)
+			return;
+	}
+	free(stack);
+}
+
+size_t stack_used(void * stack, size_t size)
+{
+	if(stack && (CONFIG_TASK_STACK_CHECK > 0))
+		return stack_scan_used(stack, size);
+	return 0;
+}
+
+int stack_overflow(void * stack)
+{
+	unsigned long * p = (unsigned long *)stack;
+	int i;
+
+	if(stack && (CONFIG_TASK_STACK_CHECK > 0))
+	{
+		for(i = 0; i < STACK_CANARY_SIZE / sizeof(unsigned long); i++)
+		{
+			if(p[i] != STACK_PAINT_WORD)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+static struct kobj_t * search_class_stack_kobj(void)
+{
+	struct kobj_t * kclass = kobj_search_directory_with_create(kobj_get_root(), "class");
+	return kobj_search_directory_with_create(kclass, "stack");
+}
+
+static ssize_t stack_read_stat(struct kobj_t * kobj, void * buf, size_t size)
+{
+	struct stack_arena_t * arena = (struct stack_arena_t *)kobj->priv;
+	char * p = buf;
+	int len = 0;
+	int i;
+
+	len += sprintf((char *)(p + len), " alloc: %lld\r\n", arena->nr_alloc);
+	len += sprintf((char *)(p + len), " hit: %lld\r\n", arena->nr_hit);
+	len += sprintf((char *)(p + len), " free: %lld\r\n", arena->nr_free);
+	len += sprintf((char *)(p + len), " release: %lld\r\n", arena->nr_release);
+	for(i = 0; i < STACK_CLASS_MAX; i++)
+	{
+		if(arena->count[i] > 0)
+			len += sprintf((char *)(p + len), " cache %ldKB: %u\r\n", (long)(stack_class_size(i) >> 10), arena->count[i]);
+	}
+	return len;
+}
+
+void do_init_stack(void)
+{
+	struct stack_arena_t * arena;
+	char name[16];
+	size_t size;
+	void * stack;
+	int i, j, c;
+
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+	{
+		arena = &__stack_arena[i];
+
+		spin_lock_init(&arena->lock);
+		for(j = 0; j < STACK_CLASS_MAX; j++)
+		{
+			init_list_head(&arena->head[j]);
+			arena->count[j] = 0;
+		}
+		arena->nr_alloc = 0;
+		arena->nr_hit = 0;
+		arena->nr_free = 0;
+		arena->nr_release = 0;
+
+		c = stack_class(CONFIG_TASK_STACK_SIZE);
+		for(j = 0; (c >= 0) && (j < CONFIG_TASK_STACK_PREFILL) && (j < CONFIG_TASK_STACK_CACHE); j++)
+		{
+			size = stack_class_size(c);
+			stack = memalign(16, size);
+			if(!stack)
+				break;
+			if(CONFIG_TASK_STACK_CHECK > 0)
+				memset(stack, STACK_PAINT_BYTE, size);
+			list_add((struct list_head *)stack, &arena->head[c]);
+			arena->count[c]++;
+		}
+
+		sprintf(name, "cpu%d", i);
+		kobj_add_regular(search_class_stack_kobj(), name, stack_read_stat, NULL, arena);
+	}
+}
@@ -121,11 +121,39 @@ static inline struct task_t * scheduler_next_ready_task(struct scheduler_t * sch
 	return rb_entry(leftmost, struct task_t, node);
 }
 
+/*
+ * The minimum vtime follows the smaller of the running task and the
+ * leftmost ready task, ignoring the idle task, and never goes backwards.
+ * Resumed tasks start from it, so they neither starve the others nor get
+ * stuck behind the huge vtime of the idle task.
+ */
+static inline void scheduler_update_min_vtime(struct scheduler_t * sched)
+{
+	struct task_t * next = scheduler_next_ready_task(sched);
+	struct task_t * running = sched->running;
+	uint64_t vtime = 0;
+	int valid = 0;
+
+	if(running && (running != sched->idle) && (running->status == TASK_STATUS_RUNNING))
+	{
+		vtime = running->vtime;
+		valid = 1;
+	}
+	if(next && (next != sched->idle))
+	{
+		if(!valid || ((int64_t)(next->vtime - vtime) < 0))
+			vtime = next->vtime;
+		valid = 1;
+	}
+	if(valid && ((int64_t)(vtime - sched->min_vtime) > 0))
+		sched->min_vtime = vtime;
+}
+
 static inline void scheduler_enqueue_task(struct scheduler_t * sched, struct task_t * task)
 {
 	struct rb_node ** link = &sched->ready.rb_root.rb_node;
 	struct rb_node * parent = NULL;
-	struct task_t * next, * entry;
+	struct task_t * entry;
 	int leftmost = 1;
 
 	while(*link)
@@ -145,27 +173,47 @@ static inline void scheduler_enqueue_task(struct scheduler_t * sched, struct tas
 
 	rb_link_node(&task->node, parent, link);
 	rb_insert_color_cached(&task->node, &sched->ready, leftmost);
-	next = scheduler_next_ready_task(sched);
-	if(likely(next))
-		sched->min_vtime = next->vtime;
-	else if(sched->running)
-		sched->min_vtime = sched->running->vtime;
-	else
-		sched->min_vtime = 0;
+	if(task != sched->idle)
+		sched->nr_ready++;
+	scheduler_update_min_vtime(sched);
 }
 
 static inline void scheduler_dequeue_task(struct scheduler_t * sched, struct task_t * task)
 {
-	struct task_t * next;
-
 	rb_erase_cached(&task->node, &sched->ready);
-	next = scheduler_next_ready_task(sched);
-	if(likely(next))
-		sched->min_vtime = next->vtime;
-	else if(sched->running)
-		sched->min_vtime = sched->running->vtime;
-	else
-		sched->min_vtime = 0;
+	if(task != sched->idle)
+		sched->nr_ready--;
+	scheduler_update_min_vtime(sched);
+}
+
+/*
+ * The task structure lives at the top of its stack block, so a task costs
+ * a single allocation from the stack arena.
+ */
+#define TASK_HEADER_SIZE	((sizeof(struct task_t) + 15) & ~15)
+
+static inline void task_release(struct task_t * task)
+{
+	if(stack_overflow(task->stack))
+		LOG("Task '%s' overflowed its %ld bytes stack", task->name ? task->name : "", (long)task->stksz);
+	if(task->name)
+		free(task->name);
+	stack_free(task->stack, task->stksz + TASK_HEADER_SIZE);
+}
+
+/*
+ * An exited task can not give its own stack back while still running on
+ * it, so the next task to run on this cpu does it after the switch.
+ */
+static inline void scheduler_reap_task(struct scheduler_t * sched)
+{
+	struct task_t * task = sched->exited;
+
+	if(task)
+	{
+		sched->exited = NULL;
+		task_release(task);
+	}
 }
 
 static inline void scheduler_switch_task(struct scheduler_t * sched, struct task_t * task)
@@ -174,7 +222,9 @@ static inline void scheduler_switch_task(struct scheduler_t * sched, struct task
 	sched->running = task;
 	struct transfer_t from = jump_fcontext(task->fctx, running);
 	struct task_t * t = (struct task_t *)from.priv;
+	smp_wmb();
 	t->fctx = from.fctx;
+	scheduler_reap_task(scheduler_self());
 }
 
 static inline struct scheduler_t * scheduler_load_balance_choice(void)
@@ -194,30 +244,148 @@ static inline struct scheduler_t * scheduler_load_balance_choice(void)
 	return sched;
 }
 
+/*
+ * A ready task may migrate to another cpu at any time, so lock the
+ * scheduler it belongs to and check it again after the lock is held.
+ */
+static inline struct scheduler_t * task_sched_lock(struct task_t * task)
+{
+	struct scheduler_t * sched;
+
+	while(1)
+	{
+		sched = task->sched;
+		spin_lock(&sched->lock);
+		if(likely(sched == task->sched))
+			return sched;
+		spin_unlock(&sched->lock);
+	}
+}
+
+static inline void scheduler_double_lock(struct scheduler_t * a, struct scheduler_t * b)
+{
+	if(a < b)
+	{
+		spin_lock(&a->lock);
+		spin_lock(&b->lock);
+	}
+	else
+	{
+		spin_lock(&b->lock);
+		spin_lock(&a->lock);
+	}
+}
+
+static inline void scheduler_double_unlock(struct scheduler_t * a, struct scheduler_t * b)
+{
+	spin_unlock(&a->lock);
+	spin_unlock(&b->lock);
+}
+
+static inline unsigned int scheduler_load(struct scheduler_t * sched)
+{
+	if(sched->running && (sched->running != sched->idle))
+		return sched->nr_ready + 1;
+	return sched->nr_ready;
+}
+
+/*
+ * Pull one task from the tail of the source ready tree. The idle task is
+ * never migrated, and a task whose context is not saved yet (fctx is null
+ * while it is switching out) must stay where it is.
+ */
+static struct task_t * scheduler_migrate_task(struct scheduler_t * src, struct scheduler_t * dst)
+{
+	struct rb_node * rbn;
+	struct task_t * task;
+	int64_t delta;
+
+	for(rbn = rb_last(&src->ready.rb_root); rbn; rbn = rb_prev(rbn))
+	{
+		task = rb_entry(rbn, struct task_t, node);
+		if((task != src->idle) && task->fctx)
+		{
+			delta = (int64_t)(task->vtime - src->min_vtime);
+			scheduler_dequeue_task(src, task);
+			src->weight -= task->weight;
+			src->nr_migrate_out++;
+			task->sched = dst;
+			task->vtime = dst->min_vtime + delta;
+			dst->weight += task->weight;
+			dst->nr_migrate_in++;
+			scheduler_enqueue_task(dst, task);
+			return task;
+		}
+	}
+	return NULL;
+}
+
+static void scheduler_load_balance(struct scheduler_t * sched)
+{
+	struct scheduler_t * busiest = NULL;
+	irq_flags_t flags;
+	unsigned int load, max;
+	int i;
+
+	if(CONFIG_MAX_SMP_CPUS <= 1)
+		return;
+
+	load = max = scheduler_load(sched);
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+	{
+		if((&__sched[i] != sched) && (__sched[i].nr_ready > max))
+		{
+			busiest = &__sched[i];
+			max = __sched[i].nr_ready;
+		}
+	}
+
+	if(busiest)
+	{
+		local_irq_save(flags);
+		scheduler_double_lock(sched, busiest);
+		load = scheduler_load(sched);
+		if(busiest->nr_ready > load)
+			scheduler_migrate_task(busiest, sched);
+		scheduler_double_unlock(sched, busiest);
+		local_irq_restore(flags);
+	}
+}
+
 static void fcontext_entry_func(struct transfer_t from)
 {
 	struct task_t * t = (struct task_t *)from.priv;
-	struct scheduler_t * sched = t->sched;
-	struct task_t * next, * task = sched->running;
+	struct scheduler_t * sched;
+	struct task_t * next, * task;
+	irq_flags_t flags;
 
+	smp_wmb();
 	t->fctx = from.fctx;
+	scheduler_reap_task(scheduler_self());
+	task = task_self();
 	task->func(task, task->data);
+	sched = task->sched;
 	task_destroy(task);
 
+	spin_lock_irqsave(&sched->lock, flags);
 	next = scheduler_next_ready_task(sched);
 	if(likely(next))
 	{
 		scheduler_dequeue_task(sched, next);
 		next->status = TASK_STATUS_RUNNING;
 		next->start = ktime_to_ns(ktime_get());
-		scheduler_switch_task(sched, next);
 	}
+	spin_unlock_irqrestore(&sched->lock, flags);
+	if(likely(next))
+		scheduler_switch_task(sched, next);
 }
 
 struct task_t * task_create(struct scheduler_t * sched, const char * name, task_func_t func, void * data, size_t stksz, int nice)
 {
 	struct task_t * task;
 	void * stack;
+	irq_flags_t flags;
+	size_t size;
 
 	if(!func)
 		return NULL;
@@ -233,26 +401,21 @@ struct task_t * task_create(struct scheduler_t * sched, const char * name, task_
 	else if(nice > 19)
 		nice = 19;
 
-	task = malloc(sizeof(struct task_t));
-	if(!task)
-		return NULL;
-
-	stack = malloc(stksz);
+	size = stksz;
+	stack = stack_alloc(&size);
 	if(!stack)
-	{
-		free(task);
 		return NULL;
-	}
+	task = (struct task_t *)(stack + size - TASK_HEADER_SIZE);
+	stksz = size - TASK_HEADER_SIZE;
 
 	RB_CLEAR_NODE(&task->node);
 	init_list_head(&task->list);
 	init_list_head(&task->slist);
 	init_list_head(&task->rlist);
-	init_list_head(&task->mlist);
-	spin_lock(&sched->lock);
+	spin_lock_irqsave(&sched->lock, flags);
 	list_add_tail(&task->list, &sched->suspend);
 	sched->weight += nice_to_weight[nice + 20];
-	spin_unlock(&sched->lock);
+	spin_unlock_irqrestore(&sched->lock, flags);
 
 	task->name = strdup(name);
 	task->status = TASK_STATUS_SUSPEND;
@@ -263,9 +426,12 @@ struct task_t * task_create(struct scheduler_t * sched, const char * name, task_
 	task->stack = stack;
 	task->stksz = stksz;
 	task->nice = nice;
+	task->pi_nice = 20;
 	task->weight = nice_to_weight[nice + 20];
 	task->inv_weight = nice_to_wmult[nice + 20];
 	task->fctx = make_fcontext(task->stack + stksz, task->stksz, fcontext_entry_func);
+	task->mblocked = NULL;
+	task->mheld = 0;
 	task->func = func;
 	task->data = data;
 	task->__errno = 0;
@@ -275,21 +441,52 @@ struct task_t * task_create(struct scheduler_t * sched, const char * name, task_
 
 void task_destroy(struct task_t * task)
 {
+	struct scheduler_t * sched;
+	irq_flags_t flags;
+
 	if(task)
 	{
-		spin_lock(&task->sched->lock);
-		task->sched->weight -= nice_to_weight[task->nice + 20];
-		spin_unlock(&task->sched->lock);
-
-		if(task->name)
-			free(task->name);
-		free(task->stack);
-		free(task);
+		local_irq_save(flags);
+		sched = task_sched_lock(task);
+		sched->weight -= task->weight;
+		if(task->status == TASK_STATUS_SUSPEND)
+			list_del_init(&task->list);
+		else if(task->status == TASK_STATUS_READY)
+			scheduler_dequeue_task(sched, task);
+		if(task == sched->running)
+		{
+			scheduler_reap_task(sched);
+			sched->exited = task;
+			task = NULL;
+		}
+		spin_unlock(&sched->lock);
+		local_irq_restore(flags);
+
+		if(task)
+			task_release(task);
 	}
 }
 
+/*
+ * The weight follows the effective nice value, which is the better of the
+ * task's own nice value and the one inherited from waiters on a mutex it
+ * holds.
+ */
+static inline void task_update_weight(struct scheduler_t * sched, struct task_t * task)
+{
+	int nice = (task->pi_nice < task->nice) ? task->pi_nice : task->nice;
+
+	sched->weight -= task->weight;
+	task->weight = nice_to_weight[nice + 20];
+	task->inv_weight = nice_to_wmult[nice + 20];
+	sched->weight += task->weight;
+}
+
 void task_renice(struct task_t * task, int nice)
 {
+	struct scheduler_t * sched;
+	irq_flags_t flags;
+
 	if(nice < -20)
 		nice = -20;
 	else if(nice > 19)
@@ -297,79 +494,156 @@ void task_renice(struct task_t * task, int nice)
 
 	if(task->nice != nice)
 	{
-		spin_lock(&task->sched->lock);
-		task->sched->weight -= nice_to_weight[task->nice + 20];
-		task->sched->weight += nice_to_weight[nice + 20];
-		spin_unlock(&task->sched->lock);
-
+		local_irq_save(flags);
+		sched = task_sched_lock(task);
 		task->nice = nice;
-		task->weight = nice_to_weight[nice + 20];
-		task->inv_weight = nice_to_wmult[nice + 20];
+		task_update_weight(sched, task);
+		spin_unlock(&sched->lock);
+		local_irq_restore(flags);
 	}
 }
 
-void task_suspend(struct task_t * task)
+/*
+ * Lend a better nice value to the task for priority inheritance. A ready
+ * task is also moved up to the minimum vtime, so it runs soon instead of
+ * waiting behind the vtime it built up at its own low weight.
+ */
+void task_boost(struct task_t * task, int nice)
 {
-	struct task_t * next;
-	uint64_t now, detla;
+	struct scheduler_t * sched;
+	irq_flags_t flags;
 
-	if(task)
+	if(nice < -20)
+		nice = -20;
+
+	if(task && (nice < task->pi_nice))
 	{
-		if(task->status == TASK_STATUS_READY)
-		{
-			task->status = TASK_STATUS_SUSPEND;
-			spin_lock(&task->sched->lock);
-			list_add_tail(&task->list, &task->sched->suspend);
-			spin_unlock(&task->sched->lock);
-			scheduler_dequeue_task(task->sched, task);
-		}
-		else if(task->status == TASK_STATUS_RUNNING)
+		local_irq_save(flags);
+		sched = task_sched_lock(task);
+		if(nice < task->pi_nice)
 		{
-			now = ktime_to_ns(ktime_get());
-			detla = now - task->start;
-
-			task->time += detla;
-			task->vtime += calc_delta_fair(task, detla);
-			task->status = TASK_STATUS_SUSPEND;
-			spin_lock(&task->sched->lock);
-			list_add_tail(&task->list, &task->sched->suspend);
-			spin_unlock(&task->sched->lock);
-
-			next = scheduler_next_ready_task(task->sched);
-			if(next)
+			task->pi_nice = nice;
+			task_update_weight(sched, task);
+			if((task->status == TASK_STATUS_READY) && ((int64_t)(task->vtime - sched->min_vtime) > 0))
 			{
-				scheduler_dequeue_task(task->sched, next);
-				next->status = TASK_STATUS_RUNNING;
-				next->start = now;
-				scheduler_switch_task(task->sched, next);
+				scheduler_dequeue_task(sched, task);
+				task->vtime = sched->min_vtime;
+				scheduler_enqueue_task(sched, task);
 			}
 		}
+		spin_unlock(&sched->lock);
+		local_irq_restore(flags);
+	}
+}
+
+void task_unboost(struct task_t * task)
+{
+	struct scheduler_t * sched;
+	irq_flags_t flags;
+
+	if(task && (task->pi_nice != 20))
+	{
+		local_irq_save(flags);
+		sched = task_sched_lock(task);
+		task->pi_nice = 20;
+		task_update_weight(sched, task);
+		spin_unlock(&sched->lock);
+		local_irq_restore(flags);
 	}
 }
 
+/*
+ * Suspend the task. For the running task the wakeup and timeout flags, if
+ * any, are checked again under the scheduler lock, so a wakeup that races
+ * with going to sleep is never lost.
+ */
+static void __task_suspend(struct task_t * task, volatile int * wakeup, volatile int * expired)
+{
+	struct scheduler_t * sched;
+	struct task_t * next = NULL;
+	irq_flags_t flags;
+	uint64_t now, detla;
+
+	local_irq_save(flags);
+	sched = task_sched_lock(task);
+	if(task->status == TASK_STATUS_READY)
+	{
+		task->status = TASK_STATUS_SUSPEND;
+		list_add_tail(&task->list, &sched->suspend);
+		scheduler_dequeue_task(sched, task);
+	}
+	else if((task->status == TASK_STATUS_RUNNING) && !(wakeup && *wakeup) && !(expired && *expired))
+	{
+		now = ktime_to_ns(ktime_get());
+		detla = now - task->start;
+
+		task->time += detla;
+		task->vtime += calc_delta_fair(task, detla);
+		task->status = TASK_STATUS_SUSPEND;
+		list_add_tail(&task->list, &sched->suspend);
+
+		next = scheduler_next_ready_task(sched);
+		if(next)
+		{
+			scheduler_dequeue_task(sched, next);
+			next->status = TASK_STATUS_RUNNING;
+			next->start = now;
+			task->fctx = NULL;
+		}
+	}
+	spin_unlock(&sched->lock);
+	local_irq_restore(flags);
+
+	if(next)
+		scheduler_switch_task(sched, next);
+}
+
+void task_suspend(struct task_t * task)
+{
+	if(task)
+		__task_suspend(task, NULL, NULL);
+}
+
 void task_resume(struct task_t * task)
 {
+	struct scheduler_t * sched;
+	irq_flags_t flags;
+
 	if(task && (task->status == TASK_STATUS_SUSPEND))
 	{
-		task->vtime = task->sched->min_vtime;
-		task->status = TASK_STATUS_READY;
-		spin_lock(&task->sched->lock);
-		list_del_init(&task->list);
-		spin_unlock(&task->sched->lock);
-		scheduler_enqueue_task(task->sched, task);
+		local_irq_save(flags);
+		sched = task_sched_lock(task);
+		if(task->status == TASK_STATUS_SUSPEND)
+		{
+			task->vtime = sched->min_vtime;
+			task->status = TASK_STATUS_READY;
+			list_del_init(&task->list);
+			scheduler_enqueue_task(sched, task);
+		}
+		spin_unlock(&sched->lock);
+		local_irq_restore(flags);
+		cpu_wakeup();
 	}
 }
 
 void task_yield(void)
 {
 	struct scheduler_t * sched = scheduler_self();
-	struct task_t * next, * self = task_self();
+	struct task_t * next = NULL, * self = task_self();
 	uint64_t now = ktime_to_ns(ktime_get());
 	uint64_t detla = now - self->start;
+	irq_flags_t flags;
+
+	if((CONFIG_MAX_SMP_CPUS > 1) && ((int64_t)(now - sched->next_balance) >= 0))
+	{
+		sched->next_balance = now + CONFIG_SCHED_BALANCE_INTERVAL * 1000000ULL;
+		scheduler_load_balance(sched);
+	}
 
 	self->time += detla;
 	self->vtime += calc_delta_fair(self, detla);
 
+	spin_lock_irqsave(&sched->lock, flags);
 	if((int64_t)(self->vtime - sched->min_vtime) < 0)
 	{
 		self->start = now;
@@ -383,73 +657,181 @@ void task_yield(void)
 		next->status = TASK_STATUS_RUNNING;
 		next->start = now;
 		if(likely(next != self))
-			scheduler_switch_task(sched, next);
+			self->fctx = NULL;
+		else
+			next = NULL;
 	}
+	spin_unlock_irqrestore(&sched->lock, flags);
+
+	if(next)
+		scheduler_switch_task(sched, next);
 }
 
+struct task_timeout_t {
+	struct timer_t timer;
+	struct task_t * task;
+	volatile int expired;
+};
+
+static int task_timeout_function(struct timer_t * timer, void * data)
+{
+	struct task_timeout_t * tt = (struct task_timeout_t *)data;
+
+	tt->expired = 1;
+	task_resume(tt->task);
+	return 0;
+}
+
+/*
+ * Suspend the current task until the wakeup flag is set or the absolute
+ * deadline in nanoseconds passes; a deadline at or beyond KTIME_MAX never
+ * expires. Returns zero on timeout. Without a task context, such as before
+ * the scheduler starts, this falls back to polling.
+ */
+int task_wait_until(volatile int * wakeup, uint64_t expires)
+{
+	struct task_t * self = task_self();
+	struct task_timeout_t tt;
+
+	if(!self || (self == self->sched->idle))
+	{
+		while(!*wakeup)
+		{
+			if((expires < KTIME_MAX) && (ktime_to_ns(ktime_get()) >= expires))
+				return 0;
+		}
+		return 1;
+	}
+
+	tt.task = self;
+	tt.expired = 0;
+	if(expires < KTIME_MAX)
+	{
+		timer_init(&tt.timer, task_timeout_function, &tt);
+		timer_start(&tt.timer, ns_to_ktime(expires), ms_to_ktime(0));
+	}
+	while(!*wakeup && !tt.expired)
+		__task_suspend(self, wakeup, &tt.expired);
+	if(expires < KTIME_MAX)
+		timer_cancel(&tt.timer);
+	return *wakeup ? 1 : 0;
+}
+
+void task_sleep(uint64_t ns)
+{
+	volatile int wakeup = 0;
+
+	if(ns > 0)
+		task_wait_until(&wakeup, ktime_to_ns(ktime_get()) + ns);
+}
+
+/*
+ * There is no periodic tick, the clockevent is always programmed for the
+ * earliest timer. With nothing to run the cpu sleeps until an interrupt or
+ * a wakeup event from task_resume on another cpu.
+ */
 static void idle_task(struct task_t * task, void * data)
 {
+	struct scheduler_t * sched = task->sched;
+	irq_flags_t flags;
+	uint64_t t;
+
 	while(1)
 	{
+		if(!sched->nr_ready)
+			scheduler_load_balance(sched);
+		local_irq_save(flags);
+		if(!sched->nr_ready)
+		{
+			t = ktime_to_ns(ktime_get());
+			cpu_idle();
+			sched->idle_time += ktime_to_ns(ktime_get()) - t;
+			sched->nr_idle++;
+		}
+		local_irq_restore(flags);
 		task_yield();
 	}
 }
 
-static void smpboot_entry_func(void)
+static struct task_t * scheduler_create_idle(struct scheduler_t * sched)
 {
-	machine_smpinit();
-
-	struct scheduler_t * sched = scheduler_self();
 	struct task_t * task = task_create(sched, "idle", idle_task, (void *)(unsigned long)(smp_processor_id()), SZ_8K, 0);
-	spin_lock(&sched->lock);
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&sched->lock, flags);
 	sched->weight -= task->weight;
 	task->nice = 26;
 	task->weight = 3;
 	task->inv_weight = 1431655765;
 	sched->weight += task->weight;
-	spin_unlock(&sched->lock);
-	task_resume(task);
+	sched->idle = task;
+	spin_unlock_irqrestore(&sched->lock, flags);
 
-	struct task_t * next = scheduler_next_ready_task(sched);
+	return task;
+}
+
+static void scheduler_start(struct scheduler_t * sched)
+{
+	struct task_t * next;
+	irq_flags_t flags;
+
+	task_resume(scheduler_create_idle(sched));
+
+	spin_lock_irqsave(&sched->lock, flags);
+	next = scheduler_next_ready_task(sched);
 	if(next)
 	{
 		sched->running = next;
 		scheduler_dequeue_task(sched, next);
 		next->status = TASK_STATUS_RUNNING;
 		next->start = ktime_to_ns(ktime_get());
-		scheduler_switch_task(sched, next);
 	}
+	spin_unlock_irqrestore(&sched->lock, flags);
+
+	if(next)
+		scheduler_switch_task(sched, next);
+}
+
+static void smpboot_entry_func(void)
+{
+	machine_smpinit();
+	scheduler_start(scheduler_self());
 }
 
 void scheduler_loop(void)
 {
 	machine_smpboot(smpboot_entry_func);
+	scheduler_start(scheduler_self());
+}
 
-	struct scheduler_t * sched = scheduler_self();
-	struct task_t * task = task_create(sched, "idle", idle_task, (void *)(unsigned long)smp_processor_id(), SZ_8K, 0);
-	spin_lock(&sched->lock);
-	sched->weight -= task->weight;
-	task->nice = 26;
-	task->weight = 3;
-	task->inv_weight = 1431655765;
-	sched->weight += task->weight;
-	spin_unlock(&sched->lock);
-	task_resume(task);
+static struct kobj_t * search_class_scheduler_kobj(void)
+{
+	struct kobj_t * kclass = kobj_search_directory_with_create(kobj_get_root(), "class");
+	return kobj_search_directory_with_create(kclass, "scheduler");
+}
 
-	struct task_t * next = scheduler_next_ready_task(sched);
-	if(next)
-	{
-		sched->running = next;
-		scheduler_dequeue_task(sched, next);
-		next->status = TASK_STATUS_RUNNING;
-		next->start = ktime_to_ns(ktime_get());
-		scheduler_switch_task(sched, next);
-	}
+static ssize_t scheduler_read_stat(struct kobj_t * kobj, void * buf, size_t size)
+{
+	struct scheduler_t * sched = (struct scheduler_t *)kobj->priv;
+	struct task_t * running = sched->running;
+	char * p = buf;
+	int len = 0;
+
+	len += sprintf((char *)(p + len), " running: %s\r\n", (running && running->name) ? running->name : "");
+	len += sprintf((char *)(p + len), " ready: %u\r\n", sched->nr_ready);
+	len += sprintf((char *)(p + len), " weight: %lld\r\n", sched->weight);
+	len += sprintf((char *)(p + len), " min vtime: %lld\r\n", sched->min_vtime);
+	len += sprintf((char *)(p + len), " migrate in: %lld\r\n", sched->nr_migrate_in);
+	len += sprintf((char *)(p + len), " migrate out: %lld\r\n", sched->nr_migrate_out);
+	len += sprintf((char *)(p + len), " idle count: %lld\r\n", sched->nr_idle);
+	len += sprintf((char *)(p + len), " idle time: %lld\r\n", sched->idle_time);
+	return len;
 }
 
 void do_init_sched(void)
 {
 	struct scheduler_t * sched;
+	char name[16];
 	int i;
 
 	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
@@ -461,8 +843,19 @@ void do_init_sched(void)
 		sched->ready = RB_ROOT_CACHED;
 		init_list_head(&sched->suspend);
 		sched->running = NULL;
+		sched->idle = NULL;
+		sched->exited = NULL;
 		sched->min_vtime = 0;
 		sched->weight = 0;
+		sched->next_balance = 0;
+		sched->nr_ready = 0;
+		sched->nr_migrate_in = 0;
+		sched->nr_migrate_out = 0;
+		sched->nr_idle = 0;
+		sched->idle_time = 0;
 		spin_unlock(&sched->lock);
+
+		sprintf(name, "cpu%d", i);
+		kobj_add_regular(search_class_scheduler_kobj(), name, scheduler_read_stat, NULL, sched);
 	}
 }
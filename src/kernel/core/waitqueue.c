@@ -0,0 +1,97 @@
+/*
+ * kernel/core/waitqueue.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <xboot/waitqueue.h>
+
+void waitqueue_init(struct waitqueue_t * wq)
+{
+	init_list_head(&wq->head);
+	spin_lock_init(&wq->lock);
+}
+
+void waitqueue_prepare(struct waitqueue_t * wq, struct waitqueue_entry_t * wqe)
+{
+	irq_flags_t flags;
+
+	init_list_head(&wqe->list);
+	wqe->task = task_self();
+	wqe->wakeup = 0;
+	spin_lock_irqsave(&wq->lock, flags);
+	list_add_tail(&wqe->list, &wq->head);
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void waitqueue_finish(struct waitqueue_t * wq, struct waitqueue_entry_t * wqe)
+{
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&wq->lock, flags);
+	list_del_init(&wqe->list);
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+int waitqueue_schedule(struct waitqueue_t * wq, struct waitqueue_entry_t * wqe, ktime_t expires)
+{
+	int ret = task_wait_until(&wqe->wakeup, ktime_to_ns(expires));
+	waitqueue_finish(wq, wqe);
+	return ret;
+}
+
+/*
+ * The entry is unlinked and the task resumed with the queue lock held, so a
+ * waiter leaving through waitqueue_finish never sees a half done wakeup.
+ */
+static inline void waitqueue_wakeup_entry(struct waitqueue_entry_t * wqe)
+{
+	list_del_init(&wqe->list);
+	wqe->wakeup = 1;
+	if(wqe->task)
+		task_resume(wqe->task);
+}
+
+void waitqueue_wakeup(struct waitqueue_t * wq)
+{
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&wq->lock, flags);
+	if(!list_empty(&wq->head))
+		waitqueue_wakeup_entry(list_first_entry(&wq->head, struct waitqueue_entry_t, list));
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void waitqueue_wakeup_all(struct waitqueue_t * wq)
+{
+	struct waitqueue_entry_t * pos, * n;
+	irq_flags_t flags;
+
+	spin_lock_irqsave(&wq->lock, flags);
+	list_for_each_entry_safe(pos, n, &wq->head, list)
+		waitqueue_wakeup_entry(pos);
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
@@ -54,6 +54,22 @@ static void fb_dummy_present(struct framebuffer_t * fb, struct surface_t * s, st
 {
 }
 
+static int fb_dummy_create_surfaces(struct framebuffer_t * fb, struct surface_t ** s, int n)
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+	{
+		if(!(s[i] = surface_alloc(fb->width, fb->height, NULL)))
+			break;
+	}
+	return i;
+}
+
+static void fb_dummy_flip(struct framebuffer_t * fb, struct surface_t * s, struct region_list_t * rl, int vsync)
+{
+}
+
 static struct framebuffer_t fb_dummy = {
 	.name		= "fb-dummy",
 	.width		= 640,
@@ -65,6 +81,8 @@ static struct framebuffer_t fb_dummy = {
 	.create		= fb_dummy_create,
 	.destroy	= fb_dummy_destroy,
 	.present	= fb_dummy_present,
+	.create_surfaces	= fb_dummy_create_surfaces,
+	.flip		= fb_dummy_flip,
 	.priv		= NULL,
 };
 
@@ -197,6 +215,100 @@ static void window_manager_free(struct window_manager_t * wm)
 	}
 }
 
+/*
+ * When the framebuffer can flip, the window renders into a chain of two or
+ * three surfaces the display scans out in turn. Each one keeps what has
+ * been damaged since it was last shown, and before it is reused as the back
+ * buffer only that part, minus what the frame will repaint anyway, is copied
+ * from the front buffer. Otherwise there is one surface and it is presented.
+ */
+static void window_chain_alloc(struct window_t * w)
+{
+	struct framebuffer_t * fb = w->wm->fb;
+	struct region_t region;
+	int n = clamp(CONFIG_WINDOW_SURFACE_COUNT, 0, WINDOW_SURFACE_MAX);
+	int i;
+
+	w->chain.count = (n >= 2) ? framebuffer_create_surfaces(fb, w->chain.s, n) : 0;
+	if(w->chain.count < 2)
+	{
+		for(i = 0; i < w->chain.count; i++)
+			framebuffer_destroy_surface(fb, w->chain.s[i]);
+		w->chain.count = 0;
+		w->s = framebuffer_create_surface(fb);
+		return;
+	}
+	region_init(&region, 0, 0, framebuffer_get_width(fb), framebuffer_get_height(fb));
+	for(i = 0; i < w->chain.count; i++)
+	{
+		w->chain.damage[i] = region_list_alloc(0);
+		if(i > 0)
+			region_list_add(w->chain.damage[i], &region);
+	}
+	w->chain.repair = region_list_alloc(0);
+	w->chain.index = 0;
+	w->s = w->chain.s[0];
+}
+
+static void window_chain_free(struct window_t * w)
+{
+	int i;
+
+	if(w->chain.count > 0)
+	{
+		for(i = 0; i < w->chain.count; i++)
+		{
+			framebuffer_destroy_surface(w->wm->fb, w->chain.s[i]);
+			region_list_free(w->chain.damage[i]);
+		}
+		region_list_free(w->chain.repair);
+	}
+	else
+		framebuffer_destroy_surface(w->wm->fb, w->s);
+}
+
+static void window_chain_acquire(struct window_t * w)
+{
+	struct surface_t * front = w->chain.s[w->chain.index];
+	struct surface_t * back;
+	struct region_t * r;
+	unsigned char * p, * q;
+	int next = (w->chain.index + 1) % w->chain.count;
+	int line, i, j;
+
+	back = w->chain.s[next];
+	region_list_subtract(w->chain.repair, w->chain.damage[next], w->rl);
+	if(w->chain.repair->count > 0)
+	{
+		surface_flush(front);
+		p = surface_get_pixels(back);
+		q = front->pixels;
+		for(i = 0; i < w->chain.repair->count; i++)
+		{
+			r = &w->chain.repair->region[i];
+			line = r->w << 2;
+			for(j = r->y; j < r->y + r->h; j++)
+				memcpy(p + j * back->stride + (r->x << 2), q + j * front->stride + (r->x << 2), line);
+		}
+	}
+	w->chain.index = next;
+	w->s = back;
+}
+
+static void window_chain_flip(struct window_t * w)
+{
+	int i;
+
+	framebuffer_flip_surface(w->wm->fb, w->s, w->rl, 1);
+	for(i = 0; i < w->chain.count; i++)
+	{
+		if(i == w->chain.index)
+			region_list_clear(w->chain.damage[i]);
+		else
+			region_list_merge(w->chain.damage[i], w->rl);
+	}
+}
+
 struct window_t * window_alloc(const char * fb, const char * input, void * data)
 {
 	struct window_manager_t * wm = window_manager_alloc(fb);
@@ -214,10 +326,13 @@ struct window_t * window_alloc(const char * fb, const char * input, void * data)
 		return NULL;
 
 	w->wm = wm;
-	w->s = framebuffer_create_surface(w->wm->fb);
+	window_chain_alloc(w);
 	w->rl = region_list_alloc(0);
 	w->event = fifo_alloc(sizeof(struct event_t) * CONFIG_EVENT_FIFO_SIZE);
 	w->launcher = 0;
+	w->background.type = WINDOW_BACKGROUND_CHECKERBOARD;
+	color_init(&w->background.color, 0, 0, 0, 255);
+	w->background.opaque = 0;
 	w->priv = data;
 	if(p)
 	{
@@ -269,11 +384,11 @@ void window_free(struct window_t * w)
 	w->wm->wcount--;
 	w->wm->refresh = 1;
 	spin_unlock(&w->wm->lock);
+	window_chain_free(w);
 	if(w->wm->wcount <= 0)
 		window_manager_free(w->wm);
 	fifo_free(w->event);
 	hmap_free(w->map);
-	framebuffer_destroy_surface(w->wm->fb, w->s);
 	region_list_free(w->rl);
 	free(w);
 }
@@ -318,43 +433,34 @@ void window_region_list_clear(struct window_t * w)
 		region_list_clear(w->rl);
 }
 
-void window_present(struct window_t * w, void * o, void (*draw)(struct window_t *, void *))
+static void window_fill_background(struct window_t * w)
 {
 	struct surface_t * s = w->s;
-	struct region_t * r, region;
-	struct matrix_t m;
+	struct region_t * r;
 	uint32_t * p, * q;
 	int x1, y1, x2, y2;
 	int l, x, y;
-	int n, i;
+	int i;
 
-	if(w->wm->refresh)
-	{
-		region_init(&region, 0, 0, framebuffer_get_width(w->wm->fb), framebuffer_get_height(w->wm->fb));
-		region_list_clear(w->rl);
-		region_list_add(w->rl, &region);
-		w->wm->refresh = 0;
-		w->wm->cursor.dirty = 0;
-	}
-	else if(w->wm->cursor.show && w->wm->cursor.dirty)
-	{
-		r = &w->wm->cursor.ro;
-		window_region_list_add(w, &(struct region_t){ r->x - 2, r->y - 2, r->w, r->h });
-		r = &w->wm->cursor.rn;
-		window_region_list_add(w, &(struct region_t){ r->x - 2, r->y - 2, r->w, r->h });
-		w->wm->cursor.dirty = 0;
-	}
-	if((n = w->rl->count) > 0)
+	switch(w->background.type)
 	{
+	case WINDOW_BACKGROUND_SOLID:
+		for(i = 0; i < w->rl->count; i++)
+		{
+			r = &w->rl->region[i];
+			surface_clear(s, &w->background.color, r->x, r->y, r->w, r->h);
+		}
+		break;
+	case WINDOW_BACKGROUND_CHECKERBOARD:
 		l = s->stride >> 2;
-		for(i = 0; i < n; i++)
+		for(i = 0; i < w->rl->count; i++)
 		{
 			r = &w->rl->region[i];
 			x1 = r->x;
 			y1 = r->y;
 			x2 = r->x + r->w;
 			y2 = r->y + r->h;
-			q = (uint32_t *)s->pixels + y1 * l + x1;
+			q = (uint32_t *)surface_get_pixels(s) + y1 * l + x1;
 			for(y = y1; y < y2; y++, q += l)
 			{
 				for(x = x1, p = q; x < x2; x++, p++)
@@ -366,16 +472,68 @@ void window_present(struct window_t * w, void * o, void (*draw)(struct window_t
 				}
 			}
 		}
+		break;
+	default:
+		break;
+	}
+}
+
+void window_present(struct window_t * w, void * o, void (*draw)(struct window_t *, void *))
+{
+	struct region_t * r, region;
+	struct matrix_t m;
+	struct profiler_mark_t mark;
+	int probe = profiler_probe("window-present");
+
+	profiler_begin(probe, &mark);
+	if(w->wm->refresh)
+	{
+		region_init(&region, 0, 0, framebuffer_get_width(w->wm->fb), framebuffer_get_height(w->wm->fb));
+		region_list_clear(w->rl);
+		region_list_add(w->rl, &region);
+		w->wm->refresh = 0;
+		w->wm->cursor.dirty = 0;
+	}
+	else if(w->wm->cursor.show && w->wm->cursor.dirty)
+	{
+		r = &w->wm->cursor.ro;
+		window_region_list_add(w, &(struct region_t){ r->x - 2, r->y - 2, r->w, r->h });
+		r = &w->wm->cursor.rn;
+		window_region_list_add(w, &(struct region_t){ r->x - 2, r->y - 2, r->w, r->h });
+		w->wm->cursor.dirty = 0;
+	}
+	if(w->rl->count > 0)
+	{
+		if(w->chain.count > 0)
+			window_chain_acquire(w);
+		if(!w->background.opaque)
+			window_fill_background(w);
 		if(draw)
+		{
+			struct profiler_mark_t dmark;
+			int probe = profiler_probe("window-draw");
+			profiler_begin(probe, &dmark);
 			draw(w, o);
+			profiler_end(probe, &dmark);
+		}
 		if(w->wm->cursor.show)
 		{
 			r = &w->wm->cursor.rn;
 			matrix_init_translate(&m, r->x - 2, r->y - 2);
-			surface_blit(s, NULL, &m, w->wm->cursor.s, RENDER_TYPE_FAST);
+			surface_blit(w->s, NULL, &m, w->wm->cursor.s, RENDER_TYPE_FAST);
+		}
+		if(w->chain.count > 0)
+		{
+			surface_flush(w->s);
+			window_chain_flip(w);
 		}
 	}
-	framebuffer_present_surface(w->wm->fb, w->s, w->rl);
+	if(w->chain.count == 0)
+	{
+		surface_flush(w->s);
+		framebuffer_present_surface(w->wm->fb, w->s, w->rl);
+	}
+	profiler_end(probe, &mark);
 }
 
 int window_pump_event(struct window_t * w, struct event_t * e)
@@ -0,0 +1,319 @@
+/*
+ * kernel/graphic/atlas.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xconfigs.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <list.h>
+#include <spinlock.h>
+#include <graphic/atlas.h>
+
+/*
+ * Glyph coverage is packed into a few square pages of 8-bits alpha, with
+ * a skyline of the top edge of the glyphs placed on each page, so a glyph
+ * goes to the lowest spot it fits and the waste is only under the skyline.
+ * Pages are kept in least recently used order, and once there are as many
+ * as the budget allows, the oldest page not pinned by a drawing is emptied
+ * and packed again from the bottom.
+ */
+#define ATLAS_HASH_SIZE			(512)
+#define ATLAS_PAGE_SIZE			(CONFIG_ATLAS_PAGE_SIZE)
+#define ATLAS_PAGE_COUNT		(CONFIG_ATLAS_PAGE_COUNT)
+
+struct atlas_skyline_t {
+	int x, y;
+	int w;
+};
+
+struct atlas_page_t {
+	struct list_head entry;
+	struct list_head glyphs;
+	int ref;
+	int nodes;
+	struct atlas_skyline_t * skyline;
+	unsigned char * pixels;
+};
+
+struct atlas_entry_t {
+	struct hlist_node node;
+	struct list_head entry;
+	uint32_t serial;
+	uint32_t face;
+	int size;
+	uint32_t index;
+	struct atlas_glyph_t glyph;
+};
+
+static struct hlist_head __atlas_hash[ATLAS_HASH_SIZE];
+static LIST_HEAD(__atlas_pages);
+static int __atlas_npages = 0;
+static struct cache_stat_t __atlas_stat = {
+	.budget = ATLAS_PAGE_COUNT * ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE,
+};
+static spinlock_t __atlas_lock = SPIN_LOCK_INIT();
+
+static inline uint32_t atlas_hash(uint32_t serial, uint32_t face, int size, uint32_t index)
+{
+	return (serial * 31 + face + size * 131 + index * 7) % ATLAS_HASH_SIZE;
+}
+
+static void atlas_page_reset(struct atlas_page_t * page)
+{
+	struct atlas_entry_t * pos, * n;
+
+	list_for_each_entry_safe(pos, n, &page->glyphs, entry)
+	{
+		hlist_del(&pos->node);
+		list_del(&pos->entry);
+		__atlas_stat.count--;
+		free(pos);
+	}
+	page->nodes = 1;
+	page->skyline[0].x = 0;
+	page->skyline[0].y = 0;
+	page->skyline[0].w = ATLAS_PAGE_SIZE;
+}
+
+static int atlas_skyline_fit(struct atlas_page_t * page, int i, int w, int h, int * y)
+{
+	struct atlas_skyline_t * sky = page->skyline;
+	int l = w;
+
+	if(sky[i].x + w > ATLAS_PAGE_SIZE)
+		return 0;
+	*y = sky[i].y;
+	while(l > 0)
+	{
+		if(i >= page->nodes)
+			return 0;
+		if(sky[i].y > *y)
+			*y = sky[i].y;
+		if(*y + h > ATLAS_PAGE_SIZE)
+			return 0;
+		l -= sky[i].w;
+		i++;
+	}
+	return 1;
+}
+
+static int atlas_skyline_pack(struct atlas_page_t * page, int w, int h, int * x, int * y)
+{
+	struct atlas_skyline_t * sky = page->skyline;
+	int bi = -1, bh = ATLAS_PAGE_SIZE + 1, bw = ATLAS_PAGE_SIZE + 1;
+	int i, t, by = 0;
+
+	if((w == 0) || (h == 0))
+	{
+		*x = 0;
+		*y = 0;
+		return 1;
+	}
+	for(i = 0; i < page->nodes; i++)
+	{
+		if(atlas_skyline_fit(page, i, w, h, &t))
+		{
+			if((t + h < bh) || ((t + h == bh) && (sky[i].w < bw)))
+			{
+				bi = i;
+				by = t;
+				bh = t + h;
+				bw = sky[i].w;
+			}
+		}
+	}
+	if(bi < 0)
+		return 0;
+	*x = sky[bi].x;
+	*y = by;
+
+	memmove(&sky[bi + 1], &sky[bi], (page->nodes - bi) * sizeof(struct atlas_skyline_t));
+	sky[bi].y = by + h;
+	sky[bi].w = w;
+	page->nodes++;
+	for(i = bi + 1; i < page->nodes; i++)
+	{
+		t = sky[i - 1].x + sky[i - 1].w - sky[i].x;
+		if(t <= 0)
+			break;
+		sky[i].x += t;
+		sky[i].w -= t;
+		if(sky[i].w > 0)
+			break;
+		memmove(&sky[i], &sky[i + 1], (page->nodes - i - 1) * sizeof(struct atlas_skyline_t));
+		page->nodes--;
+		i--;
+	}
+	for(i = 0; i < page->nodes - 1; i++)
+	{
+		if(sky[i].y == sky[i + 1].y)
+		{
+			sky[i].w += sky[i + 1].w;
+			memmove(&sky[i + 1], &sky[i + 2], (page->nodes - i - 2) * sizeof(struct atlas_skyline_t));
+			page->nodes--;
+			i--;
+		}
+	}
+	return 1;
+}
+
+static struct atlas_page_t * atlas_page_alloc(void)
+{
+	struct atlas_page_t * page;
+
+	page = malloc(sizeof(struct atlas_page_t) + (ATLAS_PAGE_SIZE + 1) * sizeof(struct atlas_skyline_t) + ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE);
+	if(!page)
+		return NULL;
+	init_list_head(&page->entry);
+	init_list_head(&page->glyphs);
+	page->ref = 0;
+	page->skyline = (struct atlas_skyline_t *)(page + 1);
+	page->pixels = (unsigned char *)(page->skyline + ATLAS_PAGE_SIZE + 1);
+	atlas_page_reset(page);
+	return page;
+}
+
+int atlas_lookup(uint32_t serial, uint32_t face, int size, uint32_t index, struct atlas_glyph_t * g)
+{
+	struct atlas_entry_t * e;
+
+	spin_lock(&__atlas_lock);
+	hlist_for_each_entry(e, &__atlas_hash[atlas_hash(serial, face, size, index)], node)
+	{
+		if((e->index == index) && (e->face == face) && (e->size == size) && (e->serial == serial))
+		{
+			list_move(&e->glyph.page->entry, &__atlas_pages);
+			e->glyph.page->ref++;
+			memcpy(g, &e->glyph, sizeof(struct atlas_glyph_t));
+			__atlas_stat.hit++;
+			spin_unlock(&__atlas_lock);
+			return 1;
+		}
+	}
+	__atlas_stat.miss++;
+	spin_unlock(&__atlas_lock);
+	return 0;
+}
+
+int atlas_insert(uint32_t serial, uint32_t face, int size, uint32_t index, int left, int top, int width, int height, int pitch, unsigned char * buffer, struct atlas_glyph_t * g)
+{
+	struct atlas_page_t * page, * pos, * fresh = NULL;
+	struct atlas_entry_t * e;
+	int x = 0, y = 0;
+	int i;
+
+	if((width < 0) || (height < 0) || (width > ATLAS_PAGE_SIZE) || (height > ATLAS_PAGE_SIZE))
+		return 0;
+	e = malloc(sizeof(struct atlas_entry_t));
+	if(!e)
+		return 0;
+	if(__atlas_npages < ATLAS_PAGE_COUNT)
+		fresh = atlas_page_alloc();
+
+	spin_lock(&__atlas_lock);
+	page = NULL;
+	list_for_each_entry(pos, &__atlas_pages, entry)
+	{
+		if(atlas_skyline_pack(pos, width, height, &x, &y))
+		{
+			page = pos;
+			break;
+		}
+	}
+	if(!page && fresh && (__atlas_npages < ATLAS_PAGE_COUNT))
+	{
+		page = fresh;
+		fresh = NULL;
+		list_add(&page->entry, &__atlas_pages);
+		__atlas_npages++;
+		__atlas_stat.bytes += ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE;
+		atlas_skyline_pack(page, width, height, &x, &y);
+	}
+	if(!page)
+	{
+		list_for_each_entry_reverse(pos, &__atlas_pages, entry)
+		{
+			if(pos->ref == 0)
+			{
+				atlas_page_reset(pos);
+				__atlas_stat.evict++;
+				atlas_skyline_pack(pos, width, height, &x, &y);
+				page = pos;
+				break;
+			}
+		}
+	}
+	if(!page)
+	{
+		spin_unlock(&__atlas_lock);
+		if(fresh)
+			free(fresh);
+		free(e);
+		return 0;
+	}
+	for(i = 0; i < height; i++)
+		memcpy(&page->pixels[(y + i) * ATLAS_PAGE_SIZE + x], &buffer[i * pitch], width);
+	e->serial = serial;
+	e->face = face;
+	e->size = size;
+	e->index = index;
+	e->glyph.left = left;
+	e->glyph.top = top;
+	e->glyph.width = width;
+	e->glyph.height = height;
+	e->glyph.pitch = ATLAS_PAGE_SIZE;
+	e->glyph.buffer = &page->pixels[y * ATLAS_PAGE_SIZE + x];
+	e->glyph.page = page;
+	hlist_add_head(&e->node, &__atlas_hash[atlas_hash(serial, face, size, index)]);
+	list_add(&e->entry, &page->glyphs);
+	list_move(&page->entry, &__atlas_pages);
+	page->ref++;
+	memcpy(g, &e->glyph, sizeof(struct atlas_glyph_t));
+	__atlas_stat.count++;
+	spin_unlock(&__atlas_lock);
+	if(fresh)
+		free(fresh);
+	return 1;
+}
+
+void atlas_release(struct atlas_glyph_t * g)
+{
+	if(g->page)
+	{
+		spin_lock(&__atlas_lock);
+		g->page->ref--;
+		spin_unlock(&__atlas_lock);
+	}
+}
+
+void atlas_stat(struct cache_stat_t * stat)
+{
+	spin_lock(&__atlas_lock);
+	memcpy(stat, &__atlas_stat, sizeof(struct cache_stat_t));
+	spin_unlock(&__atlas_lock);
+}
@@ -26,10 +26,14 @@
  *
  */
 
+#include <xconfigs.h>
 #include <ctype.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sizes.h>
+#include <shash.h>
+#include <spinlock.h>
 #include <charset.h>
 #include <graphic/font.h>
 #include <ft2build.h>
@@ -38,11 +42,38 @@
 
 struct font_t {
 	struct list_head list;
+	uint32_t id;
 	struct xfs_context_t * xfs;
 	char * family;
 	char * path;
 };
 
+/*
+ * Glyphs drawn through a matrix are kept rendered, keyed by the family
+ * name, size and code that pick the glyph, the matrix rounded to 1/4096 and the
+ * pen rounded to a quarter of a pixel, least recently used first out once
+ * a context holds more than its byte budget.
+ */
+#define FONT_GLYPH_HASH_SIZE	(256)
+#define FONT_GLYPH_BUDGET		(CONFIG_FONT_GLYPH_CACHE_SIZE)
+
+struct font_glyph_entry_t {
+	struct hlist_node node;
+	struct list_head entry;
+	uint32_t hash;
+	char * family;
+	int size;
+	uint32_t code;
+	FT_Fixed xx, xy, yx, yy;
+	int fx, fy;
+	int bytes;
+	struct font_glyph_t glyph;
+};
+
+static LIST_HEAD(__font_context_list);
+static uint32_t __font_context_serial = 0;
+static spinlock_t __font_context_lock = SPIN_LOCK_INIT();
+
 static unsigned long ft_xfs_stream_io(FT_Stream stream, unsigned long offset, unsigned char * buffer, unsigned long count)
 {
 	struct xfs_file_t * file = ((struct xfs_file_t *)stream->descriptor.pointer);
@@ -142,13 +173,10 @@ static FT_Error ftcface_requester(FTC_FaceID id, FT_Library lib, FT_Pointer data
 {
 	struct font_context_t * ctx = (struct font_context_t *)data;
 	struct font_t * pos, * n;
-	const char * p;
-	uint32_t v;
 
 	list_for_each_entry_safe(pos, n, &ctx->list, list)
 	{
-		p = pos->family;
-		if(family_hash(&p, &v) && (v == (uint32_t)(unsigned long)id))
+		if(pos->id == (uint32_t)(unsigned long)id)
 		{
 			if(pos->xfs)
 			{
@@ -178,6 +206,15 @@ struct font_context_t * font_context_alloc(void)
 	ctx = malloc(sizeof(struct font_context_t));
 	if(!ctx)
 		return NULL;
+	ctx->glyph_hash = calloc(FONT_GLYPH_HASH_SIZE, sizeof(struct hlist_head));
+	if(!ctx->glyph_hash)
+	{
+		free(ctx);
+		return NULL;
+	}
+	init_list_head(&ctx->glyph_lru);
+	memset(&ctx->glyph_stat, 0, sizeof(struct cache_stat_t));
+	ctx->glyph_stat.budget = FONT_GLYPH_BUDGET;
 	FT_Init_FreeType((FT_Library *)&ctx->library);
 	FTC_Manager_New((FT_Library)ctx->library, 0, 0, 0, ftcface_requester, ctx, (FTC_Manager *)&ctx->manager);
 	FTC_CMapCache_New((FTC_Manager)ctx->manager, (FTC_CMapCache *)&ctx->cmap);
@@ -189,16 +226,27 @@ struct font_context_t * font_context_alloc(void)
 	font_add(ctx, NULL, "roboto-bold", "/framework/assets/fonts/Roboto-Bold.ttf");
 	font_add(ctx, NULL, "roboto-bold-italic", "/framework/assets/fonts/Roboto-BoldItalic.ttf");
 	font_add(ctx, NULL, "font-awesome", "/framework/assets/fonts/FontAwesome.ttf");
+	spin_lock(&__font_context_lock);
+	ctx->serial = ++__font_context_serial;
+	list_add_tail(&ctx->entry, &__font_context_list);
+	spin_unlock(&__font_context_lock);
 
 	return ctx;
 }
 
 void font_context_free(struct font_context_t * ctx)
 {
+	struct font_glyph_entry_t * g, * t;
 	struct font_t * pos, * n;
 
 	if(ctx)
 	{
+		spin_lock(&__font_context_lock);
+		list_del(&ctx->entry);
+		spin_unlock(&__font_context_lock);
+		list_for_each_entry_safe(g, t, &ctx->glyph_lru, entry)
+			free(g);
+		free(ctx->glyph_hash);
 		list_for_each_entry_safe(pos, n, &ctx->list, list)
 		{
 			if(pos->family)
@@ -213,57 +261,88 @@ void font_context_free(struct font_context_t * ctx)
 	}
 }
 
-void * font_lookup_bitmap(struct font_context_t * ctx, const char * family, int size, uint32_t code)
+static inline FTC_SBit font_lookup_sbit(struct font_context_t * ctx, uint32_t face, int size, uint32_t code, uint32_t * index)
 {
-	struct font_t * pos, * n;
 	FTC_ScalerRec scaler;
 	FTC_SBit sbit;
-	FT_UInt index;
-	const char * p;
-	uint32_t v;
+	FT_UInt idx;
 
+	scaler.face_id = (FTC_FaceID)((unsigned long)face);
 	scaler.width = size;
 	scaler.height = size;
 	scaler.pixel = 1;
 	scaler.x_res = 0;
 	scaler.y_res = 0;
+	if((idx = FTC_CMapCache_Lookup((FTC_CMapCache)ctx->cmap, scaler.face_id, -1, code)) != 0)
+	{
+		if(FTC_SBitCache_LookupScaler((FTC_SBitCache)ctx->sbit, &scaler, FT_LOAD_RENDER, idx, &sbit, NULL) == 0)
+		{
+			*index = idx;
+			return sbit;
+		}
+	}
+	return NULL;
+}
+
+void * font_lookup_bitmap_index(struct font_context_t * ctx, const char * family, int size, uint32_t code, uint32_t * face, uint32_t * index)
+{
+	struct font_t * pos, * n;
+	FTC_SBit sbit;
+	const char * p;
+	uint32_t v;
 
 	p = family ? family : "roboto";
 	while(family_hash(&p, &v))
 	{
-		scaler.face_id = (FTC_FaceID)((unsigned long)v);
-		if((index = FTC_CMapCache_Lookup((FTC_CMapCache)ctx->cmap, scaler.face_id, -1, code)) != 0)
+		if((sbit = font_lookup_sbit(ctx, v, size, code, index)))
 		{
-			if(FTC_SBitCache_LookupScaler((FTC_SBitCache)ctx->sbit, &scaler, FT_LOAD_RENDER, index, &sbit, NULL) == 0)
-				return (void *)sbit;
+			*face = v;
+			return (void *)sbit;
 		}
 	}
 	list_for_each_entry_safe(pos, n, &ctx->list, list)
 	{
-		p = pos->family;
-		if(family_hash(&p, &v))
+		if((sbit = font_lookup_sbit(ctx, pos->id, size, code, index)))
 		{
-			scaler.face_id = (FTC_FaceID)((unsigned long)v);
-			if((index = FTC_CMapCache_Lookup((FTC_CMapCache)ctx->cmap, scaler.face_id, -1, code)) != 0)
-			{
-				if(FTC_SBitCache_LookupScaler((FTC_SBitCache)ctx->sbit, &scaler, FT_LOAD_RENDER, index, &sbit, NULL) == 0)
-					return (void *)sbit;
-			}
+			*face = pos->id;
+			return (void *)sbit;
 		}
 	}
 	p = "roboto";
 	if(family_hash(&p, &v))
 	{
-		scaler.face_id = (FTC_FaceID)((unsigned long)v);
-		if((index = FTC_CMapCache_Lookup((FTC_CMapCache)ctx->cmap, scaler.face_id, -1, 0xfffd)) != 0)
+		if((sbit = font_lookup_sbit(ctx, v, size, 0xfffd, index)))
 		{
-			if(FTC_SBitCache_LookupScaler((FTC_SBitCache)ctx->sbit, &scaler, FT_LOAD_RENDER, index, &sbit, NULL) == 0)
-				return (void *)sbit;
+			*face = v;
+			return (void *)sbit;
 		}
 	}
 	return NULL;
 }
 
+void * font_lookup_bitmap(struct font_context_t * ctx, const char * family, int size, uint32_t code)
+{
+	uint32_t face, index;
+
+	return font_lookup_bitmap_index(ctx, family, size, code, &face, &index);
+}
+
+void * font_index_bitmap(struct font_context_t * ctx, uint32_t face, int size, uint32_t index)
+{
+	FTC_ScalerRec scaler;
+	FTC_SBit sbit;
+
+	scaler.face_id = (FTC_FaceID)((unsigned long)face);
+	scaler.width = size;
+	scaler.height = size;
+	scaler.pixel = 1;
+	scaler.x_res = 0;
+	scaler.y_res = 0;
+	if(FTC_SBitCache_LookupScaler((FTC_SBitCache)ctx->sbit, &scaler, FT_LOAD_RENDER, index, &sbit, NULL) == 0)
+		return (void *)sbit;
+	return NULL;
+}
+
 void * font_lookup_glyph(struct font_context_t * ctx, const char * family, int size, uint32_t code)
 {
 	struct font_t * pos, * n;
@@ -291,15 +370,11 @@ void * font_lookup_glyph(struct font_context_t * ctx, const char * family, int s
 	}
 	list_for_each_entry_safe(pos, n, &ctx->list, list)
 	{
-		p = pos->family;
-		if(family_hash(&p, &v))
+		scaler.face_id = (FTC_FaceID)((unsigned long)pos->id);
+		if((index = FTC_CMapCache_Lookup((FTC_CMapCache)ctx->cmap, scaler.face_id, -1, code)) != 0)
 		{
-			scaler.face_id = (FTC_FaceID)((unsigned long)v);
-			if((index = FTC_CMapCache_Lookup((FTC_CMapCache)ctx->cmap, scaler.face_id, -1, code)) != 0)
-			{
-				if(FTC_ImageCache_LookupScaler((FTC_ImageCache)ctx->image, &scaler, FT_LOAD_DEFAULT, index, &glyph, NULL) == 0)
-					return (void *)glyph;
-			}
+			if(FTC_ImageCache_LookupScaler((FTC_ImageCache)ctx->image, &scaler, FT_LOAD_DEFAULT, index, &glyph, NULL) == 0)
+				return (void *)glyph;
 		}
 	}
 	p = "roboto";
@@ -315,15 +390,135 @@ void * font_lookup_glyph(struct font_context_t * ctx, const char * family, int s
 	return NULL;
 }
 
+static inline FT_Fixed font_glyph_fixed(double v)
+{
+	return ((FT_Fixed)(v * 65536) + 8) & ~15;
+}
+
+struct font_glyph_t * font_lookup_transformed_glyph(struct font_context_t * ctx, const char * family, int size, uint32_t code, struct matrix_t * m, int fx, int fy)
+{
+	struct font_glyph_entry_t * e, * o;
+	struct hlist_head * head;
+	FT_BitmapGlyph bitmap;
+	FT_Glyph glyph, gly;
+	FT_Matrix matrix;
+	FT_Vector pen;
+	const char * p;
+	uint32_t v, h;
+	int i, l;
+
+	p = family ? family : "roboto";
+	v = shash(p);
+	matrix.xx = font_glyph_fixed(m->a);
+	matrix.xy = -font_glyph_fixed(m->c);
+	matrix.yx = -font_glyph_fixed(m->b);
+	matrix.yy = font_glyph_fixed(m->d);
+	fx &= 0x30;
+	fy &= 0x30;
+	h = v + size * 31 + code * 131 + (uint32_t)matrix.xx + (uint32_t)matrix.xy * 3 + fx + fy * 7;
+	head = &ctx->glyph_hash[h % FONT_GLYPH_HASH_SIZE];
+	hlist_for_each_entry(e, head, node)
+	{
+		if((e->code == code) && (e->size == size) && (e->hash == v) && (e->fx == fx) && (e->fy == fy)
+			&& (e->xx == matrix.xx) && (e->xy == matrix.xy) && (e->yx == matrix.yx) && (e->yy == matrix.yy) && (strcmp(e->family, p) == 0))
+		{
+			list_move(&e->entry, &ctx->glyph_lru);
+			ctx->glyph_stat.hit++;
+			return &e->glyph;
+		}
+	}
+	ctx->glyph_stat.miss++;
+	glyph = (FT_Glyph)font_lookup_glyph(ctx, family, size, code);
+	if(!glyph || (FT_Glyph_Copy(glyph, &gly) != 0))
+		return NULL;
+	pen.x = fx;
+	pen.y = fy;
+	FT_Glyph_Transform(gly, &matrix, &pen);
+	if(FT_Glyph_To_Bitmap(&gly, FT_RENDER_MODE_NORMAL, NULL, 1) != 0)
+	{
+		FT_Done_Glyph(gly);
+		return NULL;
+	}
+	bitmap = (FT_BitmapGlyph)gly;
+	l = bitmap->bitmap.width * bitmap->bitmap.rows;
+	e = malloc(sizeof(struct font_glyph_entry_t) + l + strlen(p) + 1);
+	if(!e)
+	{
+		FT_Done_Glyph(gly);
+		return NULL;
+	}
+	e->hash = v;
+	e->family = (char *)(e + 1) + l;
+	strcpy(e->family, p);
+	e->size = size;
+	e->code = code;
+	e->xx = matrix.xx;
+	e->xy = matrix.xy;
+	e->yx = matrix.yx;
+	e->yy = matrix.yy;
+	e->fx = fx;
+	e->fy = fy;
+	e->bytes = sizeof(struct font_glyph_entry_t) + l + strlen(p) + 1;
+	e->glyph.left = bitmap->left;
+	e->glyph.top = bitmap->top;
+	e->glyph.width = bitmap->bitmap.width;
+	e->glyph.height = bitmap->bitmap.rows;
+	e->glyph.pitch = bitmap->bitmap.width;
+	e->glyph.advance = glyph->advance.x >> 16;
+	e->glyph.ax = bitmap->root.advance.x >> 10;
+	e->glyph.ay = bitmap->root.advance.y >> 10;
+	e->glyph.buffer = (unsigned char *)(e + 1);
+	for(i = 0; i < e->glyph.height; i++)
+		memcpy(&e->glyph.buffer[i * e->glyph.pitch], &bitmap->bitmap.buffer[i * bitmap->bitmap.pitch], e->glyph.width);
+	FT_Done_Glyph(gly);
+
+	while((ctx->glyph_stat.bytes + e->bytes > FONT_GLYPH_BUDGET) && !list_empty(&ctx->glyph_lru))
+	{
+		o = list_last_entry(&ctx->glyph_lru, struct font_glyph_entry_t, entry);
+		list_del(&o->entry);
+		hlist_del(&o->node);
+		ctx->glyph_stat.bytes -= o->bytes;
+		ctx->glyph_stat.count--;
+		ctx->glyph_stat.evict++;
+		free(o);
+	}
+	hlist_add_head(&e->node, head);
+	list_add(&e->entry, &ctx->glyph_lru);
+	ctx->glyph_stat.bytes += e->bytes;
+	ctx->glyph_stat.count++;
+	return &e->glyph;
+}
+
+void font_cache_stat(struct cache_stat_t * stat)
+{
+	struct font_context_t * pos;
+
+	memset(stat, 0, sizeof(struct cache_stat_t));
+	spin_lock(&__font_context_lock);
+	list_for_each_entry(pos, &__font_context_list, entry)
+	{
+		stat->bytes += pos->glyph_stat.bytes;
+		stat->budget += pos->glyph_stat.budget;
+		stat->count += pos->glyph_stat.count;
+		stat->hit += pos->glyph_stat.hit;
+		stat->miss += pos->glyph_stat.miss;
+		stat->evict += pos->glyph_stat.evict;
+	}
+	spin_unlock(&__font_context_lock);
+}
+
 void font_add(struct font_context_t * ctx, struct xfs_context_t * xfs, const char * family, const char * path)
 {
 	struct font_t * f;
+	const char * p = family;
+	uint32_t v;
 
-	if(ctx && family && path)
+	if(ctx && family && path && family_hash(&p, &v))
 	{
 		f = malloc(sizeof(struct font_t));
 		if(f)
 		{
+			f->id = v;
 			f->xfs = xfs;
 			f->family = strdup(family);
 			f->path = strdup(path);
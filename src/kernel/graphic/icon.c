@@ -137,7 +137,7 @@ static inline void draw_font_bitmap(struct surface_t * s, struct region_t * clip
 	sy = r.y - y;
 	dskip = s->width - dw;
 	sskip = sbit->pitch - dw;
-	dp = (uint32_t *)s->pixels + dy * s->width + dx;
+	dp = (uint32_t *)surface_get_pixels(s) + dy * s->width + dx;
 	sp = (uint8_t *)sbit->buffer + sy * sbit->pitch + sx;
 	color = color_get_premult(c);
 
@@ -179,7 +179,7 @@ static inline void draw_font_bitmap(struct surface_t * s, struct region_t * clip
 	}
 }
 
-static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip, struct color_t * c, int x, int y, FT_Bitmap * bitmap)
+static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip, struct color_t * c, int x, int y, struct font_glyph_t * g)
 {
 	struct region_t region, r;
 	uint32_t color;
@@ -199,7 +199,7 @@ static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip,
 		if(!region_intersect(&r, &r, clip))
 			return;
 	}
-	region_init(&region, x, y, bitmap->width, bitmap->rows);
+	region_init(&region, x, y, g->width, g->height);
 	if(!region_intersect(&r, &r, &region))
 		return;
 
@@ -210,9 +210,9 @@ static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip,
 	sx = r.x - x;
 	sy = r.y - y;
 	dskip = s->width - dw;
-	sskip = bitmap->pitch - dw;
-	dp = (uint32_t *)s->pixels + dy * s->width + dx;
-	sp = (uint8_t *)bitmap->buffer + sy * bitmap->pitch + sx;
+	sskip = g->pitch - dw;
+	dp = (uint32_t *)surface_get_pixels(s) + dy * s->width + dx;
+	sp = g->buffer + sy * g->pitch + sx;
 	color = (c->a << 24) | (c->r << 16) | (c->g << 8) | (c->b << 0);
 
 	for(j = 0; j < dh; j++)
@@ -255,10 +255,8 @@ static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip,
 
 void render_default_icon(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct icon_t * ico)
 {
+	struct font_glyph_t * g;
 	FTC_SBit sbit;
-	FT_BitmapGlyph bitmap;
-	FT_Glyph glyph, gly;
-	FT_Matrix matrix;
 	FT_Vector pen;
 	int tx, ty;
 
@@ -274,27 +272,12 @@ void render_default_icon(struct surface_t * s, struct region_t * clip, struct ma
 	}
 	else
 	{
-		glyph = (FT_Glyph)font_lookup_glyph(ico->fctx, ico->family, ico->size * 618 / 1000, ico->code);
-		if(glyph)
-		{
-			if(FT_Glyph_Copy(glyph, &gly) == 0)
-			{
-				matrix.xx = (FT_Fixed)(m->a * 65536);
-				matrix.xy = -((FT_Fixed)(m->c * 65536));
-				matrix.yx = -((FT_Fixed)(m->b * 65536));
-				matrix.yy = (FT_Fixed)(m->d * 65536);
-				tx = ico->metrics.ox + (ico->size - ico->metrics.width) / 2;
-				ty = ico->metrics.oy + (ico->size - ico->metrics.height) / 2;
-				pen.x = (FT_Pos)((m->tx + m->a * tx + m->c * ty) * 64);
-				pen.y = (FT_Pos)((s->height - (m->ty + m->b * tx + m->d * ty)) * 64);
-				FT_Glyph_Transform(gly, &matrix, &pen);
-				FT_Glyph_To_Bitmap(&gly, FT_RENDER_MODE_NORMAL, NULL, 1);
-				bitmap = (FT_BitmapGlyph)gly;
-				draw_font_glyph(s, clip, ico->c, bitmap->left, s->height - bitmap->top, &bitmap->bitmap);
-				pen.x += bitmap->root.advance.x >> 10;
-				pen.y += bitmap->root.advance.y >> 10;
-				FT_Done_Glyph(gly);
-			}
-		}
+		tx = ico->metrics.ox + (ico->size - ico->metrics.width) / 2;
+		ty = ico->metrics.oy + (ico->size - ico->metrics.height) / 2;
+		pen.x = (FT_Pos)((m->tx + m->a * tx + m->c * ty) * 64);
+		pen.y = (FT_Pos)((s->height - (m->ty + m->b * tx + m->d * ty)) * 64);
+		g = font_lookup_transformed_glyph(ico->fctx, ico->family, ico->size * 618 / 1000, ico->code, m, pen.x & 0x3f, pen.y & 0x3f);
+		if(g)
+			draw_font_glyph(s, clip, ico->c, (pen.x >> 6) + g->left, s->height - ((pen.y >> 6) + g->top), g);
 	}
 }
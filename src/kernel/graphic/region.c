@@ -96,48 +96,419 @@ void region_list_clone(struct region_list_t * rl, struct region_list_t * o)
 	}
 }
 
-void region_list_merge(struct region_list_t * rl, struct region_list_t * o)
+/*
+ * The spans of one band of a and one band of b, combined by the operator
+ * into the band from y0 to y1 of the output, the spans of both bands are
+ * sorted by x and neither touch nor overlap.
+ */
+enum region_op_t {
+	REGION_OP_UNION		= 0,
+	REGION_OP_INTERSECT	= 1,
+	REGION_OP_SUBTRACT	= 2,
+};
+
+static inline void region_band_push(struct region_list_t * o, int x0, int x1, int y0, int y1)
 {
-	int count;
-	int i;
+	region_init(&o->region[o->count++], x0, y0, x1 - x0, y1 - y0);
+}
+
+static void region_band_union(struct region_list_t * o, struct region_t * a, int na, struct region_t * b, int nb, int y0, int y1)
+{
+	struct region_t * r;
+	int x0 = 0, x1 = 0, cur = 0;
 
-	if(rl && o && ((count = o->count) > 0))
+	while((na > 0) || (nb > 0))
 	{
-		for(i = 0; i < count; i++)
-			region_list_add(rl, &o->region[i]);
+		if((nb <= 0) || ((na > 0) && (a->x < b->x)))
+		{
+			r = a++;
+			na--;
+		}
+		else
+		{
+			r = b++;
+			nb--;
+		}
+		if(!cur)
+		{
+			x0 = r->x;
+			x1 = r->x + r->w;
+			cur = 1;
+		}
+		else if(r->x <= x1)
+		{
+			if(r->x + r->w > x1)
+				x1 = r->x + r->w;
+		}
+		else
+		{
+			region_band_push(o, x0, x1, y0, y1);
+			x0 = r->x;
+			x1 = r->x + r->w;
+		}
 	}
+	if(cur)
+		region_band_push(o, x0, x1, y0, y1);
 }
 
-void region_list_add(struct region_list_t * rl, struct region_t * r)
+static void region_band_intersect(struct region_list_t * o, struct region_t * a, int na, struct region_t * b, int nb, int y0, int y1)
 {
-	struct region_t * p;
-	int index = -1;
-	int i;
+	int x0, x1;
 
-	if(!rl || !r)
-		return;
+	while((na > 0) && (nb > 0))
+	{
+		x0 = max(a->x, b->x);
+		x1 = min(a->x + a->w, b->x + b->w);
+		if(x0 < x1)
+			region_band_push(o, x0, x1, y0, y1);
+		if(a->x + a->w < b->x + b->w)
+		{
+			a++;
+			na--;
+		}
+		else
+		{
+			b++;
+			nb--;
+		}
+	}
+}
 
-	for(i = 0; i < rl->count; i++)
+static void region_band_subtract(struct region_list_t * o, struct region_t * a, int na, struct region_t * b, int nb, int y0, int y1)
+{
+	int x0, x1, k;
+
+	for(; na > 0; a++, na--)
 	{
-		if(region_overlap(&rl->region[i], r))
+		x0 = a->x;
+		x1 = a->x + a->w;
+		while((nb > 0) && (b->x + b->w <= x0))
 		{
-			index = i;
-			break;
+			b++;
+			nb--;
+		}
+		for(k = 0; (k < nb) && (b[k].x < x1); k++)
+		{
+			if(b[k].x > x0)
+				region_band_push(o, x0, b[k].x, y0, y1);
+			if(b[k].x + b[k].w > x0)
+				x0 = b[k].x + b[k].w;
+			if(x0 >= x1)
+				break;
 		}
+		if(x0 < x1)
+			region_band_push(o, x0, x1, y0, y1);
 	}
+}
+
+static inline int region_band_end(struct region_list_t * rl, int i)
+{
+	int y = rl->region[i].y;
+
+	for(i++; (i < rl->count) && (rl->region[i].y == y); i++);
+	return i;
+}
+
+static inline int region_list_reserve(struct region_list_t * rl, unsigned int count)
+{
+	struct region_t * r;
+	unsigned int size = rl->size;
+
+	if(count <= size)
+		return 1;
+	while(size < count)
+		size <<= 1;
+	r = realloc(rl->region, size * sizeof(struct region_t));
+	if(!r)
+		return 0;
+	rl->region = r;
+	rl->size = size;
+	return 1;
+}
+
+/*
+ * The output of an operation starts out in a scratch array on the stack,
+ * and only moves to the heap once it outgrows that
+ */
+#define REGION_LIST_SCRATCH		(32)
+
+static inline int region_list_scratch_reserve(struct region_list_t * o, struct region_t * scratch, unsigned int count)
+{
+	struct region_t * r;
+
+	if(count <= o->size)
+		return 1;
+	if(o->region != scratch)
+		return region_list_reserve(o, count);
+	r = malloc(max(count, o->size << 1) * sizeof(struct region_t));
+	if(!r)
+		return 0;
+	memcpy(r, o->region, o->count * sizeof(struct region_t));
+	o->region = r;
+	o->size = max(count, o->size << 1);
+	return 1;
+}
+
+/*
+ * Without the memory for the exact union, the damage is kept whole as the
+ * bound of both regions, drawing more than needed but never less
+ */
+static void region_list_bound(struct region_list_t * rl, struct region_list_t * a, struct region_list_t * b)
+{
+	struct region_t ra, rb;
+
+	if(!region_list_extents(a, &ra))
+	{
+		if(!region_list_extents(b, &ra))
+			return;
+	}
+	else if(region_list_extents(b, &rb))
+		region_union(&ra, &ra, &rb);
+	if(region_list_reserve(rl, 1))
+	{
+		region_clone(&rl->region[0], &ra);
+		rl->count = 1;
+	}
+}
+
+/*
+ * Sweep down both regions, cutting them at every top and bottom of their
+ * bands, each piece of the output is the spans of a and b over it combined
+ * by the operator, and joins the band above when the spans are the same.
+ */
+static void region_list_op(struct region_list_t * rl, struct region_list_t * a, struct region_list_t * b, enum region_op_t op)
+{
+	struct region_t scratch[REGION_LIST_SCRATCH];
+	struct region_list_t o;
+	int na = a->count, nb = b->count;
+	int ia = 0, ib = 0, ea, eb;
+	int ay0 = 0, ay1 = 0, by0 = 0, by1 = 0;
+	int aon, bon;
+	int y, y1;
+	int ps = -1, pe = 0, start, k;
 
-	if(index >= 0)
+	o.region = scratch;
+	o.size = REGION_LIST_SCRATCH;
+	o.count = 0;
+
+	y = INT_MAX;
+	if(na > 0)
+		y = a->region[0].y;
+	if(nb > 0)
+		y = min(y, b->region[0].y);
+	while((ia < na) || (ib < nb))
 	{
-		p = &rl->region[index];
-		region_union(p, p, r);
+		if(ia < na)
+		{
+			ay0 = a->region[ia].y;
+			ay1 = ay0 + a->region[ia].h;
+			if(ay1 <= y)
+			{
+				ia = region_band_end(a, ia);
+				continue;
+			}
+		}
+		if(ib < nb)
+		{
+			by0 = b->region[ib].y;
+			by1 = by0 + b->region[ib].h;
+			if(by1 <= y)
+			{
+				ib = region_band_end(b, ib);
+				continue;
+			}
+		}
+		if((op == REGION_OP_INTERSECT) && ((ia >= na) || (ib >= nb)))
+			break;
+		if((op == REGION_OP_SUBTRACT) && (ia >= na))
+			break;
+		aon = (ia < na) && (ay0 <= y);
+		bon = (ib < nb) && (by0 <= y);
+		if(!aon && !bon)
+		{
+			y = min((ia < na) ? ay0 : INT_MAX, (ib < nb) ? by0 : INT_MAX);
+			continue;
+		}
+		y1 = INT_MAX;
+		if(ia < na)
+			y1 = min(y1, aon ? ay1 : ay0);
+		if(ib < nb)
+			y1 = min(y1, bon ? by1 : by0);
+		ea = aon ? region_band_end(a, ia) : ia;
+		eb = bon ? region_band_end(b, ib) : ib;
+		if(!region_list_scratch_reserve(&o, scratch, o.count + (ea - ia) + (eb - ib)))
+		{
+			if(o.region != scratch)
+				free(o.region);
+			if(op == REGION_OP_UNION)
+				region_list_bound(rl, a, b);
+			return;
+		}
+		start = o.count;
+		switch(op)
+		{
+		case REGION_OP_UNION:
+			region_band_union(&o, &a->region[ia], ea - ia, &b->region[ib], eb - ib, y, y1);
+			break;
+		case REGION_OP_INTERSECT:
+			region_band_intersect(&o, &a->region[ia], ea - ia, &b->region[ib], eb - ib, y, y1);
+			break;
+		case REGION_OP_SUBTRACT:
+			region_band_subtract(&o, &a->region[ia], ea - ia, &b->region[ib], eb - ib, y, y1);
+			break;
+		default:
+			break;
+		}
+		if(o.count > start)
+		{
+			if((ps >= 0) && (pe == start) && (o.region[ps].y + o.region[ps].h == y) && (start - ps == o.count - start))
+			{
+				for(k = 0; k < start - ps; k++)
+				{
+					if((o.region[ps + k].x != o.region[start + k].x) || (o.region[ps + k].w != o.region[start + k].w))
+						break;
+				}
+				if(k == start - ps)
+				{
+					for(k = ps; k < start; k++)
+						o.region[k].h += y1 - y;
+					o.count = start;
+				}
+				else
+					ps = start;
+			}
+			else
+				ps = start;
+			pe = o.count;
+		}
+		y = y1;
 	}
+	if(o.region != scratch)
+	{
+		free(rl->region);
+		rl->region = o.region;
+		rl->size = o.size;
+	}
+	else if(region_list_reserve(rl, o.count))
+		memcpy(rl->region, o.region, o.count * sizeof(struct region_t));
 	else
 	{
-		if(rl->size <= rl->count)
-			region_list_resize(rl, rl->size << 1);
+		if(op == REGION_OP_UNION)
+			region_list_bound(rl, a, b);
+		return;
+	}
+	rl->count = o.count;
+}
+
+void region_list_union(struct region_list_t * rl, struct region_list_t * a, struct region_list_t * b)
+{
+	if(rl && a && b)
+		region_list_op(rl, a, b, REGION_OP_UNION);
+}
+
+void region_list_intersect(struct region_list_t * rl, struct region_list_t * a, struct region_list_t * b)
+{
+	if(rl && a && b)
+		region_list_op(rl, a, b, REGION_OP_INTERSECT);
+}
+
+void region_list_subtract(struct region_list_t * rl, struct region_list_t * a, struct region_list_t * b)
+{
+	if(rl && a && b)
+		region_list_op(rl, a, b, REGION_OP_SUBTRACT);
+}
+
+void region_list_merge(struct region_list_t * rl, struct region_list_t * o)
+{
+	if(rl && o && (o->count > 0))
+		region_list_op(rl, rl, o, REGION_OP_UNION);
+}
+
+/*
+ * Damage mostly comes top down, or again where it already is. A rectangle
+ * below the last band is a band of its own, and grows the last band when
+ * it lines up with its only span, a rectangle inside one already there
+ * changes nothing, the others take the full union.
+ */
+void region_list_add(struct region_list_t * rl, struct region_t * r)
+{
+	struct region_list_t o = { .region = r, .size = 1, .count = 1 };
+	struct region_t * l;
+	int i;
+
+	if(!rl || !r || region_isempty(r))
+		return;
+	if(rl->count > 0)
+	{
+		l = &rl->region[rl->count - 1];
+		if(r->y >= l->y + l->h)
+		{
+			if((r->y == l->y + l->h) && (r->x == l->x) && (r->w == l->w) && ((rl->count == 1) || (l[-1].y != l->y)))
+			{
+				l->h += r->h;
+				return;
+			}
+		}
+		else
+		{
+			for(i = 0; i < rl->count; i++)
+			{
+				l = &rl->region[i];
+				if((r->x >= l->x) && (r->y >= l->y) && (r->x + r->w <= l->x + l->w) && (r->y + r->h <= l->y + l->h))
+					return;
+			}
+			region_list_op(rl, rl, &o, REGION_OP_UNION);
+			return;
+		}
+	}
+	if(region_list_reserve(rl, rl->count + 1))
+	{
 		region_clone(&rl->region[rl->count], r);
 		rl->count++;
 	}
+	else
+		region_list_bound(rl, rl, &o);
+}
+
+void region_list_clip(struct region_list_t * rl, struct region_t * r)
+{
+	struct region_list_t o = { .region = r, .size = 1, .count = 1 };
+
+	if(rl && r)
+	{
+		if(region_isempty(r))
+			rl->count = 0;
+		else if(rl->count > 0)
+			region_list_op(rl, rl, &o, REGION_OP_INTERSECT);
+	}
+}
+
+void region_list_cut(struct region_list_t * rl, struct region_t * r)
+{
+	struct region_list_t o = { .region = r, .size = 1, .count = 1 };
+
+	if(rl && r && !region_isempty(r) && (rl->count > 0))
+		region_list_op(rl, rl, &o, REGION_OP_SUBTRACT);
+}
+
+int region_list_extents(struct region_list_t * rl, struct region_t * r)
+{
+	int x0, x1, i;
+
+	if(!rl || (rl->count <= 0))
+	{
+		region_init(r, 0, 0, 0, 0);
+		return 0;
+	}
+	x0 = rl->region[0].x;
+	x1 = rl->region[0].x + rl->region[0].w;
+	for(i = 1; i < rl->count; i++)
+	{
+		x0 = min(x0, rl->region[i].x);
+		x1 = max(x1, rl->region[i].x + rl->region[i].w);
+	}
+	region_init(r, x0, rl->region[0].y, x1 - x0, rl->region[rl->count - 1].y + rl->region[rl->count - 1].h - rl->region[0].y);
+	return 1;
 }
 
 void region_list_clear(struct region_list_t * rl)
@@ -0,0 +1,906 @@
+/*
+ * kernel/graphic/render-tile.c
+ *
+ * Copyright(c) 2007-2020 Jianjun Jiang <8192542@qq.com>
+ * Official site: http://xboot.org
+ * Mobile phone: +86-18665388956
+ * QQ: 8192542
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <xboot.h>
+#include <xboot/mutex.h>
+#include <xboot/semaphore.h>
+#include <graphic/surface.h>
+
+/*
+ * The tiled render queues the draws made to a surface and plays them back
+ * when the pixels are wanted, one tile at a time, the tiles being shared out
+ * between the calling task and a worker task on each of the other cpus. Each
+ * draw is played through the default render with its clip cut down to the
+ * tile. A pixel of the default render does not depend on where the clip
+ * starts, so the result is the very same as drawing straight through the
+ * default render. Text, icons, svg rasters, the filters and a blit of a
+ * surface onto itself are not queued, they play back what is pending and
+ * then draw in place.
+ *
+ * The tiles are bands of rows as wide as the surface. The shapes are
+ * scanline rasterized, a shape builds its edges again for each tile it
+ * touches, and a band only repeats that for the rows it is cut into.
+ */
+#define RENDER_TILE_SIZE	(CONFIG_RENDER_TILE_SIZE)
+#define RENDER_TILE_QUEUE	(1024)
+
+enum render_tile_op_t {
+	RENDER_TILE_OP_BLIT,
+	RENDER_TILE_OP_FILL,
+	RENDER_TILE_OP_LINE,
+	RENDER_TILE_OP_POLYLINE,
+	RENDER_TILE_OP_CURVE,
+	RENDER_TILE_OP_TRIANGLE,
+	RENDER_TILE_OP_RECTANGLE,
+	RENDER_TILE_OP_POLYGON,
+	RENDER_TILE_OP_CIRCLE,
+	RENDER_TILE_OP_ELLIPSE,
+	RENDER_TILE_OP_ARC,
+	RENDER_TILE_OP_GRADIENT,
+	RENDER_TILE_OP_CHECKERBOARD,
+};
+
+struct render_tile_cmd_t {
+	enum render_tile_op_t op;
+	struct region_t clip;
+	struct matrix_t m;
+	struct surface_t * src;
+	enum render_type_t type;
+	struct color_t c[4];
+	int x, y, w, h;
+	int radius, a1, a2;
+	int thickness;
+	int p, n;
+};
+
+struct render_tile_t {
+	struct mutex_t lock;
+	struct surface_t * s;
+
+	struct render_tile_cmd_t * cmds;
+	int ncmd, ccmd;
+	struct point_t * pts;
+	int npt, cpt;
+
+	int * bins;
+	int * list;
+	int * tiles;
+	int cbin, clist;
+	int nbusy;
+	atomic_t next;
+
+	struct semaphore_t start;
+	struct semaphore_t done;
+	int nworker;
+};
+
+static struct render_tile_t __render_tile;
+
+/*
+ * The surface the tiles draw into, a copy of the queued one whose render
+ * does not defer, so the default render draws right through it
+ */
+static struct render_t __render_tile_proxy = {
+	.name	 			= "tile-proxy",
+
+	.create				= render_default_create,
+	.destroy			= render_default_destroy,
+};
+
+static inline void render_tile_proxy(struct surface_t * o, struct surface_t * s)
+{
+	memcpy(o, s, sizeof(struct surface_t));
+	o->r = &__render_tile_proxy;
+}
+
+static void render_tile_exec(struct render_tile_t * t, struct render_tile_cmd_t * cmd, struct surface_t * o, struct region_t * clip)
+{
+	struct point_t * p = &t->pts[cmd->p];
+
+	switch(cmd->op)
+	{
+	case RENDER_TILE_OP_BLIT:
+		render_default_blit(o, clip, &cmd->m, cmd->src, cmd->type);
+		break;
+	case RENDER_TILE_OP_FILL:
+		render_default_fill(o, clip, &cmd->m, cmd->w, cmd->h, &cmd->c[0], cmd->type);
+		break;
+	case RENDER_TILE_OP_LINE:
+		render_default_shape_line(o, clip, &p[0], &p[1], cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_POLYLINE:
+		render_default_shape_polyline(o, clip, p, cmd->n, cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_CURVE:
+		render_default_shape_curve(o, clip, p, cmd->n, cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_TRIANGLE:
+		render_default_shape_triangle(o, clip, &p[0], &p[1], &p[2], cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_RECTANGLE:
+		render_default_shape_rectangle(o, clip, cmd->x, cmd->y, cmd->w, cmd->h, cmd->radius, cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_POLYGON:
+		render_default_shape_polygon(o, clip, p, cmd->n, cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_CIRCLE:
+		render_default_shape_circle(o, clip, cmd->x, cmd->y, cmd->radius, cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_ELLIPSE:
+		render_default_shape_ellipse(o, clip, cmd->x, cmd->y, cmd->w, cmd->h, cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_ARC:
+		render_default_shape_arc(o, clip, cmd->x, cmd->y, cmd->radius, cmd->a1, cmd->a2, cmd->thickness, &cmd->c[0]);
+		break;
+	case RENDER_TILE_OP_GRADIENT:
+		render_default_shape_gradient(o, clip, cmd->x, cmd->y, cmd->w, cmd->h, &cmd->c[0], &cmd->c[1], &cmd->c[2], &cmd->c[3]);
+		break;
+	case RENDER_TILE_OP_CHECKERBOARD:
+		render_default_shape_checkerboard(o, clip, cmd->x, cmd->y, cmd->w, cmd->h);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Take the busy tiles one by one until there is none left, the draws of a
+ * tile being played in the order they were made
+ */
+static void render_tile_work(struct render_tile_t * t)
+{
+	struct render_tile_cmd_t * cmd;
+	struct surface_t o;
+	struct region_t r, region;
+	int tile, i, j;
+
+	render_tile_proxy(&o, t->s);
+	while((i = atomic_add_return(&t->next, 1) - 1) < t->nbusy)
+	{
+		tile = t->tiles[i];
+		region_init(&region, 0, tile * RENDER_TILE_SIZE, t->s->width, RENDER_TILE_SIZE);
+		for(j = t->bins[tile]; j < t->bins[tile + 1]; j++)
+		{
+			cmd = &t->cmds[t->list[j]];
+			if(region_intersect(&r, &region, &cmd->clip))
+				render_tile_exec(t, cmd, &o, &r);
+		}
+	}
+}
+
+static void render_tile_task(struct task_t * task, void * data)
+{
+	struct render_tile_t * t = (struct render_tile_t *)data;
+
+	while(1)
+	{
+		semaphore_down(&t->start);
+		render_tile_work(t);
+		semaphore_up(&t->done);
+	}
+}
+
+/*
+ * Bin the queued draws into the tiles their clip touches and play them
+ * back, with the lock held. The mipmaps the blits sample are built before
+ * the workers start, the bands then only read them. Without the memory
+ * for the bins the draws are played one after the other on the calling
+ * task.
+ */
+static void render_tile_play(struct render_tile_t * t)
+{
+	struct render_tile_cmd_t * cmd;
+	struct surface_t o;
+	int ntile, y, i, k;
+
+	if(t->ncmd <= 0)
+		return;
+	ntile = (t->s->height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+	if(ntile + 1 > t->cbin)
+	{
+		free(t->bins);
+		free(t->tiles);
+		t->cbin = ntile + 1;
+		t->bins = malloc(sizeof(int) * t->cbin);
+		t->tiles = malloc(sizeof(int) * t->cbin);
+		if(!t->bins || !t->tiles)
+			t->cbin = 0;
+	}
+	if(t->cbin > 0)
+	{
+		memset(t->bins, 0, sizeof(int) * (ntile + 1));
+		for(i = 0, cmd = t->cmds; i < t->ncmd; i++, cmd++)
+		{
+			for(y = cmd->clip.y / RENDER_TILE_SIZE; y <= (cmd->clip.y + cmd->clip.h - 1) / RENDER_TILE_SIZE; y++)
+				t->bins[y + 1]++;
+		}
+		for(i = 0; i < ntile; i++)
+			t->bins[i + 1] += t->bins[i];
+		if(t->bins[ntile] > t->clist)
+		{
+			free(t->list);
+			t->clist = t->bins[ntile];
+			t->list = malloc(sizeof(int) * t->clist);
+			if(!t->list)
+				t->clist = 0;
+		}
+	}
+	if((t->cbin > 0) && (t->clist > 0))
+	{
+		memcpy(t->tiles, t->bins, sizeof(int) * ntile);
+		for(i = 0, cmd = t->cmds; i < t->ncmd; i++, cmd++)
+		{
+			for(y = cmd->clip.y / RENDER_TILE_SIZE; y <= (cmd->clip.y + cmd->clip.h - 1) / RENDER_TILE_SIZE; y++)
+				t->list[t->tiles[y]++] = i;
+		}
+		for(i = 0, t->nbusy = 0; i < ntile; i++)
+		{
+			if(t->bins[i + 1] > t->bins[i])
+				t->tiles[t->nbusy++] = i;
+		}
+		for(i = 0, cmd = t->cmds; i < t->ncmd; i++, cmd++)
+		{
+			if(cmd->op == RENDER_TILE_OP_BLIT)
+				render_default_blit_prepare(cmd->src, &cmd->m, cmd->type);
+		}
+		atomic_set(&t->next, 0);
+		k = task_self() ? min(t->nworker, t->nbusy - 1) : 0;
+		for(i = 0; i < k; i++)
+			semaphore_up(&t->start);
+		render_tile_work(t);
+		for(i = 0; i < k; i++)
+			semaphore_down(&t->done);
+	}
+	else
+	{
+		render_tile_proxy(&o, t->s);
+		for(i = 0, cmd = t->cmds; i < t->ncmd; i++, cmd++)
+			render_tile_exec(t, cmd, &o, &cmd->clip);
+	}
+	t->ncmd = 0;
+	t->npt = 0;
+}
+
+/*
+ * Queue a draw whose pixels all lie in the bound, with the lock held. The
+ * queue only holds the draws of one surface, drawing to another one plays
+ * it back first, as does a full queue or running out of memory.
+ */
+static struct render_tile_cmd_t * render_tile_record(struct render_tile_t * t, struct surface_t * s, struct region_t * clip, struct region_t * bound, enum render_tile_op_t op, struct point_t * p, int n)
+{
+	struct render_tile_cmd_t * cmd, * cmds;
+	struct point_t * pts;
+	struct region_t r;
+	int l;
+
+	region_init(&r, 0, 0, surface_get_width(s), surface_get_height(s));
+	if(clip)
+	{
+		if(!region_intersect(&r, &r, clip))
+			return NULL;
+	}
+	if(!region_intersect(&r, &r, bound))
+		return NULL;
+	if(t->s != s)
+	{
+		render_tile_play(t);
+		t->s = s;
+	}
+	if(t->ncmd + 1 > t->ccmd)
+	{
+		if(t->ccmd < RENDER_TILE_QUEUE)
+		{
+			l = t->ccmd > 0 ? t->ccmd * 2 : 64;
+			cmds = realloc(t->cmds, sizeof(struct render_tile_cmd_t) * l);
+			if(cmds)
+			{
+				t->cmds = cmds;
+				t->ccmd = l;
+			}
+		}
+		if(t->ncmd + 1 > t->ccmd)
+			render_tile_play(t);
+		if(t->ncmd + 1 > t->ccmd)
+			return NULL;
+	}
+	if(t->npt + n > t->cpt)
+	{
+		l = max(t->cpt * 2, max(t->npt + n, 256));
+		pts = realloc(t->pts, sizeof(struct point_t) * l);
+		if(pts)
+		{
+			t->pts = pts;
+			t->cpt = l;
+		}
+		else
+		{
+			render_tile_play(t);
+			if(t->npt + n > t->cpt)
+				return NULL;
+		}
+	}
+	cmd = &t->cmds[t->ncmd++];
+	cmd->op = op;
+	memcpy(&cmd->clip, &r, sizeof(struct region_t));
+	cmd->p = t->npt;
+	cmd->n = n;
+	if(n > 0)
+	{
+		memcpy(&t->pts[t->npt], p, sizeof(struct point_t) * n);
+		t->npt += n;
+	}
+	s->version++;
+	return cmd;
+}
+
+/*
+ * A stroke reaches past its points by half its width, up to twice the
+ * width at a miter join, and a pixel more for the antialiasing
+ */
+static inline int render_tile_extent(int thickness)
+{
+	return (max(thickness, 1) << 1) + 2;
+}
+
+static void render_tile_bound_points(struct region_t * r, struct point_t * p, int n, int thickness)
+{
+	int x0 = p[0].x, y0 = p[0].y;
+	int x1 = p[0].x, y1 = p[0].y;
+	int e = render_tile_extent(thickness);
+	int i;
+
+	for(i = 1; i < n; i++)
+	{
+		x0 = min(x0, p[i].x);
+		y0 = min(y0, p[i].y);
+		x1 = max(x1, p[i].x);
+		y1 = max(y1, p[i].y);
+	}
+	region_init(r, x0 - e, y0 - e, x1 - x0 + (e << 1) + 1, y1 - y0 + (e << 1) + 1);
+}
+
+static void render_tile_bound_rect(struct region_t * r, int x, int y, int w, int h, int thickness)
+{
+	int e = render_tile_extent(thickness);
+
+	region_init(r, min(x, x + w) - e, min(y, y + h) - e, abs(w) + (e << 1) + 1, abs(h) + (e << 1) + 1);
+}
+
+/*
+ * Play back what is queued and let a draw that can not be queued work in
+ * place, on a proxy of the surface
+ */
+static void render_tile_begin(struct surface_t * s, struct surface_t * o)
+{
+	struct render_tile_t * t = &__render_tile;
+
+	mutex_lock(&t->lock);
+	render_tile_play(t);
+	render_tile_proxy(o, s);
+	s->version++;
+}
+
+static void render_tile_end(struct surface_t * s, struct surface_t * o)
+{
+	mutex_unlock(&__render_tile.lock);
+}
+
+/*
+ * Any pixel access plays back the queue, whatever the surface, as a surface
+ * about to change may be the source of a queued blit
+ */
+static void render_tile_flush(struct surface_t * s)
+{
+	struct render_tile_t * t = &__render_tile;
+
+	if(t->ncmd > 0)
+	{
+		mutex_lock(&t->lock);
+		render_tile_play(t);
+		mutex_unlock(&t->lock);
+	}
+}
+
+static void render_tile_destroy(void * rctx)
+{
+	render_tile_flush(NULL);
+	render_default_destroy(rctx);
+}
+
+static void render_tile_blit(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct surface_t * src, enum render_type_t type)
+{
+	struct render_tile_t * t = &__render_tile;
+	struct render_tile_cmd_t * cmd;
+	struct region_t bound;
+	struct surface_t o;
+
+	if(src == s)
+	{
+		render_tile_begin(s, &o);
+		render_default_blit(&o, clip, m, src, type);
+		render_tile_end(s, &o);
+		return;
+	}
+	matrix_transform_region(m, surface_get_width(src), surface_get_height(src), &bound);
+	mutex_lock(&t->lock);
+	if((cmd = render_tile_record(t, s, clip, &bound, RENDER_TILE_OP_BLIT, NULL, 0)))
+	{
+		memcpy(&cmd->m, m, sizeof(struct matrix_t));
+		cmd->src = src;
+		cmd->type = type;
+	}
+	mutex_unlock(&t->lock);
+}
+
+static void render_tile_fill(struct surface_t * s, struct region_t * clip, struct matrix_t * m, int w, int h, struct color_t * c, enum render_type_t type)
+{
+	struct render_tile_t * t = &__render_tile;
+	struct render_tile_cmd_t * cmd;
+	struct region_t bound;
+
+	matrix_transform_region(m, w, h, &bound);
+	mutex_lock(&t->lock);
+	if((cmd = render_tile_record(t, s, clip, &bound, RENDER_TILE_OP_FILL, NULL, 0)))
+	{
+		memcpy(&cmd->m, m, sizeof(struct matrix_t));
+		memcpy(&cmd->c[0], c, sizeof(struct color_t));
+		cmd->w = w;
+		cmd->h = h;
+		cmd->type = type;
+	}
+	mutex_unlock(&t->lock);
+}
+
+static void render_tile_text(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct text_t * txt)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_text(&o, clip, m, txt);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_icon(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct icon_t * ico)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_icon(&o, clip, m, ico);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_shape(struct surface_t * s, struct region_t * clip, struct region_t * bound, enum render_tile_op_t op, struct point_t * p, int n, int thickness, struct color_t * c)
+{
+	struct render_tile_t * t = &__render_tile;
+	struct render_tile_cmd_t * cmd;
+
+	mutex_lock(&t->lock);
+	if((cmd = render_tile_record(t, s, clip, bound, op, p, n)))
+	{
+		memcpy(&cmd->c[0], c, sizeof(struct color_t));
+		cmd->thickness = thickness;
+	}
+	mutex_unlock(&t->lock);
+}
+
+static void render_tile_shape_line(struct surface_t * s, struct region_t * clip, struct point_t * p0, struct point_t * p1, int thickness, struct color_t * c)
+{
+	struct point_t p[2];
+	struct region_t bound;
+
+	memcpy(&p[0], p0, sizeof(struct point_t));
+	memcpy(&p[1], p1, sizeof(struct point_t));
+	render_tile_bound_points(&bound, p, 2, thickness);
+	render_tile_shape(s, clip, &bound, RENDER_TILE_OP_LINE, p, 2, thickness, c);
+}
+
+static void render_tile_shape_polyline(struct surface_t * s, struct region_t * clip, struct point_t * p, int n, int thickness, struct color_t * c)
+{
+	struct region_t bound;
+
+	if(n > 0)
+	{
+		render_tile_bound_points(&bound, p, n, thickness);
+		render_tile_shape(s, clip, &bound, RENDER_TILE_OP_POLYLINE, p, n, thickness, c);
+	}
+}
+
+static void render_tile_shape_curve(struct surface_t * s, struct region_t * clip, struct point_t * p, int n, int thickness, struct color_t * c)
+{
+	struct region_t bound;
+
+	if(n > 0)
+	{
+		render_tile_bound_points(&bound, p, n, thickness);
+		render_tile_shape(s, clip, &bound, RENDER_TILE_OP_CURVE, p, n, thickness, c);
+	}
+}
+
+static void render_tile_shape_triangle(struct surface_t * s, struct region_t * clip, struct point_t * p0, struct point_t * p1, struct point_t * p2, int thickness, struct color_t * c)
+{
+	struct point_t p[3];
+	struct region_t bound;
+
+	memcpy(&p[0], p0, sizeof(struct point_t));
+	memcpy(&p[1], p1, sizeof(struct point_t));
+	memcpy(&p[2], p2, sizeof(struct point_t));
+	render_tile_bound_points(&bound, p, 3, thickness);
+	render_tile_shape(s, clip, &bound, RENDER_TILE_OP_TRIANGLE, p, 3, thickness, c);
+}
+
+static void render_tile_shape_rectangle(struct surface_t * s, struct region_t * clip, int x, int y, int w, int h, int radius, int thickness, struct color_t * c)
+{
+	struct render_tile_t * t = &__render_tile;
+	struct render_tile_cmd_t * cmd;
+	struct region_t bound;
+	int r = radius & 0xffff;
+
+	render_tile_bound_rect(&bound, x - r, y - r, w + (r << 1), h + (r << 1), thickness);
+	mutex_lock(&t->lock);
+	if((cmd = render_tile_record(t, s, clip, &bound, RENDER_TILE_OP_RECTANGLE, NULL, 0)))
+	{
+		memcpy(&cmd->c[0], c, sizeof(struct color_t));
+		cmd->x = x;
+		cmd->y = y;
+		cmd->w = w;
+		cmd->h = h;
+		cmd->radius = radius;
+		cmd->thickness = thickness;
+	}
+	mutex_unlock(&t->lock);
+}
+
+static void render_tile_shape_polygon(struct surface_t * s, struct region_t * clip, struct point_t * p, int n, int thickness, struct color_t * c)
+{
+	struct region_t bound;
+
+	if(n > 0)
+	{
+		render_tile_bound_points(&bound, p, n, thickness);
+		render_tile_shape(s, clip, &bound, RENDER_TILE_OP_POLYGON, p, n, thickness, c);
+	}
+}
+
+/*
+ * The bezier control points of an arc stay within a quarter more than the
+ * radius from the center
+ */
+static void render_tile_shape_round(struct surface_t * s, struct region_t * clip, enum render_tile_op_t op, int x, int y, int w, int h, int a1, int a2, int thickness, struct color_t * c)
+{
+	struct render_tile_t * t = &__render_tile;
+	struct render_tile_cmd_t * cmd;
+	struct region_t bound;
+	int rw = w + (w >> 2);
+	int rh = h + (h >> 2);
+
+	render_tile_bound_rect(&bound, x - rw, y - rh, rw << 1, rh << 1, thickness);
+	mutex_lock(&t->lock);
+	if((cmd = render_tile_record(t, s, clip, &bound, op, NULL, 0)))
+	{
+		memcpy(&cmd->c[0], c, sizeof(struct color_t));
+		cmd->x = x;
+		cmd->y = y;
+		cmd->w = w;
+		cmd->h = h;
+		cmd->radius = w;
+		cmd->a1 = a1;
+		cmd->a2 = a2;
+		cmd->thickness = thickness;
+	}
+	mutex_unlock(&t->lock);
+}
+
+static void render_tile_shape_circle(struct surface_t * s, struct region_t * clip, int x, int y, int radius, int thickness, struct color_t * c)
+{
+	if(radius > 0)
+		render_tile_shape_round(s, clip, RENDER_TILE_OP_CIRCLE, x, y, radius, radius, 0, 0, thickness, c);
+}
+
+static void render_tile_shape_ellipse(struct surface_t * s, struct region_t * clip, int x, int y, int w, int h, int thickness, struct color_t * c)
+{
+	if((w > 0) && (h > 0))
+		render_tile_shape_round(s, clip, RENDER_TILE_OP_ELLIPSE, x, y, w, h, 0, 0, thickness, c);
+}
+
+static void render_tile_shape_arc(struct surface_t * s, struct region_t * clip, int x, int y, int radius, int a1, int a2, int thickness, struct color_t * c)
+{
+	if(radius > 0)
+		render_tile_shape_round(s, clip, RENDER_TILE_OP_ARC, x, y, radius, radius, a1, a2, thickness, c);
+}
+
+static void render_tile_shape_gradient(struct surface_t * s, struct region_t * clip, int x, int y, int w, int h, struct color_t * lt, struct color_t * rt, struct color_t * rb, struct color_t * lb)
+{
+	struct render_tile_t * t = &__render_tile;
+	struct render_tile_cmd_t * cmd;
+	struct region_t bound;
+
+	region_init(&bound, x, y, w, h);
+	mutex_lock(&t->lock);
+	if((cmd = render_tile_record(t, s, clip, &bound, RENDER_TILE_OP_GRADIENT, NULL, 0)))
+	{
+		memcpy(&cmd->c[0], lt, sizeof(struct color_t));
+		memcpy(&cmd->c[1], rt, sizeof(struct color_t));
+		memcpy(&cmd->c[2], rb, sizeof(struct color_t));
+		memcpy(&cmd->c[3], lb, sizeof(struct color_t));
+		cmd->x = x;
+		cmd->y = y;
+		cmd->w = w;
+		cmd->h = h;
+	}
+	mutex_unlock(&t->lock);
+}
+
+static void render_tile_shape_checkerboard(struct surface_t * s, struct region_t * clip, int x, int y, int w, int h)
+{
+	struct render_tile_t * t = &__render_tile;
+	struct render_tile_cmd_t * cmd;
+	struct region_t bound;
+
+	region_init(&bound, x, y, w, h);
+	mutex_lock(&t->lock);
+	if((cmd = render_tile_record(t, s, clip, &bound, RENDER_TILE_OP_CHECKERBOARD, NULL, 0)))
+	{
+		cmd->x = x;
+		cmd->y = y;
+		cmd->w = w;
+		cmd->h = h;
+	}
+	mutex_unlock(&t->lock);
+}
+
+static void render_tile_shape_raster(struct surface_t * s, struct svg_t * svg, float tx, float ty, float sx, float sy)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_shape_raster(&o, svg, tx, ty, sx, sy);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_grayscale(struct surface_t * s)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_grayscale(&o);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_sepia(struct surface_t * s)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_sepia(&o);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_invert(struct surface_t * s)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_invert(&o);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_threshold(struct surface_t * s, int threshold, const char * type)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_threshold(&o, threshold, type);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_colormap(struct surface_t * s, const char * type)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_colormap(&o, type);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_coloring(struct surface_t * s, struct color_t * c)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_coloring(&o, c);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_hue(struct surface_t * s, int angle)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_hue(&o, angle);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_saturate(struct surface_t * s, int saturate)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_saturate(&o, saturate);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_brightness(struct surface_t * s, int brightness)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_brightness(&o, brightness);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_contrast(struct surface_t * s, int contrast)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_contrast(&o, contrast);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_opacity(struct surface_t * s, int alpha)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_opacity(&o, alpha);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_haldclut(struct surface_t * s, struct surface_t * clut, const char * type)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_haldclut(&o, clut, type);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_blur(struct surface_t * s, int radius)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_blur(&o, radius);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_erode(struct surface_t * s, int times)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_erode(&o, times);
+	render_tile_end(s, &o);
+}
+
+static void render_tile_filter_dilate(struct surface_t * s, int times)
+{
+	struct surface_t o;
+
+	render_tile_begin(s, &o);
+	render_default_filter_dilate(&o, times);
+	render_tile_end(s, &o);
+}
+
+static struct render_t render_tile = {
+	.name	 			= "tile",
+
+	.create				= render_default_create,
+	.destroy			= render_tile_destroy,
+	.flush				= render_tile_flush,
+
+	.blit				= render_tile_blit,
+	.fill				= render_tile_fill,
+	.text				= render_tile_text,
+	.icon				= render_tile_icon,
+
+	.shape_line			= render_tile_shape_line,
+	.shape_polyline		= render_tile_shape_polyline,
+	.shape_curve		= render_tile_shape_curve,
+	.shape_triangle		= render_tile_shape_triangle,
+	.shape_rectangle	= render_tile_shape_rectangle,
+	.shape_polygon		= render_tile_shape_polygon,
+	.shape_circle		= render_tile_shape_circle,
+	.shape_ellipse		= render_tile_shape_ellipse,
+	.shape_arc			= render_tile_shape_arc,
+	.shape_gradient		= render_tile_shape_gradient,
+	.shape_checkerboard	= render_tile_shape_checkerboard,
+	.shape_raster		= render_tile_shape_raster,
+
+	.filter_grayscale	= render_tile_filter_grayscale,
+	.filter_sepia		= render_tile_filter_sepia,
+	.filter_invert		= render_tile_filter_invert,
+	.filter_threshold	= render_tile_filter_threshold,
+	.filter_colormap	= render_tile_filter_colormap,
+	.filter_coloring	= render_tile_filter_coloring,
+	.filter_hue			= render_tile_filter_hue,
+	.filter_saturate	= render_tile_filter_saturate,
+	.filter_brightness	= render_tile_filter_brightness,
+	.filter_contrast	= render_tile_filter_contrast,
+	.filter_opacity		= render_tile_filter_opacity,
+	.filter_haldclut	= render_tile_filter_haldclut,
+	.filter_blur		= render_tile_filter_blur,
+	.filter_erode		= render_tile_filter_erode,
+	.filter_dilate		= render_tile_filter_dilate,
+};
+
+struct render_t * search_render_tile(void)
+{
+	return &render_tile;
+}
+
+/*
+ * Registered after the other renders, the tiled one takes over every
+ * surface allocated from then on. A worker is started on each cpu but the
+ * first, whose share is drawn by the task playing the queue back. They are
+ * not pinned, the scheduler may move them like any other task, and the
+ * bands go to whichever worker asks first. Left unregistered, the render
+ * is still there for a surface that is given it, drawn without workers.
+ */
+static __init void render_tile_init(void)
+{
+	struct render_tile_t * t = &__render_tile;
+	struct task_t * task;
+	int i;
+
+	mutex_init(&t->lock);
+	semaphore_init(&t->start, 0);
+	semaphore_init(&t->done, 0);
+	if(CONFIG_RENDER_TILE > 0)
+	{
+		for(i = 1; i < CONFIG_MAX_SMP_CPUS; i++)
+		{
+			task = task_create(&__sched[i], "render-tile", render_tile_task, t, SZ_64K, 0);
+			if(task)
+			{
+				task_resume(task);
+				t->nworker++;
+			}
+		}
+		register_render(&render_tile);
+	}
+}
+
+static __exit void render_tile_exit(void)
+{
+	if(CONFIG_RENDER_TILE > 0)
+		unregister_render(&render_tile);
+}
+
+postcore_initcall(render_tile_init);
+postcore_exitcall(render_tile_exit);
@@ -29,6 +29,136 @@
 #include <xboot.h>
 #include <graphic/surface.h>
 
+/*
+ * The mipmap of a source surface, each level a box filtered half of the
+ * one before, level zero being the surface itself. It is only built when
+ * a filtered blit scales the surface down, and is thrown away once the
+ * version of the surface shows its pixels may have changed.
+ */
+#define RENDER_MIPMAP_LEVELS	(16)
+
+struct render_mipmap_t {
+	uint32_t * pixels;
+	int width;
+	int height;
+	int stride;
+};
+
+struct render_default_context_t {
+	void * pixels;
+	unsigned int version;
+	int nlevel;
+	struct render_mipmap_t level[RENDER_MIPMAP_LEVELS];
+};
+
+static void render_mipmap_reset(struct render_default_context_t * ctx)
+{
+	int i;
+
+	for(i = 1; i < ctx->nlevel; i++)
+		free(ctx->level[i].pixels);
+	ctx->nlevel = 0;
+}
+
+static void render_mipmap_reduce(struct render_mipmap_t * d, struct render_mipmap_t * s)
+{
+	uint32_t * p = d->pixels;
+	uint32_t * r0, * r1;
+	uint32_t a, b, c, e, rb, ag;
+	int x, y, x0, x1;
+
+	for(y = 0; y < d->height; y++)
+	{
+		r0 = s->pixels + min(y << 1, s->height - 1) * s->stride;
+		r1 = s->pixels + min((y << 1) + 1, s->height - 1) * s->stride;
+		for(x = 0; x < d->width; x++)
+		{
+			x0 = min(x << 1, s->width - 1);
+			x1 = min((x << 1) + 1, s->width - 1);
+			a = r0[x0];
+			b = r0[x1];
+			c = r1[x0];
+			e = r1[x1];
+			rb = (a & 0x00ff00ff) + (b & 0x00ff00ff) + (c & 0x00ff00ff) + (e & 0x00ff00ff) + 0x00020002;
+			ag = ((a >> 8) & 0x00ff00ff) + ((b >> 8) & 0x00ff00ff) + ((c >> 8) & 0x00ff00ff) + ((e >> 8) & 0x00ff00ff) + 0x00020002;
+			*p++ = ((rb >> 2) & 0x00ff00ff) | ((ag << 6) & 0xff00ff00);
+		}
+	}
+}
+
+/*
+ * The deepest level up to the one asked for, building what is missing.
+ * Only a surface of the default render has a context to keep them in.
+ * The levels are built under a lock, a source may be drawn from several
+ * cpus at once. The tiled render builds them before it wakes its workers,
+ * so its bands only ever find them ready.
+ */
+static spinlock_t __render_mipmap_lock = SPIN_LOCK_INIT();
+
+static struct render_mipmap_t * render_mipmap_get(struct surface_t * s, int level)
+{
+	struct render_default_context_t * ctx;
+	struct render_mipmap_t * o, * n;
+
+	if(!s->r || (s->r->create != render_default_create))
+		return NULL;
+	spin_lock(&__render_mipmap_lock);
+	ctx = s->rctx;
+	if(!ctx)
+	{
+		ctx = calloc(1, sizeof(struct render_default_context_t));
+		if(!ctx)
+		{
+			spin_unlock(&__render_mipmap_lock);
+			return NULL;
+		}
+		s->rctx = ctx;
+	}
+	if((ctx->nlevel == 0) || (ctx->pixels != s->pixels) || (ctx->version != s->version) || (ctx->level[0].width != s->width) || (ctx->level[0].height != s->height))
+	{
+		render_mipmap_reset(ctx);
+		ctx->pixels = s->pixels;
+		ctx->version = s->version;
+		ctx->level[0].pixels = s->pixels;
+		ctx->level[0].width = s->width;
+		ctx->level[0].height = s->height;
+		ctx->level[0].stride = s->stride >> 2;
+		ctx->nlevel = 1;
+	}
+	while((ctx->nlevel <= level) && (ctx->nlevel < RENDER_MIPMAP_LEVELS))
+	{
+		o = &ctx->level[ctx->nlevel - 1];
+		n = &ctx->level[ctx->nlevel];
+		if((o->width <= 1) && (o->height <= 1))
+			break;
+		n->width = max(o->width >> 1, 1);
+		n->height = max(o->height >> 1, 1);
+		n->stride = n->width;
+		n->pixels = malloc(n->width * n->height * sizeof(uint32_t));
+		if(!n->pixels)
+			break;
+		render_mipmap_reduce(n, o);
+		ctx->nlevel++;
+	}
+	o = &ctx->level[min(level, ctx->nlevel - 1)];
+	spin_unlock(&__render_mipmap_lock);
+	return o;
+}
+
+/*
+ * The level a filtered blit samples, one more for each halving of the
+ * source the inverse matrix makes
+ */
+static int render_mipmap_level(struct matrix_t * t)
+{
+	double scale = min(sqrt(t->a * t->a + t->b * t->b), sqrt(t->c * t->c + t->d * t->d));
+	int level;
+
+	for(level = 0; (scale >= 2.0) && (level < RENDER_MIPMAP_LEVELS - 1); level++)
+		scale *= 0.5;
+	return level;
+}
+
 void * render_default_create(struct surface_t * s)
 {
 	return NULL;
@@ -36,6 +166,13 @@ void * render_default_create(struct surface_t * s)
 
 void render_default_destroy(void * rctx)
 {
+	struct render_default_context_t * ctx = (struct render_default_context_t *)rctx;
+
+	if(ctx)
+	{
+		render_mipmap_reset(ctx);
+		free(ctx);
+	}
 }
 
 static inline void blend(uint32_t * d, uint32_t * s)
@@ -70,19 +207,410 @@ static inline void blend(uint32_t * d, uint32_t * s)
 	}
 }
 
+/*
+ * Linear interpolation of two premultiplied pixels, f in 1/256 steps
+ */
+static inline uint32_t lerp(uint32_t a, uint32_t b, int f)
+{
+	uint32_t rb = ((((a & 0x00ff00ff) * (256 - f)) + ((b & 0x00ff00ff) * f)) >> 8) & 0x00ff00ff;
+	uint32_t ag = ((((a >> 8) & 0x00ff00ff) * (256 - f)) + (((b >> 8) & 0x00ff00ff) * f)) & 0xff00ff00;
+	return rb | ag;
+}
+
+/*
+ * The span kernels, premultiplied source over, solid fill, copy and
+ * linear interpolation of two rows of n pixels. These are the portable
+ * versions, an architecture may replace them with simd ones in
+ * arch/$(ARCH)/lib, which must give the same result as blend() and
+ * lerp() bit for bit.
+ */
+static void __render_span_blend(uint32_t * d, uint32_t * s, int n)
+{
+	while(n-- > 0)
+		blend(d++, s++);
+}
+extern __typeof(__render_span_blend) render_span_blend __attribute__((weak, alias("__render_span_blend")));
+
+static void __render_span_fill(uint32_t * d, uint32_t c, int n)
+{
+	while(n-- > 0)
+		*d++ = c;
+}
+extern __typeof(__render_span_fill) render_span_fill __attribute__((weak, alias("__render_span_fill")));
+
+static void __render_span_copy(uint32_t * d, uint32_t * s, int n)
+{
+	if(n > 0)
+		memcpy(d, s, n << 2);
+}
+extern __typeof(__render_span_copy) render_span_copy __attribute__((weak, alias("__render_span_copy")));
+
+static void __render_span_lerp(uint32_t * d, uint32_t * a, uint32_t * b, int f, int n)
+{
+	while(n-- > 0)
+		*d++ = lerp(*a++, *b++, f);
+}
+extern __typeof(__render_span_lerp) render_span_lerp __attribute__((weak, alias("__render_span_lerp")));
+
+/*
+ * The pixels [*l, *r) of the columns [x1, x2) of a row whose source
+ * position, starting at (fx, fy) on column zero and stepping (a, b),
+ * falls inside a w x h source. The position is linear in x, so these
+ * pixels are always one run. The run is solved once and its ends checked
+ * with the same truncation as the pixel loop. Positions are taken from
+ * column zero rather than from x1, so a pixel samples the same source
+ * whatever clip it is drawn through.
+ */
+static inline int render_span_range(double fx, double fy, double a, double b, int x1, int x2, int w, int h, int * l, int * r)
+{
+	double lo = x1, hi = x2, t0, t1, t;
+	int i0, i1, ox, oy;
+
+	if(a == 0)
+	{
+		if(!(fx > -1) || !(fx < w))
+			return 0;
+	}
+	else
+	{
+		t0 = (-1 - fx) / a;
+		t1 = (w - fx) / a;
+		if(t0 > t1)
+		{
+			t = t0;
+			t0 = t1;
+			t1 = t;
+		}
+		lo = max(lo, t0);
+		hi = min(hi, t1);
+	}
+	if(b == 0)
+	{
+		if(!(fy > -1) || !(fy < h))
+			return 0;
+	}
+	else
+	{
+		t0 = (-1 - fy) / b;
+		t1 = (h - fy) / b;
+		if(t0 > t1)
+		{
+			t = t0;
+			t0 = t1;
+			t1 = t;
+		}
+		lo = max(lo, t0);
+		hi = min(hi, t1);
+	}
+	if(!(lo < hi))
+		return 0;
+	i0 = max((int)floor(lo) - 1, x1);
+	i1 = min((int)ceil(hi) + 1, x2);
+	for(; i0 < i1; i0++)
+	{
+		ox = (int)(fx + i0 * a);
+		oy = (int)(fy + i0 * b);
+		if(ox >= 0 && ox < w && oy >= 0 && oy < h)
+			break;
+	}
+	for(; i1 > i0; i1--)
+	{
+		ox = (int)(fx + (i1 - 1) * a);
+		oy = (int)(fy + (i1 - 1) * b);
+		if(ox >= 0 && ox < w && oy >= 0 && oy < h)
+			break;
+	}
+	*l = i0;
+	*r = i1;
+	return (i1 > i0) ? 1 : 0;
+}
+
+/*
+ * A matrix without rotation or skew keeps every source row on one
+ * destination row. The runs are clipped once for the whole call, a
+ * translation blends the source rows in place and a scale steps through
+ * them with a 32.32 fixed point dda. The dda starts from column zero and
+ * leans forward by 2^-20, so a position that lands on a column, as it
+ * does for integer scales, is not lost to the rounding of the step.
+ */
+static void render_blit_axis(uint32_t * p, int ds, uint32_t * sp, int ss, int sw, int sh, struct region_t * r, struct matrix_t * t)
+{
+	uint32_t buf[256];
+	uint32_t * q;
+	int64_t ox, dx;
+	int l, n, top, bottom;
+	int y, i, k, c;
+
+	if(!render_span_range(t->tx, 0, t->a, 0, r->x, r->x + r->w, sw, 1, &l, &n))
+		return;
+	if(!render_span_range(t->ty, 0, t->d, 0, r->y, r->y + r->h, sh, 1, &top, &bottom))
+		return;
+	p += top * ds;
+	if(t->a == 1.0)
+	{
+		/*
+		 * A source position in (-1, 0) still samples the first column,
+		 * which makes the first two pixels of the run share a column
+		 */
+		if(t->tx + l < 0)
+		{
+			for(y = top, q = p; y < bottom; y++, q += ds)
+				render_span_blend(q + l, sp + (int)(t->ty + y * t->d) * ss, 1);
+			l++;
+		}
+		k = (int)(t->tx + l);
+		for(y = top; y < bottom; y++, p += ds)
+			render_span_blend(p + l, sp + (int)(t->ty + y * t->d) * ss + k, n - l);
+	}
+	else
+	{
+		dx = (int64_t)round(t->a * 4294967296.0);
+		for(y = top; y < bottom; y++, p += ds)
+		{
+			q = sp + (int)(t->ty + y * t->d) * ss;
+			ox = (int64_t)round(t->tx * 4294967296.0) + (1 << 12) + l * dx;
+			for(i = l; i < n; i += c)
+			{
+				c = min(n - i, (int)ARRAY_SIZE(buf));
+				for(k = 0; k < c; k++, ox += dx)
+					buf[k] = q[clamp((int)(ox >> 32), 0, sw - 1)];
+				render_span_blend(p + i, buf, c);
+			}
+		}
+	}
+}
+
+/*
+ * Catmull-Rom weights of the four taps around each fraction f, all in
+ * 1/256 steps and adding up to 256. The table is filled in at boot, before
+ * any blit can read it from another cpu.
+ */
+static int __cubic_weights[256][4];
+
+static __init void render_cubic_weights_init(void)
+{
+	int f, f2, f3;
+
+	for(f = 0; f < 256; f++)
+	{
+		f2 = f * f;
+		f3 = f2 * f;
+		__cubic_weights[f][0] = (-f3 + 512 * f2 - 65536 * f) / 131072;
+		__cubic_weights[f][2] = (-3 * f3 + 1024 * f2 + 65536 * f) / 131072;
+		__cubic_weights[f][3] = (f3 - 256 * f2) / 131072;
+		__cubic_weights[f][1] = 256 - __cubic_weights[f][0] - __cubic_weights[f][2] - __cubic_weights[f][3];
+	}
+}
+
+/*
+ * The channels summed in 1/65536 steps, rounded and clamped back into a
+ * valid premultiplied pixel, the taps may overshoot either way
+ */
+static inline uint32_t render_cubic_pack(int * o)
+{
+	int a = clamp((o[3] + 32768) >> 16, 0, 255);
+	int r = clamp((o[2] + 32768) >> 16, 0, a);
+	int g = clamp((o[1] + 32768) >> 16, 0, a);
+	int b = clamp((o[0] + 32768) >> 16, 0, a);
+
+	return (a << 24) | (r << 16) | (g << 8) | (b << 0);
+}
+
+/*
+ * Sample a source at a 32.32 fixed point position, the pixel centers
+ * being at the integers, with the edge pixels repeated outwards
+ */
+static inline uint32_t render_sample_bilinear(struct render_mipmap_t * m, int64_t u, int64_t v)
+{
+	int x = (int)(u >> 32);
+	int y = (int)(v >> 32);
+	int fu = (int)(u >> 24) & 0xff;
+	int fv = (int)(v >> 24) & 0xff;
+	int x0 = clamp(x, 0, m->width - 1);
+	int x1 = clamp(x + 1, 0, m->width - 1);
+	uint32_t * r0 = m->pixels + clamp(y, 0, m->height - 1) * m->stride;
+	uint32_t * r1 = m->pixels + clamp(y + 1, 0, m->height - 1) * m->stride;
+
+	return lerp(lerp(r0[x0], r1[x0], fv), lerp(r0[x1], r1[x1], fv), fu);
+}
+
+static inline uint32_t render_sample_bicubic(struct render_mipmap_t * m, int64_t u, int64_t v)
+{
+	uint32_t * r;
+	uint32_t c;
+	int x = (int)(u >> 32);
+	int y = (int)(v >> 32);
+	int * wu = __cubic_weights[(u >> 24) & 0xff];
+	int * wv = __cubic_weights[(v >> 24) & 0xff];
+	int xs[4], t[4], o[4] = { 0, 0, 0, 0 };
+	int i, j, k;
+
+	for(i = 0; i < 4; i++)
+		xs[i] = clamp(x + i - 1, 0, m->width - 1);
+	for(j = 0; j < 4; j++)
+	{
+		r = m->pixels + clamp(y + j - 1, 0, m->height - 1) * m->stride;
+		t[0] = t[1] = t[2] = t[3] = 0;
+		for(i = 0; i < 4; i++)
+		{
+			c = r[xs[i]];
+			for(k = 0; k < 4; k++)
+				t[k] += ((c >> (k << 3)) & 0xff) * wu[i];
+		}
+		for(k = 0; k < 4; k++)
+			o[k] += t[k] * wv[j];
+	}
+	return render_cubic_pack(o);
+}
+
+/*
+ * The good and best blits, bilinear and bicubic sampling at the pixel
+ * centers. The pixels covered are the same as for the fast blit, so a
+ * sprite does not change its outline with the quality. Scaling down by
+ * two or more samples the mipmap level that brings the scale under two,
+ * which keeps the cost per pixel flat. Without rotation the source rows
+ * of a destination row are filtered once, with the span kernel for the
+ * bilinear one, so each pixel only has to be filtered along the row.
+ */
+static void render_blit_filter(uint32_t * p, int ds, struct surface_t * src, struct region_t * rg, struct matrix_t * t, enum render_type_t type)
+{
+	struct render_mipmap_t base, * mm;
+	uint32_t buf[256];
+	uint32_t * tmp = NULL, * rs[4];
+	int * col = NULL, * wu, * wv, * c;
+	int64_t u, v, du, dv;
+	double kx, ky, cx, cy, fx, fy;
+	int sw = src->width;
+	int sh = src->height;
+	int level, y, l, r, i, j, k, n, x, c0, c1;
+	int o[4];
+
+	level = render_mipmap_level(t);
+	mm = (level > 0) ? render_mipmap_get(src, level) : NULL;
+	if(!mm)
+	{
+		base.pixels = src->pixels;
+		base.width = sw;
+		base.height = sh;
+		base.stride = src->stride >> 2;
+		mm = &base;
+	}
+	kx = (double)mm->width / sw;
+	ky = (double)mm->height / sh;
+	du = (int64_t)round(t->a * kx * 4294967296.0);
+	dv = (int64_t)round(t->b * ky * 4294967296.0);
+	if((t->b == 0) && (t->c == 0))
+	{
+		if(type == RENDER_TYPE_GOOD)
+			tmp = malloc(mm->width * sizeof(uint32_t));
+		else
+			col = malloc(mm->width * sizeof(int) * 4);
+	}
+
+	for(y = rg->y, p += y * ds; y < rg->y + rg->h; y++, p += ds)
+	{
+		fx = t->tx + y * t->c;
+		fy = t->ty + y * t->d;
+		if(!render_span_range(fx, fy, t->a, t->b, rg->x, rg->x + rg->w, sw, sh, &l, &r))
+			continue;
+		cx = fx + 0.5 * t->a + 0.5 * t->c;
+		cy = fy + 0.5 * t->b + 0.5 * t->d;
+		u = (int64_t)round((cx * kx - 0.5) * 4294967296.0) + l * du;
+		v = (int64_t)round((cy * ky - 0.5) * 4294967296.0) + l * dv;
+		if(tmp || col)
+		{
+			c0 = (int)(u >> 32);
+			c1 = (int)((u + (r - l - 1) * du) >> 32);
+			if(c0 > c1)
+			{
+				k = c0;
+				c0 = c1;
+				c1 = k;
+			}
+			k = (int)(v >> 32);
+			if(tmp)
+			{
+				c0 = clamp(c0, 0, mm->width - 1);
+				c1 = clamp(c1 + 1, 0, mm->width - 1);
+				rs[0] = mm->pixels + clamp(k, 0, mm->height - 1) * mm->stride;
+				rs[1] = mm->pixels + clamp(k + 1, 0, mm->height - 1) * mm->stride;
+				render_span_lerp(tmp + c0, rs[0] + c0, rs[1] + c0, (int)(v >> 24) & 0xff, c1 - c0 + 1);
+			}
+			else
+			{
+				c0 = clamp(c0 - 1, 0, mm->width - 1);
+				c1 = clamp(c1 + 2, 0, mm->width - 1);
+				wv = __cubic_weights[(v >> 24) & 0xff];
+				for(j = 0; j < 4; j++)
+					rs[j] = mm->pixels + clamp(k + j - 1, 0, mm->height - 1) * mm->stride;
+				for(x = c0, c = col + (c0 << 2); x <= c1; x++, c += 4)
+				{
+					for(k = 0; k < 4; k++)
+						c[k] = ((rs[0][x] >> (k << 3)) & 0xff) * wv[0] + ((rs[1][x] >> (k << 3)) & 0xff) * wv[1] + ((rs[2][x] >> (k << 3)) & 0xff) * wv[2] + ((rs[3][x] >> (k << 3)) & 0xff) * wv[3];
+				}
+			}
+		}
+		for(i = l; i < r; i += n)
+		{
+			n = min(r - i, (int)ARRAY_SIZE(buf));
+			if(tmp)
+			{
+				for(k = 0; k < n; k++, u += du)
+				{
+					x = (int)(u >> 32);
+					buf[k] = lerp(tmp[clamp(x, 0, mm->width - 1)], tmp[clamp(x + 1, 0, mm->width - 1)], (int)(u >> 24) & 0xff);
+				}
+			}
+			else if(col)
+			{
+				for(k = 0; k < n; k++, u += du)
+				{
+					x = (int)(u >> 32);
+					wu = __cubic_weights[(u >> 24) & 0xff];
+					o[0] = o[1] = o[2] = o[3] = 0;
+					for(j = 0; j < 4; j++)
+					{
+						c = col + (clamp(x + j - 1, 0, mm->width - 1) << 2);
+						o[0] += c[0] * wu[j];
+						o[1] += c[1] * wu[j];
+						o[2] += c[2] * wu[j];
+						o[3] += c[3] * wu[j];
+					}
+					buf[k] = render_cubic_pack(o);
+				}
+			}
+			else if(type == RENDER_TYPE_GOOD)
+			{
+				for(k = 0; k < n; k++, u += du, v += dv)
+					buf[k] = render_sample_bilinear(mm, u, v);
+			}
+			else
+			{
+				for(k = 0; k < n; k++, u += du, v += dv)
+					buf[k] = render_sample_bicubic(mm, u, v);
+			}
+			render_span_blend(p + i, buf, n);
+		}
+	}
+	if(tmp)
+		free(tmp);
+	if(col)
+		free(col);
+}
+
 void render_default_blit(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct surface_t * src, enum render_type_t type)
 {
 	struct region_t r, region;
 	struct matrix_t t;
+	uint32_t buf[256];
 	uint32_t * p;
 	uint32_t * dp = surface_get_pixels(s);
-	uint32_t * sp = surface_get_pixels(src);
+	uint32_t * sp = src->pixels;
 	int ds = surface_get_stride(s) >> 2;
 	int ss = surface_get_stride(src) >> 2;
 	int sw = surface_get_width(src);
 	int sh = surface_get_height(src);
-	int x1, y1, x2, y2, stride;
-	int x, y, ox, oy;
+	int y, l, k, n, i;
 	double fx, fy, ofx, ofy;
 
 	region_init(&r, 0, 0, surface_get_width(s), surface_get_height(s));
@@ -95,33 +623,55 @@ void render_default_blit(struct surface_t * s, struct region_t * clip, struct ma
 	if(!region_intersect(&r, &r, &region))
 		return;
 
-	x1 = r.x;
-	y1 = r.y;
-	x2 = r.x + r.w;
-	y2 = r.y + r.h;
-	stride = ds - r.w;
-	p = dp + y1 * ds + x1;
-	fx = x1;
-	fy = y1;
 	memcpy(&t, m, sizeof(struct matrix_t));
 	matrix_invert(&t);
-	matrix_transform_point(&t, &fx, &fy);
 
-	for(y = y1; y < y2; ++y, fx += t.c, fy += t.d)
+	/*
+	 * A translation by whole pixels samples the pixel centers exactly,
+	 * where every quality gives the same result as the fast one
+	 */
+	if((t.b == 0) && (t.c == 0) && ((type == RENDER_TYPE_FAST) || ((t.a == 1.0) && (t.d == 1.0) && (t.tx == floor(t.tx)) && (t.ty == floor(t.ty)))))
+	{
+		render_blit_axis(dp, ds, sp, ss, sw, sh, &r, &t);
+		return;
+	}
+	if(type != RENDER_TYPE_FAST)
+	{
+		render_blit_filter(dp, ds, src, &r, &t, type);
+		return;
+	}
+	for(y = r.y, p = dp + y * ds; y < r.y + r.h; ++y, p += ds)
 	{
-		ofx = fx;
-		ofy = fy;
-		for(x = x1; x < x2; ++x, ofx += t.a, ofy += t.b)
+		fx = t.tx + y * t.c;
+		fy = t.ty + y * t.d;
+		if(!render_span_range(fx, fy, t.a, t.b, r.x, r.x + r.w, sw, sh, &l, &n))
+			continue;
+		for(; l < n; l += k)
 		{
-			ox = (int)ofx;
-			oy = (int)ofy;
-			if(ox >= 0 && ox < sw && oy >= 0 && oy < sh)
+			k = min(n - l, (int)ARRAY_SIZE(buf));
+			for(i = 0; i < k; i++)
 			{
-				blend(p, sp + oy * ss + ox);
+				ofx = fx + (l + i) * t.a;
+				ofy = fy + (l + i) * t.b;
+				buf[i] = sp[(int)ofy * ss + (int)ofx];
 			}
-			p++;
+			render_span_blend(p + l, buf, k);
 		}
-		p += stride;
+	}
+}
+
+void render_default_blit_prepare(struct surface_t * src, struct matrix_t * m, enum render_type_t type)
+{
+	struct matrix_t t;
+	int level;
+
+	if(type != RENDER_TYPE_FAST)
+	{
+		memcpy(&t, m, sizeof(struct matrix_t));
+		matrix_invert(&t);
+		level = render_mipmap_level(&t);
+		if(level > 0)
+			render_mipmap_get(src, level);
 	}
 }
 
@@ -131,9 +681,7 @@ void render_default_fill(struct surface_t * s, struct region_t * clip, struct ma
 	struct matrix_t t;
 	uint32_t * p, v;
 	int ds = surface_get_stride(s) >> 2;
-	int x1, y1, x2, y2, stride;
-	int x, y, ox, oy;
-	double fx, fy, ofx, ofy;
+	int y, l, n, top, bottom;
 
 	region_init(&r, 0, 0, surface_get_width(s), surface_get_height(s));
 	if(clip)
@@ -145,32 +693,24 @@ void render_default_fill(struct surface_t * s, struct region_t * clip, struct ma
 	if(!region_intersect(&r, &r, &region))
 		return;
 
-	x1 = r.x;
-	y1 = r.y;
-	x2 = r.x + r.w;
-	y2 = r.y + r.h;
-	stride = ds - r.w;
-	p = (uint32_t *)surface_get_pixels(s) + y1 * ds + x1;
+	p = (uint32_t *)surface_get_pixels(s);
 	v = color_get_premult(c);
-	fx = x1;
-	fy = y1;
 	memcpy(&t, m, sizeof(struct matrix_t));
 	matrix_invert(&t);
-	matrix_transform_point(&t, &fx, &fy);
 
-	for(y = y1; y < y2; ++y, fx += t.c, fy += t.d)
+	if((t.b == 0) && (t.c == 0))
 	{
-		ofx = fx;
-		ofy = fy;
-		for(x = x1; x < x2; ++x, ofx += t.a, ofy += t.b)
+		if(render_span_range(t.tx, 0, t.a, 0, r.x, r.x + r.w, w, 1, &l, &n) && render_span_range(t.ty, 0, t.d, 0, r.y, r.y + r.h, h, 1, &top, &bottom))
 		{
-			ox = (int)ofx;
-			oy = (int)ofy;
-			if(ox >= 0 && ox < w && oy >= 0 && oy < h)
-				*p = v;
-			p++;
+			for(y = top, p += top * ds; y < bottom; y++, p += ds)
+				render_span_fill(p + l, v, n - l);
 		}
-		p += stride;
+		return;
+	}
+	for(y = r.y, p += y * ds; y < r.y + r.h; ++y, p += ds)
+	{
+		if(render_span_range(t.tx + y * t.c, t.ty + y * t.d, t.a, t.b, r.x, r.x + r.w, w, h, &l, &n))
+			render_span_fill(p + l, v, n - l);
 	}
 }
 
@@ -219,8 +759,8 @@ struct xvg_edge_t {
 };
 
 struct xvg_active_edge_t {
-	int x, dx;
-	float ey;
+	int x, id;
+	float x0, y0, dxdy, ey;
 	int dir;
 	struct xvg_active_edge_t * next;
 };
@@ -245,6 +785,7 @@ struct xvg_context_t {
 	struct xvg_mem_page_t * cpage;
 	unsigned char * bitmap;
 	int width, height, stride;
+	int ox, oy;
 	unsigned char * scanline;
 	int cscanline;
 	float * pts;
@@ -769,7 +1310,22 @@ static int xvg_cmp_edge(const void * p, const void * q)
 	return 0;
 }
 
-static struct xvg_active_edge_t * xvg_add_active(struct xvg_context_t * ctx, struct xvg_edge_t * e, float startPoint)
+/*
+ * The crossing of an edge is solved from its top at every subsample
+ * rather than stepped, and ties are broken by the edge index, so a
+ * scanline covers the same whatever row the clip starts at
+ */
+static inline void xvg_step_active(struct xvg_active_edge_t * z, float scany)
+{
+	z->x = (int)floorf(XVG_FIX * (z->x0 + z->dxdy * (scany - z->y0)));
+}
+
+static inline int xvg_active_after(struct xvg_active_edge_t * a, struct xvg_active_edge_t * b)
+{
+	return (a->x > b->x) || ((a->x == b->x) && (a->id > b->id));
+}
+
+static struct xvg_active_edge_t * xvg_add_active(struct xvg_context_t * ctx, struct xvg_edge_t * e, int id, float startPoint)
 {
 	struct xvg_active_edge_t * z;
 
@@ -784,13 +1340,12 @@ static struct xvg_active_edge_t * xvg_add_active(struct xvg_context_t * ctx, str
 		if(!z)
 			return NULL;
 	}
-	float dxdy = (e->x1 - e->x0) / (e->y1 - e->y0);
-	if(dxdy < 0)
-		z->dx = (int)(-floorf(XVG_FIX * -dxdy));
-	else
-		z->dx = (int)floorf(XVG_FIX * dxdy);
-	z->x = (int)floorf(XVG_FIX * (e->x0 + dxdy * (startPoint - e->y0)));
+	z->dxdy = (e->x1 - e->x0) / (e->y1 - e->y0);
+	z->x0 = e->x0;
+	z->y0 = e->y0;
 	z->ey = e->y1;
+	z->id = id;
+	xvg_step_active(z, startPoint);
 	z->next = 0;
 	z->dir = e->dir;
 
@@ -803,7 +1358,7 @@ static void xvg_free_active(struct xvg_context_t * ctx, struct xvg_active_edge_t
 	ctx->freelist = z;
 }
 
-static void xvg_fill_scanline(unsigned char * scanline, int len, int x0, int x1, int maxweight, int * xmin, int * xmax)
+static void xvg_fill_scanline(unsigned char * scanline, int lo, int hi, int x0, int x1, int maxweight, int * xmin, int * xmax)
 {
 	int i = x0 >> XVG_FIXSHIFT;
 	int j = x1 >> XVG_FIXSHIFT;
@@ -811,7 +1366,7 @@ static void xvg_fill_scanline(unsigned char * scanline, int len, int x0, int x1,
 		*xmin = i;
 	if(j > *xmax)
 		*xmax = j;
-	if(i < len && j >= 0)
+	if(i < hi && j >= lo)
 	{
 		if(i == j)
 		{
@@ -819,21 +1374,21 @@ static void xvg_fill_scanline(unsigned char * scanline, int len, int x0, int x1,
 		}
 		else
 		{
-			if(i >= 0)
+			if(i >= lo)
 				scanline[i] = (unsigned char)(scanline[i] + (((XVG_FIX - (x0 & XVG_FIXMASK)) * maxweight) >> XVG_FIXSHIFT));
 			else
-				i = -1;
-			if(j < len)
+				i = lo - 1;
+			if(j < hi)
 				scanline[j] = (unsigned char)(scanline[j] + (((x1 & XVG_FIXMASK) * maxweight) >> XVG_FIXSHIFT));
 			else
-				j = len;
+				j = hi;
 			for(++i; i < j; ++i)
 				scanline[i] = (unsigned char)(scanline[i] + maxweight);
 		}
 	}
 }
 
-static void xvg_fill_active_edges(unsigned char * scanline, int len, struct xvg_active_edge_t * e, int maxweight, int * xmin, int * xmax, enum xvg_fill_rule_t rule)
+static void xvg_fill_active_edges(unsigned char * scanline, int lo, int hi, struct xvg_active_edge_t * e, int maxweight, int * xmin, int * xmax, enum xvg_fill_rule_t rule)
 {
 	int x0 = 0, w = 0;
 
@@ -851,7 +1406,7 @@ static void xvg_fill_active_edges(unsigned char * scanline, int len, struct xvg_
 				int x1 = e->x;
 				w += e->dir;
 				if(w == 0)
-					xvg_fill_scanline(scanline, len, x0, x1, maxweight, xmin, xmax);
+					xvg_fill_scanline(scanline, lo, hi, x0, x1, maxweight, xmin, xmax);
 			}
 			e = e->next;
 		}
@@ -869,7 +1424,7 @@ static void xvg_fill_active_edges(unsigned char * scanline, int len, struct xvg_
 			{
 				int x1 = e->x;
 				w = 0;
-				xvg_fill_scanline(scanline, len, x0, x1, maxweight, xmin, xmax);
+				xvg_fill_scanline(scanline, lo, hi, x0, x1, maxweight, xmin, xmax);
 			}
 			e = e->next;
 		}
@@ -884,11 +1439,13 @@ static void xvg_scanline_solid(unsigned char * dst, int count, unsigned char * c
 	int ca = c->a;
 	int i;
 
-	for(i = 0; i < count; i++)
+	for(i = 0; i < count; i++, cover++, dst += 4)
 	{
 		int b, g, r;
 		int a = idiv255((int)cover[0] * ca);
 		int ia = 255 - a;
+		if(a == 0)
+			continue;
 		b = idiv255(cb * a);
 		g = idiv255(cg * a);
 		r = idiv255(cr * a);
@@ -902,29 +1459,44 @@ static void xvg_scanline_solid(unsigned char * dst, int count, unsigned char * c
 		dst[1] = (unsigned char)g;
 		dst[2] = (unsigned char)r;
 		dst[3] = (unsigned char)a;
-
-		cover++;
-		dst += 4;
 	}
 }
 
-static void xvg_rasterize_sorted_edges(struct xvg_context_t * ctx, struct color_t * c, enum xvg_fill_rule_t rule)
+/*
+ * Rasterize the clip of the shape, either keeping the coverage in a mask
+ * or blending the color through it straight onto the surface at dx, dy
+ */
+static void xvg_rasterize_sorted_edges(struct xvg_context_t * ctx, struct region_t * clip, unsigned char * mask, int mstride, int dx, int dy)
 {
 	struct xvg_active_edge_t * active = NULL;
+	enum xvg_fill_rule_t rule = ctx->rule;
+	unsigned char * scanline;
 	int e = 0;
 	int maxweight = (255 / XVG_SUBSAMPLES);
-	int x0 = ctx->clip.x;
-	int y0 = ctx->clip.y;
-	int x1 = x0 + ctx->clip.w - 1;
-	int y1 = y0 + ctx->clip.h - 1;
+	int x0 = clip->x;
+	int y0 = clip->y;
+	int x1 = x0 + clip->w - 1;
+	int y1 = y0 + clip->h - 1;
 	int xmin, xmax;
 	int y, s;
 
+	if(ctx->cscanline < clip->w)
+	{
+		free(ctx->scanline);
+		ctx->scanline = malloc(clip->w);
+		if(!ctx->scanline)
+		{
+			ctx->cscanline = 0;
+			return;
+		}
+		ctx->cscanline = clip->w;
+	}
+	scanline = ctx->scanline - x0;
 	for(y = y0; y <= y1; y++)
 	{
-		memset(ctx->scanline, 0, ctx->width);
-		xmin = ctx->width;
-		xmax = 0;
+		memset(&scanline[x0], 0, x1 - x0 + 1);
+		xmin = x1 + 1;
+		xmax = x0 - 1;
 		for(s = 0; s < XVG_SUBSAMPLES; ++s)
 		{
 			float scany = (float)(y * XVG_SUBSAMPLES + s) + 0.5f;
@@ -939,7 +1511,7 @@ static void xvg_rasterize_sorted_edges(struct xvg_context_t * ctx, struct color_
 				}
 				else
 				{
-					z->x += z->dx;
+					xvg_step_active(z, scany);
 					step = &((*step)->next);
 				}
 			}
@@ -949,7 +1521,7 @@ static void xvg_rasterize_sorted_edges(struct xvg_context_t * ctx, struct color_
 				step = &active;
 				while(*step && (*step)->next)
 				{
-					if((*step)->x > (*step)->next->x)
+					if(xvg_active_after(*step, (*step)->next))
 					{
 						struct xvg_active_edge_t * t = *step;
 						struct xvg_active_edge_t * q = t->next;
@@ -967,14 +1539,14 @@ static void xvg_rasterize_sorted_edges(struct xvg_context_t * ctx, struct color_
 			{
 				if(ctx->edges[e].y1 > scany)
 				{
-					struct xvg_active_edge_t * z = xvg_add_active(ctx, &ctx->edges[e], scany);
+					struct xvg_active_edge_t * z = xvg_add_active(ctx, &ctx->edges[e], e, scany);
 					if(!z)
 						break;
 					if(!active)
 					{
 						active = z;
 					}
-					else if(z->x < active->x)
+					else if(xvg_active_after(active, z))
 					{
 						z->next = active;
 						active = z;
@@ -982,7 +1554,7 @@ static void xvg_rasterize_sorted_edges(struct xvg_context_t * ctx, struct color_
 					else
 					{
 						struct xvg_active_edge_t* p = active;
-						while(p->next && p->next->x < z->x)
+						while(p->next && xvg_active_after(z, p->next))
 							p = p->next;
 						z->next = p->next;
 						p->next = z;
@@ -991,14 +1563,19 @@ static void xvg_rasterize_sorted_edges(struct xvg_context_t * ctx, struct color_
 				e++;
 			}
 			if(active)
-				xvg_fill_active_edges(ctx->scanline, ctx->width, active, maxweight, &xmin, &xmax, rule);
+				xvg_fill_active_edges(scanline, x0, x1 + 1, active, maxweight, &xmin, &xmax, rule);
 		}
 		if(xmin < x0)
 			xmin = x0;
 		if(xmax > x1)
 			xmax = x1;
 		if(xmin <= xmax)
-			xvg_scanline_solid(&ctx->bitmap[y * ctx->stride] + xmin * 4, xmax - xmin + 1, &ctx->scanline[xmin], xmin, y, c);
+		{
+			if(mask)
+				memcpy(&mask[y * mstride + xmin], &scanline[xmin], xmax - xmin + 1);
+			else
+				xvg_scanline_solid(&ctx->bitmap[(y + dy) * ctx->stride] + (xmin + dx) * 4, xmax - xmin + 1, &scanline[xmin], xmin + dx, y + dy, &ctx->color);
+		}
 	}
 }
 
@@ -1056,9 +1633,8 @@ static void xvg_cubic_bezto(struct xvg_context_t * ctx, float cpx1, float cpy1,
 	xvg_add_point(ctx, x, y);
 }
 
-static void xvg_fill(struct xvg_context_t * ctx)
+static void xvg_flatten_fill(struct xvg_context_t * ctx)
 {
-	struct xvg_edge_t * e;
 	float * p;
 	int i, j;
 
@@ -1075,19 +1651,10 @@ static void xvg_fill(struct xvg_context_t * ctx)
 	xvg_add_path_point(ctx, ctx->pts[0], ctx->pts[1], 0);
 	for(i = 0, j = ctx->npoints - 1; i < ctx->npoints; j = i++)
 		xvg_add_edge(ctx, ctx->points[j].x, ctx->points[j].y, ctx->points[i].x, ctx->points[i].y);
-	for(i = 0; i < ctx->nedges; i++)
-	{
-		e = &ctx->edges[i];
-		e->y0 = e->y0 * XVG_SUBSAMPLES;
-		e->y1 = e->y1 * XVG_SUBSAMPLES;
-	}
-	qsort(ctx->edges, ctx->nedges, sizeof(struct xvg_edge_t), xvg_cmp_edge);
-	xvg_rasterize_sorted_edges(ctx, &ctx->color, ctx->rule);
 }
 
-static void xvg_stroke(struct xvg_context_t * ctx)
+static void xvg_flatten_stroke(struct xvg_context_t * ctx)
 {
-	struct xvg_edge_t * e;
 	struct xvg_point_t * p0, * p1;
 	float * p;
 	int i, closed;
@@ -1115,17 +1682,229 @@ static void xvg_stroke(struct xvg_context_t * ctx)
 	}
 	xvg_prepare_stroke(ctx, ctx->miter, ctx->join);
 	xvg_expand_stroke(ctx, ctx->points, ctx->npoints, closed, ctx->join, ctx->cap, ctx->thickness);
+}
+
+/*
+ * The coverage mask of a path, built once around its origin and kept by
+ * the path, the stroke and the thickness, so drawing the same outline again
+ * anywhere on any surface is only a blend of the color through the mask.
+ * Masks are evicted least recently used first once the cache is over its
+ * budget, and the ones too big to ever fit are rasterized straight into
+ * the clip instead.
+ */
+#define XVG_CACHE_HASH_SIZE		(256)
+#define XVG_CACHE_BUDGET		(CONFIG_RENDER_SHAPE_CACHE_SIZE)
+#define XVG_CACHE_LIMIT			(XVG_CACHE_BUDGET / 8)
+#define XVG_SHAPE_RANGE			(1 << 16)
+
+struct xvg_shape_t {
+	struct hlist_node node;
+	struct list_head entry;
+	uint32_t hash;
+	int ref;
+	int size;
+	int stroke;
+	float thickness;
+	float * pts;
+	int npts;
+	int x, y, w, h;
+	unsigned char * mask;
+};
+
+static struct hlist_head __xvg_cache_hash[XVG_CACHE_HASH_SIZE];
+static LIST_HEAD(__xvg_cache_lru);
+static struct cache_stat_t __xvg_cache_stat = {
+	.budget = XVG_CACHE_BUDGET,
+};
+static spinlock_t __xvg_cache_lock = SPIN_LOCK_INIT();
+
+static uint32_t xvg_shape_hash(float * pts, int npts, int stroke, float thickness)
+{
+	unsigned char * p = (unsigned char *)pts;
+	uint32_t h = 5381 + (stroke ? (uint32_t)(thickness * 64) : 0);
+	int l = npts * 2 * sizeof(float);
+	int i;
+
+	for(i = 0; i < l; i++)
+		h = (h << 5) + h + p[i];
+	return h;
+}
+
+static void xvg_shape_put(struct xvg_shape_t * sp)
+{
+	spin_lock(&__xvg_cache_lock);
+	if(--sp->ref > 0)
+		sp = NULL;
+	spin_unlock(&__xvg_cache_lock);
+	if(sp)
+		free(sp);
+}
+
+static struct xvg_shape_t * xvg_shape_get(struct xvg_context_t * ctx, uint32_t hash, int stroke)
+{
+	struct xvg_shape_t * sp;
+
+	spin_lock(&__xvg_cache_lock);
+	hlist_for_each_entry(sp, &__xvg_cache_hash[hash % XVG_CACHE_HASH_SIZE], node)
+	{
+		if((sp->hash == hash) && (sp->stroke == stroke) && (!stroke || (sp->thickness == ctx->thickness)) && (sp->npts == ctx->npts) && (memcmp(sp->pts, ctx->pts, ctx->npts * 2 * sizeof(float)) == 0))
+		{
+			list_move(&sp->entry, &__xvg_cache_lru);
+			sp->ref++;
+			__xvg_cache_stat.hit++;
+			spin_unlock(&__xvg_cache_lock);
+			return sp;
+		}
+	}
+	__xvg_cache_stat.miss++;
+	spin_unlock(&__xvg_cache_lock);
+	return NULL;
+}
+
+static void xvg_shape_add(struct xvg_shape_t * sp)
+{
+	struct xvg_shape_t * o;
+
+	spin_lock(&__xvg_cache_lock);
+	while((__xvg_cache_stat.bytes + sp->size > XVG_CACHE_BUDGET) && !list_empty(&__xvg_cache_lru))
+	{
+		o = list_last_entry(&__xvg_cache_lru, struct xvg_shape_t, entry);
+		list_del(&o->entry);
+		hlist_del(&o->node);
+		__xvg_cache_stat.bytes -= o->size;
+		__xvg_cache_stat.count--;
+		__xvg_cache_stat.evict++;
+		if(--o->ref == 0)
+			free(o);
+	}
+	hlist_add_head(&sp->node, &__xvg_cache_hash[sp->hash % XVG_CACHE_HASH_SIZE]);
+	list_add(&sp->entry, &__xvg_cache_lru);
+	__xvg_cache_stat.bytes += sp->size;
+	__xvg_cache_stat.count++;
+	sp->ref++;
+	spin_unlock(&__xvg_cache_lock);
+}
+
+/*
+ * Move the edges to the bound of the path, which is where the mask of
+ * the shape starts, in pixels from its origin
+ */
+static int xvg_shape_bound(struct xvg_context_t * ctx, int * x, int * y, int * w, int * h)
+{
+	struct xvg_edge_t * e;
+	float x0, y0, x1, y1;
+	int i;
+
+	if(ctx->nedges <= 0)
+		return 0;
+	e = &ctx->edges[0];
+	x0 = x1 = e->x0;
+	y0 = e->y0;
+	y1 = e->y1;
 	for(i = 0; i < ctx->nedges; i++)
 	{
 		e = &ctx->edges[i];
-		e->y0 = e->y0 * XVG_SUBSAMPLES;
-		e->y1 = e->y1 * XVG_SUBSAMPLES;
+		x0 = min(x0, min(e->x0, e->x1));
+		x1 = max(x1, max(e->x0, e->x1));
+		y0 = min(y0, e->y0);
+		y1 = max(y1, e->y1);
+	}
+	if((x0 < -XVG_SHAPE_RANGE) || (x1 > XVG_SHAPE_RANGE) || (y0 < -XVG_SHAPE_RANGE) || (y1 > XVG_SHAPE_RANGE))
+		return 0;
+	*x = (int)floorf(x0);
+	*y = (int)floorf(y0);
+	*w = (int)floorf(x1) - *x + 1;
+	*h = (int)ceilf(y1) - *y + 1;
+	for(i = 0; i < ctx->nedges; i++)
+	{
+		e = &ctx->edges[i];
+		e->x0 -= *x;
+		e->x1 -= *x;
+		e->y0 = (e->y0 - *y) * XVG_SUBSAMPLES;
+		e->y1 = (e->y1 - *y) * XVG_SUBSAMPLES;
 	}
 	qsort(ctx->edges, ctx->nedges, sizeof(struct xvg_edge_t), xvg_cmp_edge);
-	xvg_rasterize_sorted_edges(ctx, &ctx->color, ctx->rule);
+	return 1;
+}
+
+static void xvg_draw(struct xvg_context_t * ctx, int stroke)
+{
+	struct xvg_shape_t * sp;
+	struct region_t r;
+	unsigned char * m;
+	uint32_t hash;
+	int x, y, w, h, l;
+	int j;
+
+	if(ctx->npts <= 0)
+		return;
+	hash = xvg_shape_hash(ctx->pts, ctx->npts, stroke, ctx->thickness);
+	sp = xvg_shape_get(ctx, hash, stroke);
+	if(!sp)
+	{
+		if(stroke)
+			xvg_flatten_stroke(ctx);
+		else
+			xvg_flatten_fill(ctx);
+		if(!xvg_shape_bound(ctx, &x, &y, &w, &h))
+			return;
+		l = sizeof(struct xvg_shape_t) + ctx->npts * 2 * sizeof(float);
+		if(((int64_t)w * h + l > XVG_CACHE_LIMIT) || !(sp = malloc(l + w * h)))
+		{
+			region_init(&r, ctx->clip.x - ctx->ox - x, ctx->clip.y - ctx->oy - y, ctx->clip.w, ctx->clip.h);
+			region_init(&ctx->clip, 0, 0, w, h);
+			if(region_intersect(&r, &r, &ctx->clip))
+				xvg_rasterize_sorted_edges(ctx, &r, NULL, 0, ctx->ox + x, ctx->oy + y);
+			return;
+		}
+		init_hlist_node(&sp->node);
+		init_list_head(&sp->entry);
+		sp->hash = hash;
+		sp->ref = 1;
+		sp->size = l + w * h;
+		sp->stroke = stroke;
+		sp->thickness = ctx->thickness;
+		sp->pts = (float *)(sp + 1);
+		sp->npts = ctx->npts;
+		sp->x = x;
+		sp->y = y;
+		sp->w = w;
+		sp->h = h;
+		sp->mask = (unsigned char *)(sp->pts + ctx->npts * 2);
+		memcpy(sp->pts, ctx->pts, ctx->npts * 2 * sizeof(float));
+		memset(sp->mask, 0, w * h);
+		region_init(&r, 0, 0, w, h);
+		xvg_rasterize_sorted_edges(ctx, &r, sp->mask, w, 0, 0);
+		xvg_shape_add(sp);
+	}
+	region_init(&r, ctx->ox + sp->x, ctx->oy + sp->y, sp->w, sp->h);
+	if(region_intersect(&r, &r, &ctx->clip))
+	{
+		m = sp->mask + (r.y - ctx->oy - sp->y) * sp->w + (r.x - ctx->ox - sp->x);
+		for(j = 0; j < r.h; j++, m += sp->w)
+			xvg_scanline_solid(&ctx->bitmap[(r.y + j) * ctx->stride] + r.x * 4, r.w, m, r.x, r.y + j, &ctx->color);
+	}
+	xvg_shape_put(sp);
 }
 
-static void xvg_init(struct xvg_context_t * ctx, struct surface_t * s, struct region_t * clip, int thickness, struct color_t * c)
+static void xvg_fill(struct xvg_context_t * ctx)
+{
+	xvg_draw(ctx, 0);
+}
+
+static void xvg_stroke(struct xvg_context_t * ctx)
+{
+	xvg_draw(ctx, 1);
+}
+
+void render_shape_cache_stat(struct cache_stat_t * stat)
+{
+	spin_lock(&__xvg_cache_lock);
+	memcpy(stat, &__xvg_cache_stat, sizeof(struct cache_stat_t));
+	spin_unlock(&__xvg_cache_lock);
+}
+
+static void xvg_init(struct xvg_context_t * ctx, struct surface_t * s, struct region_t * clip, int ox, int oy, int thickness, struct color_t * c)
 {
 	ctx->tesstol = 0.25;
 	ctx->disttol = 0.01;
@@ -1138,12 +1917,14 @@ static void xvg_init(struct xvg_context_t * ctx, struct surface_t * s, struct re
 	ctx->freelist = NULL;
 	ctx->pages = NULL;
 	ctx->cpage = NULL;
-	ctx->bitmap = s->pixels;
+	ctx->bitmap = surface_get_pixels(s);
 	ctx->width = s->width;
 	ctx->height = s->height;
 	ctx->stride = s->stride;
-	ctx->cscanline = ctx->width;
-	ctx->scanline = malloc(ctx->cscanline);
+	ctx->ox = ox;
+	ctx->oy = oy;
+	ctx->cscanline = 0;
+	ctx->scanline = NULL;
 	ctx->pts = NULL;
 	ctx->cpts = 0;
 	ctx->npts = 0;
@@ -1181,6 +1962,8 @@ static void xvg_exit(struct xvg_context_t * ctx)
 			free(ctx->points);
 		if(ctx->scanline)
 			free(ctx->scanline);
+		if(ctx->pts)
+			free(ctx->pts);
 	}
 }
 
@@ -1195,9 +1978,9 @@ void render_default_shape_line(struct surface_t * s, struct region_t * clip, str
 		if(!region_intersect(&r, &r, clip))
 			return;
 	}
-	xvg_init(&ctx, s, &r, thickness, c);
-	xvg_move_to(&ctx, p0->x, p0->y);
-	xvg_line_to(&ctx, p1->x, p1->y);
+	xvg_init(&ctx, s, &r, p0->x, p0->y, thickness, c);
+	xvg_move_to(&ctx, 0, 0);
+	xvg_line_to(&ctx, p1->x - p0->x, p1->y - p0->y);
 	xvg_stroke(&ctx);
 	xvg_exit(&ctx);
 }
@@ -1216,11 +1999,11 @@ void render_default_shape_polyline(struct surface_t * s, struct region_t * clip,
 			if(!region_intersect(&r, &r, clip))
 				return;
 		}
-		xvg_init(&ctx, s, &r, thickness, c);
+		xvg_init(&ctx, s, &r, p[0].x, p[0].y, thickness, c);
 		xvg_reset(&ctx);
-		xvg_move_to(&ctx, p[0].x, p[0].y);
+		xvg_move_to(&ctx, 0, 0);
 		for(i = 1; i < n; i++)
-			xvg_line_to(&ctx, p[i].x, p[i].y);
+			xvg_line_to(&ctx, p[i].x - p[0].x, p[i].y - p[0].y);
 		xvg_stroke(&ctx);
 		xvg_exit(&ctx);
 	}
@@ -1240,11 +2023,11 @@ void render_default_shape_curve(struct surface_t * s, struct region_t * clip, st
 			if(!region_intersect(&r, &r, clip))
 				return;
 		}
-		xvg_init(&ctx, s, &r, thickness, c);
+		xvg_init(&ctx, s, &r, p[0].x, p[0].y, thickness, c);
 		xvg_reset(&ctx);
-		xvg_move_to(&ctx, p[0].x, p[0].y);
+		xvg_move_to(&ctx, 0, 0);
 		for(i = 1; i <= n - 3; i += 3)
-			xvg_cubic_bezto(&ctx, p[i].x, p[i].y, p[i + 1].x, p[i + 1].y, p[i + 2].x, p[i + 2].y);
+			xvg_cubic_bezto(&ctx, p[i].x - p[0].x, p[i].y - p[0].y, p[i + 1].x - p[0].x, p[i + 1].y - p[0].y, p[i + 2].x - p[0].x, p[i + 2].y - p[0].y);
 		xvg_stroke(&ctx);
 		xvg_exit(&ctx);
 	}
@@ -1261,12 +2044,12 @@ void render_default_shape_triangle(struct surface_t * s, struct region_t * clip,
 		if(!region_intersect(&r, &r, clip))
 			return;
 	}
-	xvg_init(&ctx, s, &r, thickness, c);
+	xvg_init(&ctx, s, &r, p0->x, p0->y, thickness, c);
 	xvg_reset(&ctx);
-	xvg_move_to(&ctx, p0->x, p0->y);
-	xvg_line_to(&ctx, p1->x, p1->y);
-	xvg_line_to(&ctx, p2->x, p2->y);
-	xvg_line_to(&ctx, p0->x, p0->y);
+	xvg_move_to(&ctx, 0, 0);
+	xvg_line_to(&ctx, p1->x - p0->x, p1->y - p0->y);
+	xvg_line_to(&ctx, p2->x - p0->x, p2->y - p0->y);
+	xvg_line_to(&ctx, 0, 0);
 	if(thickness > 0)
 		xvg_stroke(&ctx);
 	else
@@ -1286,59 +2069,59 @@ void render_default_shape_rectangle(struct surface_t * s, struct region_t * clip
 		if(!region_intersect(&r, &r, clip))
 			return;
 	}
-	xvg_init(&ctx, s, &r, thickness, c);
+	xvg_init(&ctx, s, &r, x, y, thickness, c);
 	xvg_reset(&ctx);
 	corner = (radius >> 16) & 0xf;
 	radius &= 0xffff;
 	if(radius > 0)
 	{
-		xvg_move_to(&ctx, x + radius, y);
-		xvg_line_to(&ctx, x + w - radius, y);
+		xvg_move_to(&ctx, radius, 0);
+		xvg_line_to(&ctx, w - radius, 0);
 		if(corner & (1 << 1))
 		{
-			xvg_line_to(&ctx, x + w, y);
-			xvg_line_to(&ctx, x + w, y + radius);
+			xvg_line_to(&ctx, w, 0);
+			xvg_line_to(&ctx, w, radius);
 		}
 		else
 		{
-			xvg_cubic_bezto(&ctx, x + w - radius * (1 - XVG_KAPPA90), y, x + w, y + radius * (1 - XVG_KAPPA90), x + w, y + radius);
+			xvg_cubic_bezto(&ctx, w - radius * (1 - XVG_KAPPA90), 0, w, radius * (1 - XVG_KAPPA90), w, radius);
 		}
-		xvg_line_to(&ctx, x + w, y + h - radius);
+		xvg_line_to(&ctx, w, h - radius);
 		if(corner & (1 << 2))
 		{
-			xvg_line_to(&ctx, x + w, y + h);
-			xvg_line_to(&ctx, w - radius, y + h);
+			xvg_line_to(&ctx, w, h);
+			xvg_line_to(&ctx, w - radius, h);
 		}
 		else
 		{
-			xvg_cubic_bezto(&ctx, x + w, y + h - radius * (1 - XVG_KAPPA90), x + w - radius * (1 - XVG_KAPPA90), y + h, x + w - radius, y + h);
+			xvg_cubic_bezto(&ctx, w, h - radius * (1 - XVG_KAPPA90), w - radius * (1 - XVG_KAPPA90), h, w - radius, h);
 		}
-		xvg_line_to(&ctx, x + radius, y + h);
+		xvg_line_to(&ctx, radius, h);
 		if(corner & (1 << 3))
 		{
-			xvg_line_to(&ctx, x, y + h);
+			xvg_line_to(&ctx, 0, h);
 		}
 		else
 		{
-			xvg_cubic_bezto(&ctx, x + radius * (1 - XVG_KAPPA90), y + h, x, y + h - radius * (1 - XVG_KAPPA90), x, y + h - radius);
+			xvg_cubic_bezto(&ctx, radius * (1 - XVG_KAPPA90), h, 0, h - radius * (1 - XVG_KAPPA90), 0, h - radius);
 		}
-		xvg_line_to(&ctx, x, y + radius);
+		xvg_line_to(&ctx, 0, radius);
 		if(corner & (1 << 0))
 		{
-			xvg_line_to(&ctx, x, y);
-			xvg_line_to(&ctx, x + radius, y);
+			xvg_line_to(&ctx, 0, 0);
+			xvg_line_to(&ctx, radius, 0);
 		}
 		else
 		{
-			xvg_cubic_bezto(&ctx, x, y + radius * (1 - XVG_KAPPA90), x + radius * (1 - XVG_KAPPA90), y, x + radius, y);
+			xvg_cubic_bezto(&ctx, 0, radius * (1 - XVG_KAPPA90), radius * (1 - XVG_KAPPA90), 0, radius, 0);
 		}
 	}
 	else
 	{
-		xvg_move_to(&ctx, x, y);
-		xvg_line_to(&ctx, x + w, y);
-		xvg_line_to(&ctx, x + w, y + h);
-		xvg_line_to(&ctx, x, y + h);
+		xvg_move_to(&ctx, 0, 0);
+		xvg_line_to(&ctx, w, 0);
+		xvg_line_to(&ctx, w, h);
+		xvg_line_to(&ctx, 0, h);
 	}
 	xvg_line_to(&ctx, ctx.pts[0], ctx.pts[1]);
 	if(thickness > 0)
@@ -1362,12 +2145,12 @@ void render_default_shape_polygon(struct surface_t * s, struct region_t * clip,
 			if(!region_intersect(&r, &r, clip))
 				return;
 		}
-		xvg_init(&ctx, s, &r, thickness, c);
+		xvg_init(&ctx, s, &r, p[0].x, p[0].y, thickness, c);
 		xvg_reset(&ctx);
-		xvg_move_to(&ctx, p[0].x, p[0].y);
+		xvg_move_to(&ctx, 0, 0);
 		for(i = 1; i < n; i++)
-			xvg_line_to(&ctx, p[i].x, p[i].y);
-		xvg_line_to(&ctx, p[0].x, p[0].y);
+			xvg_line_to(&ctx, p[i].x - p[0].x, p[i].y - p[0].y);
+		xvg_line_to(&ctx, 0, 0);
 		if(thickness > 0)
 			xvg_stroke(&ctx);
 		else
@@ -1389,13 +2172,13 @@ void render_default_shape_circle(struct surface_t * s, struct region_t * clip, i
 			if(!region_intersect(&r, &r, clip))
 				return;
 		}
-		xvg_init(&ctx, s, &r, thickness, c);
+		xvg_init(&ctx, s, &r, x, y, thickness, c);
 		xvg_reset(&ctx);
-		xvg_move_to(&ctx, x + radius, y);
-		xvg_cubic_bezto(&ctx, x + radius, y + radius * XVG_KAPPA90, x + radius * XVG_KAPPA90, y + radius, x, y + radius);
-		xvg_cubic_bezto(&ctx, x - radius * XVG_KAPPA90, y + radius, x - radius, y + radius * XVG_KAPPA90, x - radius, y);
-		xvg_cubic_bezto(&ctx, x - radius, y - radius * XVG_KAPPA90, x - radius * XVG_KAPPA90, y - radius, x, y - radius);
-		xvg_cubic_bezto(&ctx, x + radius * XVG_KAPPA90, y - radius, x + radius, y - radius * XVG_KAPPA90, x + radius, y);
+		xvg_move_to(&ctx, radius, 0);
+		xvg_cubic_bezto(&ctx, radius, radius * XVG_KAPPA90, radius * XVG_KAPPA90, radius, 0, radius);
+		xvg_cubic_bezto(&ctx, -radius * XVG_KAPPA90, radius, -radius, radius * XVG_KAPPA90, -radius, 0);
+		xvg_cubic_bezto(&ctx, -radius, -radius * XVG_KAPPA90, -radius * XVG_KAPPA90, -radius, 0, -radius);
+		xvg_cubic_bezto(&ctx, radius * XVG_KAPPA90, -radius, radius, -radius * XVG_KAPPA90, radius, 0);
 		xvg_line_to(&ctx, ctx.pts[0], ctx.pts[1]);
 		if(thickness > 0)
 			xvg_stroke(&ctx);
@@ -1418,13 +2201,13 @@ void render_default_shape_ellipse(struct surface_t * s, struct region_t * clip,
 			if(!region_intersect(&r, &r, clip))
 				return;
 		}
-		xvg_init(&ctx, s, &r, thickness, c);
+		xvg_init(&ctx, s, &r, x, y, thickness, c);
 		xvg_reset(&ctx);
-		xvg_move_to(&ctx, x + w, y);
-		xvg_cubic_bezto(&ctx, x + w, y + h * XVG_KAPPA90, x + w * XVG_KAPPA90, y + h, x, y + h);
-		xvg_cubic_bezto(&ctx, x - w * XVG_KAPPA90, y + h, x - w, y + h * XVG_KAPPA90, x - w, y);
-		xvg_cubic_bezto(&ctx, x - w, y - h * XVG_KAPPA90, x - w * XVG_KAPPA90, y - h, x, y - h);
-		xvg_cubic_bezto(&ctx, x + w * XVG_KAPPA90, y - h, x + w, y - h * XVG_KAPPA90, x + w, y);
+		xvg_move_to(&ctx, w, 0);
+		xvg_cubic_bezto(&ctx, w, h * XVG_KAPPA90, w * XVG_KAPPA90, h, 0, h);
+		xvg_cubic_bezto(&ctx, -w * XVG_KAPPA90, h, -w, h * XVG_KAPPA90, -w, 0);
+		xvg_cubic_bezto(&ctx, -w, -h * XVG_KAPPA90, -w * XVG_KAPPA90, -h, 0, -h);
+		xvg_cubic_bezto(&ctx, w * XVG_KAPPA90, -h, w, -h * XVG_KAPPA90, w, 0);
 		xvg_line_to(&ctx, ctx.pts[0], ctx.pts[1]);
 		if(thickness > 0)
 			xvg_stroke(&ctx);
@@ -1479,7 +2262,7 @@ void render_default_shape_arc(struct surface_t * s, struct region_t * clip, int
 			if(!region_intersect(&r, &r, clip))
 				return;
 		}
-		xvg_init(&ctx, s, &r, thickness, c);
+		xvg_init(&ctx, s, &r, x, y, thickness, c);
 		xvg_reset(&ctx);
 		angle1 = a1 * (M_PI / 180.0);
 		angle2 = a2 * (M_PI / 180.0);
@@ -1496,7 +2279,7 @@ void render_default_shape_arc(struct surface_t * s, struct region_t * clip, int
 		step = sweep / n;
 		for(i = 0; i < n; i++, start += step)
 		{
-			arcto_bezier(x, y, radius, start, step, cp);
+			arcto_bezier(0, 0, radius, start, step, cp);
 			if(i == 0)
 				xvg_move_to(&ctx, cp[0], cp[1]);
 			xvg_cubic_bezto(&ctx, cp[2], cp[3], cp[4], cp[5], cp[6], cp[7]);
@@ -1535,58 +2318,52 @@ void render_default_shape_gradient(struct surface_t * s, struct region_t * clip,
 	y0 = r.y - y;
 	x1 = x0 + r.w;
 	y1 = y0 + r.h;
-	for(j = 0; j < h; j++, q += stride)
+	for(j = y0, q += y0 * stride; j < y1; j++, q += stride)
 	{
-		if((j >= y0) && (j < y1))
+		if(h > 1)
+			u = (j << 8) / (h - 1);
+		else
+			u = 0;
+		v = 256 - u;
+		cl.b = (lt->b * v + lb->b * u) >> 8;
+		cl.g = (lt->g * v + lb->g * u) >> 8;
+		cl.r = (lt->r * v + lb->r * u) >> 8;
+		cl.a = (lt->a * v + lb->a * u) >> 8;
+		cr.b = (rt->b * v + rb->b * u) >> 8;
+		cr.g = (rt->g * v + rb->g * u) >> 8;
+		cr.r = (rt->r * v + rb->r * u) >> 8;
+		cr.a = (rt->a * v + rb->a * u) >> 8;
+		for(i = x0, p = q + (x0 << 2); i < x1; i++, p += 4)
 		{
-			if(h > 1)
-				u = (j << 8) / (h - 1);
+			if(w > 1)
+				u = (i << 8) / (w - 1);
 			else
 				u = 0;
 			v = 256 - u;
-			cl.b = (lt->b * v + lb->b * u) >> 8;
-			cl.g = (lt->g * v + lb->g * u) >> 8;
-			cl.r = (lt->r * v + lb->r * u) >> 8;
-			cl.a = (lt->a * v + lb->a * u) >> 8;
-			cr.b = (rt->b * v + rb->b * u) >> 8;
-			cr.g = (rt->g * v + rb->g * u) >> 8;
-			cr.r = (rt->r * v + rb->r * u) >> 8;
-			cr.a = (rt->a * v + rb->a * u) >> 8;
-			for(i = 0, p = q; i < w; i++, p += 4)
+			sa = (cl.a * v + cr.a * u) >> 8;
+			if(sa != 0)
 			{
-				if((i >= x0) && (i < x1))
+				if(sa == 255)
 				{
-					if(w > 1)
-						u = (i << 8) / (w - 1);
-					else
-						u = 0;
-					v = 256 - u;
-					sa = (cl.a * v + cr.a * u) >> 8;
-					if(sa != 0)
-					{
-						if(sa == 255)
-						{
-							p[0] = (cl.b * v + cr.b * u) >> 8;
-							p[1] = (cl.g * v + cr.g * u) >> 8;
-							p[2] = (cl.r * v + cr.r * u) >> 8;
-							p[3] = sa;
-						}
-						else
-						{
-							sr = idiv255(((cl.r * v + cr.r * u) >> 8) * sa);
-							sg = idiv255(((cl.g * v + cr.g * u) >> 8) * sa);
-							sb = idiv255(((cl.b * v + cr.b * u) >> 8) * sa);
-							db = p[0];
-							dg = p[1];
-							dr = p[2];
-							da = p[3];
-							t = sa + (sa >> 8);
-							p[3] = (((sa + da) << 8) - da * t) >> 8;
-							p[2] = (((sr + dr) << 8) - dr * t) >> 8;
-							p[1] = (((sg + dg) << 8) - dg * t) >> 8;
-							p[0] = (((sb + db) << 8) - db * t) >> 8;
-						}
-					}
+					p[0] = (cl.b * v + cr.b * u) >> 8;
+					p[1] = (cl.g * v + cr.g * u) >> 8;
+					p[2] = (cl.r * v + cr.r * u) >> 8;
+					p[3] = sa;
+				}
+				else
+				{
+					sr = idiv255(((cl.r * v + cr.r * u) >> 8) * sa);
+					sg = idiv255(((cl.g * v + cr.g * u) >> 8) * sa);
+					sb = idiv255(((cl.b * v + cr.b * u) >> 8) * sa);
+					db = p[0];
+					dg = p[1];
+					dr = p[2];
+					da = p[3];
+					t = sa + (sa >> 8);
+					p[3] = (((sa + da) << 8) - da * t) >> 8;
+					p[2] = (((sr + dr) << 8) - dr * t) >> 8;
+					p[1] = (((sg + dg) << 8) - dg * t) >> 8;
+					p[0] = (((sb + db) << 8) - db * t) >> 8;
 				}
 			}
 		}
@@ -1615,7 +2392,7 @@ void render_default_shape_checkerboard(struct surface_t * s, struct region_t * c
 	x2 = r.x + r.w;
 	y2 = r.y + r.h;
 	l = s->stride >> 2;
-	q = (uint32_t *)s->pixels + y1 * l + x1;
+	q = (uint32_t *)surface_get_pixels(s) + y1 * l + x1;
 
 	for(j = y1; j < y2; j++, q += l)
 	{
@@ -2201,7 +2978,7 @@ void render_default_filter_opacity(struct surface_t * s, int alpha)
 	switch(v)
 	{
 	case 0:
-		memset(s->pixels, 0, s->pixlen);
+		memset(p, 0, s->pixlen);
 		break;
 	case 256:
 		break;
@@ -2764,3 +3541,5 @@ void render_default_filter_dilate(struct surface_t * s, int times)
 		free(pixels);
 	}
 }
+
+core_initcall(render_cubic_weights_init);
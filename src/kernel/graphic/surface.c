@@ -88,6 +88,11 @@ inline __attribute__((always_inline)) struct render_t * search_render(void)
 	return r;
 }
 
+struct render_t * search_render_default(void)
+{
+	return &render_default;
+}
+
 bool_t register_render(struct render_t * r)
 {
 	irq_flags_t flags;
@@ -145,6 +150,7 @@ struct surface_t * surface_alloc(int width, int height, void * priv)
 	s->stride = stride;
 	s->pixlen = pixlen;
 	s->pixels = pixels;
+	s->version = 0;
 	s->r = search_render();
 	s->rctx = s->r->create(s);
 	s->priv = priv;
@@ -192,6 +198,7 @@ struct surface_t * surface_clone(struct surface_t * s, int x, int y, int w, int
 
 	if(!s)
 		return NULL;
+	surface_flush(s);
 
 	if((w <= 0) || (h <= 0))
 	{
@@ -353,6 +360,7 @@ struct surface_t * surface_clone(struct surface_t * s, int x, int y, int w, int
 	o->stride = stride;
 	o->pixlen = pixlen;
 	o->pixels = pixels;
+	o->version = 0;
 	o->r = s->r;
 	o->rctx = o->r->create(o);
 	o->priv = NULL;
@@ -369,6 +377,7 @@ struct surface_t * surface_extend(struct surface_t * s, int width, int height, c
 
 	if(!s || (width <= 0) || (height <= 0))
 		return NULL;
+	surface_flush(s);
 
 	o = malloc(sizeof(struct surface_t));
 	if(!o)
@@ -442,6 +451,7 @@ struct surface_t * surface_extend(struct surface_t * s, int width, int height, c
 	o->stride = stride;
 	o->pixlen = pixlen;
 	o->pixels = pixels;
+	o->version = 0;
 	o->r = s->r;
 	o->rctx = o->r->create(o);
 	o->priv = NULL;
@@ -456,6 +466,8 @@ void surface_clear(struct surface_t * s, struct color_t * c, int x, int y, int w
 
 	if(s)
 	{
+		surface_flush(s);
+		s->version++;
 		v = c ? color_get_premult(c) : 0;
 		if((w <= 0) || (h <= 0))
 		{
@@ -505,7 +517,7 @@ void surface_set_pixel(struct surface_t * s, int x, int y, struct color_t * c)
 {
 	if(c && s && (x < s->width) && (y < s->height))
 	{
-		uint32_t * p = (uint32_t *)s->pixels + y * (s->stride >> 2) + x;
+		uint32_t * p = (uint32_t *)surface_get_pixels(s) + y * (s->stride >> 2) + x;
 		*p = color_get_premult(c);
 	}
 }
@@ -516,7 +528,9 @@ void surface_get_pixel(struct surface_t * s, int x, int y, struct color_t * c)
 	{
 		if(s && (x < s->width) && (y < s->height))
 		{
-			uint32_t * p = (uint32_t *)s->pixels + y * (s->stride >> 2) + x;
+			uint32_t * p;
+			surface_flush(s);
+			p = (uint32_t *)s->pixels + y * (s->stride >> 2) + x;
 			color_set_premult(c, *p);
 		}
 		else
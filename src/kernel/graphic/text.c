@@ -26,27 +26,108 @@
  *
  */
 
+#include <xconfigs.h>
 #include <ctype.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <spinlock.h>
 #include <charset.h>
 #include <graphic/surface.h>
+#include <graphic/atlas.h>
 #include <graphic/font.h>
 #include <graphic/text.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_CACHE_MANAGER_H
 
-static void text_metrics(struct text_t * txt)
+/*
+ * A text run is the layout of a string, the face and index of every glyph
+ * with its pen relative to the origin of the text, and the metrics of the
+ * whole, shaped once for the string, family, size and wrap. Runs are found
+ * again by the hash kept in the text until its content changes, and are
+ * evicted least recently used first once the cache is over its budget.
+ */
+#define TEXT_RUN_HASH_SIZE		(256)
+#define TEXT_RUN_BUDGET			(CONFIG_TEXT_RUN_CACHE_SIZE)
+#define TEXT_RUN_LIMIT			(TEXT_RUN_BUDGET / 8)
+
+struct text_run_glyph_t {
+	uint32_t face;
+	uint32_t index;
+	int tx, ty;
+	int dx, dy;
+};
+
+struct text_run_t {
+	struct hlist_node node;
+	struct list_head entry;
+	uint32_t hash;
+	int ref;
+	int bytes;
+	uint32_t serial;
+	int size;
+	int wrap;
+	char * utf8;
+	char * family;
+	int ox, oy;
+	int width, height;
+	int count;
+	struct text_run_glyph_t * glyphs;
+};
+
+static struct hlist_head __text_run_hash[TEXT_RUN_HASH_SIZE];
+static LIST_HEAD(__text_run_lru);
+static struct cache_stat_t __text_run_stat = {
+	.budget = TEXT_RUN_BUDGET,
+};
+static spinlock_t __text_run_lock = SPIN_LOCK_INIT();
+
+static uint32_t text_run_hash(struct text_t * txt)
+{
+	const unsigned char * p;
+	uint32_t h = 5381 + txt->fctx->serial * 31 + txt->size * 131 + txt->wrap * 7;
+
+	for(p = (const unsigned char *)txt->utf8; *p; p++)
+		h = (h << 5) + h + *p;
+	if(txt->family)
+	{
+		h = (h << 5) + h + '|';
+		for(p = (const unsigned char *)txt->family; *p; p++)
+			h = (h << 5) + h + *p;
+	}
+	return h;
+}
+
+static inline int text_run_match(struct text_run_t * r, struct text_t * txt)
 {
+	if((r->hash != txt->run) || (r->serial != txt->fctx->serial) || (r->size != txt->size) || (r->wrap != txt->wrap))
+		return 0;
+	if(strcmp(r->utf8, txt->utf8) != 0)
+		return 0;
+	if(!r->family || !txt->family)
+		return (r->family == txt->family);
+	return (strcmp(r->family, txt->family) == 0);
+}
+
+static struct text_run_t * text_run_shape(struct text_t * txt)
+{
+	struct text_run_t * r;
+	struct text_run_glyph_t * glyphs, * g;
 	FTC_SBit sbit;
 	const char * p;
-	uint32_t code;
+	uint32_t code, face, index;
 	int col = 0, row = 0;
 	int tw = 0, th = 0, lh = 0;
 	int x = 0, y = 0, w = 0, h = 0;
+	int tx = 0, ty = 0, dx = 0, dy = 0;
+	int lu, lf, n = 0;
 
+	lu = strlen(txt->utf8) + 1;
+	lf = txt->family ? strlen(txt->family) + 1 : 0;
+	glyphs = malloc(lu * sizeof(struct text_run_glyph_t));
+	if(!glyphs)
+		return NULL;
 	p = txt->utf8;
 	while(*p)
 	{
@@ -61,6 +142,8 @@ static void text_metrics(struct text_t * txt)
 			if(th > h)
 				h = th;
 			col = 0;
+			tx = 0;
+			dx = dy = 0;
 			break;
 
 		case '\n':
@@ -73,6 +156,9 @@ static void text_metrics(struct text_t * txt)
 				h = th;
 			col = 0;
 			row++;
+			tx = 0;
+			ty += txt->size;
+			dx = dy = 0;
 			break;
 
 		case '\t':
@@ -83,10 +169,12 @@ static void text_metrics(struct text_t * txt)
 			if(th > h)
 				h = th;
 			col++;
+			tx += txt->size * 2;
+			dx = dy = 0;
 			break;
 
 		default:
-			sbit = (FTC_SBit)font_lookup_bitmap(txt->fctx, txt->family, txt->size, code);
+			sbit = (FTC_SBit)font_lookup_bitmap_index(txt->fctx, txt->family, txt->size, code, &face, &index);
 			if(sbit)
 			{
 				if((txt->wrap > 0) && (tw + sbit->xadvance > txt->wrap))
@@ -100,7 +188,19 @@ static void text_metrics(struct text_t * txt)
 						h = th;
 					col = 0;
 					row++;
+					tx = 0;
+					ty += txt->size;
+					dx = dy = 0;
 				}
+				g = &glyphs[n++];
+				g->face = face;
+				g->index = index;
+				g->tx = tx;
+				g->ty = ty;
+				g->dx = dx;
+				g->dy = dy;
+				dx += sbit->xadvance;
+				dy += sbit->yadvance;
 				tw += sbit->xadvance;
 				th += 0;
 				if(sbit->yadvance + sbit->height > lh)
@@ -124,10 +224,119 @@ static void text_metrics(struct text_t * txt)
 			break;
 		}
 	}
-	txt->metrics.ox = x;
-	txt->metrics.oy = y;
-	txt->metrics.width = w;
-	txt->metrics.height = h + lh;
+
+	r = malloc(sizeof(struct text_run_t) + n * sizeof(struct text_run_glyph_t) + lu + lf);
+	if(!r)
+	{
+		free(glyphs);
+		return NULL;
+	}
+	init_hlist_node(&r->node);
+	init_list_head(&r->entry);
+	r->hash = txt->run;
+	r->ref = 1;
+	r->bytes = sizeof(struct text_run_t) + n * sizeof(struct text_run_glyph_t) + lu + lf;
+	r->serial = txt->fctx->serial;
+	r->size = txt->size;
+	r->wrap = txt->wrap;
+	r->glyphs = (struct text_run_glyph_t *)(r + 1);
+	r->utf8 = (char *)(r->glyphs + n);
+	r->family = txt->family ? r->utf8 + lu : NULL;
+	r->ox = x;
+	r->oy = y;
+	r->width = w;
+	r->height = h + lh;
+	r->count = n;
+	memcpy(r->glyphs, glyphs, n * sizeof(struct text_run_glyph_t));
+	memcpy(r->utf8, txt->utf8, lu);
+	if(r->family)
+		memcpy(r->family, txt->family, lf);
+	free(glyphs);
+	return r;
+}
+
+static void text_run_put(struct text_run_t * r)
+{
+	spin_lock(&__text_run_lock);
+	if(--r->ref > 0)
+		r = NULL;
+	spin_unlock(&__text_run_lock);
+	if(r)
+		free(r);
+}
+
+static struct text_run_t * text_run_get(struct text_t * txt)
+{
+	struct text_run_t * r, * o;
+
+	spin_lock(&__text_run_lock);
+	hlist_for_each_entry(r, &__text_run_hash[txt->run % TEXT_RUN_HASH_SIZE], node)
+	{
+		if(text_run_match(r, txt))
+		{
+			list_move(&r->entry, &__text_run_lru);
+			r->ref++;
+			__text_run_stat.hit++;
+			spin_unlock(&__text_run_lock);
+			return r;
+		}
+	}
+	__text_run_stat.miss++;
+	spin_unlock(&__text_run_lock);
+
+	r = text_run_shape(txt);
+	if(r && (r->bytes <= TEXT_RUN_LIMIT))
+	{
+		spin_lock(&__text_run_lock);
+		while((__text_run_stat.bytes + r->bytes > TEXT_RUN_BUDGET) && !list_empty(&__text_run_lru))
+		{
+			o = list_last_entry(&__text_run_lru, struct text_run_t, entry);
+			list_del(&o->entry);
+			hlist_del(&o->node);
+			__text_run_stat.bytes -= o->bytes;
+			__text_run_stat.count--;
+			__text_run_stat.evict++;
+			if(--o->ref == 0)
+				free(o);
+		}
+		hlist_add_head(&r->node, &__text_run_hash[r->hash % TEXT_RUN_HASH_SIZE]);
+		list_add(&r->entry, &__text_run_lru);
+		__text_run_stat.bytes += r->bytes;
+		__text_run_stat.count++;
+		r->ref++;
+		spin_unlock(&__text_run_lock);
+	}
+	return r;
+}
+
+static void text_metrics(struct text_t * txt)
+{
+	struct text_run_t * r;
+
+	txt->run = text_run_hash(txt);
+	r = text_run_get(txt);
+	if(r)
+	{
+		txt->metrics.ox = r->ox;
+		txt->metrics.oy = r->oy;
+		txt->metrics.width = r->width;
+		txt->metrics.height = r->height;
+		text_run_put(r);
+	}
+	else
+	{
+		txt->metrics.ox = 0;
+		txt->metrics.oy = 0;
+		txt->metrics.width = 0;
+		txt->metrics.height = 0;
+	}
+}
+
+void text_run_cache_stat(struct cache_stat_t * stat)
+{
+	spin_lock(&__text_run_lock);
+	memcpy(stat, &__text_run_stat, sizeof(struct cache_stat_t));
+	spin_unlock(&__text_run_lock);
 }
 
 void text_init(struct text_t * txt, const char * utf8, struct color_t * c, int wrap, struct font_context_t * fctx, const char * family, int size)
@@ -186,9 +395,22 @@ void text_set_size(struct text_t * txt, int size)
 	}
 }
 
-static inline void draw_font_bitmap(struct surface_t * s, struct region_t * clip, struct color_t * c, int x, int y, FTC_SBit sbit)
+/*
+ * Glyphs of a text are drawn in batches of sub-rects out of the atlas,
+ * clipped against the same surface and clip and blended with the same
+ * color, the pages they come from stay pinned until the batch is done.
+ */
+#define TEXT_BATCH_SIZE			(64)
+
+struct text_blit_t {
+	int x, y;
+	struct atlas_glyph_t g;
+};
+
+static void draw_font_batch(struct surface_t * s, struct region_t * clip, struct color_t * c, struct text_blit_t * blits, int n)
 {
-	struct region_t region, r;
+	struct text_blit_t * b;
+	struct region_t region, cr, r;
 	uint32_t color;
 	uint32_t * dp, dv;
 	uint8_t * sp, gray;
@@ -198,69 +420,75 @@ static inline void draw_font_bitmap(struct surface_t * s, struct region_t * clip
 	int dx, dy, dw, dh;
 	int sx, sy;
 	int dskip, sskip;
-	int i, j, t;
+	int i, j, k, t;
 
-	region_init(&r, 0, 0, s->width, s->height);
-	if(clip)
-	{
-		if(!region_intersect(&r, &r, clip))
-			return;
-	}
-	region_init(&region, x, y, sbit->width, sbit->height);
-	if(!region_intersect(&r, &r, &region))
+	if(n <= 0)
 		return;
-
-	dx = r.x;
-	dy = r.y;
-	dw = r.w;
-	dh = r.h;
-	sx = r.x - x;
-	sy = r.y - y;
-	dskip = s->width - dw;
-	sskip = sbit->pitch - dw;
-	dp = (uint32_t *)s->pixels + dy * s->width + dx;
-	sp = (uint8_t *)sbit->buffer + sy * sbit->pitch + sx;
-	color = (c->a << 24) | (c->r << 16) | (c->g << 8) | (c->b << 0);
-
-	for(j = 0; j < dh; j++)
+	region_init(&cr, 0, 0, s->width, s->height);
+	if(!clip || region_intersect(&cr, &cr, clip))
 	{
-		for(i = 0; i < dw; i++)
+		color = (c->a << 24) | (c->r << 16) | (c->g << 8) | (c->b << 0);
+		for(k = 0; k < n; k++)
 		{
-			gray = *sp;
-			if(gray != 0)
+			b = &blits[k];
+			region_init(&region, b->x, b->y, b->g.width, b->g.height);
+			if(!region_intersect(&r, &cr, &region))
+				continue;
+
+			dx = r.x;
+			dy = r.y;
+			dw = r.w;
+			dh = r.h;
+			sx = r.x - b->x;
+			sy = r.y - b->y;
+			dskip = s->width - dw;
+			sskip = b->g.pitch - dw;
+			dp = (uint32_t *)surface_get_pixels(s) + dy * s->width + dx;
+			sp = b->g.buffer + sy * b->g.pitch + sx;
+
+			for(j = 0; j < dh; j++)
 			{
-				if(gray == 255)
-				{
-					*dp = color;
-				}
-				else
+				for(i = 0; i < dw; i++)
 				{
-					sr = idiv255(c->r * gray);
-					sg = idiv255(c->g * gray);
-					sb = idiv255(c->b * gray);
-					sa = idiv255(c->a * gray);
-					dv = *dp;
-					da = (dv >> 24) & 0xff;
-					dr = (dv >> 16) & 0xff;
-					dg = (dv >> 8) & 0xff;
-					db = (dv >> 0) & 0xff;
-					t = sa + (sa >> 8);
-					ta = (((sa + da) << 8) - da * t) >> 8;
-					tr = (((sr + dr) << 8) - dr * t) >> 8;
-					tg = (((sg + dg) << 8) - dg * t) >> 8;
-					tb = (((sb + db) << 8) - db * t) >> 8;
-					*dp = (ta << 24) | (tr << 16) | (tg << 8) | (tb << 0);
+					gray = *sp;
+					if(gray != 0)
+					{
+						if(gray == 255)
+						{
+							*dp = color;
+						}
+						else
+						{
+							sr = idiv255(c->r * gray);
+							sg = idiv255(c->g * gray);
+							sb = idiv255(c->b * gray);
+							sa = idiv255(c->a * gray);
+							dv = *dp;
+							da = (dv >> 24) & 0xff;
+							dr = (dv >> 16) & 0xff;
+							dg = (dv >> 8) & 0xff;
+							db = (dv >> 0) & 0xff;
+							t = sa + (sa >> 8);
+							ta = (((sa + da) << 8) - da * t) >> 8;
+							tr = (((sr + dr) << 8) - dr * t) >> 8;
+							tg = (((sg + dg) << 8) - dg * t) >> 8;
+							tb = (((sb + db) << 8) - db * t) >> 8;
+							*dp = (ta << 24) | (tr << 16) | (tg << 8) | (tb << 0);
+						}
+					}
+					sp++;
+					dp++;
 				}
+				dp += dskip;
+				sp += sskip;
 			}
-			sp++;
-			dp++;
 		}
-		dp += dskip;
-		sp += sskip;
 	}
+	for(k = 0; k < n; k++)
+		atlas_release(&blits[k].g);
 }
 
-static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip, struct color_t * c, int x, int y, FT_Bitmap * bitmap)
+static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip, struct color_t * c, int x, int y, struct font_glyph_t * g)
 {
 	struct region_t region, r;
 	uint32_t color;
@@ -280,7 +508,7 @@ static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip,
 		if(!region_intersect(&r, &r, clip))
 			return;
 	}
-	region_init(&region, x, y, bitmap->width, bitmap->rows);
+	region_init(&region, x, y, g->width, g->height);
 	if(!region_intersect(&r, &r, &region))
 		return;
 
@@ -291,9 +519,9 @@ static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip,
 	sx = r.x - x;
 	sy = r.y - y;
 	dskip = s->width - dw;
-	sskip = bitmap->pitch - dw;
-	dp = (uint32_t *)s->pixels + dy * s->width + dx;
-	sp = (uint8_t *)bitmap->buffer + sy * bitmap->pitch + sx;
+	sskip = g->pitch - dw;
+	dp = (uint32_t *)surface_get_pixels(s) + dy * s->width + dx;
+	sp = g->buffer + sy * g->pitch + sx;
 	color = color_get_premult(c);
 
 	for(j = 0; j < dh; j++)
@@ -336,82 +564,65 @@ static inline void draw_font_glyph(struct surface_t * s, struct region_t * clip,
 
 void render_default_text(struct surface_t * s, struct region_t * clip, struct matrix_t * m, struct text_t * txt)
 {
+	struct text_blit_t blits[TEXT_BATCH_SIZE], * b;
+	struct text_run_t * r;
+	struct text_run_glyph_t * rg;
+	struct font_glyph_t * g;
 	FTC_SBit sbit;
-	FT_BitmapGlyph bitmap;
-	FT_Glyph glyph, gly;
-	FT_Matrix matrix;
 	FT_Vector pen;
 	const char * p;
-	uint32_t code;
+	uint32_t code, serial;
 	int tx, ty, tw;
+	int i, n;
 
 	if((m->a == 1.0) && (m->b == 0.0) && (m->c == 0.0) && (m->d == 1.0))
 	{
-		tx = txt->metrics.ox;
-		ty = txt->metrics.oy;
-		tw = 0;
-		pen.x = (FT_Pos)(m->tx + tx);
-		pen.y = (FT_Pos)(m->ty + ty);
-
-		p = txt->utf8;
-		while(*p)
+		r = text_run_get(txt);
+		if(r)
 		{
-			p = utf8_to_code(p, &code);
-			switch(code)
+			serial = txt->fctx->serial;
+			for(i = 0, n = 0; i < r->count; i++)
 			{
-			case '\r':
-				tx = txt->metrics.ox;
-				ty += 0;
-				tw = 0;
-				pen.x = (FT_Pos)(m->tx + tx);
-				pen.y = (FT_Pos)(m->ty + ty);
-				break;
-
-			case '\n':
-				tx = txt->metrics.ox;
-				ty += txt->size;
-				tw = 0;
-				pen.x = (FT_Pos)(m->tx + tx);
-				pen.y = (FT_Pos)(m->ty + ty);
-				break;
-
-			case '\t':
-				tx += txt->size * 2;
-				ty += 0;
-				tw += txt->size * 2;
-				pen.x = (FT_Pos)(m->tx + tx);
-				pen.y = (FT_Pos)(m->ty + ty);
-				break;
-
-			default:
-				sbit = (FTC_SBit)font_lookup_bitmap(txt->fctx, txt->family, txt->size, code);
-				if(sbit)
+				rg = &r->glyphs[i];
+				b = &blits[n];
+				if(!atlas_lookup(serial, rg->face, txt->size, rg->index, &b->g))
 				{
-					if((txt->wrap > 0) && (tw + sbit->xadvance > txt->wrap))
+					sbit = (FTC_SBit)font_index_bitmap(txt->fctx, rg->face, txt->size, rg->index);
+					if(!sbit)
+						continue;
+					if(!atlas_insert(serial, rg->face, txt->size, rg->index, sbit->left, sbit->top, sbit->width, sbit->height, sbit->pitch, sbit->buffer, &b->g))
 					{
-						tx = txt->metrics.ox;
-						ty += txt->size;
-						tw = 0;
-						pen.x = (FT_Pos)(m->tx + tx);
-						pen.y = (FT_Pos)(m->ty + ty);
-					}
-					tw += sbit->xadvance;
-					{
-						draw_font_bitmap(s, clip, txt->c, pen.x, pen.y - sbit->top, sbit);
-						pen.x += sbit->xadvance;
-						pen.y += sbit->yadvance;
+						draw_font_batch(s, clip, txt->c, blits, n);
+						n = 0;
+						b = &blits[0];
+						if(!atlas_insert(serial, rg->face, txt->size, rg->index, sbit->left, sbit->top, sbit->width, sbit->height, sbit->pitch, sbit->buffer, &b->g))
+						{
+							b->g.left = sbit->left;
+							b->g.top = sbit->top;
+							b->g.width = sbit->width;
+							b->g.height = sbit->height;
+							b->g.pitch = sbit->pitch;
+							b->g.buffer = sbit->buffer;
+							b->g.page = NULL;
+						}
 					}
 				}
-				break;
+				pen.x = (FT_Pos)(m->tx + txt->metrics.ox + rg->tx) + rg->dx;
+				pen.y = (FT_Pos)(m->ty + txt->metrics.oy + rg->ty) + rg->dy;
+				b->x = pen.x;
+				b->y = pen.y - b->g.top;
+				if(!b->g.page || (++n == TEXT_BATCH_SIZE))
+				{
+					draw_font_batch(s, clip, txt->c, blits, b->g.page ? n : 1);
+					n = 0;
+				}
 			}
+			draw_font_batch(s, clip, txt->c, blits, n);
+			text_run_put(r);
 		}
 	}
 	else
 	{
-		matrix.xx = (FT_Fixed)(m->a * 65536);
-		matrix.xy = -((FT_Fixed)(m->c * 65536));
-		matrix.yx = -((FT_Fixed)(m->b * 65536));
-		matrix.yy = (FT_Fixed)(m->d * 65536);
 		tx = txt->metrics.ox;
 		ty = txt->metrics.oy;
 		tw = 0;
@@ -449,28 +660,24 @@ void render_default_text(struct surface_t * s, struct region_t * clip, struct ma
 				break;
 
 			default:
-				glyph = (FT_Glyph)font_lookup_glyph(txt->fctx, txt->family, txt->size, code);
-				if(glyph)
+				g = font_lookup_transformed_glyph(txt->fctx, txt->family, txt->size, code, m, pen.x & 0x3f, pen.y & 0x3f);
+				if(g)
 				{
-					if((txt->wrap > 0) && (tw + (glyph->advance.x >> 16) > txt->wrap))
+					if((txt->wrap > 0) && (tw + g->advance > txt->wrap))
 					{
 						tx = txt->metrics.ox;
 						ty += txt->size;
 						tw = 0;
 						pen.x = (FT_Pos)((m->tx + m->a * tx + m->c * ty) * 64);
 						pen.y = (FT_Pos)((s->height - (m->ty + m->b * tx + m->d * ty)) * 64);
+						g = font_lookup_transformed_glyph(txt->fctx, txt->family, txt->size, code, m, pen.x & 0x3f, pen.y & 0x3f);
+						if(!g)
+							break;
 					}
-					tw += (glyph->advance.x >> 16);
-					if(FT_Glyph_Copy(glyph, &gly) == 0)
-					{
-						FT_Glyph_Transform(gly, &matrix, &pen);
-						FT_Glyph_To_Bitmap(&gly, FT_RENDER_MODE_NORMAL, NULL, 1);
-						bitmap = (FT_BitmapGlyph)gly;
-						draw_font_glyph(s, clip, txt->c, bitmap->left, s->height - bitmap->top, &bitmap->bitmap);
-						pen.x += bitmap->root.advance.x >> 10;
-						pen.y += bitmap->root.advance.y >> 10;
-						FT_Done_Glyph(gly);
-					}
+					tw += g->advance;
+					draw_font_glyph(s, clip, txt->c, (pen.x >> 6) + g->left, s->height - ((pen.y >> 6) + g->top), g);
+					pen.x += g->ax;
+					pen.y += g->ay;
 				}
 				break;
 			}
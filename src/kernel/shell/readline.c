@@ -869,7 +869,7 @@ char * readline(const char * prompt)
 		}
 		else
 		{
-			task_yield();
+			task_sleep(10 * 1000000ULL);
 		}
 	}
 
@@ -26,30 +26,185 @@
  *
  */
 
+#include <xboot.h>
 #include <clockevent/clockevent.h>
 #include <clocksource/clocksource.h>
 #include <time/timer.h>
 
-static struct timer_base_t __timer_base = {
-	.head = { NULL },
-	.next = NULL,
-	.ce = NULL,
-	.lock = SPIN_LOCK_INIT(),
-};
+/*
+ * Every cpu has its own timer base. Timers due at least one tick away go
+ * to a hierarchical timing wheel, where start and cancel are O(1) and all
+ * timers of a tick expire as one batch; a tick is 2^CONFIG_TIMER_WHEEL_SHIFT
+ * nanoseconds and a wheel timer never fires early, at most one tick late.
+ * Closer deadlines stay in a per-cpu rbtree with full resolution.
+ *
+ * There is a single clockevent. Its handler services all bases, and the
+ * clockevent is only ever moved to an earlier deadline, so cancel does not
+ * touch it; a stale event just finds nothing to do.
+ */
+#define TIMER_TICK_NS			(1ULL << CONFIG_TIMER_WHEEL_SHIFT)
+#define TIMER_L0_SIZE			(1 << TIMER_WHEEL_L0_BITS)
+#define TIMER_LN_SIZE			(1 << TIMER_WHEEL_LN_BITS)
+#define TIMER_WHEEL_SPAN		(1ULL << (TIMER_WHEEL_L0_BITS + (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_LN_BITS))
+
+static struct timer_base_t __timer_base[CONFIG_MAX_SMP_CPUS];
+static struct clockevent_t * __timer_ce = NULL;
+static ktime_t __timer_ce_next = { .tv64 = KTIME_MAX };
+static spinlock_t __timer_ce_lock = SPIN_LOCK_INIT();
+
+static inline int wheel_shift(int level)
+{
+	return (level > 0) ? TIMER_WHEEL_L0_BITS + (level - 1) * TIMER_WHEEL_LN_BITS : 0;
+}
+
+static inline int wheel_slot(int level, uint64_t tick)
+{
+	if(level == 0)
+		return tick & (TIMER_L0_SIZE - 1);
+	return TIMER_L0_SIZE + (level - 1) * TIMER_LN_SIZE + ((tick >> wheel_shift(level)) & (TIMER_LN_SIZE - 1));
+}
+
+static inline uint64_t wheel_tick(ktime_t expires)
+{
+	return ((uint64_t)ktime_to_ns(expires) + TIMER_TICK_NS - 1) >> CONFIG_TIMER_WHEEL_SHIFT;
+}
+
+static void wheel_add(struct timer_base_t * base, struct timer_t * timer)
+{
+	uint64_t tick = wheel_tick(timer->expires);
+	uint64_t delta;
+	int level, slot;
 
-static inline struct timer_t * next_timer(struct timer_base_t * base)
+	if(tick < base->clk)
+		tick = base->clk;
+	delta = tick - base->clk;
+	if(delta >= TIMER_WHEEL_SPAN)
+	{
+		tick = base->clk + TIMER_WHEEL_SPAN - 1;
+		delta = TIMER_WHEEL_SPAN - 1;
+	}
+	for(level = 0; level < TIMER_WHEEL_LEVELS - 1; level++)
+	{
+		if(delta < (1ULL << wheel_shift(level + 1)))
+			break;
+	}
+	slot = wheel_slot(level, tick);
+	list_add_tail(&timer->entry, &base->wheel[slot]);
+	base->pending[slot >> 6] |= 1ULL << (slot & 63);
+	base->count++;
+	timer->slot = slot;
+}
+
+static void wheel_del(struct timer_base_t * base, struct timer_t * timer)
 {
-	return base->next;
+	int slot = timer->slot;
+
+	list_del_init(&timer->entry);
+	if(list_empty(&base->wheel[slot]))
+		base->pending[slot >> 6] &= ~(1ULL << (slot & 63));
+	base->count--;
+	timer->slot = -1;
 }
 
-static inline int add_timer(struct timer_base_t * base, struct timer_t * timer)
+static inline int wheel_first(uint64_t word, int from)
+{
+	uint64_t r = from ? (word >> from) | (word << (64 - from)) : word;
+	return r ? __builtin_ctzll(r) : -1;
+}
+
+/*
+ * The next tick at which the wheel has work, either a level zero slot
+ * falling due or a higher level slot to cascade down.
+ */
+static uint64_t wheel_next(struct timer_base_t * base)
+{
+	uint64_t clk = base->clk;
+	uint64_t next = ~0ULL;
+	uint64_t t, word;
+	int idx, d, i, w, level, shift;
+
+	idx = clk & (TIMER_L0_SIZE - 1);
+	for(i = 0; i <= TIMER_L0_SIZE / 64; i++)
+	{
+		w = ((idx >> 6) + i) % (TIMER_L0_SIZE / 64);
+		word = base->pending[w];
+		if(i == 0)
+			word &= ~0ULL << (idx & 63);
+		else if(i == TIMER_L0_SIZE / 64)
+			word &= ~(~0ULL << (idx & 63));
+		if(word)
+		{
+			d = ((w << 6) + __builtin_ctzll(word) - idx) & (TIMER_L0_SIZE - 1);
+			next = clk + d;
+			break;
+		}
+	}
+
+	for(level = 1; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		word = base->pending[(TIMER_L0_SIZE >> 6) + level - 1];
+		if(!word)
+			continue;
+		shift = wheel_shift(level);
+		idx = (clk >> shift) & (TIMER_LN_SIZE - 1);
+		if(clk & ((1ULL << shift) - 1))
+		{
+			/*
+			 * The current slot was already cascaded, what is left in it
+			 * belongs to the next round
+			 */
+			d = wheel_first(word & ~(1ULL << idx), idx);
+			if(d < 0)
+				d = TIMER_LN_SIZE;
+		}
+		else
+		{
+			d = wheel_first(word, idx);
+		}
+		t = ((clk >> shift) + d) << shift;
+		if(t < next)
+			next = t;
+	}
+	return next;
+}
+
+static inline ktime_t timer_base_next(struct timer_base_t * base)
+{
+	ktime_t next = { .tv64 = KTIME_MAX };
+	uint64_t tick;
+
+	if(base->next)
+		next = base->next->expires;
+	if(base->count > 0)
+	{
+		tick = wheel_next(base);
+		if((tick < ((uint64_t)KTIME_MAX >> CONFIG_TIMER_WHEEL_SHIFT)) && ((s64_t)(tick << CONFIG_TIMER_WHEEL_SHIFT) < next.tv64))
+			next = ns_to_ktime(tick << CONFIG_TIMER_WHEEL_SHIFT);
+	}
+	return next;
+}
+
+/*
+ * Returns the time the clockevent has to fire for this timer
+ */
+static ktime_t add_timer(struct timer_base_t * base, struct timer_t * timer, ktime_t now)
 {
 	struct rb_node ** p = &base->head.rb_node;
 	struct rb_node * parent = NULL;
 	struct timer_t * ptr;
 
 	if(timer->state != TIMER_STATE_INACTIVE)
-		return 0;
+		return ns_to_ktime(KTIME_MAX);
+	timer->state = TIMER_STATE_ENQUEUED;
+
+	if(ktime_to_ns(ktime_sub(timer->expires, now)) >= (s64_t)TIMER_TICK_NS)
+	{
+		if(base->count == 0)
+			base->clk = max(base->clk, ((uint64_t)ktime_to_ns(now) >> CONFIG_TIMER_WHEEL_SHIFT) + 1);
+		wheel_add(base, timer);
+		base->nr_wheel++;
+		return ns_to_ktime(wheel_tick(timer->expires) << CONFIG_TIMER_WHEEL_SHIFT);
+	}
 
 	while(*p)
 	{
@@ -65,29 +220,46 @@ static inline int add_timer(struct timer_base_t * base, struct timer_t * timer)
 
 	if(!base->next || timer->expires.tv64 < base->next->expires.tv64)
 		base->next = timer;
-
-	timer->state = TIMER_STATE_ENQUEUED;
-	return (timer == base->next);
+	base->nr_hres++;
+	return timer->expires;
 }
 
-static inline int del_timer(struct timer_base_t * base, struct timer_t * timer)
+static void del_timer(struct timer_base_t * base, struct timer_t * timer)
 {
-	int ret = 0;
-
 	if(timer->state != TIMER_STATE_ENQUEUED)
-		return 0;
+		return;
 
-	if(base->next == timer)
+	if(timer->slot >= 0)
 	{
-		struct rb_node * rbn = rb_next(&timer->node);
-		base->next = rbn ? rb_entry(rbn, struct timer_t, node) : NULL;
-		ret = 1;
+		wheel_del(base, timer);
+	}
+	else
+	{
+		if(base->next == timer)
+		{
+			struct rb_node * rbn = rb_next(&timer->node);
+			base->next = rbn ? rb_entry(rbn, struct timer_t, node) : NULL;
+		}
+		rb_erase(&timer->node, &base->head);
+		RB_CLEAR_NODE(&timer->node);
 	}
-	rb_erase(&timer->node, &base->head);
-	RB_CLEAR_NODE(&timer->node);
-
 	timer->state = TIMER_STATE_INACTIVE;
-	return ret;
+}
+
+static void timer_program(ktime_t expires)
+{
+	irq_flags_t flags;
+
+	if(expires.tv64 >= KTIME_MAX)
+		return;
+
+	spin_lock_irqsave(&__timer_ce_lock, flags);
+	if(expires.tv64 < __timer_ce_next.tv64)
+	{
+		__timer_ce_next = expires;
+		clockevent_set_event_next(__timer_ce, ktime_get(), expires);
+	}
+	spin_unlock_irqrestore(&__timer_ce_lock, flags);
 }
 
 void timer_init(struct timer_t * timer, int (*function)(struct timer_t *, void *), void * data)
@@ -96,8 +268,10 @@ void timer_init(struct timer_t * timer, int (*function)(struct timer_t *, void *
 	{
 		memset(timer, 0, sizeof(struct timer_t));
 		RB_CLEAR_NODE(&timer->node);
-		timer->base = &__timer_base;
+		init_list_head(&timer->entry);
+		timer->base = &__timer_base[smp_processor_id()];
 		timer->state = TIMER_STATE_INACTIVE;
+		timer->slot = -1;
 		timer->data = data;
 		timer->function = function;
 	}
@@ -105,24 +279,20 @@ void timer_init(struct timer_t * timer, int (*function)(struct timer_t *, void *
 
 void timer_start(struct timer_t * timer, ktime_t now, ktime_t interval)
 {
-	struct timer_base_t * base = timer->base;
+	struct timer_base_t * base;
 	irq_flags_t flags;
+	ktime_t expires;
 
 	if(!timer)
 		return;
 
+	base = timer->base;
 	spin_lock_irqsave(&base->lock, flags);
-	if(del_timer(base, timer))
-	{
-		struct timer_t * next = next_timer(base);
-		if(next)
-			clockevent_set_event_next(base->ce, ktime_get(), next->expires);
-	}
-	ktime_t expires = ktime_add_safe(now, interval);
-	memcpy(&timer->expires, &expires, sizeof(ktime_t));
-	if(add_timer(base, timer))
-		clockevent_set_event_next(base->ce, ktime_get(), timer->expires);
+	del_timer(base, timer);
+	timer->expires = ktime_add_safe(now, interval);
+	expires = add_timer(base, timer, ktime_get());
 	spin_unlock_irqrestore(&base->lock, flags);
+	timer_program(expires);
 }
 
 void timer_start_now(struct timer_t * timer, ktime_t interval)
@@ -134,10 +304,7 @@ void timer_start_now(struct timer_t * timer, ktime_t interval)
 void timer_forward(struct timer_t * timer, ktime_t now, ktime_t interval)
 {
 	if(timer)
-	{
-		ktime_t expires = ktime_add_safe(now, interval);
-		memcpy(&timer->expires, &expires, sizeof(ktime_t));
-	}
+		timer->expires = ktime_add_safe(now, interval);
 }
 
 void timer_forward_now(struct timer_t * timer, ktime_t interval)
@@ -148,59 +315,203 @@ void timer_forward_now(struct timer_t * timer, ktime_t interval)
 
 void timer_cancel(struct timer_t * timer)
 {
-	struct timer_base_t * base = timer->base;
+	struct timer_base_t * base;
 	irq_flags_t flags;
 
 	if(!timer)
 		return;
 
+	base = timer->base;
 	spin_lock_irqsave(&base->lock, flags);
-	if(del_timer(base, timer))
+	del_timer(base, timer);
+	spin_unlock_irqrestore(&base->lock, flags);
+}
+
+static inline void timer_expire(struct timer_base_t * base, struct timer_t * timer, ktime_t now)
+{
+	timer->state = TIMER_STATE_CALLBACK;
+	base->nr_expire++;
+	if(timer->function(timer, timer->data))
 	{
-		struct timer_t * next = next_timer(base);
-		if(next)
-			clockevent_set_event_next(base->ce, ktime_get(), next->expires);
+		timer->state = TIMER_STATE_INACTIVE;
+		add_timer(base, timer, now);
 	}
-	spin_unlock_irqrestore(&base->lock, flags);
+	else
+	{
+		timer->state = TIMER_STATE_INACTIVE;
+	}
+}
+
+static void wheel_cascade(struct timer_base_t * base, int slot)
+{
+	struct timer_t * pos, * n;
+	struct list_head head;
+
+	init_list_head(&head);
+	list_splice_init(&base->wheel[slot], &head);
+	base->pending[slot >> 6] &= ~(1ULL << (slot & 63));
+	list_for_each_entry_safe(pos, n, &head, entry)
+	{
+		list_del_init(&pos->entry);
+		base->count--;
+		wheel_add(base, pos);
+		base->nr_cascade++;
+	}
+}
+
+static void wheel_run(struct timer_base_t * base, ktime_t now)
+{
+	uint64_t tick = (uint64_t)ktime_to_ns(now) >> CONFIG_TIMER_WHEEL_SHIFT;
+	struct timer_t * pos, * n;
+	struct list_head head;
+	uint64_t next;
+	int level, slot;
+
+	while(base->count > 0)
+	{
+		next = wheel_next(base);
+		if(next > tick)
+			break;
+		base->clk = next;
+		for(level = 1; level < TIMER_WHEEL_LEVELS; level++)
+		{
+			if(base->clk & ((1ULL << wheel_shift(level)) - 1))
+				break;
+			wheel_cascade(base, wheel_slot(level, base->clk));
+		}
+
+		slot = wheel_slot(0, base->clk);
+		init_list_head(&head);
+		list_splice_init(&base->wheel[slot], &head);
+		base->pending[slot >> 6] &= ~(1ULL << (slot & 63));
+		list_for_each_entry_safe(pos, n, &head, entry)
+		{
+			list_del_init(&pos->entry);
+			base->count--;
+			pos->slot = -1;
+			pos->state = TIMER_STATE_INACTIVE;
+			if(ktime_after(pos->expires, now))
+				add_timer(base, pos, now);
+			else
+				timer_expire(base, pos, now);
+		}
+		base->clk++;
+	}
+	if(base->count > 0)
+		base->clk = min(wheel_next(base), tick + 1);
+	else
+		base->clk = max(base->clk, tick + 1);
 }
 
 static void timer_event_handler(struct clockevent_t * ce, void * data)
 {
-	struct timer_base_t * base = (struct timer_base_t *)(data);
+	struct timer_base_t * base;
 	struct timer_t * timer;
 	ktime_t now = ktime_get();
+	ktime_t next = { .tv64 = KTIME_MAX };
+	ktime_t t;
 	irq_flags_t flags;
-	int restart;
+	int i;
 
-	spin_lock_irqsave(&base->lock, flags);
-	while((timer = next_timer(base)))
-	{
-		if(now.tv64 < timer->expires.tv64)
-			break;
+	spin_lock_irqsave(&__timer_ce_lock, flags);
+	__timer_ce_next.tv64 = KTIME_MAX;
+	spin_unlock_irqrestore(&__timer_ce_lock, flags);
 
-		del_timer(base, timer);
-		timer->state = TIMER_STATE_CALLBACK;
-		restart = timer->function(timer, timer->data);
-		timer->state = TIMER_STATE_INACTIVE;
-		if(restart)
-			add_timer(base, timer);
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+	{
+		base = &__timer_base[i];
+		spin_lock_irqsave(&base->lock, flags);
+		while((timer = base->next))
+		{
+			if(now.tv64 < timer->expires.tv64)
+				break;
+			del_timer(base, timer);
+			timer_expire(base, timer, now);
+		}
+		if(base->count > 0)
+			wheel_run(base, now);
+		t = timer_base_next(base);
+		spin_unlock_irqrestore(&base->lock, flags);
+		if(t.tv64 < next.tv64)
+			next = t;
 	}
-	if((timer = next_timer(base)))
-		clockevent_set_event_next(ce, now, timer->expires);
-	spin_unlock_irqrestore(&base->lock, flags);
+	timer_program(next);
 }
 
 void timer_bind_clockevent(struct clockevent_t * ce)
 {
+	struct timer_base_t * base;
+	ktime_t next = { .tv64 = KTIME_MAX };
+	ktime_t t;
 	irq_flags_t flags;
+	int i;
 
 	if(ce)
 	{
-		spin_lock_irqsave(&__timer_base.lock, flags);
-		__timer_base.head = RB_ROOT;
-		__timer_base.next = NULL;
-		__timer_base.ce = ce;
-		clockevent_set_event_handler(__timer_base.ce, timer_event_handler, &__timer_base);
-		spin_unlock_irqrestore(&__timer_base.lock, flags);
+		spin_lock_irqsave(&__timer_ce_lock, flags);
+		__timer_ce = ce;
+		__timer_ce_next.tv64 = KTIME_MAX;
+		clockevent_set_event_handler(__timer_ce, timer_event_handler, NULL);
+		spin_unlock_irqrestore(&__timer_ce_lock, flags);
+
+		for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+		{
+			base = &__timer_base[i];
+			spin_lock_irqsave(&base->lock, flags);
+			t = timer_base_next(base);
+			spin_unlock_irqrestore(&base->lock, flags);
+			if(t.tv64 < next.tv64)
+				next = t;
+		}
+		timer_program(next);
+	}
+}
+
+static struct kobj_t * search_class_timer_kobj(void)
+{
+	struct kobj_t * kclass = kobj_search_directory_with_create(kobj_get_root(), "class");
+	return kobj_search_directory_with_create(kclass, "timer");
+}
+
+static ssize_t timer_read_stat(struct kobj_t * kobj, void * buf, size_t size)
+{
+	struct timer_base_t * base = (struct timer_base_t *)kobj->priv;
+	char * p = buf;
+	int len = 0;
+
+	len += sprintf((char *)(p + len), " pending: %d\r\n", base->count);
+	len += sprintf((char *)(p + len), " wheel: %lld\r\n", base->nr_wheel);
+	len += sprintf((char *)(p + len), " hres: %lld\r\n", base->nr_hres);
+	len += sprintf((char *)(p + len), " cascade: %lld\r\n", base->nr_cascade);
+	len += sprintf((char *)(p + len), " expire: %lld\r\n", base->nr_expire);
+	return len;
+}
+
+void do_init_timer(void)
+{
+	struct timer_base_t * base;
+	char name[16];
+	int i, j;
+
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+	{
+		base = &__timer_base[i];
+
+		base->head = RB_ROOT;
+		base->next = NULL;
+		for(j = 0; j < TIMER_WHEEL_SIZE; j++)
+			init_list_head(&base->wheel[j]);
+		for(j = 0; j < TIMER_WHEEL_SIZE / 64; j++)
+			base->pending[j] = 0;
+		base->clk = 0;
+		base->count = 0;
+		base->nr_wheel = 0;
+		base->nr_hres = 0;
+		base->nr_cascade = 0;
+		base->nr_expire = 0;
+		spin_lock_init(&base->lock);
+
+		sprintf(name, "cpu%d", i);
+		kobj_add_regular(search_class_timer_kobj(), name, timer_read_stat, NULL, base);
 	}
 }
@@ -100,7 +100,7 @@ struct vfs_file_t {
 };
 
 static struct list_head mnt_list;
-static struct mutex_t mnt_list_lock;
+static struct rwlock_t mnt_list_lock;
 static struct vfs_file_t fd_file[VFS_MAX_FD];
 static struct mutex_t fd_file_lock;
 struct list_head node_list[VFS_NODE_HASH_SIZE];
@@ -139,7 +139,7 @@ static int vfs_findroot(const char * path, struct vfs_mount_t ** mp, char ** roo
 	if(!path || !mp || !root)
 		return -1;
 
-	mutex_lock(&mnt_list_lock);
+	rwlock_read_lock(&mnt_list_lock);
 	list_for_each_entry(pos, &mnt_list, m_link)
 	{
 		len = count_match(path, pos->m_path);
@@ -149,7 +149,7 @@ static int vfs_findroot(const char * path, struct vfs_mount_t ** mp, char ** roo
 			m = pos;
 		}
 	}
-	mutex_unlock(&mnt_list_lock);
+	rwlock_read_unlock(&mnt_list_lock);
 
 	if(!m)
 		return -1;
@@ -644,12 +644,12 @@ int vfs_mount(const char * dev, const char * dir, const char * fsname, u32_t fla
 	if(m->m_flags & MOUNT_RO)
 		m->m_root->v_mode &= ~(S_IWUSR|S_IWGRP|S_IWOTH);
 
-	mutex_lock(&mnt_list_lock);
+	rwlock_write_lock(&mnt_list_lock);
 	list_for_each_entry(tm, &mnt_list, m_link)
 	{
 		if(!strcmp(tm->m_path, dir) || ((dev != NULL) && (tm->m_dev == bdev)))
 		{
-			mutex_unlock(&mnt_list_lock);
+			rwlock_write_unlock(&mnt_list_lock);
 			mutex_lock(&m->m_lock);
 			m->m_fs->unmount(m);
 			mutex_unlock(&m->m_lock);
@@ -661,7 +661,7 @@ int vfs_mount(const char * dev, const char * dir, const char * fsname, u32_t fla
 		}
 	}
 	list_add(&m->m_link, &mnt_list);
-	mutex_unlock(&mnt_list_lock);
+	rwlock_write_unlock(&mnt_list_lock);
 
 	return 0;
 }
@@ -672,7 +672,7 @@ int vfs_unmount(const char * path)
 	int found;
 	int err;
 
-	mutex_lock(&mnt_list_lock);
+	rwlock_write_lock(&mnt_list_lock);
 	found = 0;
 	list_for_each_entry(m, &mnt_list, m_link)
 	{
@@ -684,16 +684,16 @@ int vfs_unmount(const char * path)
 	}
 	if(!found)
 	{
-		mutex_unlock(&mnt_list_lock);
+		rwlock_write_unlock(&mnt_list_lock);
 		return -1;
 	}
 	if(atomic_get(&m->m_refcnt) > 1)
 	{
-		mutex_unlock(&mnt_list_lock);
+		rwlock_write_unlock(&mnt_list_lock);
 		return -1;
 	}
 	list_del(&m->m_link);
-	mutex_unlock(&mnt_list_lock);
+	rwlock_write_unlock(&mnt_list_lock);
 
 	mutex_lock(&m->m_lock);
 	err = m->m_fs->msync(m);
@@ -714,14 +714,14 @@ int vfs_sync(void)
 {
 	struct vfs_mount_t * m;
 
-	mutex_lock(&mnt_list_lock);
+	rwlock_read_lock(&mnt_list_lock);
 	list_for_each_entry(m, &mnt_list, m_link)
 	{
 		mutex_lock(&m->m_lock);
 		m->m_fs->msync(m);
 		mutex_unlock(&m->m_lock);
 	}
-	mutex_unlock(&mnt_list_lock);
+	rwlock_read_unlock(&mnt_list_lock);
 
 	return 0;
 }
@@ -734,7 +734,7 @@ struct vfs_mount_t * vfs_mount_get(int index)
 	if(index < 0)
 		return NULL;
 
-	mutex_lock(&mnt_list_lock);
+	rwlock_read_lock(&mnt_list_lock);
 	list_for_each_entry(m, &mnt_list, m_link)
 	{
 		if(!index)
@@ -744,7 +744,7 @@ struct vfs_mount_t * vfs_mount_get(int index)
 		}
 		index--;
 	}
-	mutex_unlock(&mnt_list_lock);
+	rwlock_read_unlock(&mnt_list_lock);
 
 	if(!found)
 		return NULL;
@@ -756,12 +756,12 @@ int vfs_mount_count(void)
 	struct vfs_mount_t * m;
 	int ret = 0;
 
-	mutex_lock(&mnt_list_lock);
+	rwlock_read_lock(&mnt_list_lock);
 	list_for_each_entry(m, &mnt_list, m_link)
 	{
 		ret++;
 	}
-	mutex_unlock(&mnt_list_lock);
+	rwlock_read_unlock(&mnt_list_lock);
 
 	return ret;
 }
@@ -1623,7 +1623,7 @@ void do_init_vfs(void)
 	int i;
 
 	init_list_head(&mnt_list);
-	mutex_init(&mnt_list_lock);
+	rwlock_init(&mnt_list_lock);
 
 	for(i = 0; i < VFS_MAX_FD; i++)
 	{
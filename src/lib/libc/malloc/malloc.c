@@ -8,6 +8,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <malloc.h>
+#include <smp.h>
+#include <list.h>
 #include <xboot/kobj.h>
 #include <xboot/module.h>
 
@@ -816,24 +818,387 @@ void mm_info(void * mm, size_t * mused, size_t * mfree)
 		tlsf_info(mm, mused, mfree);
 }
 
-void * malloc(size_t size)
+/*
+ * Heap statistics. The caller side counters are kept per cpu without a
+ * lock, like the magazines below, and the heap footprint with its peak is
+ * kept under the heap lock, so they cost a few instructions per call and
+ * reading them never walks the heap the way mm_info does.
+ */
+struct malloc_stat_cpu_t {
+	long used;
+	uint64_t nalloc;
+	uint64_t nfree;
+	long live[MALLOC_STAT_CLASS_COUNT];
+	uint64_t count[MALLOC_STAT_CLASS_COUNT];
+};
+
+static struct malloc_stat_cpu_t __malloc_stat_cpu[CONFIG_MAX_SMP_CPUS];
+static struct malloc_stat_t __malloc_stat_snapshot;
+static size_t __heap_used = 0;
+static size_t __heap_peak = 0;
+
+/*
+ * With CONFIG_MALLOC_TRACE every block carries a trailer at its end with
+ * the caller and a sequence number, and sits on a list of live blocks, so
+ * the blocks allocated since a snapshot can be summed up per call site.
+ */
+#if defined(CONFIG_MALLOC_TRACE) && (CONFIG_MALLOC_TRACE > 0)
+struct malloc_trace_t {
+	struct list_head entry;
+	void * caller;
+	unsigned long seq;
+	size_t size;
+};
+
+#define MALLOC_TRACE_SIZE	(sizeof(struct malloc_trace_t))
+
+static LIST_HEAD(__malloc_trace_list);
+static spinlock_t __malloc_trace_lock = SPIN_LOCK_INIT();
+static unsigned long __malloc_trace_seq = 0;
+static unsigned long __malloc_trace_snapshot = 0;
+
+static inline struct malloc_trace_t * malloc_trace_of(void * ptr)
+{
+	return (struct malloc_trace_t *)((char *)ptr + block_get_size(block_from_ptr(ptr)) - MALLOC_TRACE_SIZE);
+}
+
+static inline void malloc_trace_add(void * ptr, size_t size, void * caller)
+{
+	struct malloc_trace_t * t = malloc_trace_of(ptr);
+
+	t->caller = caller;
+	t->size = size;
+	spin_lock(&__malloc_trace_lock);
+	t->seq = ++__malloc_trace_seq;
+	list_add_tail(&t->entry, &__malloc_trace_list);
+	spin_unlock(&__malloc_trace_lock);
+}
+
+static inline void malloc_trace_del(void * ptr)
+{
+	struct malloc_trace_t * t = malloc_trace_of(ptr);
+
+	spin_lock(&__malloc_trace_lock);
+	list_del(&t->entry);
+	spin_unlock(&__malloc_trace_lock);
+}
+#else
+#define MALLOC_TRACE_SIZE	(0)
+#define malloc_trace_add(ptr, size, caller)
+#define malloc_trace_del(ptr)
+#endif
+
+/*
+ * Log2 classes of the usable size, from 16 bytes up to 256K and larger
+ */
+static inline int malloc_stat_class(size_t size)
+{
+	int c = (size > 16) ? tlsf_fls_sizet(size - 1) - 3 : 0;
+	return (c < MALLOC_STAT_CLASS_COUNT) ? c : (MALLOC_STAT_CLASS_COUNT - 1);
+}
+
+static inline void malloc_account_alloc(void * ptr, void * caller)
+{
+	struct malloc_stat_cpu_t * s = &__malloc_stat_cpu[smp_processor_id()];
+	size_t size = block_get_size(block_from_ptr(ptr)) - MALLOC_TRACE_SIZE;
+	int c = malloc_stat_class(size);
+
+	s->used += size;
+	s->nalloc++;
+	s->live[c]++;
+	s->count[c]++;
+	malloc_trace_add(ptr, size, caller);
+}
+
+static inline void malloc_account_free(void * ptr)
+{
+	struct malloc_stat_cpu_t * s = &__malloc_stat_cpu[smp_processor_id()];
+	size_t size = block_get_size(block_from_ptr(ptr)) - MALLOC_TRACE_SIZE;
+	int c = malloc_stat_class(size);
+
+	s->used -= size;
+	s->nfree++;
+	s->live[c]--;
+	malloc_trace_del(ptr);
+}
+
+/*
+ * The heap pool with its footprint accounted, called with the heap lock held
+ */
+static inline void heap_account(void * ptr, int sign)
+{
+	if(ptr)
+	{
+		if(sign > 0)
+		{
+			__heap_used += block_get_size(block_from_ptr(ptr));
+			if(__heap_used > __heap_peak)
+				__heap_peak = __heap_used;
+		}
+		else
+		{
+			__heap_used -= block_get_size(block_from_ptr(ptr));
+		}
+	}
+}
+
+static inline void * heap_malloc(size_t size)
+{
+	void * m = tlsf_malloc(__heap_pool, size);
+	heap_account(m, 1);
+	return m;
+}
+
+static inline void * heap_memalign(size_t align, size_t size)
+{
+	void * m = tlsf_memalign(__heap_pool, align, size);
+	heap_account(m, 1);
+	return m;
+}
+
+static inline void * heap_realloc(void * ptr, size_t size)
 {
 	void * m;
 
+	heap_account(ptr, -1);
+	m = tlsf_realloc(__heap_pool, ptr, size);
+	heap_account(m ? m : ptr, 1);
+	return m;
+}
+
+static inline void heap_free(void * ptr)
+{
+	heap_account(ptr, -1);
+	tlsf_free(__heap_pool, ptr);
+}
+
+/*
+ * Small blocks are recycled through per-cpu magazines in front of the heap,
+ * after the magazine and depot layers of Bonwick's vmem paper. Every cpu
+ * keeps a loaded and a previous magazine per size class, and whole
+ * magazines are swapped with a small depot under the heap lock, so the heap
+ * lock is taken once every CONFIG_MALLOC_MAGAZINE_ROUNDS operations at most.
+ *
+ * Cached blocks stay used blocks of the heap, a freed block goes to the
+ * class its real size can serve. The per-cpu part runs without a lock, as
+ * tasks are never preempted and malloc is not used from interrupt context.
+ */
+#define MAGAZINE_CLASS_COUNT	(16)
+
+struct magazine_t {
+	struct magazine_t * next;
+	int rounds;
+	void * objs[CONFIG_MALLOC_MAGAZINE_ROUNDS];
+};
+
+struct magazine_cpu_t {
+	struct magazine_t * loaded[MAGAZINE_CLASS_COUNT];
+	struct magazine_t * previous[MAGAZINE_CLASS_COUNT];
+};
+
+struct magazine_depot_t {
+	struct magazine_t * full;
+	struct magazine_t * empty;
+	int nfull;
+};
+
+static const size_t __magazine_size[MAGAZINE_CLASS_COUNT] = {
+	16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512,
+};
+static struct magazine_cpu_t __magazine_cpu[CONFIG_MAX_SMP_CPUS];
+static struct magazine_depot_t __magazine_depot[MAGAZINE_CLASS_COUNT];
+
+/*
+ * The smallest class that holds a request of this size
+ */
+static inline int magazine_class(size_t size)
+{
+	if((CONFIG_MALLOC_MAGAZINE_ROUNDS <= 0) || (size == 0) || (size > 512))
+		return -1;
+	if(size <= 128)
+		return (size - 1) >> 4;
+	if(size <= 256)
+		return 8 + ((size - 129) >> 5);
+	return 12 + ((size - 257) >> 6);
+}
+
+/*
+ * The largest class a block of this size can serve
+ */
+static inline int magazine_class_floor(size_t size)
+{
+	if((CONFIG_MALLOC_MAGAZINE_ROUNDS <= 0) || (size < 16) || (size >= 576))
+		return -1;
+	if(size < 128)
+		return (size >> 4) - 1;
+	if(size < 256)
+		return 7 + ((size - 128) >> 5);
+	if(size < 512)
+		return 11 + ((size - 256) >> 6);
+	return 15;
+}
+
+static struct magazine_t * magazine_empty(struct magazine_depot_t * depot)
+{
+	struct magazine_t * m = depot->empty;
+
+	if(m)
+		depot->empty = m->next;
+	else
+		m = heap_malloc(sizeof(struct magazine_t));
+	if(m)
+	{
+		m->next = NULL;
+		m->rounds = 0;
+	}
+	return m;
+}
+
+static void * magazine_get(int c)
+{
+	struct magazine_cpu_t * cpu = &__magazine_cpu[smp_processor_id()];
+	struct magazine_depot_t * depot = &__magazine_depot[c];
+	struct magazine_t * m = cpu->loaded[c];
+	struct magazine_t * p = cpu->previous[c];
+
+	if(!m)
+		return NULL;
+	if(m->rounds > 0)
+		return m->objs[--m->rounds];
+	if(p->rounds > 0)
+	{
+		cpu->loaded[c] = p;
+		cpu->previous[c] = m;
+		return p->objs[--p->rounds];
+	}
+
+	spin_lock(&__heap_lock);
+	if(!depot->full)
+	{
+		spin_unlock(&__heap_lock);
+		return NULL;
+	}
+	m = depot->full;
+	depot->full = m->next;
+	depot->nfull--;
+	p->next = depot->empty;
+	depot->empty = p;
+	cpu->previous[c] = cpu->loaded[c];
+	cpu->loaded[c] = m;
+	spin_unlock(&__heap_lock);
+
+	return m->objs[--m->rounds];
+}
+
+static int magazine_put(int c, void * ptr)
+{
+	struct magazine_cpu_t * cpu = &__magazine_cpu[smp_processor_id()];
+	struct magazine_depot_t * depot = &__magazine_depot[c];
+	struct magazine_t * m = cpu->loaded[c];
+	struct magazine_t * p = cpu->previous[c];
+	struct magazine_t * e;
+
+	if(m && (m->rounds < CONFIG_MALLOC_MAGAZINE_ROUNDS))
+	{
+		m->objs[m->rounds++] = ptr;
+		return 1;
+	}
+	if(p && (p->rounds == 0))
+	{
+		cpu->loaded[c] = p;
+		cpu->previous[c] = m;
+		p->objs[p->rounds++] = ptr;
+		return 1;
+	}
+
 	spin_lock(&__heap_lock);
-	m = tlsf_malloc(__heap_pool, size);
+	if(!m)
+	{
+		m = magazine_empty(depot);
+		p = magazine_empty(depot);
+		if(!m || !p)
+		{
+			if(m)
+				heap_free(m);
+			if(p)
+				heap_free(p);
+			spin_unlock(&__heap_lock);
+			return 0;
+		}
+		cpu->loaded[c] = m;
+		cpu->previous[c] = p;
+		spin_unlock(&__heap_lock);
+		m->objs[m->rounds++] = ptr;
+		return 1;
+	}
+	if(depot->nfull < CONFIG_MALLOC_MAGAZINE_DEPOT)
+	{
+		e = magazine_empty(depot);
+		if(!e)
+		{
+			spin_unlock(&__heap_lock);
+			return 0;
+		}
+		p->next = depot->full;
+		depot->full = p;
+		depot->nfull++;
+	}
+	else
+	{
+		while(p->rounds > 0)
+			heap_free(p->objs[--p->rounds]);
+		e = p;
+	}
+	cpu->previous[c] = m;
+	cpu->loaded[c] = e;
 	spin_unlock(&__heap_lock);
+
+	e->objs[e->rounds++] = ptr;
+	return 1;
+}
+
+static void * __malloc(size_t size, void * caller)
+{
+	void * m = NULL;
+	int c;
+
+	if(size == 0)
+		return NULL;
+	size += MALLOC_TRACE_SIZE;
+	c = magazine_class(size);
+	if(c >= 0)
+	{
+		m = magazine_get(c);
+		size = __magazine_size[c];
+	}
+	if(!m)
+	{
+		spin_lock(&__heap_lock);
+		m = heap_malloc(size);
+		spin_unlock(&__heap_lock);
+	}
+	if(m)
+		malloc_account_alloc(m, caller);
 	return m;
 }
+
+void * malloc(size_t size)
+{
+	return __malloc(size, __builtin_return_address(0));
+}
 EXPORT_SYMBOL(malloc);
 
 void * memalign(size_t align, size_t size)
 {
 	void * m;
 
+	if(size == 0)
+		return NULL;
 	spin_lock(&__heap_lock);
-	m = tlsf_memalign(__heap_pool, align, size);
+	m = heap_memalign(align, size + MALLOC_TRACE_SIZE);
 	spin_unlock(&__heap_lock);
+	if(m)
+		malloc_account_alloc(m, __builtin_return_address(0));
 	return m;
 }
 EXPORT_SYMBOL(memalign);
@@ -842,9 +1207,18 @@ void * realloc(void * ptr, size_t size)
 {
 	void * m;
 
+	if(!ptr)
+		return __malloc(size, __builtin_return_address(0));
+	if(size == 0)
+	{
+		free(ptr);
+		return NULL;
+	}
+	malloc_account_free(ptr);
 	spin_lock(&__heap_lock);
-	m = tlsf_realloc(__heap_pool, ptr, size);
+	m = heap_realloc(ptr, size + MALLOC_TRACE_SIZE);
 	spin_unlock(&__heap_lock);
+	malloc_account_alloc(m ? m : ptr, __builtin_return_address(0));
 	return m;
 }
 EXPORT_SYMBOL(realloc);
@@ -853,7 +1227,7 @@ void * calloc(size_t nmemb, size_t size)
 {
 	void * m;
 
-	if((m = malloc(nmemb * size)))
+	if((m = __malloc(nmemb * size, __builtin_return_address(0))))
 		memset(m, 0, nmemb * size);
 	return m;
 }
@@ -861,12 +1235,190 @@ EXPORT_SYMBOL(calloc);
 
 void free(void * ptr)
 {
+	int c;
+
+	if(!ptr)
+		return;
+	malloc_account_free(ptr);
+	c = magazine_class_floor(block_get_size(block_from_ptr(ptr)));
+	if((c >= 0) && magazine_put(c, ptr))
+		return;
 	spin_lock(&__heap_lock);
-	tlsf_free(__heap_pool, ptr);
+	heap_free(ptr);
 	spin_unlock(&__heap_lock);
 }
 EXPORT_SYMBOL(free);
 
+size_t malloc_usable_size(void * ptr)
+{
+	return ptr ? block_get_size(block_from_ptr(ptr)) - MALLOC_TRACE_SIZE : 0;
+}
+EXPORT_SYMBOL(malloc_usable_size);
+
+/*
+ * Give the blocks cached by this cpu and by the depot back to the heap
+ */
+void malloc_drain(void)
+{
+	struct magazine_cpu_t * cpu = &__magazine_cpu[smp_processor_id()];
+	struct magazine_depot_t * depot;
+	struct magazine_t * m;
+	int c;
+
+	spin_lock(&__heap_lock);
+	for(c = 0; c < MAGAZINE_CLASS_COUNT; c++)
+	{
+		depot = &__magazine_depot[c];
+		if((m = cpu->loaded[c]))
+		{
+			while(m->rounds > 0)
+				heap_free(m->objs[--m->rounds]);
+		}
+		if((m = cpu->previous[c]))
+		{
+			while(m->rounds > 0)
+				heap_free(m->objs[--m->rounds]);
+		}
+		while((m = depot->full))
+		{
+			depot->full = m->next;
+			while(m->rounds > 0)
+				heap_free(m->objs[--m->rounds]);
+			heap_free(m);
+		}
+		depot->nfull = 0;
+		while((m = depot->empty))
+		{
+			depot->empty = m->next;
+			heap_free(m);
+		}
+	}
+	spin_unlock(&__heap_lock);
+}
+EXPORT_SYMBOL(malloc_drain);
+
+/*
+ * The upper bound of a class, the last one holds everything above the
+ * bound of the one before it, which is what it returns
+ */
+size_t malloc_stat_class_size(int c)
+{
+	if(c >= MALLOC_STAT_CLASS_COUNT - 1)
+		c = MALLOC_STAT_CLASS_COUNT - 2;
+	return (size_t)16 << c;
+}
+EXPORT_SYMBOL(malloc_stat_class_size);
+
+void malloc_stat(struct malloc_stat_t * stat)
+{
+	struct malloc_stat_cpu_t * s;
+	int i, c;
+
+	memset(stat, 0, sizeof(struct malloc_stat_t));
+	for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+	{
+		s = &__malloc_stat_cpu[i];
+		stat->used += s->used;
+		stat->nalloc += s->nalloc;
+		stat->nfree += s->nfree;
+		for(c = 0; c < MALLOC_STAT_CLASS_COUNT; c++)
+		{
+			stat->live[c] += s->live[c];
+			stat->count[c] += s->count[c];
+		}
+	}
+	spin_lock(&__heap_lock);
+	stat->heap = __heap_used;
+	stat->peak = __heap_peak;
+	spin_unlock(&__heap_lock);
+}
+EXPORT_SYMBOL(malloc_stat);
+
+/*
+ * Remember the current counters, and the last sequence number with
+ * CONFIG_MALLOC_TRACE, for malloc_stat_diff and malloc_leak
+ */
+void malloc_snapshot(void)
+{
+	malloc_stat(&__malloc_stat_snapshot);
+#if defined(CONFIG_MALLOC_TRACE) && (CONFIG_MALLOC_TRACE > 0)
+	spin_lock(&__malloc_trace_lock);
+	__malloc_trace_snapshot = __malloc_trace_seq;
+	spin_unlock(&__malloc_trace_lock);
+#endif
+}
+EXPORT_SYMBOL(malloc_snapshot);
+
+/*
+ * The counters relative to the last snapshot, the peak stays absolute
+ */
+void malloc_stat_diff(struct malloc_stat_t * stat)
+{
+	struct malloc_stat_t * o = &__malloc_stat_snapshot;
+	int c;
+
+	malloc_stat(stat);
+	stat->used -= o->used;
+	stat->heap -= o->heap;
+	stat->nalloc -= o->nalloc;
+	stat->nfree -= o->nfree;
+	for(c = 0; c < MALLOC_STAT_CLASS_COUNT; c++)
+	{
+		stat->live[c] -= o->live[c];
+		stat->count[c] -= o->count[c];
+	}
+}
+EXPORT_SYMBOL(malloc_stat_diff);
+
+/*
+ * Sum up the blocks allocated since the last snapshot and still live by
+ * call site, largest first. Returns the number of sites filled in, always
+ * zero without CONFIG_MALLOC_TRACE. Sites beyond the array are dropped.
+ */
+int malloc_leak(struct malloc_site_t * site, int n)
+{
+	int count = 0;
+#if defined(CONFIG_MALLOC_TRACE) && (CONFIG_MALLOC_TRACE > 0)
+	struct malloc_trace_t * t;
+	struct malloc_site_t tmp;
+	int i, j;
+
+	spin_lock(&__malloc_trace_lock);
+	list_for_each_entry(t, &__malloc_trace_list, entry)
+	{
+		if((long)(t->seq - __malloc_trace_snapshot) <= 0)
+			continue;
+		for(i = 0; i < count; i++)
+		{
+			if(site[i].caller == t->caller)
+				break;
+		}
+		if(i == count)
+		{
+			if(count >= n)
+				continue;
+			site[i].caller = t->caller;
+			site[i].count = 0;
+			site[i].bytes = 0;
+			count++;
+		}
+		site[i].count++;
+		site[i].bytes += t->size;
+	}
+	spin_unlock(&__malloc_trace_lock);
+
+	for(i = 1; i < count; i++)
+	{
+		tmp = site[i];
+		for(j = i; (j > 0) && (site[j - 1].bytes < tmp.bytes); j--)
+			site[j] = site[j - 1];
+		site[j] = tmp;
+	}
+#endif
+	return count;
+}
+EXPORT_SYMBOL(malloc_leak);
+
 static struct kobj_t * search_class_memory_kobj(void)
 {
 	struct kobj_t * kclass = kobj_search_directory_with_create(kobj_get_root(), "class");
@@ -886,6 +1438,78 @@ static ssize_t memory_read_meminfo(struct kobj_t * kobj, void * buf, size_t size
 	return len;
 }
 
+static ssize_t memory_read_magazine(struct kobj_t * kobj, void * buf, size_t size)
+{
+	struct magazine_cpu_t * cpu;
+	struct magazine_t * m;
+	char * p = buf;
+	int len = 0;
+	int c, i, n;
+
+	for(c = 0; c < MAGAZINE_CLASS_COUNT; c++)
+	{
+		n = 0;
+		spin_lock(&__heap_lock);
+		for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+		{
+			cpu = &__magazine_cpu[i];
+			if(cpu->loaded[c])
+				n += cpu->loaded[c]->rounds + cpu->previous[c]->rounds;
+		}
+		for(m = __magazine_depot[c].full; m; m = m->next)
+			n += m->rounds;
+		spin_unlock(&__heap_lock);
+		len += sprintf((char *)(p + len), " %4ld: %d\r\n", (long)__magazine_size[c], n);
+	}
+	return len;
+}
+
+static ssize_t memory_read_stat(struct kobj_t * kobj, void * buf, size_t size)
+{
+	struct malloc_stat_t stat;
+	char * p = buf;
+	int len = 0;
+	int c;
+
+	malloc_stat(&stat);
+	len += sprintf((char *)(p + len), " used: %ld\r\n", (long)stat.used);
+	len += sprintf((char *)(p + len), " heap: %ld\r\n", (long)stat.heap);
+	len += sprintf((char *)(p + len), " peak: %ld\r\n", (long)stat.peak);
+	len += sprintf((char *)(p + len), " alloc: %lld\r\n", (long long)stat.nalloc);
+	len += sprintf((char *)(p + len), " free: %lld\r\n", (long long)stat.nfree);
+	for(c = 0; c < MALLOC_STAT_CLASS_COUNT; c++)
+		len += sprintf((char *)(p + len), " %s%-8ld: %ld live, %lld total\r\n", (c < MALLOC_STAT_CLASS_COUNT - 1) ? "<=" : "> ", (long)malloc_stat_class_size(c), stat.live[c], (long long)stat.count[c]);
+	return len;
+}
+
+static ssize_t memory_write_snapshot(struct kobj_t * kobj, void * buf, size_t size)
+{
+	malloc_snapshot();
+	return size;
+}
+
+static ssize_t memory_read_leak(struct kobj_t * kobj, void * buf, size_t size)
+{
+	struct malloc_stat_t stat;
+	struct malloc_site_t site[32];
+	char * p = buf;
+	int len = 0;
+	int c, i, n;
+
+	malloc_stat_diff(&stat);
+	len += sprintf((char *)(p + len), " used: %+ld\r\n", (long)stat.used);
+	len += sprintf((char *)(p + len), " heap: %+ld\r\n", (long)stat.heap);
+	for(c = 0; c < MALLOC_STAT_CLASS_COUNT; c++)
+	{
+		if(stat.live[c] != 0)
+			len += sprintf((char *)(p + len), " %s%-8ld: %+ld live\r\n", (c < MALLOC_STAT_CLASS_COUNT - 1) ? "<=" : "> ", (long)malloc_stat_class_size(c), stat.live[c]);
+	}
+	n = malloc_leak(site, 32);
+	for(i = 0; i < n; i++)
+		len += sprintf((char *)(p + len), " %p: %ld bytes in %ld blocks\r\n", site[i].caller, site[i].bytes, site[i].count);
+	return len;
+}
+
 void do_init_mem(void)
 {
 	void * heap;
@@ -905,4 +1529,8 @@ void do_init_mem(void)
 	spin_lock_init(&__heap_lock);
 	__heap_pool = mm_create(heap, size);
 	kobj_add_regular(search_class_memory_kobj(), "meminfo", memory_read_meminfo, NULL, mm_get(__heap_pool));
+	kobj_add_regular(search_class_memory_kobj(), "magazine", memory_read_magazine, NULL, NULL);
+	kobj_add_regular(search_class_memory_kobj(), "stat", memory_read_stat, NULL, NULL);
+	kobj_add_regular(search_class_memory_kobj(), "snapshot", NULL, memory_write_snapshot, NULL);
+	kobj_add_regular(search_class_memory_kobj(), "leak", memory_read_leak, NULL, NULL);
 }
@@ -0,0 +1,220 @@
+/*
+ * wboxtest/benchmark/channel.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_channel_pdata_t
+{
+	struct channel_t * bping;
+	struct channel_t * bpong;
+	struct mchannel_t * mping;
+	struct mchannel_t * mpong;
+	struct mchannel_t * mstream;
+	atomic_t done;
+
+	ktime_t t1;
+	ktime_t t2;
+	int calls;
+};
+
+static void channel_byte_echo_task(struct task_t * task, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+	int v;
+
+	do {
+		channel_recv(pdat->bping, (unsigned char *)&v, sizeof(int));
+		channel_send(pdat->bpong, (unsigned char *)&v, sizeof(int));
+	} while(v >= 0);
+	atomic_inc(&pdat->done);
+}
+
+static void channel_msg_echo_task(struct task_t * task, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+	void * msg;
+
+	do {
+		mchannel_recv(pdat->mping, &msg, 0);
+		mchannel_send(pdat->mpong, msg, 0);
+	} while(msg);
+	atomic_inc(&pdat->done);
+}
+
+static void channel_byte_sink_task(struct task_t * task, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+	int v;
+
+	do {
+		channel_recv(pdat->bping, (unsigned char *)&v, sizeof(int));
+	} while(v >= 0);
+	atomic_inc(&pdat->done);
+}
+
+static void channel_msg_sink_task(struct task_t * task, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+	void * msg;
+
+	do {
+		mchannel_recv(pdat->mstream, &msg, 0);
+	} while(msg);
+	atomic_inc(&pdat->done);
+}
+
+static void channel_wait_done(struct wbt_channel_pdata_t * pdat)
+{
+	while(atomic_get(&pdat->done) == 0)
+		task_yield();
+	atomic_set(&pdat->done, 0);
+}
+
+static void * channel_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_channel_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_channel_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->bping = channel_alloc(256);
+	pdat->bpong = channel_alloc(256);
+	pdat->mping = mchannel_alloc(0);
+	pdat->mpong = mchannel_alloc(0);
+	pdat->mstream = mchannel_alloc(64);
+	if(!pdat->bping || !pdat->bpong || !pdat->mping || !pdat->mpong || !pdat->mstream)
+	{
+		channel_free(pdat->bping);
+		channel_free(pdat->bpong);
+		mchannel_free(pdat->mping);
+		mchannel_free(pdat->mpong);
+		mchannel_free(pdat->mstream);
+		free(pdat);
+		return NULL;
+	}
+	atomic_set(&pdat->done, 0);
+	return pdat;
+}
+
+static void channel_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+
+	if(pdat)
+	{
+		channel_free(pdat->bping);
+		channel_free(pdat->bpong);
+		mchannel_free(pdat->mping);
+		mchannel_free(pdat->mpong);
+		mchannel_free(pdat->mstream);
+		free(pdat);
+	}
+}
+
+static void channel_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+	struct task_t * task;
+	void * msg;
+	int v;
+
+	if(pdat)
+	{
+		task = task_create(NULL, "wbt-echo", channel_byte_echo_task, pdat, SZ_64K, 0);
+		assert_not_null(task);
+		if(task)
+		{
+			task_resume(task);
+			pdat->calls = 0;
+			pdat->t2 = pdat->t1 = ktime_get();
+			do {
+				v = pdat->calls++;
+				channel_send(pdat->bping, (unsigned char *)&v, sizeof(int));
+				channel_recv(pdat->bpong, (unsigned char *)&v, sizeof(int));
+				pdat->t2 = ktime_get();
+			} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+			v = -1;
+			channel_send(pdat->bping, (unsigned char *)&v, sizeof(int));
+			channel_recv(pdat->bpong, (unsigned char *)&v, sizeof(int));
+			channel_wait_done(pdat);
+			wboxtest_print(" Byte ping-pong: %.2f round trips/s, %.3fus\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1), (double)ktime_us_delta(pdat->t2, pdat->t1) / pdat->calls);
+		}
+
+		task = task_create(NULL, "wbt-echo", channel_msg_echo_task, pdat, SZ_64K, 0);
+		assert_not_null(task);
+		if(task)
+		{
+			task_resume(task);
+			pdat->calls = 0;
+			pdat->t2 = pdat->t1 = ktime_get();
+			do {
+				pdat->calls++;
+				mchannel_send(pdat->mping, pdat, 0);
+				mchannel_recv(pdat->mpong, &msg, 0);
+				pdat->t2 = ktime_get();
+			} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+			mchannel_send(pdat->mping, NULL, 0);
+			mchannel_recv(pdat->mpong, &msg, 0);
+			channel_wait_done(pdat);
+			wboxtest_print(" Message ping-pong: %.2f round trips/s, %.3fus\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1), (double)ktime_us_delta(pdat->t2, pdat->t1) / pdat->calls);
+		}
+
+		task = task_create(NULL, "wbt-sink", channel_byte_sink_task, pdat, SZ_64K, 0);
+		assert_not_null(task);
+		if(task)
+		{
+			task_resume(task);
+			pdat->calls = 0;
+			pdat->t2 = pdat->t1 = ktime_get();
+			do {
+				v = pdat->calls++;
+				channel_send(pdat->bping, (unsigned char *)&v, sizeof(int));
+				pdat->t2 = ktime_get();
+			} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+			v = -1;
+			channel_send(pdat->bping, (unsigned char *)&v, sizeof(int));
+			channel_wait_done(pdat);
+			wboxtest_print(" Byte stream: %.2f msgs/s\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+		}
+
+		task = task_create(NULL, "wbt-sink", channel_msg_sink_task, pdat, SZ_64K, 0);
+		assert_not_null(task);
+		if(task)
+		{
+			task_resume(task);
+			pdat->calls = 0;
+			pdat->t2 = pdat->t1 = ktime_get();
+			do {
+				pdat->calls++;
+				mchannel_send(pdat->mstream, pdat, 0);
+				pdat->t2 = ktime_get();
+			} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+			mchannel_send(pdat->mstream, NULL, 0);
+			channel_wait_done(pdat);
+			wboxtest_print(" Message stream: %.2f msgs/s\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+		}
+	}
+}
+
+static struct wboxtest_t wbt_channel = {
+	.group	= "benchmark",
+	.name	= "channel",
+	.setup	= channel_setup,
+	.clean	= channel_clean,
+	.run	= channel_run,
+};
+
+static __init void channel_wbt_init(void)
+{
+	register_wboxtest(&wbt_channel);
+}
+
+static __exit void channel_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_channel);
+}
+
+wboxtest_initcall(channel_wbt_init);
+wboxtest_exitcall(channel_wbt_exit);
@@ -0,0 +1,207 @@
+/*
+ * wboxtest/benchmark/malloc.c
+ */
+
+#include <wboxtest.h>
+
+#define MALLOC_BENCHMARK_SLOTS	(1024)
+#define MALLOC_BENCHMARK_POOL	(SZ_4M)
+
+struct wbt_malloc_pdata_t
+{
+	void * pool;
+	void * mm;
+	struct kmem_cache_t * cache;
+	void * slot[MALLOC_BENCHMARK_SLOTS];
+	size_t req[MALLOC_BENCHMARK_SLOTS];
+	unsigned short index[4096];
+	unsigned short size[4096];
+
+	ktime_t t1;
+	ktime_t t2;
+	int calls;
+};
+
+enum {
+	MALLOC_HEAP,
+	MALLOC_TLSF,
+	MALLOC_KMEM,
+};
+
+static inline void * wbt_alloc(struct wbt_malloc_pdata_t * pdat, int type, size_t size)
+{
+	switch(type)
+	{
+	case MALLOC_HEAP:
+		return malloc(size);
+	case MALLOC_TLSF:
+		return mm_malloc(pdat->mm, size);
+	case MALLOC_KMEM:
+		return kmem_cache_alloc(pdat->cache);
+	default:
+		return NULL;
+	}
+}
+
+static inline void wbt_free(struct wbt_malloc_pdata_t * pdat, int type, void * p)
+{
+	switch(type)
+	{
+	case MALLOC_HEAP:
+		free(p);
+		break;
+	case MALLOC_TLSF:
+		mm_free(pdat->mm, p);
+		break;
+	case MALLOC_KMEM:
+		kmem_cache_free(pdat->cache, p);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Bytes handed out against bytes asked for over the live slots
+ */
+static void wbt_overhead(struct wbt_malloc_pdata_t * pdat, int type, size_t * used, size_t * req)
+{
+	int j;
+
+	for(j = 0; j < MALLOC_BENCHMARK_SLOTS; j++)
+	{
+		if(pdat->slot[j])
+		{
+			if(type == MALLOC_KMEM)
+				*used += pdat->cache->size;
+			else
+				*used += malloc_usable_size(pdat->slot[j]);
+			*req += pdat->req[j];
+		}
+	}
+}
+
+/*
+ * Random alloc and free over a set of slots, about half of them live
+ */
+static void wbt_workload(struct wbt_malloc_pdata_t * pdat, int type, int fixed, const char * name)
+{
+	size_t used = 0, req = 0;
+	int i, j;
+
+	memset(pdat->slot, 0, sizeof(pdat->slot));
+	pdat->calls = 0;
+	pdat->t2 = pdat->t1 = ktime_get();
+	do {
+		for(i = 0; i < 4096; i++)
+		{
+			j = pdat->index[i];
+			if(pdat->slot[j])
+			{
+				wbt_free(pdat, type, pdat->slot[j]);
+				pdat->slot[j] = NULL;
+			}
+			else
+			{
+				pdat->req[j] = fixed ? fixed : pdat->size[i];
+				pdat->slot[j] = wbt_alloc(pdat, type, pdat->req[j]);
+			}
+		}
+		if(pdat->calls == 0)
+			wbt_overhead(pdat, type, &used, &req);
+		pdat->calls += 4096;
+		pdat->t2 = ktime_get();
+	} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+
+	for(j = 0; j < MALLOC_BENCHMARK_SLOTS; j++)
+	{
+		if(pdat->slot[j])
+		{
+			wbt_free(pdat, type, pdat->slot[j]);
+			pdat->slot[j] = NULL;
+		}
+	}
+	wboxtest_print(" %s: %.2f ops/s, used/requested %.3f\r\n", name, (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1), req ? (double)used / req : 0.0);
+}
+
+static void * malloc_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_malloc_pdata_t * pdat;
+	int i;
+
+	pdat = malloc(sizeof(struct wbt_malloc_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->pool = malloc(MALLOC_BENCHMARK_POOL);
+	pdat->cache = kmem_cache_create("wbt-malloc", 64, 0);
+	if(!pdat->pool || !pdat->cache)
+	{
+		if(pdat->pool)
+			free(pdat->pool);
+		kmem_cache_destroy(pdat->cache);
+		free(pdat);
+		return NULL;
+	}
+	pdat->mm = mm_create(pdat->pool, MALLOC_BENCHMARK_POOL);
+	for(i = 0; i < 4096; i++)
+	{
+		pdat->index[i] = wboxtest_random_int(0, MALLOC_BENCHMARK_SLOTS - 1);
+		pdat->size[i] = wboxtest_random_int(8, 320);
+	}
+	return pdat;
+}
+
+static void malloc_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_malloc_pdata_t * pdat = (struct wbt_malloc_pdata_t *)data;
+
+	if(pdat)
+	{
+		mm_destroy(pdat->mm);
+		free(pdat->pool);
+		kmem_cache_destroy(pdat->cache);
+		free(pdat);
+	}
+}
+
+static void malloc_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_malloc_pdata_t * pdat = (struct wbt_malloc_pdata_t *)data;
+	size_t mused, mfree;
+
+	if(pdat)
+	{
+		wbt_workload(pdat, MALLOC_TLSF, 0, "TLSF 8-320");
+		wbt_workload(pdat, MALLOC_HEAP, 0, "Magazine 8-320");
+		wbt_workload(pdat, MALLOC_TLSF, 64, "TLSF 64");
+		wbt_workload(pdat, MALLOC_HEAP, 64, "Magazine 64");
+		wbt_workload(pdat, MALLOC_KMEM, 64, "Kmem 64");
+
+		mm_info(mm_get(pdat->mm), &mused, &mfree);
+		assert_equal(mused, 0);
+		kmem_cache_shrink(pdat->cache);
+		assert_equal(pdat->cache->nr_slabs, 0);
+	}
+}
+
+static struct wboxtest_t wbt_malloc = {
+	.group	= "benchmark",
+	.name	= "malloc",
+	.setup	= malloc_setup,
+	.clean	= malloc_clean,
+	.run	= malloc_run,
+};
+
+static __init void malloc_wbt_init(void)
+{
+	register_wboxtest(&wbt_malloc);
+}
+
+static __exit void malloc_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_malloc);
+}
+
+wboxtest_initcall(malloc_wbt_init);
+wboxtest_exitcall(malloc_wbt_exit);
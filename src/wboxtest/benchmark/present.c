@@ -0,0 +1,124 @@
+/*
+ * wboxtest/benchmark/present.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_present_pdata_t
+{
+	struct window_t * w;
+	struct color_t c;
+
+	ktime_t t1;
+	ktime_t t2;
+	int calls;
+};
+
+static void * present_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_present_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_present_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->w = window_alloc(NULL, NULL, NULL);
+	if(!pdat->w)
+	{
+		free(pdat);
+		return NULL;
+	}
+	color_init(&pdat->c, 0x20, 0x40, 0x60, 0xff);
+	return pdat;
+}
+
+static void present_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_present_pdata_t * pdat = (struct wbt_present_pdata_t *)data;
+
+	if(pdat)
+	{
+		window_free(pdat->w);
+		free(pdat);
+	}
+}
+
+/*
+ * Stands for an application covering the whole window with an opaque
+ * background, as most of them do
+ */
+static void draw_opaque(struct window_t * w, void * o)
+{
+	struct wbt_present_pdata_t * pdat = (struct wbt_present_pdata_t *)o;
+
+	surface_clear(w->s, &pdat->c, 0, 0, window_get_width(w), window_get_height(w));
+}
+
+static double present_bench(struct wbt_present_pdata_t * pdat, const char * name, enum window_background_t type, int opaque)
+{
+	struct region_t r;
+	double ms;
+
+	region_init(&r, 0, 0, window_get_width(pdat->w), window_get_height(pdat->w));
+	window_set_background(pdat->w, type, &pdat->c);
+	window_set_opaque(pdat->w, opaque);
+	pdat->calls = 0;
+	pdat->t2 = pdat->t1 = ktime_get();
+	do {
+		pdat->calls++;
+		window_region_list_clear(pdat->w);
+		window_region_list_add(pdat->w, &r);
+		window_present(pdat->w, pdat, draw_opaque);
+		pdat->t2 = ktime_get();
+	} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+	ms = (double)ktime_ms_delta(pdat->t2, pdat->t1) / pdat->calls;
+	wboxtest_print(" %s: %.3f ms/frame, %d frames\r\n", name, ms, pdat->calls);
+	return ms;
+}
+
+static void present_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_present_pdata_t * pdat = (struct wbt_present_pdata_t *)data;
+	struct color_t c;
+	int bytes;
+	double ms;
+
+	if(pdat)
+	{
+		window_region_list_clear(pdat->w);
+		window_region_list_add(pdat->w, &(struct region_t){ 0, 0, 16, 16 });
+		window_set_background(pdat->w, WINDOW_BACKGROUND_SOLID, &pdat->c);
+		window_set_opaque(pdat->w, 0);
+		window_present(pdat->w, NULL, NULL);
+		surface_get_pixel(pdat->w->s, 8, 8, &c);
+		assert_true((c.r == pdat->c.r) && (c.g == pdat->c.g) && (c.b == pdat->c.b) && (c.a == pdat->c.a));
+
+		bytes = window_get_width(pdat->w) * window_get_height(pdat->w) * 4;
+		ms = present_bench(pdat, "Checkerboard", WINDOW_BACKGROUND_CHECKERBOARD, 0);
+		present_bench(pdat, "Solid", WINDOW_BACKGROUND_SOLID, 0);
+		present_bench(pdat, "None", WINDOW_BACKGROUND_NONE, 0);
+		ms -= present_bench(pdat, "Opaque root", WINDOW_BACKGROUND_CHECKERBOARD, 1);
+		wboxtest_print(" Saved: %.3f ms/frame, %d bytes/frame of background writes\r\n", ms, bytes);
+	}
+}
+
+static struct wboxtest_t wbt_present = {
+	.group	= "benchmark",
+	.name	= "present",
+	.setup	= present_setup,
+	.clean	= present_clean,
+	.run	= present_run,
+};
+
+static __init void present_wbt_init(void)
+{
+	register_wboxtest(&wbt_present);
+}
+
+static __exit void present_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_present);
+}
+
+wboxtest_initcall(present_wbt_init);
+wboxtest_exitcall(present_wbt_exit);
@@ -0,0 +1,347 @@
+/*
+ * wboxtest/benchmark/region.c
+ */
+
+#include <wboxtest.h>
+
+#define REGION_MAP_SIZE		(256)
+
+struct wbt_region_pdata_t
+{
+	struct region_list_t * a;
+	struct region_list_t * b;
+	struct region_list_t * r;
+	unsigned char * ma;
+	unsigned char * mb;
+	unsigned char * mr;
+
+	ktime_t t1;
+	ktime_t t2;
+	int calls;
+};
+
+static void region_random(struct region_t * r, int size, int maxw)
+{
+	int w = wboxtest_random_int(1, maxw);
+	int h = wboxtest_random_int(1, maxw);
+
+	region_init(r, wboxtest_random_int(0, size - w), wboxtest_random_int(0, size - h), w, h);
+}
+
+static void region_list_random(struct region_list_t * rl, int n, int maxw)
+{
+	struct region_t r;
+	int i;
+
+	region_list_clear(rl);
+	for(i = 0; i < n; i++)
+	{
+		region_random(&r, REGION_MAP_SIZE, maxw);
+		region_list_add(rl, &r);
+	}
+}
+
+static void region_list_map(struct region_list_t * rl, unsigned char * m)
+{
+	struct region_t * r;
+	int i, x, y;
+
+	memset(m, 0, REGION_MAP_SIZE * REGION_MAP_SIZE);
+	for(i = 0; i < rl->count; i++)
+	{
+		r = &rl->region[i];
+		for(y = r->y; y < r->y + r->h; y++)
+		{
+			for(x = r->x; x < r->x + r->w; x++)
+				m[y * REGION_MAP_SIZE + x]++;
+		}
+	}
+}
+
+static int region_list_banded(struct region_list_t * rl)
+{
+	struct region_t * p, * r;
+	int i;
+
+	for(i = 1; i < rl->count; i++)
+	{
+		p = &rl->region[i - 1];
+		r = &rl->region[i];
+		if(r->y == p->y)
+		{
+			if((r->h != p->h) || (r->x <= p->x + p->w))
+				return 0;
+		}
+		else if(r->y < p->y + p->h)
+			return 0;
+	}
+	return 1;
+}
+
+static long region_list_area(struct region_list_t * rl)
+{
+	long area = 0;
+	int i;
+
+	for(i = 0; i < rl->count; i++)
+		area += rl->region[i].w * rl->region[i].h;
+	return area;
+}
+
+/*
+ * The dirty list as it was before, each rectangle is merged into the
+ * bounding box of the first one it overlaps or touches
+ */
+static long region_bbox_area(struct region_t * rs, int n)
+{
+	struct region_t b[64];
+	long area = 0;
+	int count = 0;
+	int i, j;
+
+	for(i = 0; i < n; i++)
+	{
+		for(j = 0; j < count; j++)
+		{
+			if(region_overlap(&b[j], &rs[i]))
+			{
+				region_union(&b[j], &b[j], &rs[i]);
+				break;
+			}
+		}
+		if(j == count)
+			region_clone(&b[count++], &rs[i]);
+	}
+	for(i = 0; i < count; i++)
+		area += b[i].w * b[i].h;
+	return area;
+}
+
+static void * region_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_region_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_region_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->a = region_list_alloc(0);
+	pdat->b = region_list_alloc(0);
+	pdat->r = region_list_alloc(0);
+	pdat->ma = malloc(REGION_MAP_SIZE * REGION_MAP_SIZE);
+	pdat->mb = malloc(REGION_MAP_SIZE * REGION_MAP_SIZE);
+	pdat->mr = malloc(REGION_MAP_SIZE * REGION_MAP_SIZE);
+	if(!pdat->a || !pdat->b || !pdat->r || !pdat->ma || !pdat->mb || !pdat->mr)
+	{
+		region_list_free(pdat->a);
+		region_list_free(pdat->b);
+		region_list_free(pdat->r);
+		free(pdat->ma);
+		free(pdat->mb);
+		free(pdat->mr);
+		free(pdat);
+		return NULL;
+	}
+	return pdat;
+}
+
+static void region_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_region_pdata_t * pdat = (struct wbt_region_pdata_t *)data;
+
+	if(pdat)
+	{
+		region_list_free(pdat->a);
+		region_list_free(pdat->b);
+		region_list_free(pdat->r);
+		free(pdat->ma);
+		free(pdat->mb);
+		free(pdat->mr);
+		free(pdat);
+	}
+}
+
+static void region_area_bench(struct wbt_region_pdata_t * pdat, int n)
+{
+	struct region_t rs[64];
+	long old = 0, area = 0, exact = 0;
+	int t, i, k, x, y;
+
+	for(t = 0; t < 100; t++)
+	{
+		region_list_clear(pdat->r);
+		for(i = 0; i < n; i++)
+		{
+			region_random(&rs[i], REGION_MAP_SIZE, 32);
+			region_list_add(pdat->r, &rs[i]);
+		}
+		old += region_bbox_area(rs, n);
+		area += region_list_area(pdat->r);
+		memset(pdat->ma, 0, REGION_MAP_SIZE * REGION_MAP_SIZE);
+		for(i = 0; i < n; i++)
+		{
+			for(y = rs[i].y; y < rs[i].y + rs[i].h; y++)
+			{
+				for(x = rs[i].x; x < rs[i].x + rs[i].w; x++)
+					pdat->ma[y * REGION_MAP_SIZE + x] = 1;
+			}
+		}
+		for(k = 0; k < REGION_MAP_SIZE * REGION_MAP_SIZE; k++)
+			exact += pdat->ma[k];
+	}
+	assert_equal(area, exact);
+	wboxtest_print(" Area of %d rects: %ld pixels, bounding boxes %ld pixels\r\n", n, area / 100, old / 100);
+}
+
+static int region_op_check(struct wbt_region_pdata_t * pdat, int op)
+{
+	int k, v;
+
+	region_list_map(pdat->a, pdat->ma);
+	region_list_map(pdat->b, pdat->mb);
+	region_list_map(pdat->r, pdat->mr);
+	for(k = 0; k < REGION_MAP_SIZE * REGION_MAP_SIZE; k++)
+	{
+		if(op == 0)
+			v = pdat->ma[k] | pdat->mb[k];
+		else if(op == 1)
+			v = pdat->ma[k] & pdat->mb[k];
+		else
+			v = pdat->ma[k] & !pdat->mb[k];
+		if(pdat->mr[k] != v)
+			return 0;
+	}
+	return region_list_banded(pdat->r);
+}
+
+/*
+ * Add rectangles one by one, top down or in any order and some of them
+ * inside the one before, the list has to cover just what they cover
+ */
+static int region_add_check(struct wbt_region_pdata_t * pdat, int topdown)
+{
+	struct region_t r;
+	int n = wboxtest_random_int(1, 32);
+	int i, k, x, y;
+
+	region_list_clear(pdat->a);
+	memset(pdat->mb, 0, REGION_MAP_SIZE * REGION_MAP_SIZE);
+	for(i = 0, y = 0; i < n; i++)
+	{
+		region_random(&r, REGION_MAP_SIZE, 64);
+		if(topdown)
+		{
+			if(y + r.h > REGION_MAP_SIZE)
+				break;
+			r.y = y;
+			y += wboxtest_random_int(0, 1) ? r.h : r.h + wboxtest_random_int(1, 8);
+			if(wboxtest_random_int(0, 1) && (i > 0))
+			{
+				r.x = pdat->a->region[pdat->a->count - 1].x;
+				r.w = pdat->a->region[pdat->a->count - 1].w;
+			}
+		}
+		region_list_add(pdat->a, &r);
+		for(k = r.y; k < r.y + r.h; k++)
+		{
+			for(x = r.x; x < r.x + r.w; x++)
+				pdat->mb[k * REGION_MAP_SIZE + x] = 1;
+		}
+		if(!topdown && wboxtest_random_int(0, 1) && (r.w > 2) && (r.h > 2))
+		{
+			region_init(&r, r.x + 1, r.y + 1, r.w - 2, r.h - 2);
+			region_list_add(pdat->a, &r);
+		}
+	}
+	region_list_map(pdat->a, pdat->ma);
+	if(memcmp(pdat->ma, pdat->mb, REGION_MAP_SIZE * REGION_MAP_SIZE) != 0)
+		return 0;
+	return region_list_banded(pdat->a);
+}
+
+static void region_op_bench(struct wbt_region_pdata_t * pdat, int op)
+{
+	static const char * name[] = { "Union", "Intersect", "Subtract" };
+
+	region_list_random(pdat->a, 16, 64);
+	region_list_random(pdat->b, 16, 64);
+	pdat->calls = 0;
+	pdat->t2 = pdat->t1 = ktime_get();
+	do {
+		pdat->calls++;
+		if(op == 0)
+			region_list_union(pdat->r, pdat->a, pdat->b);
+		else if(op == 1)
+			region_list_intersect(pdat->r, pdat->a, pdat->b);
+		else
+			region_list_subtract(pdat->r, pdat->a, pdat->b);
+		pdat->t2 = ktime_get();
+	} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+	assert_true(region_op_check(pdat, op));
+	wboxtest_print(" %s: %.2f Kops/s, %d and %d rects to %d rects\r\n", name[op], (double)pdat->calls / ktime_ms_delta(pdat->t2, pdat->t1), pdat->a->count, pdat->b->count, pdat->r->count);
+}
+
+static void region_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_region_pdata_t * pdat = (struct wbt_region_pdata_t *)data;
+	struct region_t rs[2];
+	int i, op, n = 0;
+
+	if(pdat)
+	{
+		for(i = 0; i < 1000; i++)
+		{
+			region_list_random(pdat->a, wboxtest_random_int(0, 24), 96);
+			region_list_random(pdat->b, wboxtest_random_int(0, 24), 96);
+			op = wboxtest_random_int(0, 2);
+			if(op == 0)
+				region_list_union(pdat->r, pdat->a, pdat->b);
+			else if(op == 1)
+				region_list_intersect(pdat->r, pdat->a, pdat->b);
+			else
+				region_list_subtract(pdat->r, pdat->a, pdat->b);
+			if(!region_op_check(pdat, op))
+				n++;
+		}
+		assert_equal(n, 0);
+		for(i = 0, n = 0; i < 1000; i++)
+		{
+			if(!region_add_check(pdat, i & 1))
+				n++;
+		}
+		assert_equal(n, 0);
+		region_list_clear(pdat->r);
+		region_init(&rs[0], 8, 8, 24, 24);
+		region_init(&rs[1], 32, 32, 160, 24);
+		region_list_add(pdat->r, &rs[0]);
+		region_list_add(pdat->r, &rs[1]);
+		assert_equal(region_list_area(pdat->r), 24 * 24 + 160 * 24);
+		wboxtest_print(" Diagonal: %ld pixels, bounding boxes %ld pixels\r\n", region_list_area(pdat->r), region_bbox_area(rs, 2));
+		region_area_bench(pdat, 2);
+		region_area_bench(pdat, 8);
+		region_area_bench(pdat, 32);
+		for(op = 0; op < 3; op++)
+			region_op_bench(pdat, op);
+	}
+}
+
+static struct wboxtest_t wbt_region = {
+	.group	= "benchmark",
+	.name	= "region",
+	.setup	= region_setup,
+	.clean	= region_clean,
+	.run	= region_run,
+};
+
+static __init void region_wbt_init(void)
+{
+	register_wboxtest(&wbt_region);
+}
+
+static __exit void region_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_region);
+}
+
+wboxtest_initcall(region_wbt_init);
+wboxtest_exitcall(region_wbt_exit);
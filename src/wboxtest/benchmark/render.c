@@ -0,0 +1,266 @@
+/*
+ * wboxtest/benchmark/render.c
+ */
+
+#include <wboxtest.h>
+#include <graphic/atlas.h>
+
+struct wbt_render_pdata_t
+{
+	struct surface_t * dst;
+	struct surface_t * src;
+	int count;
+
+	ktime_t t1;
+	ktime_t t2;
+	int calls;
+};
+
+static uint32_t render_random_pixel(void)
+{
+	int a = wboxtest_random_int(0, 3);
+
+	if(a == 0)
+		a = 0;
+	else if(a == 1)
+		a = 255;
+	else
+		a = wboxtest_random_int(0, 255);
+	return (a << 24) | (wboxtest_random_int(0, a) << 16) | (wboxtest_random_int(0, a) << 8) | (wboxtest_random_int(0, a) << 0);
+}
+
+static void render_blit_bench(struct wbt_render_pdata_t * pdat, const char * name, struct matrix_t * m, enum render_type_t type)
+{
+	struct region_t r, region;
+
+	region_init(&r, 0, 0, surface_get_width(pdat->dst), surface_get_height(pdat->dst));
+	matrix_transform_region(m, surface_get_width(pdat->src), surface_get_height(pdat->src), &region);
+	if(!region_intersect(&r, &r, &region))
+		return;
+	pdat->calls = 0;
+	pdat->t2 = pdat->t1 = ktime_get();
+	do {
+		pdat->calls++;
+		render_default_blit(pdat->dst, NULL, m, pdat->src, type);
+		pdat->t2 = ktime_get();
+	} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+	wboxtest_print(" %s: %.2f Mpixels/s\r\n", name, (double)pdat->calls * r.w * r.h / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+}
+
+static void render_shape_bench(struct wbt_render_pdata_t * pdat)
+{
+	struct cache_stat_t s1, s2;
+	struct color_t c;
+
+	color_init(&c, 0x33, 0x66, 0x99, 0x80);
+	render_shape_cache_stat(&s1);
+	pdat->calls = 0;
+	pdat->t2 = pdat->t1 = ktime_get();
+	do {
+		pdat->calls++;
+		render_default_shape_rectangle(pdat->dst, NULL, pdat->calls & 0x3f, pdat->calls & 0x1f, 128, 96, 16, 0, &c);
+		pdat->t2 = ktime_get();
+	} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+	render_shape_cache_stat(&s2);
+	wboxtest_print(" Shape: %.2f Mpixels/s, %lld hits, %lld misses\r\n", (double)pdat->calls * 128 * 96 / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1), (long long)(s2.hit - s1.hit), (long long)(s2.miss - s1.miss));
+}
+
+static void render_text_bench(struct wbt_render_pdata_t * pdat)
+{
+	struct font_context_t * f;
+	struct cache_stat_t s1, s2, a1, a2;
+	struct text_t txt;
+	struct color_t c;
+	struct matrix_t m;
+
+	f = font_context_alloc();
+	if(!f)
+		return;
+	color_init(&c, 0xff, 0xff, 0xff, 0xff);
+	text_init(&txt, "The quick brown fox", &c, 0, f, "roboto", 20);
+	font_cache_stat(&s1);
+	pdat->calls = 0;
+	pdat->t2 = pdat->t1 = ktime_get();
+	do {
+		pdat->calls++;
+		matrix_init_translate(&m, 20 + (pdat->calls & 0x7) * 0.125, 120);
+		matrix_rotate(&m, 0.3);
+		render_default_text(pdat->dst, NULL, &m, &txt);
+		pdat->t2 = ktime_get();
+	} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+	font_cache_stat(&s2);
+	wboxtest_print(" Rotated text: %.2f Kglyphs/s, %lld hits, %lld misses\r\n", (double)pdat->calls * 19 / ktime_ms_delta(pdat->t2, pdat->t1), (long long)(s2.hit - s1.hit), (long long)(s2.miss - s1.miss));
+
+	text_run_cache_stat(&s1);
+	atlas_stat(&a1);
+	pdat->calls = 0;
+	pdat->t2 = pdat->t1 = ktime_get();
+	do {
+		pdat->calls++;
+		text_init(&txt, "The quick brown fox", &c, 0, f, "roboto", 20);
+		matrix_init_translate(&m, 20, 120);
+		render_default_text(pdat->dst, NULL, &m, &txt);
+		pdat->t2 = ktime_get();
+	} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+	text_run_cache_stat(&s2);
+	atlas_stat(&a2);
+	wboxtest_print(" Label: %.2f Klabels/s, %lld hits, %lld misses, atlas %lld hits, %lld misses\r\n", (double)pdat->calls / ktime_ms_delta(pdat->t2, pdat->t1), (long long)(s2.hit - s1.hit), (long long)(s2.miss - s1.miss), (long long)(a2.hit - a1.hit), (long long)(a2.miss - a1.miss));
+	font_context_free(f);
+}
+
+static void * render_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_render_pdata_t * pdat;
+	uint32_t * p, * q;
+	int i;
+
+	pdat = malloc(sizeof(struct wbt_render_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->dst = surface_alloc(256, 256, NULL);
+	pdat->src = surface_alloc(256, 256, NULL);
+	pdat->count = 256 * 256;
+	if(!pdat->dst || !pdat->src)
+	{
+		if(pdat->dst)
+			surface_free(pdat->dst);
+		if(pdat->src)
+			surface_free(pdat->src);
+		free(pdat);
+		return NULL;
+	}
+	p = surface_get_pixels(pdat->dst);
+	q = surface_get_pixels(pdat->src);
+	for(i = 0; i < pdat->count; i++)
+	{
+		p[i] = render_random_pixel();
+		q[i] = render_random_pixel();
+	}
+
+	return pdat;
+}
+
+static void render_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_render_pdata_t * pdat = (struct wbt_render_pdata_t *)data;
+
+	if(pdat)
+	{
+		surface_free(pdat->dst);
+		surface_free(pdat->src);
+		free(pdat);
+	}
+}
+
+static void render_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_render_pdata_t * pdat = (struct wbt_render_pdata_t *)data;
+	struct matrix_t m;
+	struct color_t c;
+	uint32_t * p, * q;
+
+	if(pdat)
+	{
+		p = surface_get_pixels(pdat->dst);
+		q = surface_get_pixels(pdat->src);
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			render_span_blend(p, q, pdat->count);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Blend: %.2f Mpixels/s\r\n", (double)pdat->calls * pdat->count / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			render_span_fill(p, 0xff336699, pdat->count);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Fill: %.2f Mpixels/s\r\n", (double)pdat->calls * pdat->count / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			render_span_copy(p, q, pdat->count);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Copy: %.2f Mpixels/s\r\n", (double)pdat->calls * pdat->count / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+
+		matrix_init_identity(&m);
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			surface_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_GOOD);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Blit: %.2f Mpixels/s\r\n", (double)pdat->calls * pdat->count / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+		matrix_init_translate(&m, 3, 5);
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			render_default_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_FAST);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Default translate: %.2f Mpixels/s\r\n", (double)pdat->calls * (256 - 3) * (256 - 5) / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+
+		matrix_init_scale(&m, 2, 2);
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			render_default_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_FAST);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Default scale: %.2f Mpixels/s\r\n", (double)pdat->calls * pdat->count / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+
+		matrix_init_scale(&m, 1.5, 1.5);
+		render_blit_bench(pdat, "Default good scale", &m, RENDER_TYPE_GOOD);
+		render_blit_bench(pdat, "Default best scale", &m, RENDER_TYPE_BEST);
+		matrix_init_scale(&m, 0.2, 0.2);
+		render_blit_bench(pdat, "Default good shrink", &m, RENDER_TYPE_GOOD);
+		matrix_init_rotate(&m, 0.3);
+		render_blit_bench(pdat, "Default good rotate", &m, RENDER_TYPE_GOOD);
+
+		matrix_init_identity(&m);
+		color_init(&c, 0x33, 0x66, 0x99, 0xff);
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			surface_fill(pdat->dst, NULL, &m, 256, 256, &c, RENDER_TYPE_GOOD);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Rect: %.2f Mpixels/s\r\n", (double)pdat->calls * pdat->count / 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+
+		render_shape_bench(pdat);
+		render_text_bench(pdat);
+	}
+}
+
+static struct wboxtest_t wbt_render = {
+	.group	= "benchmark",
+	.name	= "render",
+	.setup	= render_setup,
+	.clean	= render_clean,
+	.run	= render_run,
+};
+
+static __init void render_wbt_init(void)
+{
+	register_wboxtest(&wbt_render);
+}
+
+static __exit void render_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_render);
+}
+
+wboxtest_initcall(render_wbt_init);
+wboxtest_exitcall(render_wbt_exit);
@@ -0,0 +1,135 @@
+/*
+ * wboxtest/benchmark/task.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_task_pdata_t
+{
+	volatile int done;
+
+	ktime_t t1;
+	ktime_t t2;
+	int calls;
+};
+
+static void task_benchmark_func(struct task_t * task, void * data)
+{
+	struct wbt_task_pdata_t * pdat = (struct wbt_task_pdata_t *)data;
+
+	pdat->done++;
+}
+
+static void * task_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_task_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_task_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->done = 0;
+	return pdat;
+}
+
+static void task_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_task_pdata_t * pdat = (struct wbt_task_pdata_t *)data;
+
+	if(pdat)
+		free(pdat);
+}
+
+static void task_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_task_pdata_t * pdat = (struct wbt_task_pdata_t *)data;
+	struct task_t * task;
+	void * stack;
+	size_t size;
+	int n;
+
+	if(pdat)
+	{
+		/*
+		 * The memory a task needs used to come from two heap allocations,
+		 * now it is a single block from the stack arena.
+		 */
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			task = malloc(sizeof(struct task_t));
+			stack = malloc(SZ_64K);
+			free(stack);
+			free(task);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Heap: %.2f tasks/s\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			size = SZ_64K;
+			stack = stack_alloc(&size);
+			stack_free(stack, size);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Arena: %.2f tasks/s\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			task = task_create(scheduler_self(), "wbt-task", task_benchmark_func, pdat, SZ_64K, 0);
+			if(!task)
+				break;
+			task_destroy(task);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Create: %.2f tasks/s\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+		assert_not_null(task);
+
+		/*
+		 * The loops above never yield, so let the other ready tasks take
+		 * back the time they are owed before timing the spawn loop.
+		 */
+		task_yield();
+		pdat->calls = 0;
+		pdat->done = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			n = ++pdat->calls;
+			task = task_create(scheduler_self(), "wbt-task", task_benchmark_func, pdat, SZ_64K, 0);
+			if(!task)
+				break;
+			task_resume(task);
+			while(pdat->done < n)
+				task_yield();
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Spawn: %.2f tasks/s\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+		assert_not_null(task);
+	}
+}
+
+static struct wboxtest_t wbt_task = {
+	.group	= "benchmark",
+	.name	= "task",
+	.setup	= task_setup,
+	.clean	= task_clean,
+	.run	= task_run,
+};
+
+static __init void task_wbt_init(void)
+{
+	register_wboxtest(&wbt_task);
+}
+
+static __exit void task_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_task);
+}
+
+wboxtest_initcall(task_wbt_init);
+wboxtest_exitcall(task_wbt_exit);
@@ -0,0 +1,125 @@
+/*
+ * wboxtest/benchmark/timer.c
+ */
+
+#include <wboxtest.h>
+
+#define TIMER_BENCHMARK_COUNT	(100000)
+
+struct wbt_timer_pdata_t
+{
+	struct timer_t * timers;
+	int * interval;
+	volatile int fired;
+
+	ktime_t t1;
+	ktime_t t2;
+};
+
+static int timer_benchmark_function(struct timer_t * timer, void * data)
+{
+	struct wbt_timer_pdata_t * pdat = (struct wbt_timer_pdata_t *)data;
+
+	pdat->fired++;
+	return 0;
+}
+
+static void * timer_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_timer_pdata_t * pdat;
+	int i;
+
+	pdat = malloc(sizeof(struct wbt_timer_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->timers = malloc(sizeof(struct timer_t) * TIMER_BENCHMARK_COUNT);
+	pdat->interval = malloc(sizeof(int) * TIMER_BENCHMARK_COUNT);
+	if(!pdat->timers || !pdat->interval)
+	{
+		free(pdat->timers);
+		free(pdat->interval);
+		free(pdat);
+		return NULL;
+	}
+	for(i = 0; i < TIMER_BENCHMARK_COUNT; i++)
+	{
+		timer_init(&pdat->timers[i], timer_benchmark_function, pdat);
+		pdat->interval[i] = wboxtest_random_int(1000, 60000);
+	}
+	pdat->fired = 0;
+	return pdat;
+}
+
+static void timer_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_timer_pdata_t * pdat = (struct wbt_timer_pdata_t *)data;
+
+	if(pdat)
+	{
+		free(pdat->timers);
+		free(pdat->interval);
+		free(pdat);
+	}
+}
+
+static void timer_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_timer_pdata_t * pdat = (struct wbt_timer_pdata_t *)data;
+	int i;
+
+	if(pdat)
+	{
+		/*
+		 * Intervals spread from one second to one minute, none fire in the test
+		 */
+		pdat->t1 = ktime_get();
+		for(i = 0; i < TIMER_BENCHMARK_COUNT; i++)
+			timer_start_now(&pdat->timers[i], ms_to_ktime(pdat->interval[i]));
+		pdat->t2 = ktime_get();
+		wboxtest_print(" Start: %.3fns per timer\r\n", (double)ktime_to_ns(ktime_sub(pdat->t2, pdat->t1)) / TIMER_BENCHMARK_COUNT);
+
+		pdat->t1 = ktime_get();
+		for(i = 0; i < TIMER_BENCHMARK_COUNT; i++)
+			timer_start_now(&pdat->timers[i], ms_to_ktime(pdat->interval[TIMER_BENCHMARK_COUNT - 1 - i]));
+		pdat->t2 = ktime_get();
+		wboxtest_print(" Restart: %.3fns per timer\r\n", (double)ktime_to_ns(ktime_sub(pdat->t2, pdat->t1)) / TIMER_BENCHMARK_COUNT);
+
+		pdat->t1 = ktime_get();
+		for(i = 0; i < TIMER_BENCHMARK_COUNT; i++)
+			timer_cancel(&pdat->timers[i]);
+		pdat->t2 = ktime_get();
+		wboxtest_print(" Cancel: %.3fns per timer\r\n", (double)ktime_to_ns(ktime_sub(pdat->t2, pdat->t1)) / TIMER_BENCHMARK_COUNT);
+		assert_equal(pdat->fired, 0);
+
+		/*
+		 * A batch of timers all due together, expired from one interrupt
+		 */
+		for(i = 0; i < 1000; i++)
+			timer_start_now(&pdat->timers[i], ms_to_ktime(5));
+		task_sleep(20 * 1000000);
+		wboxtest_print(" Expired: %d of 1000\r\n", pdat->fired);
+		assert_equal(pdat->fired, 1000);
+	}
+}
+
+static struct wboxtest_t wbt_timer = {
+	.group	= "benchmark",
+	.name	= "timer",
+	.setup	= timer_setup,
+	.clean	= timer_clean,
+	.run	= timer_run,
+};
+
+static __init void timer_wbt_init(void)
+{
+	register_wboxtest(&wbt_timer);
+}
+
+static __exit void timer_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_timer);
+}
+
+wboxtest_initcall(timer_wbt_init);
+wboxtest_exitcall(timer_wbt_exit);
@@ -0,0 +1,287 @@
+/*
+ * wboxtest/framework/dobject.c
+ */
+
+#include <framework/core/l-color.h>
+#include <framework/core/l-dobject.h>
+#include <framework/core/l-window.h>
+#include <wboxtest.h>
+
+static const char dobject_scene[] =
+	"root = Dobject.new(640, 480)\n"
+	"root:setBackgroundColor(Color.new({0, 0, 0, 255}))\n"
+	"parent = Dobject.new(100, 100)\n"
+	"child = Dobject.new(20, 20)\n"
+	"child:setPosition(10, 10)\n"
+	"child:setBackgroundColor(Color.new({255, 0, 0, 255}))\n"
+	"parent:addChild(child)\n"
+	"root:addChild(parent)\n"
+	"root:render(window)\n";
+
+static const char dobject_move[] =
+	"parent:setPosition(300, 200)\n"
+	"root:render(window)\n";
+
+static const char dobject_layer[] =
+	"layer = Dobject.new(100, 100)\n"
+	"layer:setPosition(50, 50)\n"
+	"layer:setBackgroundColor(Color.new({0, 0, 255, 255}))\n"
+	"inner = Dobject.new(40, 40)\n"
+	"inner:setPosition(10, 10)\n"
+	"leaf = Dobject.new(10, 10)\n"
+	"leaf:setPosition(5, 5)\n"
+	"leaf:setBackgroundColor(Color.new({0, 255, 0, 255}))\n"
+	"inner:addChild(leaf)\n"
+	"layer:addChild(inner)\n"
+	"layer:setCacheAsBitmap(true)\n"
+	"root:addChild(layer)\n"
+	"a = Dobject.new(10, 10)\n"
+	"a:setPosition(120, 60)\n"
+	"root:addChild(a)\n"
+	"b = Dobject.new(10, 10)\n"
+	"b:setPosition(60, 120)\n"
+	"root:addChild(b)\n"
+	"root:render(window)\n";
+
+static const char dobject_layer_over[] =
+	"a:setBackgroundColor(Color.new({255, 255, 255, 255}))\n"
+	"b:setBackgroundColor(Color.new({255, 255, 255, 255}))\n"
+	"root:render(window)\n";
+
+static const char dobject_layer_evict[] =
+	"for i = 1, 8 do\n"
+	"	local o = Dobject.new(500, 500)\n"
+	"	o:setPosition(i * 10, i * 10)\n"
+	"	o:setBackgroundColor(Color.new({i * 30, 0, 0, 255}))\n"
+	"	o:setCacheAsBitmap(true)\n"
+	"	root:addChild(o)\n"
+	"end\n"
+	"root:render(window)\n";
+
+struct wbt_dobject_pdata_t
+{
+	struct window_t * w;
+	lua_State * L;
+};
+
+static void * dobject_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_dobject_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_dobject_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->w = window_alloc(NULL, NULL, NULL);
+	if(!pdat->w)
+	{
+		free(pdat);
+		return NULL;
+	}
+	pdat->L = luaL_newstate();
+	if(!pdat->L)
+	{
+		window_free(pdat->w);
+		free(pdat);
+		return NULL;
+	}
+	luaL_openlibs(pdat->L);
+	luaL_requiref(pdat->L, "Color", luaopen_color, 1);
+	luaL_requiref(pdat->L, "Dobject", luaopen_dobject, 1);
+	luaL_requiref(pdat->L, "Window", luaopen_window, 1);
+	lua_pop(pdat->L, 3);
+	lua_pushlightuserdata(pdat->L, pdat->w);
+	luaL_setmetatable(pdat->L, MT_WINDOW);
+	lua_setglobal(pdat->L, "window");
+	return pdat;
+}
+
+static void dobject_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_dobject_pdata_t * pdat = (struct wbt_dobject_pdata_t *)data;
+
+	if(pdat)
+	{
+		lua_close(pdat->L);
+		window_free(pdat->w);
+		free(pdat);
+	}
+}
+
+static struct ldobject_t * dobject_global(lua_State * L, const char * name)
+{
+	struct ldobject_t * o;
+
+	lua_getglobal(L, name);
+	o = luaL_testudata(L, -1, MT_DOBJECT);
+	lua_pop(L, 1);
+	return o;
+}
+
+static uint32_t dobject_pixel(struct window_t * w, int x, int y)
+{
+	uint32_t * p = surface_get_pixels(w->s);
+
+	return p[y * (surface_get_stride(w->s) >> 2) + x];
+}
+
+static int dobject_dirty(struct window_t * w, int x, int y)
+{
+	int i;
+
+	for(i = 0; i < w->rl->count; i++)
+	{
+		if(region_hit(&w->rl->region[i], x, y))
+			return 1;
+	}
+	return 0;
+}
+
+static void dobject_copy(struct window_t * w, uint32_t * p, int x, int y, int width, int height)
+{
+	int j;
+
+	for(j = 0; j < height; j++)
+		memcpy(&p[j * width], (uint32_t *)surface_get_pixels(w->s) + (y + j) * (surface_get_stride(w->s) >> 2) + x, width * sizeof(uint32_t));
+}
+
+static void dobject_layer_run(struct wbt_dobject_pdata_t * pdat)
+{
+	struct ldobject_t * root, * layer, * inner, * leaf;
+	struct cache_stat_t s1, s2;
+	uint32_t * p, * q;
+
+	assert_equal(luaL_dostring(pdat->L, dobject_layer), LUA_OK);
+	root = dobject_global(pdat->L, "root");
+	layer = dobject_global(pdat->L, "layer");
+	inner = dobject_global(pdat->L, "inner");
+	leaf = dobject_global(pdat->L, "leaf");
+	if(!root || !layer || !inner || !leaf)
+		return;
+	assert_not_null(layer->layer.s);
+	assert_false(layer->mflag & MFLAG_LAYER);
+	assert_equal(dobject_pixel(pdat->w, 55, 55), 0xff0000ff);
+	assert_equal(dobject_pixel(pdat->w, 70, 70), 0xff00ff00);
+
+	/*
+	 * Both dirty rectangles cross the layer, which is blitted into each of
+	 * them but found in the cache once for the frame
+	 */
+	dobject_layer_stat(&s1);
+	assert_equal(luaL_dostring(pdat->L, dobject_layer_over), LUA_OK);
+	dobject_layer_stat(&s2);
+	assert_equal(s2.hit - s1.hit, 1);
+	assert_equal(s2.miss, s1.miss);
+
+	/*
+	 * Moving the object itself only moves where the layer is blitted
+	 */
+	dobject_layer_stat(&s1);
+	assert_equal(luaL_dostring(pdat->L, "layer:setPosition(150, 300)"), LUA_OK);
+	assert_false(layer->mflag & MFLAG_LAYER);
+	assert_equal(luaL_dostring(pdat->L, "root:render(window)"), LUA_OK);
+	dobject_layer_stat(&s2);
+	assert_equal(s2.miss, s1.miss);
+	assert_equal(dobject_pixel(pdat->w, 170, 320), 0xff00ff00);
+
+	/*
+	 * A change deep down marks every layer up to the root
+	 */
+	assert_equal(luaL_dostring(pdat->L, "leaf:setBackgroundColor(Color.new({255, 0, 255, 255}))"), LUA_OK);
+	assert_true(leaf->mflag & MFLAG_LAYER);
+	assert_true(inner->mflag & MFLAG_LAYER);
+	assert_true(layer->mflag & MFLAG_LAYER);
+	assert_true(root->mflag & MFLAG_LAYER);
+	dobject_layer_stat(&s1);
+	assert_equal(luaL_dostring(pdat->L, "root:render(window)"), LUA_OK);
+	dobject_layer_stat(&s2);
+	assert_equal(s2.miss - s1.miss, 1);
+	assert_false(layer->mflag & MFLAG_LAYER);
+	assert_equal(dobject_pixel(pdat->w, 170, 320), 0xffff00ff);
+
+	/*
+	 * The blitted layer looks the same as the subtree drawn in place
+	 */
+	p = malloc(102 * 102 * sizeof(uint32_t));
+	q = malloc(102 * 102 * sizeof(uint32_t));
+	if(p && q)
+	{
+		dobject_copy(pdat->w, p, 150, 300, 102, 102);
+		assert_equal(luaL_dostring(pdat->L, "layer:setCacheAsBitmap(false) root:render(window)"), LUA_OK);
+		assert_null(layer->layer.s);
+		dobject_copy(pdat->w, q, 150, 300, 102, 102);
+		assert_memory_equal(p, q, 102 * 102 * sizeof(uint32_t));
+	}
+	free(p);
+	free(q);
+
+	/*
+	 * More layers than the budget holds, the oldest make room for the new
+	 */
+	dobject_layer_stat(&s1);
+	assert_equal(luaL_dostring(pdat->L, dobject_layer_evict), LUA_OK);
+	dobject_layer_stat(&s2);
+	assert_true(s2.evict > s1.evict);
+	assert_true(s2.bytes <= CONFIG_DOBJECT_LAYER_CACHE_SIZE);
+}
+
+static void dobject_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_dobject_pdata_t * pdat = (struct wbt_dobject_pdata_t *)data;
+	struct ldobject_t * root, * parent, * child;
+
+	if(pdat)
+	{
+		assert_equal(luaL_dostring(pdat->L, dobject_scene), LUA_OK);
+		root = dobject_global(pdat->L, "root");
+		parent = dobject_global(pdat->L, "parent");
+		child = dobject_global(pdat->L, "child");
+		assert_not_null(root);
+		assert_not_null(parent);
+		assert_not_null(child);
+		if(!root || !parent || !child)
+			return;
+		assert_equal(parent->subtree_bounds.x, 0);
+		assert_equal(dobject_pixel(pdat->w, 20, 20), 0xffff0000);
+
+		/*
+		 * Moving the parent has to throw away the cached bounds of its subtree
+		 * and of the root, or the draw of the dirty region at the new place
+		 * would cull the parent and never reach the child
+		 */
+		assert_equal(luaL_dostring(pdat->L, dobject_move), LUA_OK);
+		assert_true(region_contains(&parent->subtree_bounds, &child->global_bounds));
+		assert_equal(parent->subtree_bounds.x, 300);
+		assert_equal(parent->subtree_bounds.y, 200);
+		assert_equal(child->subtree_bounds.x, 310);
+		assert_true(region_contains(&root->subtree_bounds, &parent->subtree_bounds));
+		assert_true(dobject_dirty(pdat->w, 20, 20));
+		assert_true(dobject_dirty(pdat->w, 320, 220));
+		assert_false(dobject_dirty(pdat->w, 600, 450));
+		assert_equal(dobject_pixel(pdat->w, 320, 220), 0xffff0000);
+		assert_equal(dobject_pixel(pdat->w, 20, 20), 0xff000000);
+
+		dobject_layer_run(pdat);
+	}
+}
+
+static struct wboxtest_t wbt_dobject = {
+	.group	= "framework",
+	.name	= "dobject",
+	.setup	= dobject_setup,
+	.clean	= dobject_clean,
+	.run	= dobject_run,
+};
+
+static __init void dobject_wbt_init(void)
+{
+	register_wboxtest(&wbt_dobject);
+}
+
+static __exit void dobject_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_dobject);
+}
+
+wboxtest_initcall(dobject_wbt_init);
+wboxtest_exitcall(dobject_wbt_exit);
@@ -0,0 +1,197 @@
+/*
+ * wboxtest/graphic/blit.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_blit_pdata_t
+{
+	struct surface_t * dst;
+	struct surface_t * ref;
+	struct surface_t * src;
+	uint32_t * back;
+};
+
+static uint32_t blit_random_pixel(void)
+{
+	int a = wboxtest_random_int(0, 3);
+
+	if(a == 0)
+		a = 0;
+	else if(a == 1)
+		a = 255;
+	else
+		a = wboxtest_random_int(0, 255);
+	return (a << 24) | (wboxtest_random_int(0, a) << 16) | (wboxtest_random_int(0, a) << 8) | (wboxtest_random_int(0, a) << 0);
+}
+
+static void * blit_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_blit_pdata_t * pdat;
+	uint32_t * p;
+	int i;
+
+	pdat = malloc(sizeof(struct wbt_blit_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->dst = surface_alloc(256, 256, NULL);
+	pdat->ref = surface_alloc(256, 256, NULL);
+	pdat->src = surface_alloc(64, 48, NULL);
+	pdat->back = malloc(256 * 256 * sizeof(uint32_t));
+	if(!pdat->dst || !pdat->ref || !pdat->src || !pdat->back)
+	{
+		if(pdat->dst)
+			surface_free(pdat->dst);
+		if(pdat->ref)
+			surface_free(pdat->ref);
+		if(pdat->src)
+			surface_free(pdat->src);
+		free(pdat->back);
+		free(pdat);
+		return NULL;
+	}
+	p = surface_get_pixels(pdat->src);
+	for(i = 0; i < 64 * 48; i++)
+		p[i] = blit_random_pixel();
+	for(i = 0; i < 256 * 256; i++)
+		pdat->back[i] = blit_random_pixel();
+	return pdat;
+}
+
+static void blit_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_blit_pdata_t * pdat = (struct wbt_blit_pdata_t *)data;
+
+	if(pdat)
+	{
+		surface_free(pdat->dst);
+		surface_free(pdat->ref);
+		surface_free(pdat->src);
+		free(pdat->back);
+		free(pdat);
+	}
+}
+
+/*
+ * The generic nearest path, one pixel at a time. A pixel whose source
+ * column lies within 2^-16 of a column edge is left out of the compare,
+ * as the dda of the axis path rounds its step to 2^-32 and leans forward
+ * by 2^-20 there. Returns the number of differing pixels.
+ */
+static int blit_compare(struct wbt_blit_pdata_t * pdat, struct region_t * clip, struct matrix_t * m)
+{
+	struct region_t r, region;
+	struct matrix_t t;
+	uint32_t * p = surface_get_pixels(pdat->ref);
+	uint32_t * q = surface_get_pixels(pdat->dst);
+	uint32_t * sp = surface_get_pixels(pdat->src);
+	double fx, fy;
+	int ox, oy;
+	int x, y, n = 0;
+
+	memcpy(p, pdat->back, pdat->ref->pixlen);
+	memcpy(q, pdat->back, pdat->dst->pixlen);
+	render_default_blit(pdat->dst, clip, m, pdat->src, RENDER_TYPE_FAST);
+
+	region_init(&r, 0, 0, 256, 256);
+	if(clip && !region_intersect(&r, &r, clip))
+		return memcmp(p, q, pdat->dst->pixlen) ? 1 : 0;
+	matrix_transform_region(m, 64, 48, &region);
+	if(!region_intersect(&r, &r, &region))
+		return memcmp(p, q, pdat->dst->pixlen) ? 1 : 0;
+	memcpy(&t, m, sizeof(struct matrix_t));
+	matrix_invert(&t);
+	for(y = r.y; y < r.y + r.h; y++)
+	{
+		for(x = r.x; x < r.x + r.w; x++)
+		{
+			fx = t.tx + x * t.a + y * t.c;
+			fy = t.ty + x * t.b + y * t.d;
+			ox = (int)fx;
+			oy = (int)fy;
+			if(ox >= 0 && ox < 64 && oy >= 0 && oy < 48)
+			{
+				if((t.a != 1.0) && (fabs(fx - round(fx)) < 1.0 / 65536))
+				{
+					p[y * 256 + x] = q[y * 256 + x];
+					continue;
+				}
+				render_span_blend(&p[y * 256 + x], &sp[oy * 64 + ox], 1);
+			}
+		}
+	}
+	for(y = 0; y < 256; y++)
+	{
+		for(x = 0; x < 256; x++)
+		{
+			if(p[y * 256 + x] != q[y * 256 + x])
+				n++;
+		}
+	}
+	return n;
+}
+
+static void blit_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_blit_pdata_t * pdat = (struct wbt_blit_pdata_t *)data;
+	struct region_t clip;
+	struct matrix_t m;
+
+	if(pdat)
+	{
+		matrix_init_translate(&m, 3, 5);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+		matrix_init_translate(&m, 17.25, 9.75);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+		matrix_init_translate(&m, -0.5, -0.5);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+
+		matrix_init_translate(&m, 10.3, 20.6);
+		matrix_scale(&m, 2, 2);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+		matrix_init_translate(&m, 7, 11);
+		matrix_scale(&m, 3, 1.5);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+		matrix_init_translate(&m, 40.5, 30.5);
+		matrix_scale(&m, 0.7, 0.45);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+		matrix_init_translate(&m, 200.4, 100);
+		matrix_scale(&m, -1.3, 1);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+
+		matrix_init_translate(&m, -20.5, -13);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+		matrix_init_translate(&m, 230.7, 225.2);
+		matrix_scale(&m, 1.7, 1.7);
+		assert_equal(blit_compare(pdat, NULL, &m), 0);
+		matrix_init_translate(&m, 30.2, 40.9);
+		matrix_scale(&m, 2.5, 2.5);
+		region_init(&clip, 57, 61, 83, 45);
+		assert_equal(blit_compare(pdat, &clip, &m), 0);
+		matrix_init_translate(&m, 30, 40);
+		region_init(&clip, 50, 41, 13, 200);
+		assert_equal(blit_compare(pdat, &clip, &m), 0);
+	}
+}
+
+static struct wboxtest_t wbt_blit = {
+	.group	= "graphic",
+	.name	= "blit",
+	.setup	= blit_setup,
+	.clean	= blit_clean,
+	.run	= blit_run,
+};
+
+static __init void blit_wbt_init(void)
+{
+	register_wboxtest(&wbt_blit);
+}
+
+static __exit void blit_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_blit);
+}
+
+wboxtest_initcall(blit_wbt_init);
+wboxtest_exitcall(blit_wbt_exit);
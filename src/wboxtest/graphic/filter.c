@@ -0,0 +1,141 @@
+/*
+ * wboxtest/graphic/filter.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_filter_pdata_t
+{
+	struct surface_t * src;
+	struct surface_t * quad;
+	struct surface_t * dst;
+};
+
+static void * filter_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_filter_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_filter_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->src = surface_alloc(64, 64, NULL);
+	pdat->quad = surface_alloc(2, 2, NULL);
+	pdat->dst = surface_alloc(256, 256, NULL);
+	if(!pdat->src || !pdat->quad || !pdat->dst)
+	{
+		if(pdat->src)
+			surface_free(pdat->src);
+		if(pdat->quad)
+			surface_free(pdat->quad);
+		if(pdat->dst)
+			surface_free(pdat->dst);
+		free(pdat);
+		return NULL;
+	}
+	pdat->src->r->destroy(pdat->src->rctx);
+	pdat->src->r = search_render_default();
+	pdat->src->rctx = render_default_create(pdat->src);
+	return pdat;
+}
+
+static void filter_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_filter_pdata_t * pdat = (struct wbt_filter_pdata_t *)data;
+
+	if(pdat)
+	{
+		surface_free(pdat->src);
+		surface_free(pdat->quad);
+		surface_free(pdat->dst);
+		free(pdat);
+	}
+}
+
+/*
+ * Blit a constant source onto a clear surface, every pixel covered has to
+ * come out as the constant itself. Returns the number of other pixels.
+ */
+static int filter_constant(struct wbt_filter_pdata_t * pdat, struct matrix_t * m, enum render_type_t type, uint32_t c)
+{
+	uint32_t * p = surface_get_pixels(pdat->dst);
+	int i, k, n;
+
+	memset(p, 0, pdat->dst->pixlen);
+	render_default_blit(pdat->dst, NULL, m, pdat->src, type);
+	for(i = 0, k = 0, n = 0; i < 256 * 256; i++)
+	{
+		if(p[i] == c)
+			k++;
+		else if(p[i] != 0)
+			n++;
+	}
+	return (k > 0) ? n : -1;
+}
+
+static void filter_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_filter_pdata_t * pdat = (struct wbt_filter_pdata_t *)data;
+	struct matrix_t m;
+	uint32_t * p;
+	uint32_t c = 0x80402010;
+	int i;
+
+	if(pdat)
+	{
+		p = surface_get_pixels(pdat->src);
+		for(i = 0; i < 64 * 64; i++)
+			p[i] = c;
+		matrix_init_translate(&m, 3.3, 7.7);
+		matrix_scale(&m, 1.5, 1.5);
+		assert_equal(filter_constant(pdat, &m, RENDER_TYPE_GOOD, c), 0);
+		assert_equal(filter_constant(pdat, &m, RENDER_TYPE_BEST, c), 0);
+		matrix_init_translate(&m, 100.4, 20.6);
+		matrix_rotate(&m, 0.3);
+		matrix_scale(&m, 2.2, 1.7);
+		assert_equal(filter_constant(pdat, &m, RENDER_TYPE_GOOD, c), 0);
+		assert_equal(filter_constant(pdat, &m, RENDER_TYPE_BEST, c), 0);
+		matrix_init_translate(&m, 10.5, 10.5);
+		matrix_scale(&m, 0.3, 0.3);
+		assert_equal(filter_constant(pdat, &m, RENDER_TYPE_GOOD, c), 0);
+		assert_equal(filter_constant(pdat, &m, RENDER_TYPE_BEST, c), 0);
+
+		/*
+		 * Half a pixel off in both axes puts the pixel center of (1, 1)
+		 * right between the four source pixels, a black one and three
+		 * white ones. Each column is mixed down first, (0x00 + 0xff) / 2
+		 * and 0xff, then the two columns, (0x7f + 0xff) / 2.
+		 */
+		p = surface_get_pixels(pdat->quad);
+		p[0] = 0xff000000;
+		p[1] = 0xffffffff;
+		p[2] = 0xffffffff;
+		p[3] = 0xffffffff;
+		p = surface_get_pixels(pdat->dst);
+		memset(p, 0, pdat->dst->pixlen);
+		matrix_init_translate(&m, 0.5, 0.5);
+		render_default_blit(pdat->dst, NULL, &m, pdat->quad, RENDER_TYPE_GOOD);
+		assert_equal(p[1 * 256 + 1], 0xffbfbfbf);
+	}
+}
+
+static struct wboxtest_t wbt_filter = {
+	.group	= "graphic",
+	.name	= "filter",
+	.setup	= filter_setup,
+	.clean	= filter_clean,
+	.run	= filter_run,
+};
+
+static __init void filter_wbt_init(void)
+{
+	register_wboxtest(&wbt_filter);
+}
+
+static __exit void filter_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_filter);
+}
+
+wboxtest_initcall(filter_wbt_init);
+wboxtest_exitcall(filter_wbt_exit);
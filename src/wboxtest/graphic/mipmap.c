@@ -0,0 +1,149 @@
+/*
+ * wboxtest/graphic/mipmap.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_mipmap_pdata_t
+{
+	struct surface_t * src;
+	struct surface_t * dst;
+};
+
+static void * mipmap_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_mipmap_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_mipmap_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->src = surface_alloc(256, 256, NULL);
+	pdat->dst = surface_alloc(64, 64, NULL);
+	if(!pdat->src || !pdat->dst)
+	{
+		if(pdat->src)
+			surface_free(pdat->src);
+		if(pdat->dst)
+			surface_free(pdat->dst);
+		free(pdat);
+		return NULL;
+	}
+	/*
+	 * The mipmaps are kept by the default render, the source is moved onto
+	 * it whatever render the surfaces were given
+	 */
+	pdat->src->r->destroy(pdat->src->rctx);
+	pdat->src->r = search_render_default();
+	pdat->src->rctx = render_default_create(pdat->src);
+	return pdat;
+}
+
+static void mipmap_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_mipmap_pdata_t * pdat = (struct wbt_mipmap_pdata_t *)data;
+
+	if(pdat)
+	{
+		surface_free(pdat->src);
+		surface_free(pdat->dst);
+		free(pdat);
+	}
+}
+
+static uint32_t mipmap_pixel(struct surface_t * s, int x, int y)
+{
+	uint32_t * p = surface_get_pixels(s);
+
+	return p[y * (surface_get_stride(s) >> 2) + x];
+}
+
+static void mipmap_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_mipmap_pdata_t * pdat = (struct wbt_mipmap_pdata_t *)data;
+	struct color_t black, white;
+	struct matrix_t m;
+	uint32_t * p;
+	int x, y;
+
+	if(pdat)
+	{
+		color_init(&black, 0, 0, 0, 255);
+		color_init(&white, 255, 255, 255, 255);
+		matrix_init_scale(&m, 0.25, 0.25);
+
+		/*
+		 * The first blit builds the mipmaps of the source, the shape drawn
+		 * into it afterwards has to show up in the next blit
+		 */
+		surface_clear(pdat->src, &black, 0, 0, 0, 0);
+		surface_clear(pdat->dst, NULL, 0, 0, 0, 0);
+		render_default_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_GOOD);
+		assert_equal(mipmap_pixel(pdat->dst, 32, 32), 0xff000000);
+
+		render_default_shape_rectangle(pdat->src, NULL, 64, 64, 128, 128, 0, 0, &white);
+		surface_clear(pdat->dst, NULL, 0, 0, 0, 0);
+		render_default_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_GOOD);
+		assert_equal(mipmap_pixel(pdat->dst, 32, 32), 0xffffffff);
+		assert_equal(mipmap_pixel(pdat->dst, 4, 4), 0xff000000);
+
+		render_default_shape_rectangle(pdat->src, NULL, 64, 64, 128, 128, 0, 0, &black);
+		surface_clear(pdat->dst, NULL, 0, 0, 0, 0);
+		render_default_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_BEST);
+		assert_equal(mipmap_pixel(pdat->dst, 32, 32), 0xff000000);
+
+		/*
+		 * Each 4x4 block of the source has its middle 2x2 white and the
+		 * ring around it black. Every level past the first averages that
+		 * to 0x40, while the first one sampled at a quarter only ever
+		 * sees the white middles.
+		 */
+		p = surface_get_pixels(pdat->src);
+		for(y = 0; y < 256; y++)
+		{
+			for(x = 0; x < 256; x++)
+				p[y * 256 + x] = (((x & 3) == 1 || (x & 3) == 2) && ((y & 3) == 1 || (y & 3) == 2)) ? 0xffffffff : 0xff000000;
+		}
+		surface_clear(pdat->dst, NULL, 0, 0, 0, 0);
+		render_default_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_GOOD);
+		assert_equal(mipmap_pixel(pdat->dst, 10, 10), 0xff404040);
+		assert_equal(mipmap_pixel(pdat->dst, 33, 47), 0xff404040);
+
+		/*
+		 * The source is blackened behind the back of its version, so only
+		 * a blit that samples the levels built above still sees 0x40. That
+		 * has to be the case at a half, and not at three quarters.
+		 */
+		for(x = 0; x < 256 * 256; x++)
+			((uint32_t *)pdat->src->pixels)[x] = 0xff000000;
+		matrix_init_scale(&m, 0.5, 0.5);
+		surface_clear(pdat->dst, NULL, 0, 0, 0, 0);
+		render_default_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_GOOD);
+		assert_equal(mipmap_pixel(pdat->dst, 10, 10), 0xff404040);
+		matrix_init_scale(&m, 0.75, 0.75);
+		surface_clear(pdat->dst, NULL, 0, 0, 0, 0);
+		render_default_blit(pdat->dst, NULL, &m, pdat->src, RENDER_TYPE_GOOD);
+		assert_equal(mipmap_pixel(pdat->dst, 10, 10), 0xff000000);
+	}
+}
+
+static struct wboxtest_t wbt_mipmap = {
+	.group	= "graphic",
+	.name	= "mipmap",
+	.setup	= mipmap_setup,
+	.clean	= mipmap_clean,
+	.run	= mipmap_run,
+};
+
+static __init void mipmap_wbt_init(void)
+{
+	register_wboxtest(&wbt_mipmap);
+}
+
+static __exit void mipmap_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_mipmap);
+}
+
+wboxtest_initcall(mipmap_wbt_init);
+wboxtest_exitcall(mipmap_wbt_exit);
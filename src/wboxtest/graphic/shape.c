@@ -0,0 +1,100 @@
+/*
+ * wboxtest/graphic/shape.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_shape_pdata_t
+{
+	struct surface_t * s1;
+	struct surface_t * s2;
+};
+
+static void * shape_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_shape_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_shape_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->s1 = surface_alloc(256, 256, NULL);
+	pdat->s2 = surface_alloc(256, 256, NULL);
+	if(!pdat->s1 || !pdat->s2)
+	{
+		if(pdat->s1)
+			surface_free(pdat->s1);
+		if(pdat->s2)
+			surface_free(pdat->s2);
+		free(pdat);
+		return NULL;
+	}
+	return pdat;
+}
+
+static void shape_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_shape_pdata_t * pdat = (struct wbt_shape_pdata_t *)data;
+
+	if(pdat)
+	{
+		surface_free(pdat->s1);
+		surface_free(pdat->s2);
+		free(pdat);
+	}
+}
+
+static void shape_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_shape_pdata_t * pdat = (struct wbt_shape_pdata_t *)data;
+	struct cache_stat_t s1, s2;
+	struct color_t c;
+	uint32_t * p, * q;
+	int j, n;
+
+	if(pdat)
+	{
+		color_init(&c, 0x33, 0x66, 0x99, 0x80);
+		p = surface_get_pixels(pdat->s1);
+		q = surface_get_pixels(pdat->s2);
+		memset(p, 0, pdat->s1->pixlen);
+		memset(q, 0, pdat->s2->pixlen);
+
+		/*
+		 * The same circle moved by whole pixels comes from the cached mask,
+		 * it has to look the same as the one rasterized at first
+		 */
+		render_default_shape_circle(pdat->s1, NULL, 100, 100, 60, 3, &c);
+		render_shape_cache_stat(&s1);
+		render_default_shape_circle(pdat->s2, NULL, 120, 110, 60, 3, &c);
+		render_shape_cache_stat(&s2);
+		assert_equal(s2.miss, s1.miss);
+		for(j = 30, n = 0; j < 172; j++)
+		{
+			if(memcmp(&p[j * 256 + 30], &q[(j + 10) * 256 + 50], 142 * sizeof(uint32_t)) != 0)
+				n++;
+		}
+		assert_equal(n, 0);
+	}
+}
+
+static struct wboxtest_t wbt_shape = {
+	.group	= "graphic",
+	.name	= "shape",
+	.setup	= shape_setup,
+	.clean	= shape_clean,
+	.run	= shape_run,
+};
+
+static __init void shape_wbt_init(void)
+{
+	register_wboxtest(&wbt_shape);
+}
+
+static __exit void shape_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_shape);
+}
+
+wboxtest_initcall(shape_wbt_init);
+wboxtest_exitcall(shape_wbt_exit);
@@ -0,0 +1,155 @@
+/*
+ * wboxtest/graphic/span.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_span_pdata_t
+{
+	uint32_t * dst;
+	uint32_t * src;
+	uint32_t * ref;
+	int count;
+};
+
+static uint32_t span_random_pixel(void)
+{
+	int a = wboxtest_random_int(0, 3);
+
+	if(a == 0)
+		a = 0;
+	else if(a == 1)
+		a = 255;
+	else
+		a = wboxtest_random_int(0, 255);
+	return (a << 24) | (wboxtest_random_int(0, a) << 16) | (wboxtest_random_int(0, a) << 8) | (wboxtest_random_int(0, a) << 0);
+}
+
+static uint32_t span_reference_blend(uint32_t d, uint32_t s)
+{
+	uint32_t sa = s >> 24;
+	uint32_t v = 0;
+	int i, c;
+
+	if(sa == 0)
+		return d;
+	for(i = 0; i < 32; i += 8)
+	{
+		c = ((s >> i) & 0xff) + ((((d >> i) & 0xff) * (256 - sa)) >> 8);
+		v |= (c & 0xff) << i;
+	}
+	return v;
+}
+
+static uint32_t span_reference_lerp(uint32_t a, uint32_t b, int f)
+{
+	uint32_t v = 0;
+	int i, c;
+
+	for(i = 0; i < 32; i += 8)
+	{
+		c = (((a >> i) & 0xff) * (256 - f) + ((b >> i) & 0xff) * f) >> 8;
+		v |= (c & 0xff) << i;
+	}
+	return v;
+}
+
+static void * span_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_span_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_span_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	/*
+	 * An odd length leaves a tail behind the wide loops
+	 */
+	pdat->count = 256 * 256 + 7;
+	pdat->dst = malloc(pdat->count * sizeof(uint32_t));
+	pdat->src = malloc(pdat->count * sizeof(uint32_t));
+	pdat->ref = malloc(pdat->count * sizeof(uint32_t));
+	if(!pdat->dst || !pdat->src || !pdat->ref)
+	{
+		free(pdat->dst);
+		free(pdat->src);
+		free(pdat->ref);
+		free(pdat);
+		return NULL;
+	}
+	return pdat;
+}
+
+static void span_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_span_pdata_t * pdat = (struct wbt_span_pdata_t *)data;
+
+	if(pdat)
+	{
+		free(pdat->dst);
+		free(pdat->src);
+		free(pdat->ref);
+		free(pdat);
+	}
+}
+
+static void span_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_span_pdata_t * pdat = (struct wbt_span_pdata_t *)data;
+	uint32_t * p, * q;
+	int i, f;
+
+	if(pdat)
+	{
+		p = pdat->dst;
+		q = pdat->src;
+		for(i = 0; i < pdat->count; i++)
+		{
+			p[i] = span_random_pixel();
+			q[i] = span_random_pixel();
+			pdat->ref[i] = span_reference_blend(p[i], q[i]);
+		}
+		render_span_blend(p, q, pdat->count);
+		assert_memory_equal(p, pdat->ref, pdat->count * sizeof(uint32_t));
+
+		for(f = 0; f < 256; f += 85)
+		{
+			for(i = 0; i < pdat->count; i++)
+				pdat->ref[i] = span_reference_lerp(p[i], q[i], f);
+			render_span_lerp(p, p, q, f, pdat->count);
+			assert_memory_equal(p, pdat->ref, pdat->count * sizeof(uint32_t));
+		}
+
+		render_span_copy(p, q, pdat->count);
+		assert_memory_equal(p, q, pdat->count * sizeof(uint32_t));
+
+		render_span_fill(p, 0xff336699, pdat->count);
+		for(i = 0; i < pdat->count; i++)
+		{
+			if(p[i] != 0xff336699)
+				break;
+		}
+		assert_equal(i, pdat->count);
+	}
+}
+
+static struct wboxtest_t wbt_span = {
+	.group	= "graphic",
+	.name	= "span",
+	.setup	= span_setup,
+	.clean	= span_clean,
+	.run	= span_run,
+};
+
+static __init void span_wbt_init(void)
+{
+	register_wboxtest(&wbt_span);
+}
+
+static __exit void span_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_span);
+}
+
+wboxtest_initcall(span_wbt_init);
+wboxtest_exitcall(span_wbt_exit);
@@ -0,0 +1,128 @@
+/*
+ * wboxtest/graphic/text.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_text_pdata_t
+{
+	struct surface_t * s;
+	struct font_context_t * f;
+	uint32_t * ref;
+};
+
+static void * text_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_text_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_text_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->s = surface_alloc(256, 256, NULL);
+	pdat->f = font_context_alloc();
+	pdat->ref = malloc(256 * 256 * sizeof(uint32_t));
+	if(!pdat->s || !pdat->f || !pdat->ref)
+	{
+		if(pdat->s)
+			surface_free(pdat->s);
+		if(pdat->f)
+			font_context_free(pdat->f);
+		free(pdat->ref);
+		free(pdat);
+		return NULL;
+	}
+	return pdat;
+}
+
+static void text_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_text_pdata_t * pdat = (struct wbt_text_pdata_t *)data;
+
+	if(pdat)
+	{
+		surface_free(pdat->s);
+		font_context_free(pdat->f);
+		free(pdat->ref);
+		free(pdat);
+	}
+}
+
+static void text_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_text_pdata_t * pdat = (struct wbt_text_pdata_t *)data;
+	struct text_t txt;
+	struct color_t c;
+	struct matrix_t m;
+	uint32_t * p;
+
+	if(pdat)
+	{
+		p = surface_get_pixels(pdat->s);
+		color_init(&c, 0xff, 0xff, 0xff, 0xff);
+		text_init(&txt, "The quick brown fox", &c, 0, pdat->f, "roboto", 20);
+
+		/*
+		 * A rotated run at a fractional offset, drawn a second time from the
+		 * cached glyphs, has to come out the same
+		 */
+		matrix_init_translate(&m, 20.3, 120.7);
+		matrix_rotate(&m, 0.3);
+		memset(p, 0, pdat->s->pixlen);
+		render_default_text(pdat->s, NULL, &m, &txt);
+		memcpy(pdat->ref, p, pdat->s->pixlen);
+		memset(p, 0, pdat->s->pixlen);
+		render_default_text(pdat->s, NULL, &m, &txt);
+		assert_memory_equal(p, pdat->ref, pdat->s->pixlen);
+
+		matrix_init_translate(&m, 20, 120);
+		memset(p, 0, pdat->s->pixlen);
+		render_default_text(pdat->s, NULL, &m, &txt);
+		memcpy(pdat->ref, p, pdat->s->pixlen);
+		text_init(&txt, "The quick brown fox", &c, 0, pdat->f, "roboto", 20);
+		memset(p, 0, pdat->s->pixlen);
+		render_default_text(pdat->s, NULL, &m, &txt);
+		assert_memory_equal(p, pdat->ref, pdat->s->pixlen);
+
+		/*
+		 * The two family lists hash the same but pick different faces, the
+		 * rotated glyphs of the bold one must not stand in for the other
+		 */
+		matrix_init_translate(&m, 20, 120);
+		matrix_rotate(&m, 0.3);
+		text_init(&txt, "The quick brown fox", &c, 0, pdat->f, "roboto", 20);
+		memset(p, 0, pdat->s->pixlen);
+		render_default_text(pdat->s, NULL, &m, &txt);
+		memcpy(pdat->ref, p, pdat->s->pixlen);
+		assert_equal(shash("roboto-bold,vwvxujf"), shash("roboto,ghbndfe"));
+		text_init(&txt, "The quick brown fox", &c, 0, pdat->f, "roboto-bold,vwvxujf", 20);
+		memset(p, 0, pdat->s->pixlen);
+		render_default_text(pdat->s, NULL, &m, &txt);
+		assert_memory_not_equal(p, pdat->ref, pdat->s->pixlen);
+		text_init(&txt, "The quick brown fox", &c, 0, pdat->f, "roboto,ghbndfe", 20);
+		memset(p, 0, pdat->s->pixlen);
+		render_default_text(pdat->s, NULL, &m, &txt);
+		assert_memory_equal(p, pdat->ref, pdat->s->pixlen);
+	}
+}
+
+static struct wboxtest_t wbt_text = {
+	.group	= "graphic",
+	.name	= "text",
+	.setup	= text_setup,
+	.clean	= text_clean,
+	.run	= text_run,
+};
+
+static __init void text_wbt_init(void)
+{
+	register_wboxtest(&wbt_text);
+}
+
+static __exit void text_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_text);
+}
+
+wboxtest_initcall(text_wbt_init);
+wboxtest_exitcall(text_wbt_exit);
@@ -0,0 +1,147 @@
+/*
+ * wboxtest/graphic/tile.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_tile_pdata_t
+{
+	struct surface_t * dst;
+	struct surface_t * ref;
+	struct surface_t * src;
+};
+
+static void * tile_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_tile_pdata_t * pdat;
+	uint32_t * p;
+	int i;
+
+	pdat = malloc(sizeof(struct wbt_tile_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->dst = surface_alloc(256, 256, NULL);
+	pdat->ref = surface_alloc(256, 256, NULL);
+	pdat->src = surface_alloc(256, 256, NULL);
+	if(!pdat->dst || !pdat->ref || !pdat->src)
+	{
+		if(pdat->dst)
+			surface_free(pdat->dst);
+		if(pdat->ref)
+			surface_free(pdat->ref);
+		if(pdat->src)
+			surface_free(pdat->src);
+		free(pdat);
+		return NULL;
+	}
+	p = surface_get_pixels(pdat->src);
+	for(i = 0; i < 256 * 256; i++)
+		p[i] = 0xff000000 | (wboxtest_random_int(0, 255) << 16) | (wboxtest_random_int(0, 255) << 8) | wboxtest_random_int(0, 255);
+
+	/*
+	 * The tiled render is given to the surface whether it is the one in
+	 * use or not, so the queue is played back here in either case
+	 */
+	pdat->dst->r->destroy(pdat->dst->rctx);
+	pdat->dst->r = search_render_tile();
+	pdat->dst->rctx = pdat->dst->r->create(pdat->dst);
+	return pdat;
+}
+
+static void tile_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_tile_pdata_t * pdat = (struct wbt_tile_pdata_t *)data;
+
+	if(pdat)
+	{
+		surface_free(pdat->dst);
+		surface_free(pdat->ref);
+		surface_free(pdat->src);
+		free(pdat);
+	}
+}
+
+static void tile_scene(struct surface_t * s, struct render_t * r, struct surface_t * src)
+{
+	struct matrix_t m;
+	struct color_t c[4];
+	struct point_t p[5];
+	int i, j;
+
+	color_init(&c[0], 0x20, 0x40, 0x80, 0xff);
+	color_init(&c[1], 0x80, 0x20, 0x40, 0xff);
+	color_init(&c[2], 0x40, 0x80, 0x20, 0xff);
+	color_init(&c[3], 0x60, 0x60, 0x60, 0x80);
+	r->shape_gradient(s, NULL, 0, 0, surface_get_width(s), surface_get_height(s), &c[0], &c[1], &c[2], &c[3]);
+	for(i = 0; i < 16; i++)
+	{
+		j = i * 37 % 200;
+		matrix_init_translate(&m, j, i * 13);
+		matrix_rotate(&m, i * 0.2);
+		matrix_scale(&m, 0.25 + i * 0.05, 0.25 + i * 0.05);
+		r->blit(s, NULL, &m, src, (i & 1) ? RENDER_TYPE_GOOD : RENDER_TYPE_FAST);
+		matrix_init_translate(&m, 200 - j, i * 11);
+		r->fill(s, NULL, &m, 40, 24, &c[3], RENDER_TYPE_GOOD);
+		p[0].x = j; p[0].y = 0;
+		p[1].x = 255 - j; p[1].y = 255;
+		r->shape_line(s, NULL, &p[0], &p[1], i % 4 + 1, &c[i & 3]);
+		r->shape_circle(s, NULL, j + 20, 255 - i * 15, 6 + i, i & 3, &c[(i + 1) & 3]);
+		r->shape_rectangle(s, NULL, i * 9, j, 48, 32, i & 7, i & 1, &c[(i + 2) & 3]);
+		p[0].x = j; p[0].y = i * 15;
+		p[1].x = j + 40; p[1].y = i * 15 + 10;
+		p[2].x = j + 30; p[2].y = i * 15 + 50;
+		p[3].x = j - 10; p[3].y = i * 15 + 40;
+		p[4].x = j + 20; p[4].y = i * 15 + 20;
+		r->shape_polygon(s, NULL, p, 5, 0, &c[(i + 3) & 3]);
+	}
+}
+
+static void tile_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_tile_pdata_t * pdat = (struct wbt_tile_pdata_t *)data;
+	uint32_t * p;
+	ktime_t t1, t2, t3;
+
+	if(pdat)
+	{
+		t1 = ktime_get();
+		tile_scene(pdat->ref, search_render_default(), pdat->src);
+		surface_get_pixels(pdat->ref);
+		t2 = ktime_get();
+
+		/*
+		 * The draws are only queued, the gradient under them shows up once
+		 * the surface is flushed
+		 */
+		p = pdat->dst->pixels;
+		tile_scene(pdat->dst, pdat->dst->r, pdat->src);
+		assert_equal(p[0], 0);
+		surface_flush(pdat->dst);
+		t3 = ktime_get();
+		assert_not_equal(p[0], 0);
+		wboxtest_print(" Tile frame: %lld us, default %lld us\r\n", ktime_us_delta(t3, t2), ktime_us_delta(t2, t1));
+		assert_memory_equal(p, surface_get_pixels(pdat->ref), pdat->dst->pixlen);
+	}
+}
+
+static struct wboxtest_t wbt_tile = {
+	.group	= "graphic",
+	.name	= "tile",
+	.setup	= tile_setup,
+	.clean	= tile_clean,
+	.run	= tile_run,
+};
+
+static __init void tile_wbt_init(void)
+{
+	register_wboxtest(&wbt_tile);
+}
+
+static __exit void tile_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_tile);
+}
+
+wboxtest_initcall(tile_wbt_init);
+wboxtest_exitcall(tile_wbt_exit);
@@ -0,0 +1,122 @@
+/*
+ * wboxtest/kernel/channel.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_channel_pdata_t
+{
+	struct mchannel_t * c[3];
+	int value[3];
+	atomic_t done;
+};
+
+static void channel_sender_task(struct task_t * task, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+
+	task_sleep(2 * 1000000);
+	mchannel_send(pdat->c[2], &pdat->value[2], 0);
+	task_sleep(2 * 1000000);
+	mchannel_send(pdat->c[0], &pdat->value[0], 0);
+	mchannel_send(pdat->c[1], &pdat->value[1], 0);
+	atomic_inc(&pdat->done);
+}
+
+static void * channel_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_channel_pdata_t * pdat;
+	int i;
+
+	pdat = malloc(sizeof(struct wbt_channel_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	for(i = 0; i < 3; i++)
+	{
+		pdat->c[i] = mchannel_alloc(i);
+		pdat->value[i] = i;
+	}
+	atomic_set(&pdat->done, 0);
+	return pdat;
+}
+
+static void channel_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+	int i;
+
+	if(pdat)
+	{
+		for(i = 0; i < 3; i++)
+			mchannel_free(pdat->c[i]);
+		free(pdat);
+	}
+}
+
+static void channel_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_channel_pdata_t * pdat = (struct wbt_channel_pdata_t *)data;
+	struct task_t * task;
+	void * msg;
+	ktime_t t1, t2;
+
+	if(pdat)
+	{
+		assert_not_null(pdat->c[0]);
+		assert_not_null(pdat->c[1]);
+		assert_not_null(pdat->c[2]);
+
+		assert_false(mchannel_trysend(pdat->c[0], pdat));
+		assert_true(mchannel_trysend(pdat->c[1], &pdat->value[1]));
+		assert_false(mchannel_trysend(pdat->c[1], pdat));
+		assert_true(mchannel_tryrecv(pdat->c[1], &msg));
+		assert_true(msg == &pdat->value[1]);
+		assert_false(mchannel_tryrecv(pdat->c[1], &msg));
+
+		t1 = ktime_get();
+		assert_equal(channel_select(pdat->c, 3, &msg, 5 * 1000000), -1);
+		t2 = ktime_get();
+		assert_true(ktime_us_delta(t2, t1) >= 5000);
+		assert_true(list_empty(&pdat->c[0]->rwait));
+		assert_true(list_empty(&pdat->c[2]->rwait));
+		assert_false(mchannel_send(pdat->c[0], pdat, 2 * 1000000));
+		assert_true(list_empty(&pdat->c[0]->swait));
+
+		task = task_create(NULL, "wbt-sender", channel_sender_task, pdat, SZ_64K, 0);
+		assert_not_null(task);
+		if(task)
+		{
+			task_resume(task);
+			assert_equal(channel_select(pdat->c, 3, &msg, 1000 * 1000000), 2);
+			assert_true(msg == &pdat->value[2]);
+			assert_equal(channel_select(pdat->c, 3, &msg, 1000 * 1000000), 0);
+			assert_true(msg == &pdat->value[0]);
+			assert_true(mchannel_recv(pdat->c[1], &msg, 1000 * 1000000));
+			assert_true(msg == &pdat->value[1]);
+			while(atomic_get(&pdat->done) == 0)
+				task_sleep(1000000);
+		}
+	}
+}
+
+static struct wboxtest_t wbt_channel = {
+	.group	= "kernel",
+	.name	= "channel",
+	.setup	= channel_setup,
+	.clean	= channel_clean,
+	.run	= channel_run,
+};
+
+static __init void channel_wbt_init(void)
+{
+	register_wboxtest(&wbt_channel);
+}
+
+static __exit void channel_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_channel);
+}
+
+wboxtest_initcall(channel_wbt_init);
+wboxtest_exitcall(channel_wbt_exit);
@@ -0,0 +1,94 @@
+/*
+ * wboxtest/kernel/heap.c
+ */
+
+#include <wboxtest.h>
+
+#define HEAP_TEST_BLOCKS	(64)
+
+struct wbt_heap_pdata_t
+{
+	void * blk[HEAP_TEST_BLOCKS];
+};
+
+static void * heap_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_heap_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_heap_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	memset(pdat, 0, sizeof(struct wbt_heap_pdata_t));
+	return pdat;
+}
+
+static void heap_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_heap_pdata_t * pdat = (struct wbt_heap_pdata_t *)data;
+
+	if(pdat)
+		free(pdat);
+}
+
+static void heap_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_heap_pdata_t * pdat = (struct wbt_heap_pdata_t *)data;
+	struct malloc_stat_t stat;
+	struct malloc_site_t site[4];
+	int i, n;
+
+	if(pdat)
+	{
+		malloc_snapshot();
+		for(i = 0; i < HEAP_TEST_BLOCKS; i++)
+			pdat->blk[i] = malloc(1000);
+		malloc_stat_diff(&stat);
+		wboxtest_print(" Used %ld, heap %ld, live %ld in the 1024 class\r\n", (long)stat.used, (long)stat.heap, stat.live[6]);
+		assert_true(stat.used >= HEAP_TEST_BLOCKS * 1000);
+		assert_true(stat.heap >= HEAP_TEST_BLOCKS * 1000);
+		assert_true(stat.live[6] >= HEAP_TEST_BLOCKS);
+		assert_true(stat.nalloc >= HEAP_TEST_BLOCKS);
+		malloc_stat(&stat);
+		assert_true(stat.peak >= stat.heap);
+
+		n = malloc_leak(site, ARRAY_SIZE(site));
+		if(CONFIG_MALLOC_TRACE > 0)
+		{
+			assert_true(n > 0);
+			assert_true(site[0].count >= HEAP_TEST_BLOCKS);
+			assert_true(site[0].bytes >= HEAP_TEST_BLOCKS * 1000);
+		}
+		else
+		{
+			assert_equal(n, 0);
+		}
+
+		for(i = 0; i < HEAP_TEST_BLOCKS; i++)
+			free(pdat->blk[i]);
+		malloc_stat_diff(&stat);
+		assert_true(stat.live[6] < HEAP_TEST_BLOCKS);
+		assert_true(stat.used < HEAP_TEST_BLOCKS * 1000);
+	}
+}
+
+static struct wboxtest_t wbt_heap = {
+	.group	= "kernel",
+	.name	= "heap",
+	.setup	= heap_setup,
+	.clean	= heap_clean,
+	.run	= heap_run,
+};
+
+static __init void heap_wbt_init(void)
+{
+	register_wboxtest(&wbt_heap);
+}
+
+static __exit void heap_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_heap);
+}
+
+wboxtest_initcall(heap_wbt_init);
+wboxtest_exitcall(heap_wbt_exit);
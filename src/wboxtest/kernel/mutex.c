@@ -0,0 +1,229 @@
+/*
+ * wboxtest/kernel/mutex.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_mutex_pdata_t
+{
+	struct mutex_t m;
+	struct semaphore_t sem;
+	struct rwlock_t rw;
+	struct condition_t c;
+	volatile int ready;
+	volatile int boosted;
+	volatile int count;
+	atomic_t done;
+};
+
+static void mutex_holder_task(struct task_t * task, void * data)
+{
+	struct wbt_mutex_pdata_t * pdat = (struct wbt_mutex_pdata_t *)data;
+
+	mutex_lock(&pdat->m);
+	pdat->ready = 1;
+	while(task->pi_nice > 0)
+		task_sleep(1000000);
+	pdat->boosted = task->pi_nice;
+	mutex_unlock(&pdat->m);
+	atomic_inc(&pdat->done);
+}
+
+static void mutex_waiter_task(struct task_t * task, void * data)
+{
+	struct wbt_mutex_pdata_t * pdat = (struct wbt_mutex_pdata_t *)data;
+
+	mutex_lock(&pdat->m);
+	pdat->count++;
+	mutex_unlock(&pdat->m);
+	atomic_inc(&pdat->done);
+}
+
+static void semaphore_worker_task(struct task_t * task, void * data)
+{
+	struct wbt_mutex_pdata_t * pdat = (struct wbt_mutex_pdata_t *)data;
+
+	semaphore_down(&pdat->sem);
+	pdat->count++;
+	task_sleep(1000000);
+	pdat->count--;
+	semaphore_up(&pdat->sem);
+	atomic_inc(&pdat->done);
+}
+
+static void rwlock_reader_task(struct task_t * task, void * data)
+{
+	struct wbt_mutex_pdata_t * pdat = (struct wbt_mutex_pdata_t *)data;
+
+	rwlock_read_lock(&pdat->rw);
+	pdat->count++;
+	rwlock_read_unlock(&pdat->rw);
+	atomic_inc(&pdat->done);
+}
+
+static void condition_signal_task(struct task_t * task, void * data)
+{
+	struct wbt_mutex_pdata_t * pdat = (struct wbt_mutex_pdata_t *)data;
+
+	task_sleep(1000000);
+	mutex_lock(&pdat->m);
+	pdat->ready = 1;
+	condition_signal(&pdat->c);
+	mutex_unlock(&pdat->m);
+	atomic_inc(&pdat->done);
+}
+
+static void wait_done(struct wbt_mutex_pdata_t * pdat, int n)
+{
+	int i;
+
+	for(i = 0; (atomic_get(&pdat->done) < n) && (i < 1000); i++)
+		task_sleep(1000000);
+}
+
+static void * mutex_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_mutex_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_mutex_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	mutex_init(&pdat->m);
+	semaphore_init(&pdat->sem, 2);
+	rwlock_init(&pdat->rw);
+	condition_init(&pdat->c);
+	return pdat;
+}
+
+static void mutex_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_mutex_pdata_t * pdat = (struct wbt_mutex_pdata_t *)data;
+
+	if(pdat)
+		free(pdat);
+}
+
+static void mutex_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_mutex_pdata_t * pdat = (struct wbt_mutex_pdata_t *)data;
+	struct task_t * holder, * task;
+	int i;
+
+	if(pdat)
+	{
+		/*
+		 * A nice 19 holder must run at the nice -20 of its waiter
+		 */
+		pdat->ready = 0;
+		pdat->boosted = 20;
+		pdat->count = 0;
+		atomic_set(&pdat->done, 0);
+		holder = task_create(NULL, "wbt-holder", mutex_holder_task, pdat, SZ_64K, 19);
+		task = task_create(NULL, "wbt-waiter", mutex_waiter_task, pdat, SZ_64K, -20);
+		assert_not_null(holder);
+		assert_not_null(task);
+		if(holder && task)
+		{
+			task_resume(holder);
+			while(!pdat->ready)
+				task_sleep(1000000);
+			task_resume(task);
+			wait_done(pdat, 2);
+			wboxtest_print(" Holder boosted to nice %d\r\n", pdat->boosted);
+			assert_equal(pdat->boosted, -20);
+			assert_equal(pdat->count, 1);
+			assert_true(mutex_trylock(&pdat->m));
+			mutex_unlock(&pdat->m);
+		}
+
+		/*
+		 * No more than two workers inside the semaphore at a time
+		 */
+		pdat->count = 0;
+		atomic_set(&pdat->done, 0);
+		for(i = 0; i < 4; i++)
+		{
+			task = task_create(NULL, "wbt-sem", semaphore_worker_task, pdat, SZ_64K, 0);
+			if(task)
+				task_resume(task);
+		}
+		task_sleep(500000);
+		assert_inrange(pdat->count, 0, 2);
+		wait_done(pdat, 4);
+		assert_equal(atomic_get(&pdat->done), 4);
+		assert_equal(pdat->sem.count, 2);
+		assert_true(semaphore_trydown(&pdat->sem));
+		assert_true(semaphore_trydown(&pdat->sem));
+		assert_false(semaphore_trydown(&pdat->sem));
+		assert_equal(semaphore_down_timeout(&pdat->sem, 2 * 1000000), 0);
+		semaphore_up(&pdat->sem);
+		semaphore_up(&pdat->sem);
+
+		/*
+		 * Readers share the lock, a writer keeps them all out
+		 */
+		assert_true(rwlock_read_trylock(&pdat->rw));
+		assert_true(rwlock_read_trylock(&pdat->rw));
+		assert_false(rwlock_write_trylock(&pdat->rw));
+		rwlock_read_unlock(&pdat->rw);
+		rwlock_read_unlock(&pdat->rw);
+		rwlock_write_lock(&pdat->rw);
+		assert_false(rwlock_read_trylock(&pdat->rw));
+		pdat->count = 0;
+		atomic_set(&pdat->done, 0);
+		for(i = 0; i < 4; i++)
+		{
+			task = task_create(NULL, "wbt-reader", rwlock_reader_task, pdat, SZ_64K, 0);
+			if(task)
+				task_resume(task);
+		}
+		task_sleep(2 * 1000000);
+		assert_equal(pdat->count, 0);
+		rwlock_write_unlock(&pdat->rw);
+		wait_done(pdat, 4);
+		assert_equal(pdat->count, 4);
+		assert_true(rwlock_write_trylock(&pdat->rw));
+		rwlock_write_unlock(&pdat->rw);
+
+		/*
+		 * Condition wait with and without a signal
+		 */
+		mutex_lock(&pdat->m);
+		assert_equal(condition_wait_timeout(&pdat->c, &pdat->m, 2 * 1000000), 0);
+		pdat->ready = 0;
+		atomic_set(&pdat->done, 0);
+		task = task_create(NULL, "wbt-signal", condition_signal_task, pdat, SZ_64K, 0);
+		if(task)
+			task_resume(task);
+		while(!pdat->ready)
+		{
+			if(!condition_wait_timeout(&pdat->c, &pdat->m, 1000 * 1000000))
+				break;
+		}
+		assert_equal(pdat->ready, 1);
+		mutex_unlock(&pdat->m);
+		wait_done(pdat, 1);
+	}
+}
+
+static struct wboxtest_t wbt_mutex = {
+	.group	= "kernel",
+	.name	= "mutex",
+	.setup	= mutex_setup,
+	.clean	= mutex_clean,
+	.run	= mutex_run,
+};
+
+static __init void mutex_wbt_init(void)
+{
+	register_wboxtest(&wbt_mutex);
+}
+
+static __exit void mutex_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_mutex);
+}
+
+wboxtest_initcall(mutex_wbt_init);
+wboxtest_exitcall(mutex_wbt_exit);
@@ -0,0 +1,145 @@
+/*
+ * wboxtest/kernel/profiler.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_profiler_pdata_t
+{
+	struct profiler_event_t ev[64];
+
+	ktime_t t1;
+	ktime_t t2;
+	int calls;
+	volatile int sum;
+};
+
+static void * profiler_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_profiler_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_profiler_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	return pdat;
+}
+
+static void profiler_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_profiler_pdata_t * pdat = (struct wbt_profiler_pdata_t *)data;
+
+	if(pdat)
+		free(pdat);
+}
+
+static void profiler_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_profiler_pdata_t * pdat = (struct wbt_profiler_pdata_t *)data;
+	struct profiler_stat_t stat;
+	int probe = profiler_probe("wbt-probe");
+	int sleep = profiler_probe("wbt-sleep");
+	int loop = profiler_probe("wbt-loop");
+	struct profiler_mark_t m;
+	int i, j, k, n, cpu;
+
+	if(pdat)
+	{
+		assert_true(profiler_count() >= 2);
+		assert_string_equal(profiler_get_probe(probe)->name, "wbt-probe");
+		profiler_reset();
+
+		pdat->calls = 0;
+		pdat->t2 = pdat->t1 = ktime_get();
+		do {
+			pdat->calls++;
+			profiler_begin(probe, &m);
+			profiler_end(probe, &m);
+			pdat->t2 = ktime_get();
+		} while(ktime_before(pdat->t2, ktime_add_ms(pdat->t1, 1000)));
+		wboxtest_print(" Probe: %.2f calls/s\r\n", (double)pdat->calls * 1000.0 / ktime_ms_delta(pdat->t2, pdat->t1));
+		profiler_stat(probe, &stat);
+		assert_equal(stat.count, pdat->calls);
+		assert_equal(stat.migrated, 0);
+
+		pdat->sum = 0;
+		profiler_begin(loop, &m);
+		for(i = 0; i < 1000000; i++)
+			pdat->sum += i;
+		profiler_end(loop, &m);
+		profiler_stat(loop, &stat);
+		wboxtest_print(" Loop: %lldns, %lld cycles, %lld instructions\r\n", stat.total, stat.counter[PROFILER_COUNTER_CYCLES], stat.counter[PROFILER_COUNTER_INSTRUCTIONS]);
+		if(profiler_counter_available(PROFILER_COUNTER_CYCLES))
+		{
+			assert_true(stat.counter[PROFILER_COUNTER_CYCLES] >= 1000000);
+		}
+		else
+		{
+			assert_equal(stat.counter[PROFILER_COUNTER_CYCLES], 0);
+		}
+		if(profiler_counter_available(PROFILER_COUNTER_INSTRUCTIONS))
+		{
+			assert_true(stat.counter[PROFILER_COUNTER_INSTRUCTIONS] >= 1000000);
+		}
+
+		profiler_trace_enable(1);
+		for(i = 0; i < 4; i++)
+		{
+			profiler_begin(sleep, &m);
+			task_sleep(1000000);
+			profiler_end(sleep, &m);
+		}
+		profiler_trace_enable(0);
+		profiler_stat(sleep, &stat);
+		wboxtest_print(" Sleep 1ms: avg %lldns, min %lldns, max %lldns\r\n", stat.total / 4, stat.min, stat.max);
+		assert_equal(stat.count, 4);
+		assert_true(stat.min >= 1000000);
+		assert_equal(stat.hist[fls64(stat.min)] > 0, 1);
+
+		/*
+		 * The end of a sleep that moved to another cpu is in the ring of
+		 * that cpu, it is paired with its begin by the cpu it carries
+		 */
+		for(cpu = 0, n = 0; cpu < CONFIG_MAX_SMP_CPUS; cpu++)
+			n += profiler_trace_read(cpu, &pdat->ev[n], ARRAY_SIZE(pdat->ev) - n);
+		assert_true(n >= 8);
+		for(i = 0; i < n; i++)
+		{
+			if((pdat->ev[i].id == sleep) && (pdat->ev[i].type == PROFILER_EVENT_BEGIN))
+				break;
+		}
+		for(j = n, k = 0; (i < n) && (k < n); k++)
+		{
+			if((pdat->ev[k].id == sleep) && (pdat->ev[k].cpu == pdat->ev[i].cpu) && (pdat->ev[k].time > pdat->ev[i].time))
+			{
+				if((j == n) || (pdat->ev[k].time < pdat->ev[j].time))
+					j = k;
+			}
+		}
+		assert_true(j < n);
+		assert_equal(pdat->ev[i].type, PROFILER_EVENT_BEGIN);
+		assert_equal(pdat->ev[j].type, PROFILER_EVENT_END);
+		assert_true(pdat->ev[j].time - pdat->ev[i].time >= 1000000);
+	}
+}
+
+static struct wboxtest_t wbt_profiler = {
+	.group	= "kernel",
+	.name	= "profiler",
+	.setup	= profiler_setup,
+	.clean	= profiler_clean,
+	.run	= profiler_run,
+};
+
+static __init void profiler_wbt_init(void)
+{
+	register_wboxtest(&wbt_profiler);
+}
+
+static __exit void profiler_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_profiler);
+}
+
+wboxtest_initcall(profiler_wbt_init);
+wboxtest_exitcall(profiler_wbt_exit);
@@ -0,0 +1,123 @@
+/*
+ * wboxtest/kernel/scheduler.c
+ */
+
+#include <wboxtest.h>
+
+#define SCHEDULER_WORKERS	(CONFIG_MAX_SMP_CPUS * 4)
+
+struct wbt_scheduler_pdata_t
+{
+	atomic_t done;
+	uint64_t loops[SCHEDULER_WORKERS];
+	unsigned int cpus[SCHEDULER_WORKERS];
+	uint64_t migrate[CONFIG_MAX_SMP_CPUS];
+};
+
+struct wbt_scheduler_worker_t
+{
+	struct wbt_scheduler_pdata_t * pdat;
+	int index;
+};
+
+static struct wbt_scheduler_worker_t workers[SCHEDULER_WORKERS];
+
+static void scheduler_worker_task(struct task_t * task, void * data)
+{
+	struct wbt_scheduler_worker_t * w = (struct wbt_scheduler_worker_t *)data;
+	struct wbt_scheduler_pdata_t * pdat = w->pdat;
+	ktime_t timeout = ktime_add_ms(ktime_get(), 1000);
+	volatile int i;
+
+	do {
+		for(i = 0; i < 10000; i++);
+		pdat->loops[w->index]++;
+		pdat->cpus[w->index] |= 1 << smp_processor_id();
+		task_yield();
+	} while(ktime_before(ktime_get(), timeout));
+	atomic_inc(&pdat->done);
+}
+
+static void * scheduler_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_scheduler_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_scheduler_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	memset(pdat, 0, sizeof(struct wbt_scheduler_pdata_t));
+	atomic_set(&pdat->done, 0);
+	return pdat;
+}
+
+static void scheduler_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_scheduler_pdata_t * pdat = (struct wbt_scheduler_pdata_t *)data;
+
+	if(pdat)
+		free(pdat);
+}
+
+static void scheduler_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_scheduler_pdata_t * pdat = (struct wbt_scheduler_pdata_t *)data;
+	struct task_t * task;
+	uint64_t migrate = 0;
+	int i;
+
+	if(pdat)
+	{
+		for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+			pdat->migrate[i] = __sched[i].nr_migrate_in;
+
+		/*
+		 * Every worker starts on the first cpu, the load balancer
+		 * should spread them over the others.
+		 */
+		for(i = 0; i < SCHEDULER_WORKERS; i++)
+		{
+			workers[i].pdat = pdat;
+			workers[i].index = i;
+			task = task_create(&__sched[0], "wbt-sched", scheduler_worker_task, &workers[i], SZ_64K, 0);
+			assert_not_null(task);
+			if(task)
+				task_resume(task);
+			else
+				atomic_inc(&pdat->done);
+		}
+		while(atomic_get(&pdat->done) < SCHEDULER_WORKERS)
+			task_yield();
+
+		for(i = 0; i < SCHEDULER_WORKERS; i++)
+			wboxtest_print(" Worker%d: %lld loops, cpu mask 0x%x\r\n", i, pdat->loops[i], pdat->cpus[i]);
+		for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+		{
+			wboxtest_print(" CPU%d: migrate in %lld\r\n", i, __sched[i].nr_migrate_in - pdat->migrate[i]);
+			migrate += __sched[i].nr_migrate_in - pdat->migrate[i];
+		}
+		if(CONFIG_MAX_SMP_CPUS > 1)
+			assert_true(migrate > 0);
+	}
+}
+
+static struct wboxtest_t wbt_scheduler = {
+	.group	= "kernel",
+	.name	= "scheduler",
+	.setup	= scheduler_setup,
+	.clean	= scheduler_clean,
+	.run	= scheduler_run,
+};
+
+static __init void scheduler_wbt_init(void)
+{
+	register_wboxtest(&wbt_scheduler);
+}
+
+static __exit void scheduler_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_scheduler);
+}
+
+wboxtest_initcall(scheduler_wbt_init);
+wboxtest_exitcall(scheduler_wbt_exit);
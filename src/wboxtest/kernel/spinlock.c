@@ -0,0 +1,114 @@
+/*
+ * wboxtest/kernel/spinlock.c
+ */
+
+#include <wboxtest.h>
+
+#define SPINLOCK_LOOPS		(1000000)
+
+struct wbt_spinlock_pdata_t
+{
+	spinlock_t lock;
+	volatile uint64_t counter;
+	atomic_t done;
+
+	ktime_t t1;
+	ktime_t t2;
+};
+
+static void spinlock_worker_task(struct task_t * task, void * data)
+{
+	struct wbt_spinlock_pdata_t * pdat = (struct wbt_spinlock_pdata_t *)data;
+	int i;
+
+	for(i = 0; i < SPINLOCK_LOOPS; i++)
+	{
+		if(i & 0x7)
+		{
+			spin_lock(&pdat->lock);
+		}
+		else
+		{
+			while(!spin_trylock(&pdat->lock));
+		}
+		pdat->counter++;
+		spin_unlock(&pdat->lock);
+	}
+	atomic_inc(&pdat->done);
+}
+
+static void * spinlock_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_spinlock_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_spinlock_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	spin_lock_init(&pdat->lock);
+	pdat->counter = 0;
+	atomic_set(&pdat->done, 0);
+	return pdat;
+}
+
+static void spinlock_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_spinlock_pdata_t * pdat = (struct wbt_spinlock_pdata_t *)data;
+
+	if(pdat)
+		free(pdat);
+}
+
+static void spinlock_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_spinlock_pdata_t * pdat = (struct wbt_spinlock_pdata_t *)data;
+	struct task_t * task;
+	int64_t us;
+	int i;
+
+	if(pdat)
+	{
+		pdat->t1 = ktime_get();
+		for(i = 0; i < CONFIG_MAX_SMP_CPUS; i++)
+		{
+			task = task_create(&__sched[i], "wbt-spinlock", spinlock_worker_task, pdat, SZ_64K, 0);
+			assert_not_null(task);
+			if(task)
+				task_resume(task);
+			else
+				atomic_inc(&pdat->done);
+		}
+		while(atomic_get(&pdat->done) < CONFIG_MAX_SMP_CPUS)
+			task_yield();
+		pdat->t2 = ktime_get();
+
+		assert_equal(pdat->counter, (uint64_t)SPINLOCK_LOOPS * CONFIG_MAX_SMP_CPUS);
+		us = ktime_us_delta(pdat->t2, pdat->t1);
+		wboxtest_print(" Cpus: %d, Counter: %lld\r\n", CONFIG_MAX_SMP_CPUS, pdat->counter);
+		wboxtest_print(" Throughput: %lld locks/s\r\n", (us > 0) ? (int64_t)(pdat->counter * 1000000 / us) : 0);
+#if defined(CONFIG_SPINLOCK_STAT) && (CONFIG_SPINLOCK_STAT > 0)
+		wboxtest_print(" Contended: %u, Spins: %u\r\n", pdat->lock.contended, pdat->lock.spins);
+#endif
+	}
+}
+
+static struct wboxtest_t wbt_spinlock = {
+	.group	= "kernel",
+	.name	= "spinlock",
+	.setup	= spinlock_setup,
+	.clean	= spinlock_clean,
+	.run	= spinlock_run,
+};
+
+static __init void spinlock_wbt_init(void)
+{
+	register_wboxtest(&wbt_spinlock);
+}
+
+static __exit void spinlock_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_spinlock);
+}
+
+wboxtest_initcall(spinlock_wbt_init);
+wboxtest_exitcall(spinlock_wbt_exit);
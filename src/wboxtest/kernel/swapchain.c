@@ -0,0 +1,132 @@
+/*
+ * wboxtest/kernel/swapchain.c
+ */
+
+#include <wboxtest.h>
+
+#define SWAPCHAIN_FRAMES	(16)
+
+struct wbt_swapchain_pdata_t
+{
+	struct window_t * w;
+	struct surface_t * front;
+	struct surface_t * back;
+	int frame;
+};
+
+static void * swapchain_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_swapchain_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_swapchain_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	pdat->w = window_alloc(NULL, NULL, NULL);
+	if(!pdat->w)
+	{
+		free(pdat);
+		return NULL;
+	}
+	return pdat;
+}
+
+static void swapchain_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_swapchain_pdata_t * pdat = (struct wbt_swapchain_pdata_t *)data;
+
+	if(pdat)
+	{
+		window_free(pdat->w);
+		free(pdat);
+	}
+}
+
+static void swapchain_color(struct color_t * c, int frame)
+{
+	color_init(c, (frame * 16) & 0xff, 0x80, 0xff - ((frame * 16) & 0xff), 0xff);
+}
+
+/*
+ * Each frame repaints a square of its own, the ones of the frames before
+ * have to be carried over into the back buffer by the chain
+ */
+static void draw_swapchain(struct window_t * w, void * o)
+{
+	struct wbt_swapchain_pdata_t * pdat = (struct wbt_swapchain_pdata_t *)o;
+	struct color_t c;
+
+	pdat->back = w->s;
+	swapchain_color(&c, pdat->frame);
+	surface_clear(w->s, &c, pdat->frame * 16, 0, 16, 16);
+}
+
+static void swapchain_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_swapchain_pdata_t * pdat = (struct wbt_swapchain_pdata_t *)data;
+	struct window_t * w;
+	struct region_t r;
+	struct color_t c;
+	uint32_t * p;
+	int index, onscreen, misorder, lost, i;
+
+	if(pdat)
+	{
+		w = pdat->w;
+		if(w->chain.count < 2)
+		{
+			wboxtest_print(" The framebuffer can not flip, no swap chain\r\n");
+			return;
+		}
+		window_set_opaque(w, 1);
+		pdat->front = w->chain.s[w->chain.index];
+		index = w->chain.index;
+		onscreen = 0;
+		misorder = 0;
+		for(pdat->frame = 0; pdat->frame < SWAPCHAIN_FRAMES; pdat->frame++)
+		{
+			region_init(&r, pdat->frame * 16, 0, 16, 16);
+			window_region_list_clear(w);
+			window_region_list_add(w, &r);
+			pdat->back = NULL;
+			window_present(w, pdat, draw_swapchain);
+			index = (index + 1) % w->chain.count;
+			if(!pdat->back || (pdat->back == pdat->front))
+				onscreen++;
+			if((pdat->back != w->chain.s[index]) || (w->chain.index != index))
+				misorder++;
+			pdat->front = w->chain.s[w->chain.index];
+		}
+		assert_equal(onscreen, 0);
+		assert_equal(misorder, 0);
+		p = surface_get_pixels(pdat->front);
+		for(i = 0, lost = 0; i < SWAPCHAIN_FRAMES; i++)
+		{
+			swapchain_color(&c, i);
+			if(p[i * 16 + 8] != color_get_premult(&c))
+				lost++;
+		}
+		assert_equal(lost, 0);
+	}
+}
+
+static struct wboxtest_t wbt_swapchain = {
+	.group	= "kernel",
+	.name	= "swapchain",
+	.setup	= swapchain_setup,
+	.clean	= swapchain_clean,
+	.run	= swapchain_run,
+};
+
+static __init void swapchain_wbt_init(void)
+{
+	register_wboxtest(&wbt_swapchain);
+}
+
+static __exit void swapchain_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_swapchain);
+}
+
+wboxtest_initcall(swapchain_wbt_init);
+wboxtest_exitcall(swapchain_wbt_exit);
@@ -0,0 +1,111 @@
+/*
+ * wboxtest/kernel/timer.c
+ */
+
+#include <wboxtest.h>
+
+#define TIMER_TEST_COUNT	(6)
+
+struct wbt_timer_pdata_t
+{
+	struct timer_t timer[TIMER_TEST_COUNT];
+	ktime_t expires[TIMER_TEST_COUNT];
+	ktime_t fired[TIMER_TEST_COUNT];
+	atomic_t done;
+};
+
+static const int timer_interval_us[TIMER_TEST_COUNT] = {
+	300, 900, 5000, 50000, 400000, 1500000,
+};
+
+static int timer_test_function(struct timer_t * timer, void * data)
+{
+	struct wbt_timer_pdata_t * pdat = (struct wbt_timer_pdata_t *)data;
+	int i = timer - &pdat->timer[0];
+
+	pdat->fired[i] = ktime_get();
+	atomic_inc(&pdat->done);
+	return 0;
+}
+
+static void * timer_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_timer_pdata_t * pdat;
+	int i;
+
+	pdat = malloc(sizeof(struct wbt_timer_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	for(i = 0; i < TIMER_TEST_COUNT; i++)
+		timer_init(&pdat->timer[i], timer_test_function, pdat);
+	atomic_set(&pdat->done, 0);
+	return pdat;
+}
+
+static void timer_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_timer_pdata_t * pdat = (struct wbt_timer_pdata_t *)data;
+	int i;
+
+	if(pdat)
+	{
+		for(i = 0; i < TIMER_TEST_COUNT; i++)
+			timer_cancel(&pdat->timer[i]);
+		free(pdat);
+	}
+}
+
+static void timer_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_timer_pdata_t * pdat = (struct wbt_timer_pdata_t *)data;
+	s64_t slack = 2 * ((1LL << CONFIG_TIMER_WHEEL_SHIFT) / 1000) + 1000;
+	ktime_t now;
+	s64_t late;
+	int i;
+
+	if(pdat)
+	{
+		now = ktime_get();
+		for(i = 0; i < TIMER_TEST_COUNT; i++)
+		{
+			pdat->expires[i] = ktime_add_us(now, timer_interval_us[i]);
+			timer_start(&pdat->timer[i], now, us_to_ktime(timer_interval_us[i]));
+		}
+		timer_start_now(&pdat->timer[2], ms_to_ktime(1000));
+		timer_cancel(&pdat->timer[2]);
+		for(i = 0; (atomic_get(&pdat->done) < TIMER_TEST_COUNT - 1) && (i < 300); i++)
+			task_sleep(10 * 1000000);
+		assert_equal(atomic_get(&pdat->done), TIMER_TEST_COUNT - 1);
+
+		for(i = 0; i < TIMER_TEST_COUNT; i++)
+		{
+			if(i == 2)
+				continue;
+			late = ktime_us_delta(pdat->fired[i], pdat->expires[i]);
+			wboxtest_print(" Timer %dus: %lldus late\r\n", timer_interval_us[i], late);
+			assert_inrange(late, 0, slack);
+		}
+	}
+}
+
+static struct wboxtest_t wbt_timer = {
+	.group	= "kernel",
+	.name	= "timer",
+	.setup	= timer_setup,
+	.clean	= timer_clean,
+	.run	= timer_run,
+};
+
+static __init void timer_wbt_init(void)
+{
+	register_wboxtest(&wbt_timer);
+}
+
+static __exit void timer_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_timer);
+}
+
+wboxtest_initcall(timer_wbt_init);
+wboxtest_exitcall(timer_wbt_exit);
@@ -0,0 +1,112 @@
+/*
+ * wboxtest/kernel/waitqueue.c
+ */
+
+#include <wboxtest.h>
+
+struct wbt_waitqueue_pdata_t
+{
+	struct waitqueue_t wq;
+	volatile int produced;
+	volatile int consumed;
+	atomic_t done;
+};
+
+static void waitqueue_producer_task(struct task_t * task, void * data)
+{
+	struct wbt_waitqueue_pdata_t * pdat = (struct wbt_waitqueue_pdata_t *)data;
+	int i;
+
+	for(i = 0; i < 100; i++)
+	{
+		task_sleep(1000000);
+		pdat->produced++;
+		waitqueue_wakeup(&pdat->wq);
+	}
+	atomic_inc(&pdat->done);
+}
+
+static void * waitqueue_setup(struct wboxtest_t * wbt)
+{
+	struct wbt_waitqueue_pdata_t * pdat;
+
+	pdat = malloc(sizeof(struct wbt_waitqueue_pdata_t));
+	if(!pdat)
+		return NULL;
+
+	waitqueue_init(&pdat->wq);
+	pdat->produced = 0;
+	pdat->consumed = 0;
+	atomic_set(&pdat->done, 0);
+	return pdat;
+}
+
+static void waitqueue_clean(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_waitqueue_pdata_t * pdat = (struct wbt_waitqueue_pdata_t *)data;
+
+	if(pdat)
+		free(pdat);
+}
+
+static void waitqueue_run(struct wboxtest_t * wbt, void * data)
+{
+	struct wbt_waitqueue_pdata_t * pdat = (struct wbt_waitqueue_pdata_t *)data;
+	struct task_t * task;
+	ktime_t t1, t2;
+
+	if(pdat)
+	{
+		t1 = ktime_get();
+		task_sleep(20 * 1000000);
+		t2 = ktime_get();
+		wboxtest_print(" Sleep 20ms: %lldus\r\n", ktime_us_delta(t2, t1));
+		assert_true(ktime_us_delta(t2, t1) >= 20000);
+
+		t1 = ktime_get();
+		assert_equal(wait_event_timeout(&pdat->wq, pdat->produced > 0, 10 * 1000000), 0);
+		t2 = ktime_get();
+		assert_true(ktime_us_delta(t2, t1) >= 10000);
+		assert_true(list_empty(&pdat->wq.head));
+
+		task = task_create(NULL, "wbt-producer", waitqueue_producer_task, pdat, SZ_64K, 0);
+		assert_not_null(task);
+		if(task)
+		{
+			task_resume(task);
+			t1 = ktime_get();
+			while(pdat->consumed < 100)
+			{
+				if(!wait_event_timeout(&pdat->wq, pdat->produced > pdat->consumed, 1000 * 1000000))
+					break;
+				pdat->consumed++;
+			}
+			t2 = ktime_get();
+			wboxtest_print(" Consumed %d events in %lldus\r\n", pdat->consumed, ktime_us_delta(t2, t1));
+			assert_equal(pdat->consumed, 100);
+			while(atomic_get(&pdat->done) == 0)
+				task_sleep(1000000);
+		}
+	}
+}
+
+static struct wboxtest_t wbt_waitqueue = {
+	.group	= "kernel",
+	.name	= "waitqueue",
+	.setup	= waitqueue_setup,
+	.clean	= waitqueue_clean,
+	.run	= waitqueue_run,
+};
+
+static __init void waitqueue_wbt_init(void)
+{
+	register_wboxtest(&wbt_waitqueue);
+}
+
+static __exit void waitqueue_wbt_exit(void)
+{
+	unregister_wboxtest(&wbt_waitqueue);
+}
+
+wboxtest_initcall(waitqueue_wbt_init);
+wboxtest_exitcall(waitqueue_wbt_exit);